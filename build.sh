@@ -4,12 +4,30 @@ SOURCE_FILE=main.cpp
 OUTPUT_FILE=node.out
 
 BOOST_LIBRARIES="boost_chrono boost_context boost_filesystem boost_iostreams boost_locale boost_program_options boost_regex boost_serialization boost_system boost_thread boost_timer boost_wave boost_date_time boost_graph boost_random boost_exception"
-LIBRARIES="${BOOST_LIBRARIES} pthread jsoncpp microhttpd jsonrpccpp-common jsonrpccpp-server jsonrpccpp-client"
+LIBRARIES="${BOOST_LIBRARIES} pthread z jsoncpp microhttpd jsonrpccpp-common jsonrpccpp-server jsonrpccpp-client"
 LINK_RESULT=""
+EXTRA_FLAGS=""
+# main.cpp must be made with ./build.coffee --static_precomp
+if [ "${STATIC_PRECOMP}" == "1" ]; then
+  # marker from build.coffee, or the table itself in a main.cpp unfolded some other way
+  if ! grep -q "^#define BUILD_STATIC_PRECOMP$" ${SOURCE_FILE} && ! grep -Eq "ge_precomp base\[32\]\[8\] ?= ?\{" ${SOURCE_FILE}; then
+    echo "${SOURCE_FILE} has no static table, run ./build.coffee --static_precomp"
+    exit 1
+  fi
+  EXTRA_FLAGS="${EXTRA_FLAGS} -DED25519_STATIC_PRECOMP"
+fi
+# main.cpp must be made with ./build.coffee --fe51
+if [ "${FE51}" == "1" ]; then
+  if ! grep -q "^#define BUILD_FE51$" ${SOURCE_FILE} && ! grep -q "__int128" ${SOURCE_FILE}; then
+    echo "${SOURCE_FILE} has no fe51.c, run ./build.coffee --fe51"
+    exit 1
+  fi
+  EXTRA_FLAGS="${EXTRA_FLAGS} -DFE_RADIX51"
+fi
 for each in ${LIBRARIES}; do
   LINK_RESULT="${LINK_RESULT} -l${each}"
 done
 
-COMMAND="g++-9 ${SOURCE_FILE} -o ${OUTPUT_FILE} -pedantic -O2 -std=c++2a -fPIC ${LINK_RESULT}"
+COMMAND="g++-9 ${SOURCE_FILE} -o ${OUTPUT_FILE} -pedantic -O2 -std=c++2a -fPIC ${EXTRA_FLAGS} ${LINK_RESULT}"
 echo "execute command: ${COMMAND}"
 bash -c "${COMMAND}"
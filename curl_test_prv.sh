@@ -1,6 +1,7 @@
 #!/bin/bash
 curl --data-binary '{"id":1,"jsonrpc":"2.0","method":"bc_height"}' -H 'content-type:text/plain;' http://localhost:10002
 curl --data-binary '{"id":1,"jsonrpc":"2.0","method":"debug_key_gen"}' -H 'content-type:text/plain;' http://localhost:10002
+curl --data-binary '{"id":1,"jsonrpc":"2.0","method":"debug_key_gen_bulk","params":{"count": 3}}' -H 'content-type:text/plain;' http://localhost:10002
 # pub_key=d67b8af90684a7220be81fb3fa4a3477a4a8abf56dad3856f1a4687868b34343
 # prv_key=e89ecc5ea4e671941fe8b904b30b334793ff7d81f0f7bb44efb48f4eb2d47651906e8d78d7bcb26cb6f553556273ee9e6f9d812d4d697a7453c03fe74df1043f
 
@@ -46,6 +47,10 @@ curl --data-binary '{"id":1,"jsonrpc":"2.0","method":"get_tx_mining_mode","param
 curl --data-binary '{"id":1,"jsonrpc":"2.0","method":"set_tx_mining_mode","params":{"enabled": 1}}' -H 'content-type:text/plain;' http://localhost:10002
 curl --data-binary '{"id":1,"jsonrpc":"2.0","method":"get_tx_mining_mode","params":{}}' -H 'content-type:text/plain;' http://localhost:10002
 curl --data-binary '{"id":1,"jsonrpc":"2.0","method":"get_my_weight","params":{}}' -H 'content-type:text/plain;' http://localhost:10002
+curl --data-binary '{"id":1,"jsonrpc":"2.0","method":"debug_verify_bench","params":{"count": 2000}}' -H 'content-type:text/plain;' http://localhost:10002
+curl --data-binary '{"id":1,"jsonrpc":"2.0","method":"get_persist_stats"}' -H 'content-type:text/plain;' http://localhost:10002
+curl --data-binary '{"id":1,"jsonrpc":"2.0","method":"get_mempool_stats"}' -H 'content-type:text/plain;' http://localhost:10002
+curl --data-binary '{"id":1,"jsonrpc":"2.0","method":"debug_chain_rollback","params":{"count": 1}}' -H 'content-type:text/plain;' http://localhost:10002
 
 
 curl --data-binary '{"id":1,"jsonrpc":"2.0","method":"shutdown"}' -H 'content-type:text/plain;' http://localhost:10002
@@ -6,3 +6,10 @@ curl --data-binary '{"id":1,"jsonrpc":"2.0","method":"get_node_list"}' -H 'conte
 
 curl --data-binary '{"id":1,"jsonrpc":"2.0","method":"get_block_number", "params": {"id": 0}}' -H 'content-type:text/plain;' http://localhost:10001
 curl --data-binary '{"id":1,"jsonrpc":"2.0","method":"get_block_number", "params": {"id": 1}}' -H 'content-type:text/plain;' http://localhost:10001
+curl --data-binary '{"id":1,"jsonrpc":"2.0","method":"get_block_bin", "params": {"id": 0}}' -H 'content-type:text/plain;' http://localhost:10001
+curl --data-binary '{"id":1,"jsonrpc":"2.0","method":"get_block_by_hash", "params": {"hash": "00000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000"}}' -H 'content-type:text/plain;' http://localhost:10001
+curl --data-binary '{"id":1,"jsonrpc":"2.0","method":"get_tx_proof", "params": {"id": 1, "hash": "00000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000"}}' -H 'content-type:text/plain;' http://localhost:10001
+curl --data-binary '{"id":1,"jsonrpc":"2.0","method":"get_pack_info", "params": {"id": 0}}' -H 'content-type:text/plain;' http://localhost:10001
+curl --data-binary '{"id":1,"jsonrpc":"2.0","method":"get_weight_rank", "params": {"address": "0"}}' -H 'content-type:text/plain;' http://localhost:10001
+curl --data-binary '{"id":1,"jsonrpc":"2.0","method":"get_top_weights", "params": {"count": 10}}' -H 'content-type:text/plain;' http://localhost:10001
+curl -s http://localhost:10003/pack/0 | wc -c
@@ -25,25 +25,92 @@
 #include<algorithm>
 #include<vector>
 #include<unordered_map>
+#include<list>
+#include<map>
+#include<set>
+#include<memory>
+#include<deque>
+#include<queue>
+#include<tuple>
+#include<mutex>
+#include<condition_variable>
+#include<atomic>
+#include<functional>
 #include<cstring>
 #include<getopt.h>
+#include<sys/wait.h>
+#include<sys/socket.h>
+#include<sys/time.h>
+#include<sys/sendfile.h>
+#include<netinet/in.h>
+#include<zlib.h>
+#pragma push_macro("U")
+#pragma push_macro("V")
+#undef U
+#undef V
+#include<ext/pb_ds/assoc_container.hpp>
+#include<ext/pb_ds/tree_policy.hpp>
+#pragma pop_macro("U")
+#pragma pop_macro("V")
 #define FOR_COL(it,arr)for(auto it=arr.begin(),end=arr.end(); it !=end;++it)
 U std;U jsonrpc;U jsonrpc;U Json;
 #include <stddef.h>
-int ed25519_create_seed(u8*seed);void ed25519_create_keypair(u8*public_key,u8*private_key,C u8*seed);void ed25519_sign(u8*signature,C u8*message,size_t message_len,C u8*public_key,C u8*private_key);int ed25519_verify(C u8*signature,C u8*message,size_t message_len,C u8*public_key);void ed25519_add_scalar(u8*public_key,u8*private_key,C u8*scalar);void ed25519_key_exchange(u8*shared_secret,C u8*public_key,C u8*private_key);typedef Q fe[10];void fe_0(fe h);void fe_1(fe h);void fe_frombytes(fe h,C u8*s);void fe_tobytes(u8*s,C fe h);void fe_copy(fe h,C fe f);int fe_isnegative(C fe f);int fe_isnonzero(C fe f);void fe_cmov(fe f,C fe g,u32 b);void fe_cswap(fe f,fe g,u32 b);void fe_neg(fe h,C fe f);void fe_add(fe h,C fe f,C fe g);void fe_invert(fe out,C fe z);void fe_sq(fe h,C fe f);void fe_sq2(fe h,C fe f);void fe_mul(fe h,C fe f,C fe g);void fe_mul121666(fe h,fe f);void fe_pow22523(fe out,C fe z);void fe_sub(fe h,C fe f,C fe g);static u64 load_3(C u8*in){u64 result;result=(u64)in[0];result|=((u64)in[1])<<8;result|=((u64)in[2])<<16;E result;}static u64 load_4(C u8*in){u64 result;result=(u64)in[0];result|=((u64)in[1])<<8;result|=((u64)in[2])<<16;result|=((u64)in[3])<<24;E result;}void fe_0(fe h){h[0]=0;h[1]=0;h[2]=0;h[3]=0;h[4]=0;h[5]=0;h[6]=0;h[7]=0;h[8]=0;h[9]=0;}void fe_1(fe h){h[0]=1;h[1]=0;h[2]=0;h[3]=0;h[4]=0;h[5]=0;h[6]=0;h[7]=0;h[8]=0;h[9]=0;}void fe_add(fe h,C fe f,C fe g){Q f0=f[0];Q f1=f[1];Q f2=f[2];Q f3=f[3];Q f4=f[4];Q f5=f[5];Q f6=f[6];Q f7=f[7];Q f8=f[8];Q f9=f[9];Q g0=g[0];Q g1=g[1];Q g2=g[2];Q g3=g[3];Q g4=g[4];Q g5=g[5];Q g6=g[6];Q g7=g[7];Q g8=g[8];Q g9=g[9];Q h0=f0+g0;Q h1=f1+g1;Q h2=f2+g2;Q h3=f3+g3;Q h4=f4+g4;Q h5=f5+g5;Q h6=f6+g6;Q h7=f7+g7;Q h8=f8+g8;Q h9=f9+g9;h[0]=h0;h[1]=h1;h[2]=h2;h[3]=h3;h[4]=h4;h[5]=h5;h[6]=h6;h[7]=h7;h[8]=h8;h[9]=h9;}void fe_cmov(fe f,C fe g,u32 b){Q f0=f[0];Q f1=f[1];Q f2=f[2];Q f3=f[3];Q f4=f[4];Q f5=f[5];Q f6=f[6];Q f7=f[7];Q f8=f[8];Q f9=f[9];Q g0=g[0];Q g1=g[1];Q g2=g[2];Q g3=g[3];Q g4=g[4];Q g5=g[5];Q g6=g[6];Q g7=g[7];Q g8=g[8];Q g9=g[9];Q x0=f0^g0;Q x1=f1^g1;Q x2=f2^g2;Q x3=f3^g3;Q x4=f4^g4;Q x5=f5^g5;Q x6=f6^g6;Q x7=f7^g7;Q x8=f8^g8;Q x9=f9^g9;b=(u32)(-(int)b);x0 &=b;x1 &=b;x2 &=b;x3 &=b;x4 &=b;x5 &=b;x6 &=b;x7 &=b;x8 &=b;x9 &=b;f[0]=f0^x0;f[1]=f1^x1;f[2]=f2^x2;f[3]=f3^x3;f[4]=f4^x4;f[5]=f5^x5;f[6]=f6^x6;f[7]=f7^x7;f[8]=f8^x8;f[9]=f9^x9;}void fe_cswap(fe f,fe g,u32 b){Q f0=f[0];Q f1=f[1];Q f2=f[2];Q f3=f[3];Q f4=f[4];Q f5=f[5];Q f6=f[6];Q f7=f[7];Q f8=f[8];Q f9=f[9];Q g0=g[0];Q g1=g[1];Q g2=g[2];Q g3=g[3];Q g4=g[4];Q g5=g[5];Q g6=g[6];Q g7=g[7];Q g8=g[8];Q g9=g[9];Q x0=f0^g0;Q x1=f1^g1;Q x2=f2^g2;Q x3=f3^g3;Q x4=f4^g4;Q x5=f5^g5;Q x6=f6^g6;Q x7=f7^g7;Q x8=f8^g8;Q x9=f9^g9;b=(u32)(-(int)b);x0 &=b;x1 &=b;x2 &=b;x3 &=b;x4 &=b;x5 &=b;x6 &=b;x7 &=b;x8 &=b;x9 &=b;f[0]=f0^x0;f[1]=f1^x1;f[2]=f2^x2;f[3]=f3^x3;f[4]=f4^x4;f[5]=f5^x5;f[6]=f6^x6;f[7]=f7^x7;f[8]=f8^x8;f[9]=f9^x9;g[0]=g0^x0;g[1]=g1^x1;g[2]=g2^x2;g[3]=g3^x3;g[4]=g4^x4;g[5]=g5^x5;g[6]=g6^x6;g[7]=g7^x7;g[8]=g8^x8;g[9]=g9^x9;}void fe_copy(fe h,C fe f){Q f0=f[0];Q f1=f[1];Q f2=f[2];Q f3=f[3];Q f4=f[4];Q f5=f[5];Q f6=f[6];Q f7=f[7];Q f8=f[8];Q f9=f[9];h[0]=f0;h[1]=f1;h[2]=f2;h[3]=f3;h[4]=f4;h[5]=f5;h[6]=f6;h[7]=f7;h[8]=f8;h[9]=f9;}void fe_frombytes(fe h,C u8*s){I h0=load_4(s);I h1=load_3(s+4)<<6;I h2=load_3(s+7)<<5;I h3=load_3(s+10)<<3;I h4=load_3(s+13)<<2;I h5=load_4(s+16);I h6=load_3(s+20)<<7;I h7=load_3(s+23)<<5;I h8=load_3(s+26)<<4;I h9=(load_3(s+29)& 8388607)<<2;I L0;I L1;I L2;I L3;I L4;I L5;I L6;I L7;I L8;I L9;L9=(h9+(I)(1<<24))>>25;h0+=L9*19;h9-=L9<<25;L1=(h1+(I)(1<<24))>>25;h2+=L1;h1-=L1<<25;L3=(h3+(I)(1<<24))>>25;h4+=L3;h3-=L3<<25;L5=(h5+(I)(1<<24))>>25;h6+=L5;h5-=L5<<25;L7=(h7+(I)(1<<24))>>25;h8+=L7;h7-=L7<<25;L0=(h0+(I)(1<<25))>>26;h1+=L0;h0-=L0<<26;L2=(h2+(I)(1<<25))>>26;h3+=L2;h2-=L2<<26;L4=(h4+(I)(1<<25))>>26;h5+=L4;h4-=L4<<26;L6=(h6+(I)(1<<25))>>26;h7+=L6;h6-=L6<<26;L8=(h8+(I)(1<<25))>>26;h9+=L8;h8-=L8<<26;h[0]=(Q)h0;h[1]=(Q)h1;h[2]=(Q)h2;h[3]=(Q)h3;h[4]=(Q)h4;h[5]=(Q)h5;h[6]=(Q)h6;h[7]=(Q)h7;h[8]=(Q)h8;h[9]=(Q)h9;}void fe_invert(fe out,C fe z){fe t0;fe t1;fe t2;fe t3;int i;fe_sq(t0,z);for(i=1;i < 1;++i){fe_sq(t0,t0);}fe_sq(t1,t0);for(i=1;i < 2;++i){fe_sq(t1,t1);}fe_mul(t1,z,t1);fe_mul(t0,t0,t1);fe_sq(t2,t0);for(i=1;i < 1;++i){fe_sq(t2,t2);}fe_mul(t1,t1,t2);fe_sq(t2,t1);for(i=1;i < 5;++i){fe_sq(t2,t2);}fe_mul(t1,t2,t1);fe_sq(t2,t1);for(i=1;i < 10;++i){fe_sq(t2,t2);}fe_mul(t2,t2,t1);fe_sq(t3,t2);for(i=1;i < 20;++i){fe_sq(t3,t3);}fe_mul(t2,t3,t2);fe_sq(t2,t2);for(i=1;i < 10;++i){fe_sq(t2,t2);}fe_mul(t1,t2,t1);fe_sq(t2,t1);for(i=1;i < 50;++i){fe_sq(t2,t2);}fe_mul(t2,t2,t1);fe_sq(t3,t2);for(i=1;i < 100;++i){fe_sq(t3,t3);}fe_mul(t2,t3,t2);fe_sq(t2,t2);for(i=1;i < 50;++i){fe_sq(t2,t2);}fe_mul(t1,t2,t1);fe_sq(t1,t1);for(i=1;i < 5;++i){fe_sq(t1,t1);}fe_mul(out,t1,t0);}int fe_isnegative(C fe f){u8 s[32];fe_tobytes(s,f);E s[0] & 1;}int fe_isnonzero(C fe f){u8 s[32];u8 r;fe_tobytes(s,f);r=s[0];
+typedef struct ed25519_verify_context ed25519_verify_context;int ed25519_create_seed(u8*seed);int ed25519_create_seeds(u8*seeds,size_t num);void ed25519_create_keypair(u8*public_key,u8*private_key,C u8*seed);int ed25519_create_keypairs(u8*public_keys,u8*private_keys,C u8*seeds,size_t num);void ed25519_sign(u8*signature,C u8*message,size_t message_len,C u8*public_key,C u8*private_key);int ed25519_verify(C u8*signature,C u8*message,size_t message_len,C u8*public_key);int ed25519_verify_with_context(C u8*signature,C u8*message,size_t message_len,C ed25519_verify_context*context);int ed25519_verify_context_init(ed25519_verify_context*context,C u8*public_key);int ed25519_verify_batch(C u8**signatures,C u8**messages,C size_t*message_lens,C u8**public_keys,size_t num,int*valid);void ed25519_add_scalar(u8*public_key,u8*private_key,C u8*scalar);void ed25519_key_exchange(u8*shared_secret,C u8*public_key,C u8*private_key);
+#ifndef FE_RADIX51
+typedef Q fe[10];
+#define FE(...){__VA_ARGS__}
+#endif
+#ifdef FE_RADIX51
+typedef u64 fe[5];
+#define FE51_LIMB(lo,hi,p2)((u64)((i64)(lo)+(i64)(hi)*(1<<26)+(i64)(p2)))
+#define FE(t0,t1,t2,t3,t4,t5,t6,t7,t8,t9){FE51_LIMB(t0,t1,0xfffffffffffda),FE51_LIMB(t2,t3,0xffffffffffffe),FE51_LIMB(t4,t5,0xffffffffffffe),FE51_LIMB(t6,t7,0xffffffffffffe),FE51_LIMB(t8,t9,0xffffffffffffe)}
+#endif
+void fe_0(fe h);void fe_1(fe h);void fe_frombytes(fe h,C u8*s);void fe_tobytes(u8*s,C fe h);void fe_copy(fe h,C fe f);int fe_isnegative(C fe f);int fe_isnonzero(C fe f);void fe_cmov(fe f,C fe g,u32 b);void fe_cswap(fe f,fe g,u32 b);void fe_neg(fe h,C fe f);void fe_add(fe h,C fe f,C fe g);void fe_invert(fe out,C fe z);void fe_batch_invert(fe*out,C fe*z,size_t n);void fe_sq(fe h,C fe f);void fe_sq2(fe h,C fe f);void fe_mul(fe h,C fe f,C fe g);void fe_mul121666(fe h,fe f);void fe_pow22523(fe out,C fe z);void fe_sub(fe h,C fe f,C fe g);static u64 load_3(C u8*in){u64 result;result=(u64)in[0];result|=((u64)in[1])<<8;result|=((u64)in[2])<<16;E result;}static u64 load_4(C u8*in){u64 result;result=(u64)in[0];result|=((u64)in[1])<<8;result|=((u64)in[2])<<16;result|=((u64)in[3])<<24;E result;}
+#ifndef FE_RADIX51
+void fe_0(fe h){h[0]=0;h[1]=0;h[2]=0;h[3]=0;h[4]=0;h[5]=0;h[6]=0;h[7]=0;h[8]=0;h[9]=0;}void fe_1(fe h){h[0]=1;h[1]=0;h[2]=0;h[3]=0;h[4]=0;h[5]=0;h[6]=0;h[7]=0;h[8]=0;h[9]=0;}void fe_add(fe h,C fe f,C fe g){Q f0=f[0];Q f1=f[1];Q f2=f[2];Q f3=f[3];Q f4=f[4];Q f5=f[5];Q f6=f[6];Q f7=f[7];Q f8=f[8];Q f9=f[9];Q g0=g[0];Q g1=g[1];Q g2=g[2];Q g3=g[3];Q g4=g[4];Q g5=g[5];Q g6=g[6];Q g7=g[7];Q g8=g[8];Q g9=g[9];Q h0=f0+g0;Q h1=f1+g1;Q h2=f2+g2;Q h3=f3+g3;Q h4=f4+g4;Q h5=f5+g5;Q h6=f6+g6;Q h7=f7+g7;Q h8=f8+g8;Q h9=f9+g9;h[0]=h0;h[1]=h1;h[2]=h2;h[3]=h3;h[4]=h4;h[5]=h5;h[6]=h6;h[7]=h7;h[8]=h8;h[9]=h9;}void fe_cmov(fe f,C fe g,u32 b){Q f0=f[0];Q f1=f[1];Q f2=f[2];Q f3=f[3];Q f4=f[4];Q f5=f[5];Q f6=f[6];Q f7=f[7];Q f8=f[8];Q f9=f[9];Q g0=g[0];Q g1=g[1];Q g2=g[2];Q g3=g[3];Q g4=g[4];Q g5=g[5];Q g6=g[6];Q g7=g[7];Q g8=g[8];Q g9=g[9];Q x0=f0^g0;Q x1=f1^g1;Q x2=f2^g2;Q x3=f3^g3;Q x4=f4^g4;Q x5=f5^g5;Q x6=f6^g6;Q x7=f7^g7;Q x8=f8^g8;Q x9=f9^g9;b=(u32)(-(int)b);x0 &=b;x1 &=b;x2 &=b;x3 &=b;x4 &=b;x5 &=b;x6 &=b;x7 &=b;x8 &=b;x9 &=b;f[0]=f0^x0;f[1]=f1^x1;f[2]=f2^x2;f[3]=f3^x3;f[4]=f4^x4;f[5]=f5^x5;f[6]=f6^x6;f[7]=f7^x7;f[8]=f8^x8;f[9]=f9^x9;}void fe_cswap(fe f,fe g,u32 b){Q f0=f[0];Q f1=f[1];Q f2=f[2];Q f3=f[3];Q f4=f[4];Q f5=f[5];Q f6=f[6];Q f7=f[7];Q f8=f[8];Q f9=f[9];Q g0=g[0];Q g1=g[1];Q g2=g[2];Q g3=g[3];Q g4=g[4];Q g5=g[5];Q g6=g[6];Q g7=g[7];Q g8=g[8];Q g9=g[9];Q x0=f0^g0;Q x1=f1^g1;Q x2=f2^g2;Q x3=f3^g3;Q x4=f4^g4;Q x5=f5^g5;Q x6=f6^g6;Q x7=f7^g7;Q x8=f8^g8;Q x9=f9^g9;b=(u32)(-(int)b);x0 &=b;x1 &=b;x2 &=b;x3 &=b;x4 &=b;x5 &=b;x6 &=b;x7 &=b;x8 &=b;x9 &=b;f[0]=f0^x0;f[1]=f1^x1;f[2]=f2^x2;f[3]=f3^x3;f[4]=f4^x4;f[5]=f5^x5;f[6]=f6^x6;f[7]=f7^x7;f[8]=f8^x8;f[9]=f9^x9;g[0]=g0^x0;g[1]=g1^x1;g[2]=g2^x2;g[3]=g3^x3;g[4]=g4^x4;g[5]=g5^x5;g[6]=g6^x6;g[7]=g7^x7;g[8]=g8^x8;g[9]=g9^x9;}void fe_copy(fe h,C fe f){Q f0=f[0];Q f1=f[1];Q f2=f[2];Q f3=f[3];Q f4=f[4];Q f5=f[5];Q f6=f[6];Q f7=f[7];Q f8=f[8];Q f9=f[9];h[0]=f0;h[1]=f1;h[2]=f2;h[3]=f3;h[4]=f4;h[5]=f5;h[6]=f6;h[7]=f7;h[8]=f8;h[9]=f9;}void fe_frombytes(fe h,C u8*s){I h0=load_4(s);I h1=load_3(s+4)<<6;I h2=load_3(s+7)<<5;I h3=load_3(s+10)<<3;I h4=load_3(s+13)<<2;I h5=load_4(s+16);I h6=load_3(s+20)<<7;I h7=load_3(s+23)<<5;I h8=load_3(s+26)<<4;I h9=(load_3(s+29)& 8388607)<<2;I L0;I L1;I L2;I L3;I L4;I L5;I L6;I L7;I L8;I L9;L9=(h9+(I)(1<<24))>>25;h0+=L9*19;h9-=L9<<25;L1=(h1+(I)(1<<24))>>25;h2+=L1;h1-=L1<<25;L3=(h3+(I)(1<<24))>>25;h4+=L3;h3-=L3<<25;L5=(h5+(I)(1<<24))>>25;h6+=L5;h5-=L5<<25;L7=(h7+(I)(1<<24))>>25;h8+=L7;h7-=L7<<25;L0=(h0+(I)(1<<25))>>26;h1+=L0;h0-=L0<<26;L2=(h2+(I)(1<<25))>>26;h3+=L2;h2-=L2<<26;L4=(h4+(I)(1<<25))>>26;h5+=L4;h4-=L4<<26;L6=(h6+(I)(1<<25))>>26;h7+=L6;h6-=L6<<26;L8=(h8+(I)(1<<25))>>26;h9+=L8;h8-=L8<<26;h[0]=(Q)h0;h[1]=(Q)h1;h[2]=(Q)h2;h[3]=(Q)h3;h[4]=(Q)h4;h[5]=(Q)h5;h[6]=(Q)h6;h[7]=(Q)h7;h[8]=(Q)h8;h[9]=(Q)h9;}
+#endif
+void fe_invert(fe out,C fe z){fe t0;fe t1;fe t2;fe t3;int i;fe_sq(t0,z);for(i=1;i < 1;++i){fe_sq(t0,t0);}fe_sq(t1,t0);for(i=1;i < 2;++i){fe_sq(t1,t1);}fe_mul(t1,z,t1);fe_mul(t0,t0,t1);fe_sq(t2,t0);for(i=1;i < 1;++i){fe_sq(t2,t2);}fe_mul(t1,t1,t2);fe_sq(t2,t1);for(i=1;i < 5;++i){fe_sq(t2,t2);}fe_mul(t1,t2,t1);fe_sq(t2,t1);for(i=1;i < 10;++i){fe_sq(t2,t2);}fe_mul(t2,t2,t1);fe_sq(t3,t2);for(i=1;i < 20;++i){fe_sq(t3,t3);}fe_mul(t2,t3,t2);fe_sq(t2,t2);for(i=1;i < 10;++i){fe_sq(t2,t2);}fe_mul(t1,t2,t1);fe_sq(t2,t1);for(i=1;i < 50;++i){fe_sq(t2,t2);}fe_mul(t2,t2,t1);fe_sq(t3,t2);for(i=1;i < 100;++i){fe_sq(t3,t3);}fe_mul(t2,t3,t2);fe_sq(t2,t2);for(i=1;i < 50;++i){fe_sq(t2,t2);}fe_mul(t1,t2,t1);fe_sq(t1,t1);for(i=1;i < 5;++i){fe_sq(t1,t1);}fe_mul(out,t1,t0);}void fe_batch_invert(fe*out,C fe*z,size_t n){fe inv;size_t i;if(n==0){E;}fe_copy(out[0],z[0]);for(i=1;i < n;++i){fe_mul(out[i],out[i-1],z[i]);}fe_invert(inv,out[n-1]);for(i=n-1;i > 0;--i){fe_mul(out[i],inv,out[i-1]);fe_mul(inv,inv,z[i]);}fe_copy(out[0],inv);}
+#ifndef FE_RADIX51
+int fe_isnegative(C fe f){u8 s[32];fe_tobytes(s,f);E s[0] & 1;}int fe_isnonzero(C fe f){u8 s[32];u8 r;fe_tobytes(s,f);r=s[0];
 #define F(i)r|=s[i]
 F(1);F(2);F(3);F(4);F(5);F(6);F(7);F(8);F(9);F(10);F(11);F(12);F(13);F(14);F(15);F(16);F(17);F(18);F(19);F(20);F(21);F(22);F(23);F(24);F(25);F(26);F(27);F(28);F(29);F(30);F(31);
 #undef F
-E r !=0;}void fe_mul(fe h,C fe f,C fe g){Q f0=f[0];Q f1=f[1];Q f2=f[2];Q f3=f[3];Q f4=f[4];Q f5=f[5];Q f6=f[6];Q f7=f[7];Q f8=f[8];Q f9=f[9];Q g0=g[0];Q g1=g[1];Q g2=g[2];Q g3=g[3];Q g4=g[4];Q g5=g[5];Q g6=g[6];Q g7=g[7];Q g8=g[8];Q g9=g[9];Q g1_19=19*g1;Q g2_19=19*g2;Q g3_19=19*g3;Q g4_19=19*g4;Q g5_19=19*g5;Q g6_19=19*g6;Q g7_19=19*g7;Q g8_19=19*g8;Q g9_19=19*g9;Q f1_2=2*f1;Q f3_2=2*f3;Q f5_2=2*f5;Q f7_2=2*f7;Q f9_2=2*f9;I f0g0=f0*(I)g0;I f0g1=f0*(I)g1;I f0g2=f0*(I)g2;I f0g3=f0*(I)g3;I f0g4=f0*(I)g4;I f0g5=f0*(I)g5;I f0g6=f0*(I)g6;I f0g7=f0*(I)g7;I f0g8=f0*(I)g8;I f0g9=f0*(I)g9;I f1g0=f1*(I)g0;I f1g1_2=f1_2*(I)g1;I f1g2=f1*(I)g2;I f1g3_2=f1_2*(I)g3;I f1g4=f1*(I)g4;I f1g5_2=f1_2*(I)g5;I f1g6=f1*(I)g6;I f1g7_2=f1_2*(I)g7;I f1g8=f1*(I)g8;I f1g9_38=f1_2*(I)g9_19;I f2g0=f2*(I)g0;I f2g1=f2*(I)g1;I f2g2=f2*(I)g2;I f2g3=f2*(I)g3;I f2g4=f2*(I)g4;I f2g5=f2*(I)g5;I f2g6=f2*(I)g6;I f2g7=f2*(I)g7;I f2g8_19=f2*(I)g8_19;I f2g9_19=f2*(I)g9_19;I f3g0=f3*(I)g0;I f3g1_2=f3_2*(I)g1;I f3g2=f3*(I)g2;I f3g3_2=f3_2*(I)g3;I f3g4=f3*(I)g4;I f3g5_2=f3_2*(I)g5;I f3g6=f3*(I)g6;I f3g7_38=f3_2*(I)g7_19;I f3g8_19=f3*(I)g8_19;I f3g9_38=f3_2*(I)g9_19;I f4g0=f4*(I)g0;I f4g1=f4*(I)g1;I f4g2=f4*(I)g2;I f4g3=f4*(I)g3;I f4g4=f4*(I)g4;I f4g5=f4*(I)g5;I f4g6_19=f4*(I)g6_19;I f4g7_19=f4*(I)g7_19;I f4g8_19=f4*(I)g8_19;I f4g9_19=f4*(I)g9_19;I f5g0=f5*(I)g0;I f5g1_2=f5_2*(I)g1;I f5g2=f5*(I)g2;I f5g3_2=f5_2*(I)g3;I f5g4=f5*(I)g4;I f5g5_38=f5_2*(I)g5_19;I f5g6_19=f5*(I)g6_19;I f5g7_38=f5_2*(I)g7_19;I f5g8_19=f5*(I)g8_19;I f5g9_38=f5_2*(I)g9_19;I f6g0=f6*(I)g0;I f6g1=f6*(I)g1;I f6g2=f6*(I)g2;I f6g3=f6*(I)g3;I f6g4_19=f6*(I)g4_19;I f6g5_19=f6*(I)g5_19;I f6g6_19=f6*(I)g6_19;I f6g7_19=f6*(I)g7_19;I f6g8_19=f6*(I)g8_19;I f6g9_19=f6*(I)g9_19;I f7g0=f7*(I)g0;I f7g1_2=f7_2*(I)g1;I f7g2=f7*(I)g2;I f7g3_38=f7_2*(I)g3_19;I f7g4_19=f7*(I)g4_19;I f7g5_38=f7_2*(I)g5_19;I f7g6_19=f7*(I)g6_19;I f7g7_38=f7_2*(I)g7_19;I f7g8_19=f7*(I)g8_19;I f7g9_38=f7_2*(I)g9_19;I f8g0=f8*(I)g0;I f8g1=f8*(I)g1;I f8g2_19=f8*(I)g2_19;I f8g3_19=f8*(I)g3_19;I f8g4_19=f8*(I)g4_19;I f8g5_19=f8*(I)g5_19;I f8g6_19=f8*(I)g6_19;I f8g7_19=f8*(I)g7_19;I f8g8_19=f8*(I)g8_19;I f8g9_19=f8*(I)g9_19;I f9g0=f9*(I)g0;I f9g1_38=f9_2*(I)g1_19;I f9g2_19=f9*(I)g2_19;I f9g3_38=f9_2*(I)g3_19;I f9g4_19=f9*(I)g4_19;I f9g5_38=f9_2*(I)g5_19;I f9g6_19=f9*(I)g6_19;I f9g7_38=f9_2*(I)g7_19;I f9g8_19=f9*(I)g8_19;I f9g9_38=f9_2*(I)g9_19;I h0=f0g0+f1g9_38+f2g8_19+f3g7_38+f4g6_19+f5g5_38+f6g4_19+f7g3_38+f8g2_19+f9g1_38;I h1=f0g1+f1g0+f2g9_19+f3g8_19+f4g7_19+f5g6_19+f6g5_19+f7g4_19+f8g3_19+f9g2_19;I h2=f0g2+f1g1_2+f2g0+f3g9_38+f4g8_19+f5g7_38+f6g6_19+f7g5_38+f8g4_19+f9g3_38;I h3=f0g3+f1g2+f2g1+f3g0+f4g9_19+f5g8_19+f6g7_19+f7g6_19+f8g5_19+f9g4_19;I h4=f0g4+f1g3_2+f2g2+f3g1_2+f4g0+f5g9_38+f6g8_19+f7g7_38+f8g6_19+f9g5_38;I h5=f0g5+f1g4+f2g3+f3g2+f4g1+f5g0+f6g9_19+f7g8_19+f8g7_19+f9g6_19;I h6=f0g6+f1g5_2+f2g4+f3g3_2+f4g2+f5g1_2+f6g0+f7g9_38+f8g8_19+f9g7_38;I h7=f0g7+f1g6+f2g5+f3g4+f4g3+f5g2+f6g1+f7g0+f8g9_19+f9g8_19;I h8=f0g8+f1g7_2+f2g6+f3g5_2+f4g4+f5g3_2+f6g2+f7g1_2+f8g0+f9g9_38;I h9=f0g9+f1g8+f2g7+f3g6+f4g5+f5g4+f6g3+f7g2+f8g1+f9g0;I L0;I L1;I L2;I L3;I L4;I L5;I L6;I L7;I L8;I L9;L0=(h0+(I)(1<<25))>>26;h1+=L0;h0-=L0<<26;L4=(h4+(I)(1<<25))>>26;h5+=L4;h4-=L4<<26;L1=(h1+(I)(1<<24))>>25;h2+=L1;h1-=L1<<25;L5=(h5+(I)(1<<24))>>25;h6+=L5;h5-=L5<<25;L2=(h2+(I)(1<<25))>>26;h3+=L2;h2-=L2<<26;L6=(h6+(I)(1<<25))>>26;h7+=L6;h6-=L6<<26;L3=(h3+(I)(1<<24))>>25;h4+=L3;h3-=L3<<25;L7=(h7+(I)(1<<24))>>25;h8+=L7;h7-=L7<<25;L4=(h4+(I)(1<<25))>>26;h5+=L4;h4-=L4<<26;L8=(h8+(I)(1<<25))>>26;h9+=L8;h8-=L8<<26;L9=(h9+(I)(1<<24))>>25;h0+=L9*19;h9-=L9<<25;L0=(h0+(I)(1<<25))>>26;h1+=L0;h0-=L0<<26;h[0]=(Q)h0;h[1]=(Q)h1;h[2]=(Q)h2;h[3]=(Q)h3;h[4]=(Q)h4;h[5]=(Q)h5;h[6]=(Q)h6;h[7]=(Q)h7;h[8]=(Q)h8;h[9]=(Q)h9;}void fe_mul121666(fe h,fe f){Q f0=f[0];Q f1=f[1];Q f2=f[2];Q f3=f[3];Q f4=f[4];Q f5=f[5];Q f6=f[6];Q f7=f[7];Q f8=f[8];Q f9=f[9];I h0=f0*(I)121666;I h1=f1*(I)121666;I h2=f2*(I)121666;I h3=f3*(I)121666;I h4=f4*(I)121666;I h5=f5*(I)121666;I h6=f6*(I)121666;I h7=f7*(I)121666;I h8=f8*(I)121666;I h9=f9*(I)121666;I L0;I L1;I L2;I L3;I L4;I L5;I L6;I L7;I L8;I L9;L9=(h9+(I)(1<<24))>>25;h0+=L9*19;h9-=L9<<25;L1=(h1+(I)(1<<24))>>25;h2+=L1;h1-=L1<<25;L3=(h3+(I)(1<<24))>>25;h4+=L3;h3-=L3<<25;L5=(h5+(I)(1<<24))>>25;h6+=L5;h5-=L5<<25;L7=(h7+(I)(1<<24))>>25;h8+=L7;h7-=L7<<25;L0=(h0+(I)(1<<25))>>26;h1+=L0;h0-=L0<<26;L2=(h2+(I)(1<<25))>>26;h3+=L2;h2-=L2<<26;L4=(h4+(I)(1<<25))>>26;h5+=L4;h4-=L4<<26;L6=(h6+(I)(1<<25))>>26;h7+=L6;h6-=L6<<26;L8=(h8+(I)(1<<25))>>26;h9+=L8;h8-=L8<<26;h[0]=(Q)h0;h[1]=(Q)h1;h[2]=(Q)h2;h[3]=(Q)h3;h[4]=(Q)h4;h[5]=(Q)h5;h[6]=(Q)h6;h[7]=(Q)h7;h[8]=(Q)h8;h[9]=(Q)h9;}void fe_neg(fe h,C fe f){Q f0=f[0];Q f1=f[1];Q f2=f[2];Q f3=f[3];Q f4=f[4];Q f5=f[5];Q f6=f[6];Q f7=f[7];Q f8=f[8];Q f9=f[9];Q h0=-f0;Q h1=-f1;Q h2=-f2;Q h3=-f3;Q h4=-f4;Q h5=-f5;Q h6=-f6;Q h7=-f7;Q h8=-f8;Q h9=-f9;h[0]=h0;h[1]=h1;h[2]=h2;h[3]=h3;h[4]=h4;h[5]=h5;h[6]=h6;h[7]=h7;h[8]=h8;h[9]=h9;}void fe_pow22523(fe out,C fe z){fe t0;fe t1;fe t2;int i;fe_sq(t0,z);for(i=1;i < 1;++i){fe_sq(t0,t0);}fe_sq(t1,t0);for(i=1;i < 2;++i){fe_sq(t1,t1);}fe_mul(t1,z,t1);fe_mul(t0,t0,t1);fe_sq(t0,t0);for(i=1;i < 1;++i){fe_sq(t0,t0);}fe_mul(t0,t1,t0);fe_sq(t1,t0);for(i=1;i < 5;++i){fe_sq(t1,t1);}fe_mul(t0,t1,t0);fe_sq(t1,t0);for(i=1;i < 10;++i){fe_sq(t1,t1);}fe_mul(t1,t1,t0);fe_sq(t2,t1);for(i=1;i < 20;++i){fe_sq(t2,t2);}fe_mul(t1,t2,t1);fe_sq(t1,t1);for(i=1;i < 10;++i){fe_sq(t1,t1);}fe_mul(t0,t1,t0);fe_sq(t1,t0);for(i=1;i < 50;++i){fe_sq(t1,t1);}fe_mul(t1,t1,t0);fe_sq(t2,t1);for(i=1;i < 100;++i){fe_sq(t2,t2);}fe_mul(t1,t2,t1);fe_sq(t1,t1);for(i=1;i < 50;++i){fe_sq(t1,t1);}fe_mul(t0,t1,t0);fe_sq(t0,t0);for(i=1;i < 2;++i){fe_sq(t0,t0);}fe_mul(out,t0,z);E;}void fe_sq(fe h,C fe f){Q f0=f[0];Q f1=f[1];Q f2=f[2];Q f3=f[3];Q f4=f[4];Q f5=f[5];Q f6=f[6];Q f7=f[7];Q f8=f[8];Q f9=f[9];Q f0_2=2*f0;Q f1_2=2*f1;Q f2_2=2*f2;Q f3_2=2*f3;Q f4_2=2*f4;Q f5_2=2*f5;Q f6_2=2*f6;Q f7_2=2*f7;Q f5_38=38*f5;Q f6_19=19*f6;Q f7_38=38*f7;Q f8_19=19*f8;Q f9_38=38*f9;I f0f0=f0*(I)f0;I f0f1_2=f0_2*(I)f1;I f0f2_2=f0_2*(I)f2;I f0f3_2=f0_2*(I)f3;I f0f4_2=f0_2*(I)f4;I f0f5_2=f0_2*(I)f5;I f0f6_2=f0_2*(I)f6;I f0f7_2=f0_2*(I)f7;I f0f8_2=f0_2*(I)f8;I f0f9_2=f0_2*(I)f9;I f1f1_2=f1_2*(I)f1;I f1f2_2=f1_2*(I)f2;I f1f3_4=f1_2*(I)f3_2;I f1f4_2=f1_2*(I)f4;I f1f5_4=f1_2*(I)f5_2;I f1f6_2=f1_2*(I)f6;I f1f7_4=f1_2*(I)f7_2;I f1f8_2=f1_2*(I)f8;I f1f9_76=f1_2*(I)f9_38;I f2f2=f2*(I)f2;I f2f3_2=f2_2*(I)f3;I f2f4_2=f2_2*(I)f4;I f2f5_2=f2_2*(I)f5;I f2f6_2=f2_2*(I)f6;I f2f7_2=f2_2*(I)f7;I f2f8_38=f2_2*(I)f8_19;I f2f9_38=f2*(I)f9_38;I f3f3_2=f3_2*(I)f3;I f3f4_2=f3_2*(I)f4;I f3f5_4=f3_2*(I)f5_2;I f3f6_2=f3_2*(I)f6;I f3f7_76=f3_2*(I)f7_38;I f3f8_38=f3_2*(I)f8_19;I f3f9_76=f3_2*(I)f9_38;I f4f4=f4*(I)f4;I f4f5_2=f4_2*(I)f5;I f4f6_38=f4_2*(I)f6_19;I f4f7_38=f4*(I)f7_38;I f4f8_38=f4_2*(I)f8_19;I f4f9_38=f4*(I)f9_38;I f5f5_38=f5*(I)f5_38;I f5f6_38=f5_2*(I)f6_19;I f5f7_76=f5_2*(I)f7_38;I f5f8_38=f5_2*(I)f8_19;I f5f9_76=f5_2*(I)f9_38;I f6f6_19=f6*(I)f6_19;I f6f7_38=f6*(I)f7_38;I f6f8_38=f6_2*(I)f8_19;I f6f9_38=f6*(I)f9_38;I f7f7_38=f7*(I)f7_38;I f7f8_38=f7_2*(I)f8_19;I f7f9_76=f7_2*(I)f9_38;I f8f8_19=f8*(I)f8_19;I f8f9_38=f8*(I)f9_38;I f9f9_38=f9*(I)f9_38;I h0=f0f0+f1f9_76+f2f8_38+f3f7_76+f4f6_38+f5f5_38;I h1=f0f1_2+f2f9_38+f3f8_38+f4f7_38+f5f6_38;I h2=f0f2_2+f1f1_2+f3f9_76+f4f8_38+f5f7_76+f6f6_19;I h3=f0f3_2+f1f2_2+f4f9_38+f5f8_38+f6f7_38;I h4=f0f4_2+f1f3_4+f2f2+f5f9_76+f6f8_38+f7f7_38;I h5=f0f5_2+f1f4_2+f2f3_2+f6f9_38+f7f8_38;I h6=f0f6_2+f1f5_4+f2f4_2+f3f3_2+f7f9_76+f8f8_19;I h7=f0f7_2+f1f6_2+f2f5_2+f3f4_2+f8f9_38;I h8=f0f8_2+f1f7_4+f2f6_2+f3f5_4+f4f4+f9f9_38;I h9=f0f9_2+f1f8_2+f2f7_2+f3f6_2+f4f5_2;I L0;I L1;I L2;I L3;I L4;I L5;I L6;I L7;I L8;I L9;L0=(h0+(I)(1<<25))>>26;h1+=L0;h0-=L0<<26;L4=(h4+(I)(1<<25))>>26;h5+=L4;h4-=L4<<26;L1=(h1+(I)(1<<24))>>25;h2+=L1;h1-=L1<<25;L5=(h5+(I)(1<<24))>>25;h6+=L5;h5-=L5<<25;L2=(h2+(I)(1<<25))>>26;h3+=L2;h2-=L2<<26;L6=(h6+(I)(1<<25))>>26;h7+=L6;h6-=L6<<26;L3=(h3+(I)(1<<24))>>25;h4+=L3;h3-=L3<<25;L7=(h7+(I)(1<<24))>>25;h8+=L7;h7-=L7<<25;L4=(h4+(I)(1<<25))>>26;h5+=L4;h4-=L4<<26;L8=(h8+(I)(1<<25))>>26;h9+=L8;h8-=L8<<26;L9=(h9+(I)(1<<24))>>25;h0+=L9*19;h9-=L9<<25;L0=(h0+(I)(1<<25))>>26;h1+=L0;h0-=L0<<26;h[0]=(Q)h0;h[1]=(Q)h1;h[2]=(Q)h2;h[3]=(Q)h3;h[4]=(Q)h4;h[5]=(Q)h5;h[6]=(Q)h6;h[7]=(Q)h7;h[8]=(Q)h8;h[9]=(Q)h9;}void fe_sq2(fe h,C fe f){Q f0=f[0];Q f1=f[1];Q f2=f[2];Q f3=f[3];Q f4=f[4];Q f5=f[5];Q f6=f[6];Q f7=f[7];Q f8=f[8];Q f9=f[9];Q f0_2=2*f0;Q f1_2=2*f1;Q f2_2=2*f2;Q f3_2=2*f3;Q f4_2=2*f4;Q f5_2=2*f5;Q f6_2=2*f6;Q f7_2=2*f7;Q f5_38=38*f5;Q f6_19=19*f6;Q f7_38=38*f7;Q f8_19=19*f8;Q f9_38=38*f9;I f0f0=f0*(I)f0;I f0f1_2=f0_2*(I)f1;I f0f2_2=f0_2*(I)f2;I f0f3_2=f0_2*(I)f3;I f0f4_2=f0_2*(I)f4;I f0f5_2=f0_2*(I)f5;I f0f6_2=f0_2*(I)f6;I f0f7_2=f0_2*(I)f7;I f0f8_2=f0_2*(I)f8;I f0f9_2=f0_2*(I)f9;I f1f1_2=f1_2*(I)f1;I f1f2_2=f1_2*(I)f2;I f1f3_4=f1_2*(I)f3_2;I f1f4_2=f1_2*(I)f4;I f1f5_4=f1_2*(I)f5_2;I f1f6_2=f1_2*(I)f6;I f1f7_4=f1_2*(I)f7_2;I f1f8_2=f1_2*(I)f8;I f1f9_76=f1_2*(I)f9_38;I f2f2=f2*(I)f2;I f2f3_2=f2_2*(I)f3;I f2f4_2=f2_2*(I)f4;I f2f5_2=f2_2*(I)f5;I f2f6_2=f2_2*(I)f6;I f2f7_2=f2_2*(I)f7;I f2f8_38=f2_2*(I)f8_19;I f2f9_38=f2*(I)f9_38;I f3f3_2=f3_2*(I)f3;I f3f4_2=f3_2*(I)f4;I f3f5_4=f3_2*(I)f5_2;I f3f6_2=f3_2*(I)f6;I f3f7_76=f3_2*(I)f7_38;I f3f8_38=f3_2*(I)f8_19;I f3f9_76=f3_2*(I)f9_38;I f4f4=f4*(I)f4;I f4f5_2=f4_2*(I)f5;I f4f6_38=f4_2*(I)f6_19;I f4f7_38=f4*(I)f7_38;I f4f8_38=f4_2*(I)f8_19;I f4f9_38=f4*(I)f9_38;I f5f5_38=f5*(I)f5_38;I f5f6_38=f5_2*(I)f6_19;I f5f7_76=f5_2*(I)f7_38;I f5f8_38=f5_2*(I)f8_19;I f5f9_76=f5_2*(I)f9_38;I f6f6_19=f6*(I)f6_19;I f6f7_38=f6*(I)f7_38;I f6f8_38=f6_2*(I)f8_19;I f6f9_38=f6*(I)f9_38;I f7f7_38=f7*(I)f7_38;I f7f8_38=f7_2*(I)f8_19;I f7f9_76=f7_2*(I)f9_38;I f8f8_19=f8*(I)f8_19;I f8f9_38=f8*(I)f9_38;I f9f9_38=f9*(I)f9_38;I h0=f0f0+f1f9_76+f2f8_38+f3f7_76+f4f6_38+f5f5_38;I h1=f0f1_2+f2f9_38+f3f8_38+f4f7_38+f5f6_38;I h2=f0f2_2+f1f1_2+f3f9_76+f4f8_38+f5f7_76+f6f6_19;I h3=f0f3_2+f1f2_2+f4f9_38+f5f8_38+f6f7_38;I h4=f0f4_2+f1f3_4+f2f2+f5f9_76+f6f8_38+f7f7_38;I h5=f0f5_2+f1f4_2+f2f3_2+f6f9_38+f7f8_38;I h6=f0f6_2+f1f5_4+f2f4_2+f3f3_2+f7f9_76+f8f8_19;I h7=f0f7_2+f1f6_2+f2f5_2+f3f4_2+f8f9_38;I h8=f0f8_2+f1f7_4+f2f6_2+f3f5_4+f4f4+f9f9_38;I h9=f0f9_2+f1f8_2+f2f7_2+f3f6_2+f4f5_2;I L0;I L1;I L2;I L3;I L4;I L5;I L6;I L7;I L8;I L9;h0+=h0;h1+=h1;h2+=h2;h3+=h3;h4+=h4;h5+=h5;h6+=h6;h7+=h7;h8+=h8;h9+=h9;L0=(h0+(I)(1<<25))>>26;h1+=L0;h0-=L0<<26;L4=(h4+(I)(1<<25))>>26;h5+=L4;h4-=L4<<26;L1=(h1+(I)(1<<24))>>25;h2+=L1;h1-=L1<<25;L5=(h5+(I)(1<<24))>>25;h6+=L5;h5-=L5<<25;L2=(h2+(I)(1<<25))>>26;h3+=L2;h2-=L2<<26;L6=(h6+(I)(1<<25))>>26;h7+=L6;h6-=L6<<26;L3=(h3+(I)(1<<24))>>25;h4+=L3;h3-=L3<<25;L7=(h7+(I)(1<<24))>>25;h8+=L7;h7-=L7<<25;L4=(h4+(I)(1<<25))>>26;h5+=L4;h4-=L4<<26;L8=(h8+(I)(1<<25))>>26;h9+=L8;h8-=L8<<26;L9=(h9+(I)(1<<24))>>25;h0+=L9*19;h9-=L9<<25;L0=(h0+(I)(1<<25))>>26;h1+=L0;h0-=L0<<26;h[0]=(Q)h0;h[1]=(Q)h1;h[2]=(Q)h2;h[3]=(Q)h3;h[4]=(Q)h4;h[5]=(Q)h5;h[6]=(Q)h6;h[7]=(Q)h7;h[8]=(Q)h8;h[9]=(Q)h9;}void fe_sub(fe h,C fe f,C fe g){Q f0=f[0];Q f1=f[1];Q f2=f[2];Q f3=f[3];Q f4=f[4];Q f5=f[5];Q f6=f[6];Q f7=f[7];Q f8=f[8];Q f9=f[9];Q g0=g[0];Q g1=g[1];Q g2=g[2];Q g3=g[3];Q g4=g[4];Q g5=g[5];Q g6=g[6];Q g7=g[7];Q g8=g[8];Q g9=g[9];Q h0=f0-g0;Q h1=f1-g1;Q h2=f2-g2;Q h3=f3-g3;Q h4=f4-g4;Q h5=f5-g5;Q h6=f6-g6;Q h7=f7-g7;Q h8=f8-g8;Q h9=f9-g9;h[0]=h0;h[1]=h1;h[2]=h2;h[3]=h3;h[4]=h4;h[5]=h5;h[6]=h6;h[7]=h7;h[8]=h8;h[9]=h9;}void fe_tobytes(u8*s,C fe h){Q h0=h[0];Q h1=h[1];Q h2=h[2];Q h3=h[3];Q h4=h[4];Q h5=h[5];Q h6=h[6];Q h7=h[7];Q h8=h[8];Q h9=h[9];Q q;Q L0;Q L1;Q L2;Q L3;Q L4;Q L5;Q L6;Q L7;Q L8;Q L9;q=(19*h9+(((Q)1)<<24))>>25;q=(h0+q)>>26;q=(h1+q)>>25;q=(h2+q)>>26;q=(h3+q)>>25;q=(h4+q)>>26;q=(h5+q)>>25;q=(h6+q)>>26;q=(h7+q)>>25;q=(h8+q)>>26;q=(h9+q)>>25;h0+=19*q;L0=h0>>26;h1+=L0;h0-=L0<<26;L1=h1>>25;h2+=L1;h1-=L1<<25;L2=h2>>26;h3+=L2;h2-=L2<<26;L3=h3>>25;h4+=L3;h3-=L3<<25;L4=h4>>26;h5+=L4;h4-=L4<<26;L5=h5>>25;h6+=L5;h5-=L5<<25;L6=h6>>26;h7+=L6;h6-=L6<<26;L7=h7>>25;h8+=L7;h7-=L7<<25;L8=h8>>26;h9+=L8;h8-=L8<<26;L9=h9>>25;h9-=L9<<25;s[0]=(u8)(h0>>0);s[1]=(u8)(h0>>8);s[2]=(u8)(h0>>16);s[3]=(u8)((h0>>24)|(h1<<2));s[4]=(u8)(h1>>6);s[5]=(u8)(h1>>14);s[6]=(u8)((h1>>22)|(h2<<3));s[7]=(u8)(h2>>5);s[8]=(u8)(h2>>13);s[9]=(u8)((h2>>21)|(h3<<5));s[10]=(u8)(h3>>3);s[11]=(u8)(h3>>11);s[12]=(u8)((h3>>19)|(h4<<6));s[13]=(u8)(h4>>2);s[14]=(u8)(h4>>10);s[15]=(u8)(h4>>18);s[16]=(u8)(h5>>0);s[17]=(u8)(h5>>8);s[18]=(u8)(h5>>16);s[19]=(u8)((h5>>24)|(h6<<1));s[20]=(u8)(h6>>7);s[21]=(u8)(h6>>15);s[22]=(u8)((h6>>23)|(h7<<3));s[23]=(u8)(h7>>5);s[24]=(u8)(h7>>13);s[25]=(u8)((h7>>21)|(h8<<4));s[26]=(u8)(h8>>4);s[27]=(u8)(h8>>12);s[28]=(u8)((h8>>20)|(h9<<6));s[29]=(u8)(h9>>2);s[30]=(u8)(h9>>10);s[31]=(u8)(h9>>18);}typedef struct{fe X;fe Y;fe Z;}ge_p2;typedef struct{fe X;fe Y;fe Z;fe T;}ge_p3;typedef struct{fe X;fe Y;fe Z;fe T;}ge_p1p1;typedef struct{fe yplusx;fe yminusx;fe xy2d;}ge_precomp;typedef struct{fe YplusX;fe YminusX;fe Z;fe T2d;}ge_cached;void ge_p3_tobytes(u8*s,C ge_p3*h);void ge_tobytes(u8*s,C ge_p2*h);int ge_frombytes_negate_vartime(ge_p3*h,C u8*s);void ge_add(ge_p1p1*r,C ge_p3*p,C ge_cached*q);void ge_sub(ge_p1p1*r,C ge_p3*p,C ge_cached*q);void ge_double_scalarmult_vartime(ge_p2*r,C u8*a,C ge_p3*A,C u8*b);void ge_madd(ge_p1p1*r,C ge_p3*p,C ge_precomp*q);void ge_msub(ge_p1p1*r,C ge_p3*p,C ge_precomp*q);void ge_scalarmult_base(ge_p3*h,C u8*a);void ge_p1p1_to_p2(ge_p2*r,C ge_p1p1*p);void ge_p1p1_to_p3(ge_p3*r,C ge_p1p1*p);void ge_p2_0(ge_p2*h);void ge_p2_dbl(ge_p1p1*r,C ge_p2*p);void ge_p3_0(ge_p3*h);void ge_p3_dbl(ge_p1p1*r,C ge_p3*p);void ge_p3_to_cached(ge_cached*r,C ge_p3*p);void ge_p3_to_p2(ge_p2*r,C ge_p3*p);static C ge_precomp Bi[8]={{{25967493,-14356035,29566456,3660896,-12694345,4014787,27544626,-11754271,-6079156,2047605},{-12545711,934262,-2722910,3049990,-727428,9406986,12720692,5043384,19500929,-15469378},{-8738181,4489570,9688441,-14785194,10184609,-12363380,29287919,11864899,-24514362,-4438546},},{{15636291,-9688557,24204773,-7912398,616977,-16685262,27787600,-14772189,28944400,-1550024},{16568933,4717097,-11556148,-1102322,15682896,-11807043,16354577,-11775962,7689662,11199574},{30464156,-5976125,-11779434,-15670865,23220365,15915852,7512774,10017326,-17749093,-9920357},},{{10861363,11473154,27284546,1981175,-30064349,12577861,32867885,14515107,-15438304,10819380},{4708026,6336745,20377586,9066809,-11272109,6594696,-25653668,12483688,-12668491,5581306},{19563160,16186464,-29386857,4097519,10237984,-4348115,28542350,13850243,-23678021,-15815942},},{{5153746,9909285,1723747,-2777874,30523605,5516873,19480852,5230134,-23952439,-15175766},{-30269007,-3463509,7665486,10083793,28475525,1649722,20654025,16520125,30598449,7715701},{28881845,14381568,9657904,3680757,-20181635,7843316,-31400660,1370708,29794553,-1409300},},{{-22518993,-6692182,14201702,-8745502,-23510406,8844726,18474211,-1361450,-13062696,13821877},{-6455177,-7839871,3374702,-4740862,-27098617,-10571707,31655028,-7212327,18853322,-14220951},{4566830,-12963868,-28974889,-12240689,-7602672,-2830569,-8514358,-10431137,2207753,-3209784},},{{-25154831,-4185821,29681144,7868801,-6854661,-9423865,-12437364,-663000,-31111463,-16132436},{25576264,-2703214,7349804,-11814844,16472782,9300885,3844789,15725684,171356,6466918},{23103977,13316479,9739013,-16149481,817875,-15038942,8965339,-14088058,-30714912,16193877},},{{-33521811,3180713,-2394130,14003687,-16903474,-16270840,17238398,4729455,-18074513,9256800},{-25182317,-4174131,32336398,5036987,-21236817,11360617,22616405,9761698,-19827198,630305},{-13720693,2639453,-24237460,-7406481,9494427,-5774029,-6554551,-15960994,-2449256,-14291300},},{{-3151181,-5046075,9282714,6866145,-31907062,-863023,-18940575,15033784,25105118,-7894876},{-24326370,15950226,-31801215,-14592823,-11662737,-5090925,1573892,-2625887,2198790,-15804619},{-3099351,10324967,-2241613,7453183,-5446979,-2735503,-13812022,-16236442,-32461234,-12290683},},};// didn't find full solution yet
-static ge_precomp base[32][8];static int active_row;void cached_to_precomp(ge_precomp*preComp,ge_cached*cached){fe inverse;fe_invert(inverse,cached->Z);fe_mul(preComp->yminusx,cached->YminusX,inverse);fe_mul(preComp->yplusx,cached->YplusX,inverse);fe_mul(preComp->xy2d,cached->T2d,inverse);}void compute_row(ge_cached*b){ge_precomp result;ge_p3 p3;ge_p3_0(&p3);int j;for(j=0;j < 8;j++){ge_p1p1 p1p1;ge_cached cached;ge_add(&p1p1,& p3,b);ge_p1p1_to_p3(& p3,& p1p1);ge_p3_to_cached(& cached,& p3);cached_to_precomp(&result,&cached);base[active_row][j]=result;}}void compute_lookup_table(ge_cached*b){ge_p3 p3;ge_p2 p2;ge_p1p1 p1p1;ge_cached cached;ge_p3_0(&p3);ge_add(&p1p1,&p3,b);ge_p1p1_to_p3(&p3,&p1p1);int i,k;for(i=0;i < 32;i++){active_row=i;ge_p3_to_cached(&cached,&p3);compute_row(&cached);ge_p3_to_p2(&p2,&p3);for(k=0;k < 7;k++){ge_p2_dbl(&p1p1,&p2);ge_p1p1_to_p2(&p2,&p1p1);}ge_p2_dbl(& p1p1,& p2);ge_p1p1_to_p3(& p3,& p1p1);}}void LOOKT_write_lookup_table_to_flash(void){fe ypx={25967493,-14356035,29566456,3660896,-12694345,4014787,27544626,-11754271,-6079156,2047605};fe ymx={-12545711,934262,-2722910,3049990,-727428,9406986,12720692,5043384,19500929,-15469378};fe T2d={-8738181,4489570,9688441,-14785194,10184609,-12363380,29287919,11864899,-24514362,-4438546};fe Z;fe_1(Z);ge_cached Bi0;int p;for(p=0;p < 10;p++){Bi0.YplusX[p]=ypx[p];Bi0.YminusX[p]=ymx[p];Bi0.T2d[p]=T2d[p];Bi0.Z[p]=Z[p];}compute_lookup_table(&Bi0);}void ge_add(ge_p1p1*r,C ge_p3*p,C ge_cached*q){fe t0;fe_add(r->X,p->Y,p->X);fe_sub(r->Y,p->Y,p->X);fe_mul(r->Z,r->X,q->YplusX);fe_mul(r->Y,r->Y,q->YminusX);fe_mul(r->T,q->T2d,p->T);fe_mul(r->X,p->Z,q->Z);fe_add(t0,r->X,r->X);fe_sub(r->X,r->Z,r->Y);fe_add(r->Y,r->Z,r->Y);fe_add(r->Z,t0,r->T);fe_sub(r->T,t0,r->T);}static void slide(signed char*r,C u8*a){int i;int b;int k;for(i=0;i < 256;++i){r[i]=1 &(a[i>>3]>>(i & 7));}for(i=0;i < 256;++i)if(r[i]){for(b=1;b <=6 && i+b < 256;++b){if(r[i+b]){if(r[i]+(r[i+b]<<b)<=15){r[i]+=r[i+b]<<b;r[i+b]=0;}else if(r[i]-(r[i+b]<<b)>=-15){r[i]-=r[i+b]<<b;for(k=i+b;k < 256;++k){if(!r[k]){r[k]=1;break;}r[k]=0;}}else{break;}}}}}void ge_double_scalarmult_vartime(ge_p2*r,C u8*a,C ge_p3*A,C u8*b){signed char aslide[256];signed char bslide[256];ge_cached Ai[8];ge_p1p1 t;ge_p3 u;ge_p3 A2;int i;slide(aslide,a);slide(bslide,b);ge_p3_to_cached(&Ai[0],A);ge_p3_dbl(&t,A);ge_p1p1_to_p3(&A2,&t);ge_add(&t,&A2,&Ai[0]);ge_p1p1_to_p3(&u,&t);ge_p3_to_cached(&Ai[1],&u);ge_add(&t,&A2,&Ai[1]);ge_p1p1_to_p3(&u,&t);ge_p3_to_cached(&Ai[2],&u);ge_add(&t,&A2,&Ai[2]);ge_p1p1_to_p3(&u,&t);ge_p3_to_cached(&Ai[3],&u);ge_add(&t,&A2,&Ai[3]);ge_p1p1_to_p3(&u,&t);ge_p3_to_cached(&Ai[4],&u);ge_add(&t,&A2,&Ai[4]);ge_p1p1_to_p3(&u,&t);ge_p3_to_cached(&Ai[5],&u);ge_add(&t,&A2,&Ai[5]);ge_p1p1_to_p3(&u,&t);ge_p3_to_cached(&Ai[6],&u);ge_add(&t,&A2,&Ai[6]);ge_p1p1_to_p3(&u,&t);ge_p3_to_cached(&Ai[7],&u);ge_p2_0(r);for(i=255;i >=0;--i){if(aslide[i]||bslide[i]){break;}}for(;i >=0;--i){ge_p2_dbl(&t,r);if(aslide[i] > 0){ge_p1p1_to_p3(&u,&t);ge_add(&t,&u,&Ai[aslide[i] / 2]);}else if(aslide[i] < 0){ge_p1p1_to_p3(&u,&t);ge_sub(&t,&u,&Ai[(-aslide[i])/ 2]);}if(bslide[i] > 0){ge_p1p1_to_p3(&u,&t);ge_madd(&t,&u,&Bi[bslide[i] / 2]);}else if(bslide[i] < 0){ge_p1p1_to_p3(&u,&t);ge_msub(&t,&u,&Bi[(-bslide[i])/ 2]);}ge_p1p1_to_p2(r,&t);}}static C fe d={-10913610,13857413,-15372611,6949391,114729,-8787816,-6275908,-3247719,-18696448,-12055116};static C fe sqrtm1={-32595792,-7943725,9377950,3500415,12389472,-272473,-25146209,-2005654,326686,11406482};int ge_frombytes_negate_vartime(ge_p3*h,C u8*s){fe u;fe v;fe v3;fe vxx;fe check;fe_frombytes(h->Y,s);fe_1(h->Z);fe_sq(u,h->Y);fe_mul(v,u,d);fe_sub(u,u,h->Z);fe_add(v,v,h->Z);fe_sq(v3,v);fe_mul(v3,v3,v);fe_sq(h->X,v3);fe_mul(h->X,h->X,v);fe_mul(h->X,h->X,u);fe_pow22523(h->X,h->X);fe_mul(h->X,h->X,v3);fe_mul(h->X,h->X,u);fe_sq(vxx,h->X);fe_mul(vxx,vxx,v);fe_sub(check,vxx,u);if(fe_isnonzero(check)){fe_add(check,vxx,u);if(fe_isnonzero(check)){E-1;}fe_mul(h->X,h->X,sqrtm1);}if(fe_isnegative(h->X)==(s[31]>>7)){fe_neg(h->X,h->X);}fe_mul(h->T,h->X,h->Y);E 0;}void ge_madd(ge_p1p1*r,C ge_p3*p,C ge_precomp*q){fe t0;fe_add(r->X,p->Y,p->X);fe_sub(r->Y,p->Y,p->X);fe_mul(r->Z,r->X,q->yplusx);fe_mul(r->Y,r->Y,q->yminusx);fe_mul(r->T,q->xy2d,p->T);fe_add(t0,p->Z,p->Z);fe_sub(r->X,r->Z,r->Y);fe_add(r->Y,r->Z,r->Y);fe_add(r->Z,t0,r->T);fe_sub(r->T,t0,r->T);}void ge_msub(ge_p1p1*r,C ge_p3*p,C ge_precomp*q){fe t0;fe_add(r->X,p->Y,p->X);fe_sub(r->Y,p->Y,p->X);fe_mul(r->Z,r->X,q->yminusx);fe_mul(r->Y,r->Y,q->yplusx);fe_mul(r->T,q->xy2d,p->T);fe_add(t0,p->Z,p->Z);fe_sub(r->X,r->Z,r->Y);fe_add(r->Y,r->Z,r->Y);fe_sub(r->Z,t0,r->T);fe_add(r->T,t0,r->T);}void ge_p1p1_to_p2(ge_p2*r,C ge_p1p1*p){fe_mul(r->X,p->X,p->T);fe_mul(r->Y,p->Y,p->Z);fe_mul(r->Z,p->Z,p->T);}void ge_p1p1_to_p3(ge_p3*r,C ge_p1p1*p){fe_mul(r->X,p->X,p->T);fe_mul(r->Y,p->Y,p->Z);fe_mul(r->Z,p->Z,p->T);fe_mul(r->T,p->X,p->Y);}void ge_p2_0(ge_p2*h){fe_0(h->X);fe_1(h->Y);fe_1(h->Z);}void ge_p2_dbl(ge_p1p1*r,C ge_p2*p){fe t0;fe_sq(r->X,p->X);fe_sq(r->Z,p->Y);fe_sq2(r->T,p->Z);fe_add(r->Y,p->X,p->Y);fe_sq(t0,r->Y);fe_add(r->Y,r->Z,r->X);fe_sub(r->Z,r->Z,r->X);fe_sub(r->X,t0,r->Y);fe_sub(r->T,r->T,r->Z);}void ge_p3_0(ge_p3*h){fe_0(h->X);fe_1(h->Y);fe_1(h->Z);fe_0(h->T);}void ge_p3_dbl(ge_p1p1*r,C ge_p3*p){ge_p2 q;ge_p3_to_p2(&q,p);ge_p2_dbl(r,&q);}static C fe d2={-21827239,-5839606,-30745221,13898782,229458,15978800,-12551817,-6495438,29715968,9444199};void ge_p3_to_cached(ge_cached*r,C ge_p3*p){fe_add(r->YplusX,p->Y,p->X);fe_sub(r->YminusX,p->Y,p->X);fe_copy(r->Z,p->Z);fe_mul(r->T2d,p->T,d2);}void ge_p3_to_p2(ge_p2*r,C ge_p3*p){fe_copy(r->X,p->X);fe_copy(r->Y,p->Y);fe_copy(r->Z,p->Z);}void ge_p3_tobytes(u8*s,C ge_p3*h){fe recip;fe x;fe y;fe_invert(recip,h->Z);fe_mul(x,h->X,recip);fe_mul(y,h->Y,recip);fe_tobytes(s,y);s[31]^=fe_isnegative(x)<<7;}static u8 equal(signed char b,signed char c){u8 ub=b;u8 uc=c;u8 x=ub^uc;u64 y=x;y-=1;y>>=63;E(u8)y;}static u8 negative(signed char b){u64 x=b;x>>=63;E(u8)x;}static void cmov(ge_precomp*t,C ge_precomp*u,u8 b){fe_cmov(t->yplusx,u->yplusx,b);fe_cmov(t->yminusx,u->yminusx,b);fe_cmov(t->xy2d,u->xy2d,b);}static void select(ge_precomp*t,int pos,signed char b){ge_precomp minust;u8 bnegative=negative(b);u8 babs=b-(((-bnegative)& b)<<1);fe_1(t->yplusx);fe_1(t->yminusx);fe_0(t->xy2d);cmov(t,&base[pos][0],equal(babs,1));cmov(t,&base[pos][1],equal(babs,2));cmov(t,&base[pos][2],equal(babs,3));cmov(t,&base[pos][3],equal(babs,4));cmov(t,&base[pos][4],equal(babs,5));cmov(t,&base[pos][5],equal(babs,6));cmov(t,&base[pos][6],equal(babs,7));cmov(t,&base[pos][7],equal(babs,8));fe_copy(minust.yplusx,t->yminusx);fe_copy(minust.yminusx,t->yplusx);fe_neg(minust.xy2d,t->xy2d);cmov(t,&minust,bnegative);}void ge_scalarmult_base(ge_p3*h,C u8*a){signed char e[64];signed char L;ge_p1p1 r;ge_p2 s;ge_precomp t;int i;for(i=0;i < 32;++i){e[2*i+0]=(a[i]>>0)& 15;e[2*i+1]=(a[i]>>4)& 15;}L=0;for(i=0;i < 63;++i){e[i]+=L;L=e[i]+8;L>>=4;e[i]-=L<<4;}e[63]+=L;ge_p3_0(h);for(i=1;i < 64;i+=2){select(&t,i / 2,e[i]);ge_madd(&r,h,&t);ge_p1p1_to_p3(h,&r);}ge_p3_dbl(&r,h);ge_p1p1_to_p2(&s,&r);ge_p2_dbl(&r,&s);ge_p1p1_to_p2(&s,&r);ge_p2_dbl(&r,&s);ge_p1p1_to_p2(&s,&r);ge_p2_dbl(&r,&s);ge_p1p1_to_p3(h,&r);for(i=0;i < 64;i+=2){select(&t,i / 2,e[i]);ge_madd(&r,h,&t);ge_p1p1_to_p3(h,&r);}}void ge_sub(ge_p1p1*r,C ge_p3*p,C ge_cached*q){fe t0;fe_add(r->X,p->Y,p->X);fe_sub(r->Y,p->Y,p->X);fe_mul(r->Z,r->X,q->YminusX);fe_mul(r->Y,r->Y,q->YplusX);fe_mul(r->T,q->T2d,p->T);fe_mul(r->X,p->Z,q->Z);fe_add(t0,r->X,r->X);fe_sub(r->X,r->Z,r->Y);fe_add(r->Y,r->Z,r->Y);fe_sub(r->Z,t0,r->T);fe_add(r->T,t0,r->T);}void ge_tobytes(u8*s,C ge_p2*h){fe recip;fe x;fe y;fe_invert(recip,h->Z);fe_mul(x,h->X,recip);fe_mul(y,h->Y,recip);fe_tobytes(s,y);s[31]^=fe_isnegative(x)<<7;}void sc_reduce(u8*s);void sc_muladd(u8*s,C u8*a,C u8*b,C u8*c);void sc_reduce(u8*s){I s0=2097151 & load_3(s);I s1=2097151 &(load_4(s+2)>>5);I s2=2097151 &(load_3(s+5)>>2);I s3=2097151 &(load_4(s+7)>>7);I s4=2097151 &(load_4(s+10)>>4);I s5=2097151 &(load_3(s+13)>>1);I s6=2097151 &(load_4(s+15)>>6);I s7=2097151 &(load_3(s+18)>>3);I s8=2097151 & load_3(s+21);I s9=2097151 &(load_4(s+23)>>5);I s10=2097151 &(load_3(s+26)>>2);I s11=2097151 &(load_4(s+28)>>7);I s12=2097151 &(load_4(s+31)>>4);I s13=2097151 &(load_3(s+34)>>1);I s14=2097151 &(load_4(s+36)>>6);I s15=2097151 &(load_3(s+39)>>3);I s16=2097151 & load_3(s+42);I s17=2097151 &(load_4(s+44)>>5);I s18=2097151 &(load_3(s+47)>>2);I s19=2097151 &(load_4(s+49)>>7);I s20=2097151 &(load_4(s+52)>>4);I s21=2097151 &(load_3(s+55)>>1);I s22=2097151 &(load_4(s+57)>>6);I s23=(load_4(s+60)>>3);I L0;I L1;I L2;I L3;I L4;I L5;I L6;I L7;I L8;I L9;I L10;I L11;I L12;I L13;I L14;I L15;I L16;s11+=s23*666643;s12+=s23*470296;s13+=s23*654183;s14-=s23*997805;s15+=s23*136657;s16-=s23*683901;s23=0;s10+=s22*666643;s11+=s22*470296;s12+=s22*654183;s13-=s22*997805;s14+=s22*136657;s15-=s22*683901;s22=0;s9+=s21*666643;s10+=s21*470296;s11+=s21*654183;s12-=s21*997805;s13+=s21*136657;s14-=s21*683901;s21=0;s8+=s20*666643;s9+=s20*470296;s10+=s20*654183;s11-=s20*997805;s12+=s20*136657;s13-=s20*683901;s20=0;s7+=s19*666643;s8+=s19*470296;s9+=s19*654183;s10-=s19*997805;s11+=s19*136657;s12-=s19*683901;s19=0;s6+=s18*666643;s7+=s18*470296;s8+=s18*654183;s9-=s18*997805;s10+=s18*136657;s11-=s18*683901;s18=0;L6=(s6+(1<<20))>>21;s7+=L6;s6-=L6<<21;L8=(s8+(1<<20))>>21;s9+=L8;s8-=L8<<21;L10=(s10+(1<<20))>>21;s11+=L10;s10-=L10<<21;L12=(s12+(1<<20))>>21;s13+=L12;s12-=L12<<21;L14=(s14+(1<<20))>>21;s15+=L14;s14-=L14<<21;L16=(s16+(1<<20))>>21;s17+=L16;s16-=L16<<21;L7=(s7+(1<<20))>>21;s8+=L7;s7-=L7<<21;L9=(s9+(1<<20))>>21;s10+=L9;s9-=L9<<21;L11=(s11+(1<<20))>>21;s12+=L11;s11-=L11<<21;L13=(s13+(1<<20))>>21;s14+=L13;s13-=L13<<21;L15=(s15+(1<<20))>>21;s16+=L15;s15-=L15<<21;s5+=s17*666643;s6+=s17*470296;s7+=s17*654183;s8-=s17*997805;s9+=s17*136657;s10-=s17*683901;s17=0;s4+=s16*666643;s5+=s16*470296;s6+=s16*654183;s7-=s16*997805;s8+=s16*136657;s9-=s16*683901;s16=0;s3+=s15*666643;s4+=s15*470296;s5+=s15*654183;s6-=s15*997805;s7+=s15*136657;s8-=s15*683901;s15=0;s2+=s14*666643;s3+=s14*470296;s4+=s14*654183;s5-=s14*997805;s6+=s14*136657;s7-=s14*683901;s14=0;s1+=s13*666643;s2+=s13*470296;s3+=s13*654183;s4-=s13*997805;s5+=s13*136657;s6-=s13*683901;s13=0;s0+=s12*666643;s1+=s12*470296;s2+=s12*654183;s3-=s12*997805;s4+=s12*136657;s5-=s12*683901;s12=0;L0=(s0+(1<<20))>>21;s1+=L0;s0-=L0<<21;L2=(s2+(1<<20))>>21;s3+=L2;s2-=L2<<21;L4=(s4+(1<<20))>>21;s5+=L4;s4-=L4<<21;L6=(s6+(1<<20))>>21;s7+=L6;s6-=L6<<21;L8=(s8+(1<<20))>>21;s9+=L8;s8-=L8<<21;L10=(s10+(1<<20))>>21;s11+=L10;s10-=L10<<21;L1=(s1+(1<<20))>>21;s2+=L1;s1-=L1<<21;L3=(s3+(1<<20))>>21;s4+=L3;s3-=L3<<21;L5=(s5+(1<<20))>>21;s6+=L5;s5-=L5<<21;L7=(s7+(1<<20))>>21;s8+=L7;s7-=L7<<21;L9=(s9+(1<<20))>>21;s10+=L9;s9-=L9<<21;L11=(s11+(1<<20))>>21;s12+=L11;s11-=L11<<21;s0+=s12*666643;s1+=s12*470296;s2+=s12*654183;s3-=s12*997805;s4+=s12*136657;s5-=s12*683901;s12=0;L0=s0>>21;s1+=L0;s0-=L0<<21;L1=s1>>21;s2+=L1;s1-=L1<<21;L2=s2>>21;s3+=L2;s2-=L2<<21;L3=s3>>21;s4+=L3;s3-=L3<<21;L4=s4>>21;s5+=L4;s4-=L4<<21;L5=s5>>21;s6+=L5;s5-=L5<<21;L6=s6>>21;s7+=L6;s6-=L6<<21;L7=s7>>21;s8+=L7;s7-=L7<<21;L8=s8>>21;s9+=L8;s8-=L8<<21;L9=s9>>21;s10+=L9;s9-=L9<<21;L10=s10>>21;s11+=L10;s10-=L10<<21;L11=s11>>21;s12+=L11;s11-=L11<<21;s0+=s12*666643;s1+=s12*470296;s2+=s12*654183;s3-=s12*997805;s4+=s12*136657;s5-=s12*683901;s12=0;L0=s0>>21;s1+=L0;s0-=L0<<21;L1=s1>>21;s2+=L1;s1-=L1<<21;L2=s2>>21;s3+=L2;s2-=L2<<21;L3=s3>>21;s4+=L3;s3-=L3<<21;L4=s4>>21;s5+=L4;s4-=L4<<21;L5=s5>>21;s6+=L5;s5-=L5<<21;L6=s6>>21;s7+=L6;s6-=L6<<21;L7=s7>>21;s8+=L7;s7-=L7<<21;L8=s8>>21;s9+=L8;s8-=L8<<21;L9=s9>>21;s10+=L9;s9-=L9<<21;L10=s10>>21;s11+=L10;s10-=L10<<21;s[0]=(u8)(s0>>0);s[1]=(u8)(s0>>8);s[2]=(u8)((s0>>16)|(s1<<5));s[3]=(u8)(s1>>3);s[4]=(u8)(s1>>11);s[5]=(u8)((s1>>19)|(s2<<2));s[6]=(u8)(s2>>6);s[7]=(u8)((s2>>14)|(s3<<7));s[8]=(u8)(s3>>1);s[9]=(u8)(s3>>9);s[10]=(u8)((s3>>17)|(s4<<4));s[11]=(u8)(s4>>4);s[12]=(u8)(s4>>12);s[13]=(u8)((s4>>20)|(s5<<1));s[14]=(u8)(s5>>7);s[15]=(u8)((s5>>15)|(s6<<6));s[16]=(u8)(s6>>2);s[17]=(u8)(s6>>10);s[18]=(u8)((s6>>18)|(s7<<3));s[19]=(u8)(s7>>5);s[20]=(u8)(s7>>13);s[21]=(u8)(s8>>0);s[22]=(u8)(s8>>8);s[23]=(u8)((s8>>16)|(s9<<5));s[24]=(u8)(s9>>3);s[25]=(u8)(s9>>11);s[26]=(u8)((s9>>19)|(s10<<2));s[27]=(u8)(s10>>6);s[28]=(u8)((s10>>14)|(s11<<7));s[29]=(u8)(s11>>1);s[30]=(u8)(s11>>9);s[31]=(u8)(s11>>17);}void sc_muladd(u8*s,C u8*a,C u8*b,C u8*c){I a0=2097151 & load_3(a);I a1=2097151 &(load_4(a+2)>>5);I a2=2097151 &(load_3(a+5)>>2);I a3=2097151 &(load_4(a+7)>>7);I a4=2097151 &(load_4(a+10)>>4);I a5=2097151 &(load_3(a+13)>>1);I a6=2097151 &(load_4(a+15)>>6);I a7=2097151 &(load_3(a+18)>>3);I a8=2097151 & load_3(a+21);I a9=2097151 &(load_4(a+23)>>5);I a10=2097151 &(load_3(a+26)>>2);I a11=(load_4(a+28)>>7);I b0=2097151 & load_3(b);I b1=2097151 &(load_4(b+2)>>5);I b2=2097151 &(load_3(b+5)>>2);I b3=2097151 &(load_4(b+7)>>7);I b4=2097151 &(load_4(b+10)>>4);I b5=2097151 &(load_3(b+13)>>1);I b6=2097151 &(load_4(b+15)>>6);I b7=2097151 &(load_3(b+18)>>3);I b8=2097151 & load_3(b+21);I b9=2097151 &(load_4(b+23)>>5);I b10=2097151 &(load_3(b+26)>>2);I b11=(load_4(b+28)>>7);I c0=2097151 & load_3(c);I c1=2097151 &(load_4(c+2)>>5);I c2=2097151 &(load_3(c+5)>>2);I c3=2097151 &(load_4(c+7)>>7);I c4=2097151 &(load_4(c+10)>>4);I c5=2097151 &(load_3(c+13)>>1);I c6=2097151 &(load_4(c+15)>>6);I c7=2097151 &(load_3(c+18)>>3);I c8=2097151 & load_3(c+21);I c9=2097151 &(load_4(c+23)>>5);I c10=2097151 &(load_3(c+26)>>2);I c11=(load_4(c+28)>>7);I s0;I s1;I s2;I s3;I s4;I s5;I s6;I s7;I s8;I s9;I s10;I s11;I s12;I s13;I s14;I s15;I s16;I s17;I s18;I s19;I s20;I s21;I s22;I s23;I L0;I L1;I L2;I L3;I L4;I L5;I L6;I L7;I L8;I L9;I L10;I L11;I L12;I L13;I L14;I L15;I L16;I L17;I L18;I L19;I L20;I L21;I L22;s0=c0+a0*b0;s1=c1+a0*b1+a1*b0;s2=c2+a0*b2+a1*b1+a2*b0;s3=c3+a0*b3+a1*b2+a2*b1+a3*b0;s4=c4+a0*b4+a1*b3+a2*b2+a3*b1+a4*b0;s5=c5+a0*b5+a1*b4+a2*b3+a3*b2+a4*b1+a5*b0;s6=c6+a0*b6+a1*b5+a2*b4+a3*b3+a4*b2+a5*b1+a6*b0;s7=c7+a0*b7+a1*b6+a2*b5+a3*b4+a4*b3+a5*b2+a6*b1+a7*b0;s8=c8+a0*b8+a1*b7+a2*b6+a3*b5+a4*b4+a5*b3+a6*b2+a7*b1+a8*b0;s9=c9+a0*b9+a1*b8+a2*b7+a3*b6+a4*b5+a5*b4+a6*b3+a7*b2+a8*b1+a9*b0;s10=c10+a0*b10+a1*b9+a2*b8+a3*b7+a4*b6+a5*b5+a6*b4+a7*b3+a8*b2+a9*b1+a10*b0;s11=c11+a0*b11+a1*b10+a2*b9+a3*b8+a4*b7+a5*b6+a6*b5+a7*b4+a8*b3+a9*b2+a10*b1+a11*b0;s12=a1*b11+a2*b10+a3*b9+a4*b8+a5*b7+a6*b6+a7*b5+a8*b4+a9*b3+a10*b2+a11*b1;s13=a2*b11+a3*b10+a4*b9+a5*b8+a6*b7+a7*b6+a8*b5+a9*b4+a10*b3+a11*b2;s14=a3*b11+a4*b10+a5*b9+a6*b8+a7*b7+a8*b6+a9*b5+a10*b4+a11*b3;s15=a4*b11+a5*b10+a6*b9+a7*b8+a8*b7+a9*b6+a10*b5+a11*b4;s16=a5*b11+a6*b10+a7*b9+a8*b8+a9*b7+a10*b6+a11*b5;s17=a6*b11+a7*b10+a8*b9+a9*b8+a10*b7+a11*b6;s18=a7*b11+a8*b10+a9*b9+a10*b8+a11*b7;s19=a8*b11+a9*b10+a10*b9+a11*b8;s20=a9*b11+a10*b10+a11*b9;s21=a10*b11+a11*b10;s22=a11*b11;s23=0;L0=(s0+(1<<20))>>21;s1+=L0;s0-=L0<<21;L2=(s2+(1<<20))>>21;s3+=L2;s2-=L2<<21;L4=(s4+(1<<20))>>21;s5+=L4;s4-=L4<<21;L6=(s6+(1<<20))>>21;s7+=L6;s6-=L6<<21;L8=(s8+(1<<20))>>21;s9+=L8;s8-=L8<<21;L10=(s10+(1<<20))>>21;s11+=L10;s10-=L10<<21;L12=(s12+(1<<20))>>21;s13+=L12;s12-=L12<<21;L14=(s14+(1<<20))>>21;s15+=L14;s14-=L14<<21;L16=(s16+(1<<20))>>21;s17+=L16;s16-=L16<<21;L18=(s18+(1<<20))>>21;s19+=L18;s18-=L18<<21;L20=(s20+(1<<20))>>21;s21+=L20;s20-=L20<<21;L22=(s22+(1<<20))>>21;s23+=L22;s22-=L22<<21;L1=(s1+(1<<20))>>21;s2+=L1;s1-=L1<<21;L3=(s3+(1<<20))>>21;s4+=L3;s3-=L3<<21;L5=(s5+(1<<20))>>21;s6+=L5;s5-=L5<<21;L7=(s7+(1<<20))>>21;s8+=L7;s7-=L7<<21;L9=(s9+(1<<20))>>21;s10+=L9;s9-=L9<<21;L11=(s11+(1<<20))>>21;s12+=L11;s11-=L11<<21;L13=(s13+(1<<20))>>21;s14+=L13;s13-=L13<<21;L15=(s15+(1<<20))>>21;s16+=L15;s15-=L15<<21;L17=(s17+(1<<20))>>21;s18+=L17;s17-=L17<<21;L19=(s19+(1<<20))>>21;s20+=L19;s19-=L19<<21;L21=(s21+(1<<20))>>21;s22+=L21;s21-=L21<<21;s11+=s23*666643;s12+=s23*470296;s13+=s23*654183;s14-=s23*997805;s15+=s23*136657;s16-=s23*683901;s23=0;s10+=s22*666643;s11+=s22*470296;s12+=s22*654183;s13-=s22*997805;s14+=s22*136657;s15-=s22*683901;s22=0;s9+=s21*666643;s10+=s21*470296;s11+=s21*654183;s12-=s21*997805;s13+=s21*136657;s14-=s21*683901;s21=0;s8+=s20*666643;s9+=s20*470296;s10+=s20*654183;s11-=s20*997805;s12+=s20*136657;s13-=s20*683901;s20=0;s7+=s19*666643;s8+=s19*470296;s9+=s19*654183;s10-=s19*997805;s11+=s19*136657;s12-=s19*683901;s19=0;s6+=s18*666643;s7+=s18*470296;s8+=s18*654183;s9-=s18*997805;s10+=s18*136657;s11-=s18*683901;s18=0;L6=(s6+(1<<20))>>21;s7+=L6;s6-=L6<<21;L8=(s8+(1<<20))>>21;s9+=L8;s8-=L8<<21;L10=(s10+(1<<20))>>21;s11+=L10;s10-=L10<<21;L12=(s12+(1<<20))>>21;s13+=L12;s12-=L12<<21;L14=(s14+(1<<20))>>21;s15+=L14;s14-=L14<<21;L16=(s16+(1<<20))>>21;s17+=L16;s16-=L16<<21;L7=(s7+(1<<20))>>21;s8+=L7;s7-=L7<<21;L9=(s9+(1<<20))>>21;s10+=L9;s9-=L9<<21;L11=(s11+(1<<20))>>21;s12+=L11;s11-=L11<<21;L13=(s13+(1<<20))>>21;s14+=L13;s13-=L13<<21;L15=(s15+(1<<20))>>21;s16+=L15;s15-=L15<<21;s5+=s17*666643;s6+=s17*470296;s7+=s17*654183;s8-=s17*997805;s9+=s17*136657;s10-=s17*683901;s17=0;s4+=s16*666643;s5+=s16*470296;s6+=s16*654183;s7-=s16*997805;s8+=s16*136657;s9-=s16*683901;s16=0;s3+=s15*666643;s4+=s15*470296;s5+=s15*654183;s6-=s15*997805;s7+=s15*136657;s8-=s15*683901;s15=0;s2+=s14*666643;s3+=s14*470296;s4+=s14*654183;s5-=s14*997805;s6+=s14*136657;s7-=s14*683901;s14=0;s1+=s13*666643;s2+=s13*470296;s3+=s13*654183;s4-=s13*997805;s5+=s13*136657;s6-=s13*683901;s13=0;s0+=s12*666643;s1+=s12*470296;s2+=s12*654183;s3-=s12*997805;s4+=s12*136657;s5-=s12*683901;s12=0;L0=(s0+(1<<20))>>21;s1+=L0;s0-=L0<<21;L2=(s2+(1<<20))>>21;s3+=L2;s2-=L2<<21;L4=(s4+(1<<20))>>21;s5+=L4;s4-=L4<<21;L6=(s6+(1<<20))>>21;s7+=L6;s6-=L6<<21;L8=(s8+(1<<20))>>21;s9+=L8;s8-=L8<<21;L10=(s10+(1<<20))>>21;s11+=L10;s10-=L10<<21;L1=(s1+(1<<20))>>21;s2+=L1;s1-=L1<<21;L3=(s3+(1<<20))>>21;s4+=L3;s3-=L3<<21;L5=(s5+(1<<20))>>21;s6+=L5;s5-=L5<<21;L7=(s7+(1<<20))>>21;s8+=L7;s7-=L7<<21;L9=(s9+(1<<20))>>21;s10+=L9;s9-=L9<<21;L11=(s11+(1<<20))>>21;s12+=L11;s11-=L11<<21;s0+=s12*666643;s1+=s12*470296;s2+=s12*654183;s3-=s12*997805;s4+=s12*136657;s5-=s12*683901;s12=0;L0=s0>>21;s1+=L0;s0-=L0<<21;L1=s1>>21;s2+=L1;s1-=L1<<21;L2=s2>>21;s3+=L2;s2-=L2<<21;L3=s3>>21;s4+=L3;s3-=L3<<21;L4=s4>>21;s5+=L4;s4-=L4<<21;L5=s5>>21;s6+=L5;s5-=L5<<21;L6=s6>>21;s7+=L6;s6-=L6<<21;L7=s7>>21;s8+=L7;s7-=L7<<21;L8=s8>>21;s9+=L8;s8-=L8<<21;L9=s9>>21;s10+=L9;s9-=L9<<21;L10=s10>>21;s11+=L10;s10-=L10<<21;L11=s11>>21;s12+=L11;s11-=L11<<21;s0+=s12*666643;s1+=s12*470296;s2+=s12*654183;s3-=s12*997805;s4+=s12*136657;s5-=s12*683901;s12=0;L0=s0>>21;s1+=L0;s0-=L0<<21;L1=s1>>21;s2+=L1;s1-=L1<<21;L2=s2>>21;s3+=L2;s2-=L2<<21;L3=s3>>21;s4+=L3;s3-=L3<<21;L4=s4>>21;s5+=L4;s4-=L4<<21;L5=s5>>21;s6+=L5;s5-=L5<<21;L6=s6>>21;s7+=L6;s6-=L6<<21;L7=s7>>21;s8+=L7;s7-=L7<<21;L8=s8>>21;s9+=L8;s8-=L8<<21;L9=s9>>21;s10+=L9;s9-=L9<<21;L10=s10>>21;s11+=L10;s10-=L10<<21;s[0]=(u8)(s0>>0);s[1]=(u8)(s0>>8);s[2]=(u8)((s0>>16)|(s1<<5));s[3]=(u8)(s1>>3);s[4]=(u8)(s1>>11);s[5]=(u8)((s1>>19)|(s2<<2));s[6]=(u8)(s2>>6);s[7]=(u8)((s2>>14)|(s3<<7));s[8]=(u8)(s3>>1);s[9]=(u8)(s3>>9);s[10]=(u8)((s3>>17)|(s4<<4));s[11]=(u8)(s4>>4);s[12]=(u8)(s4>>12);s[13]=(u8)((s4>>20)|(s5<<1));s[14]=(u8)(s5>>7);s[15]=(u8)((s5>>15)|(s6<<6));s[16]=(u8)(s6>>2);s[17]=(u8)(s6>>10);s[18]=(u8)((s6>>18)|(s7<<3));s[19]=(u8)(s7>>5);s[20]=(u8)(s7>>13);s[21]=(u8)(s8>>0);s[22]=(u8)(s8>>8);s[23]=(u8)((s8>>16)|(s9<<5));s[24]=(u8)(s9>>3);s[25]=(u8)(s9>>11);s[26]=(u8)((s9>>19)|(s10<<2));s[27]=(u8)(s10>>6);s[28]=(u8)((s10>>14)|(s11<<7));s[29]=(u8)(s11>>1);s[30]=(u8)(s11>>9);s[31]=(u8)(s11>>17);}
+E r !=0;}void fe_mul(fe h,C fe f,C fe g){Q f0=f[0];Q f1=f[1];Q f2=f[2];Q f3=f[3];Q f4=f[4];Q f5=f[5];Q f6=f[6];Q f7=f[7];Q f8=f[8];Q f9=f[9];Q g0=g[0];Q g1=g[1];Q g2=g[2];Q g3=g[3];Q g4=g[4];Q g5=g[5];Q g6=g[6];Q g7=g[7];Q g8=g[8];Q g9=g[9];Q g1_19=19*g1;Q g2_19=19*g2;Q g3_19=19*g3;Q g4_19=19*g4;Q g5_19=19*g5;Q g6_19=19*g6;Q g7_19=19*g7;Q g8_19=19*g8;Q g9_19=19*g9;Q f1_2=2*f1;Q f3_2=2*f3;Q f5_2=2*f5;Q f7_2=2*f7;Q f9_2=2*f9;I f0g0=f0*(I)g0;I f0g1=f0*(I)g1;I f0g2=f0*(I)g2;I f0g3=f0*(I)g3;I f0g4=f0*(I)g4;I f0g5=f0*(I)g5;I f0g6=f0*(I)g6;I f0g7=f0*(I)g7;I f0g8=f0*(I)g8;I f0g9=f0*(I)g9;I f1g0=f1*(I)g0;I f1g1_2=f1_2*(I)g1;I f1g2=f1*(I)g2;I f1g3_2=f1_2*(I)g3;I f1g4=f1*(I)g4;I f1g5_2=f1_2*(I)g5;I f1g6=f1*(I)g6;I f1g7_2=f1_2*(I)g7;I f1g8=f1*(I)g8;I f1g9_38=f1_2*(I)g9_19;I f2g0=f2*(I)g0;I f2g1=f2*(I)g1;I f2g2=f2*(I)g2;I f2g3=f2*(I)g3;I f2g4=f2*(I)g4;I f2g5=f2*(I)g5;I f2g6=f2*(I)g6;I f2g7=f2*(I)g7;I f2g8_19=f2*(I)g8_19;I f2g9_19=f2*(I)g9_19;I f3g0=f3*(I)g0;I f3g1_2=f3_2*(I)g1;I f3g2=f3*(I)g2;I f3g3_2=f3_2*(I)g3;I f3g4=f3*(I)g4;I f3g5_2=f3_2*(I)g5;I f3g6=f3*(I)g6;I f3g7_38=f3_2*(I)g7_19;I f3g8_19=f3*(I)g8_19;I f3g9_38=f3_2*(I)g9_19;I f4g0=f4*(I)g0;I f4g1=f4*(I)g1;I f4g2=f4*(I)g2;I f4g3=f4*(I)g3;I f4g4=f4*(I)g4;I f4g5=f4*(I)g5;I f4g6_19=f4*(I)g6_19;I f4g7_19=f4*(I)g7_19;I f4g8_19=f4*(I)g8_19;I f4g9_19=f4*(I)g9_19;I f5g0=f5*(I)g0;I f5g1_2=f5_2*(I)g1;I f5g2=f5*(I)g2;I f5g3_2=f5_2*(I)g3;I f5g4=f5*(I)g4;I f5g5_38=f5_2*(I)g5_19;I f5g6_19=f5*(I)g6_19;I f5g7_38=f5_2*(I)g7_19;I f5g8_19=f5*(I)g8_19;I f5g9_38=f5_2*(I)g9_19;I f6g0=f6*(I)g0;I f6g1=f6*(I)g1;I f6g2=f6*(I)g2;I f6g3=f6*(I)g3;I f6g4_19=f6*(I)g4_19;I f6g5_19=f6*(I)g5_19;I f6g6_19=f6*(I)g6_19;I f6g7_19=f6*(I)g7_19;I f6g8_19=f6*(I)g8_19;I f6g9_19=f6*(I)g9_19;I f7g0=f7*(I)g0;I f7g1_2=f7_2*(I)g1;I f7g2=f7*(I)g2;I f7g3_38=f7_2*(I)g3_19;I f7g4_19=f7*(I)g4_19;I f7g5_38=f7_2*(I)g5_19;I f7g6_19=f7*(I)g6_19;I f7g7_38=f7_2*(I)g7_19;I f7g8_19=f7*(I)g8_19;I f7g9_38=f7_2*(I)g9_19;I f8g0=f8*(I)g0;I f8g1=f8*(I)g1;I f8g2_19=f8*(I)g2_19;I f8g3_19=f8*(I)g3_19;I f8g4_19=f8*(I)g4_19;I f8g5_19=f8*(I)g5_19;I f8g6_19=f8*(I)g6_19;I f8g7_19=f8*(I)g7_19;I f8g8_19=f8*(I)g8_19;I f8g9_19=f8*(I)g9_19;I f9g0=f9*(I)g0;I f9g1_38=f9_2*(I)g1_19;I f9g2_19=f9*(I)g2_19;I f9g3_38=f9_2*(I)g3_19;I f9g4_19=f9*(I)g4_19;I f9g5_38=f9_2*(I)g5_19;I f9g6_19=f9*(I)g6_19;I f9g7_38=f9_2*(I)g7_19;I f9g8_19=f9*(I)g8_19;I f9g9_38=f9_2*(I)g9_19;I h0=f0g0+f1g9_38+f2g8_19+f3g7_38+f4g6_19+f5g5_38+f6g4_19+f7g3_38+f8g2_19+f9g1_38;I h1=f0g1+f1g0+f2g9_19+f3g8_19+f4g7_19+f5g6_19+f6g5_19+f7g4_19+f8g3_19+f9g2_19;I h2=f0g2+f1g1_2+f2g0+f3g9_38+f4g8_19+f5g7_38+f6g6_19+f7g5_38+f8g4_19+f9g3_38;I h3=f0g3+f1g2+f2g1+f3g0+f4g9_19+f5g8_19+f6g7_19+f7g6_19+f8g5_19+f9g4_19;I h4=f0g4+f1g3_2+f2g2+f3g1_2+f4g0+f5g9_38+f6g8_19+f7g7_38+f8g6_19+f9g5_38;I h5=f0g5+f1g4+f2g3+f3g2+f4g1+f5g0+f6g9_19+f7g8_19+f8g7_19+f9g6_19;I h6=f0g6+f1g5_2+f2g4+f3g3_2+f4g2+f5g1_2+f6g0+f7g9_38+f8g8_19+f9g7_38;I h7=f0g7+f1g6+f2g5+f3g4+f4g3+f5g2+f6g1+f7g0+f8g9_19+f9g8_19;I h8=f0g8+f1g7_2+f2g6+f3g5_2+f4g4+f5g3_2+f6g2+f7g1_2+f8g0+f9g9_38;I h9=f0g9+f1g8+f2g7+f3g6+f4g5+f5g4+f6g3+f7g2+f8g1+f9g0;I L0;I L1;I L2;I L3;I L4;I L5;I L6;I L7;I L8;I L9;L0=(h0+(I)(1<<25))>>26;h1+=L0;h0-=L0<<26;L4=(h4+(I)(1<<25))>>26;h5+=L4;h4-=L4<<26;L1=(h1+(I)(1<<24))>>25;h2+=L1;h1-=L1<<25;L5=(h5+(I)(1<<24))>>25;h6+=L5;h5-=L5<<25;L2=(h2+(I)(1<<25))>>26;h3+=L2;h2-=L2<<26;L6=(h6+(I)(1<<25))>>26;h7+=L6;h6-=L6<<26;L3=(h3+(I)(1<<24))>>25;h4+=L3;h3-=L3<<25;L7=(h7+(I)(1<<24))>>25;h8+=L7;h7-=L7<<25;L4=(h4+(I)(1<<25))>>26;h5+=L4;h4-=L4<<26;L8=(h8+(I)(1<<25))>>26;h9+=L8;h8-=L8<<26;L9=(h9+(I)(1<<24))>>25;h0+=L9*19;h9-=L9<<25;L0=(h0+(I)(1<<25))>>26;h1+=L0;h0-=L0<<26;h[0]=(Q)h0;h[1]=(Q)h1;h[2]=(Q)h2;h[3]=(Q)h3;h[4]=(Q)h4;h[5]=(Q)h5;h[6]=(Q)h6;h[7]=(Q)h7;h[8]=(Q)h8;h[9]=(Q)h9;}void fe_mul121666(fe h,fe f){Q f0=f[0];Q f1=f[1];Q f2=f[2];Q f3=f[3];Q f4=f[4];Q f5=f[5];Q f6=f[6];Q f7=f[7];Q f8=f[8];Q f9=f[9];I h0=f0*(I)121666;I h1=f1*(I)121666;I h2=f2*(I)121666;I h3=f3*(I)121666;I h4=f4*(I)121666;I h5=f5*(I)121666;I h6=f6*(I)121666;I h7=f7*(I)121666;I h8=f8*(I)121666;I h9=f9*(I)121666;I L0;I L1;I L2;I L3;I L4;I L5;I L6;I L7;I L8;I L9;L9=(h9+(I)(1<<24))>>25;h0+=L9*19;h9-=L9<<25;L1=(h1+(I)(1<<24))>>25;h2+=L1;h1-=L1<<25;L3=(h3+(I)(1<<24))>>25;h4+=L3;h3-=L3<<25;L5=(h5+(I)(1<<24))>>25;h6+=L5;h5-=L5<<25;L7=(h7+(I)(1<<24))>>25;h8+=L7;h7-=L7<<25;L0=(h0+(I)(1<<25))>>26;h1+=L0;h0-=L0<<26;L2=(h2+(I)(1<<25))>>26;h3+=L2;h2-=L2<<26;L4=(h4+(I)(1<<25))>>26;h5+=L4;h4-=L4<<26;L6=(h6+(I)(1<<25))>>26;h7+=L6;h6-=L6<<26;L8=(h8+(I)(1<<25))>>26;h9+=L8;h8-=L8<<26;h[0]=(Q)h0;h[1]=(Q)h1;h[2]=(Q)h2;h[3]=(Q)h3;h[4]=(Q)h4;h[5]=(Q)h5;h[6]=(Q)h6;h[7]=(Q)h7;h[8]=(Q)h8;h[9]=(Q)h9;}void fe_neg(fe h,C fe f){Q f0=f[0];Q f1=f[1];Q f2=f[2];Q f3=f[3];Q f4=f[4];Q f5=f[5];Q f6=f[6];Q f7=f[7];Q f8=f[8];Q f9=f[9];Q h0=-f0;Q h1=-f1;Q h2=-f2;Q h3=-f3;Q h4=-f4;Q h5=-f5;Q h6=-f6;Q h7=-f7;Q h8=-f8;Q h9=-f9;h[0]=h0;h[1]=h1;h[2]=h2;h[3]=h3;h[4]=h4;h[5]=h5;h[6]=h6;h[7]=h7;h[8]=h8;h[9]=h9;}
+#endif
+void fe_pow22523(fe out,C fe z){fe t0;fe t1;fe t2;int i;fe_sq(t0,z);for(i=1;i < 1;++i){fe_sq(t0,t0);}fe_sq(t1,t0);for(i=1;i < 2;++i){fe_sq(t1,t1);}fe_mul(t1,z,t1);fe_mul(t0,t0,t1);fe_sq(t0,t0);for(i=1;i < 1;++i){fe_sq(t0,t0);}fe_mul(t0,t1,t0);fe_sq(t1,t0);for(i=1;i < 5;++i){fe_sq(t1,t1);}fe_mul(t0,t1,t0);fe_sq(t1,t0);for(i=1;i < 10;++i){fe_sq(t1,t1);}fe_mul(t1,t1,t0);fe_sq(t2,t1);for(i=1;i < 20;++i){fe_sq(t2,t2);}fe_mul(t1,t2,t1);fe_sq(t1,t1);for(i=1;i < 10;++i){fe_sq(t1,t1);}fe_mul(t0,t1,t0);fe_sq(t1,t0);for(i=1;i < 50;++i){fe_sq(t1,t1);}fe_mul(t1,t1,t0);fe_sq(t2,t1);for(i=1;i < 100;++i){fe_sq(t2,t2);}fe_mul(t1,t2,t1);fe_sq(t1,t1);for(i=1;i < 50;++i){fe_sq(t1,t1);}fe_mul(t0,t1,t0);fe_sq(t0,t0);for(i=1;i < 2;++i){fe_sq(t0,t0);}fe_mul(out,t0,z);E;}
+#ifndef FE_RADIX51
+void fe_sq(fe h,C fe f){Q f0=f[0];Q f1=f[1];Q f2=f[2];Q f3=f[3];Q f4=f[4];Q f5=f[5];Q f6=f[6];Q f7=f[7];Q f8=f[8];Q f9=f[9];Q f0_2=2*f0;Q f1_2=2*f1;Q f2_2=2*f2;Q f3_2=2*f3;Q f4_2=2*f4;Q f5_2=2*f5;Q f6_2=2*f6;Q f7_2=2*f7;Q f5_38=38*f5;Q f6_19=19*f6;Q f7_38=38*f7;Q f8_19=19*f8;Q f9_38=38*f9;I f0f0=f0*(I)f0;I f0f1_2=f0_2*(I)f1;I f0f2_2=f0_2*(I)f2;I f0f3_2=f0_2*(I)f3;I f0f4_2=f0_2*(I)f4;I f0f5_2=f0_2*(I)f5;I f0f6_2=f0_2*(I)f6;I f0f7_2=f0_2*(I)f7;I f0f8_2=f0_2*(I)f8;I f0f9_2=f0_2*(I)f9;I f1f1_2=f1_2*(I)f1;I f1f2_2=f1_2*(I)f2;I f1f3_4=f1_2*(I)f3_2;I f1f4_2=f1_2*(I)f4;I f1f5_4=f1_2*(I)f5_2;I f1f6_2=f1_2*(I)f6;I f1f7_4=f1_2*(I)f7_2;I f1f8_2=f1_2*(I)f8;I f1f9_76=f1_2*(I)f9_38;I f2f2=f2*(I)f2;I f2f3_2=f2_2*(I)f3;I f2f4_2=f2_2*(I)f4;I f2f5_2=f2_2*(I)f5;I f2f6_2=f2_2*(I)f6;I f2f7_2=f2_2*(I)f7;I f2f8_38=f2_2*(I)f8_19;I f2f9_38=f2*(I)f9_38;I f3f3_2=f3_2*(I)f3;I f3f4_2=f3_2*(I)f4;I f3f5_4=f3_2*(I)f5_2;I f3f6_2=f3_2*(I)f6;I f3f7_76=f3_2*(I)f7_38;I f3f8_38=f3_2*(I)f8_19;I f3f9_76=f3_2*(I)f9_38;I f4f4=f4*(I)f4;I f4f5_2=f4_2*(I)f5;I f4f6_38=f4_2*(I)f6_19;I f4f7_38=f4*(I)f7_38;I f4f8_38=f4_2*(I)f8_19;I f4f9_38=f4*(I)f9_38;I f5f5_38=f5*(I)f5_38;I f5f6_38=f5_2*(I)f6_19;I f5f7_76=f5_2*(I)f7_38;I f5f8_38=f5_2*(I)f8_19;I f5f9_76=f5_2*(I)f9_38;I f6f6_19=f6*(I)f6_19;I f6f7_38=f6*(I)f7_38;I f6f8_38=f6_2*(I)f8_19;I f6f9_38=f6*(I)f9_38;I f7f7_38=f7*(I)f7_38;I f7f8_38=f7_2*(I)f8_19;I f7f9_76=f7_2*(I)f9_38;I f8f8_19=f8*(I)f8_19;I f8f9_38=f8*(I)f9_38;I f9f9_38=f9*(I)f9_38;I h0=f0f0+f1f9_76+f2f8_38+f3f7_76+f4f6_38+f5f5_38;I h1=f0f1_2+f2f9_38+f3f8_38+f4f7_38+f5f6_38;I h2=f0f2_2+f1f1_2+f3f9_76+f4f8_38+f5f7_76+f6f6_19;I h3=f0f3_2+f1f2_2+f4f9_38+f5f8_38+f6f7_38;I h4=f0f4_2+f1f3_4+f2f2+f5f9_76+f6f8_38+f7f7_38;I h5=f0f5_2+f1f4_2+f2f3_2+f6f9_38+f7f8_38;I h6=f0f6_2+f1f5_4+f2f4_2+f3f3_2+f7f9_76+f8f8_19;I h7=f0f7_2+f1f6_2+f2f5_2+f3f4_2+f8f9_38;I h8=f0f8_2+f1f7_4+f2f6_2+f3f5_4+f4f4+f9f9_38;I h9=f0f9_2+f1f8_2+f2f7_2+f3f6_2+f4f5_2;I L0;I L1;I L2;I L3;I L4;I L5;I L6;I L7;I L8;I L9;L0=(h0+(I)(1<<25))>>26;h1+=L0;h0-=L0<<26;L4=(h4+(I)(1<<25))>>26;h5+=L4;h4-=L4<<26;L1=(h1+(I)(1<<24))>>25;h2+=L1;h1-=L1<<25;L5=(h5+(I)(1<<24))>>25;h6+=L5;h5-=L5<<25;L2=(h2+(I)(1<<25))>>26;h3+=L2;h2-=L2<<26;L6=(h6+(I)(1<<25))>>26;h7+=L6;h6-=L6<<26;L3=(h3+(I)(1<<24))>>25;h4+=L3;h3-=L3<<25;L7=(h7+(I)(1<<24))>>25;h8+=L7;h7-=L7<<25;L4=(h4+(I)(1<<25))>>26;h5+=L4;h4-=L4<<26;L8=(h8+(I)(1<<25))>>26;h9+=L8;h8-=L8<<26;L9=(h9+(I)(1<<24))>>25;h0+=L9*19;h9-=L9<<25;L0=(h0+(I)(1<<25))>>26;h1+=L0;h0-=L0<<26;h[0]=(Q)h0;h[1]=(Q)h1;h[2]=(Q)h2;h[3]=(Q)h3;h[4]=(Q)h4;h[5]=(Q)h5;h[6]=(Q)h6;h[7]=(Q)h7;h[8]=(Q)h8;h[9]=(Q)h9;}void fe_sq2(fe h,C fe f){Q f0=f[0];Q f1=f[1];Q f2=f[2];Q f3=f[3];Q f4=f[4];Q f5=f[5];Q f6=f[6];Q f7=f[7];Q f8=f[8];Q f9=f[9];Q f0_2=2*f0;Q f1_2=2*f1;Q f2_2=2*f2;Q f3_2=2*f3;Q f4_2=2*f4;Q f5_2=2*f5;Q f6_2=2*f6;Q f7_2=2*f7;Q f5_38=38*f5;Q f6_19=19*f6;Q f7_38=38*f7;Q f8_19=19*f8;Q f9_38=38*f9;I f0f0=f0*(I)f0;I f0f1_2=f0_2*(I)f1;I f0f2_2=f0_2*(I)f2;I f0f3_2=f0_2*(I)f3;I f0f4_2=f0_2*(I)f4;I f0f5_2=f0_2*(I)f5;I f0f6_2=f0_2*(I)f6;I f0f7_2=f0_2*(I)f7;I f0f8_2=f0_2*(I)f8;I f0f9_2=f0_2*(I)f9;I f1f1_2=f1_2*(I)f1;I f1f2_2=f1_2*(I)f2;I f1f3_4=f1_2*(I)f3_2;I f1f4_2=f1_2*(I)f4;I f1f5_4=f1_2*(I)f5_2;I f1f6_2=f1_2*(I)f6;I f1f7_4=f1_2*(I)f7_2;I f1f8_2=f1_2*(I)f8;I f1f9_76=f1_2*(I)f9_38;I f2f2=f2*(I)f2;I f2f3_2=f2_2*(I)f3;I f2f4_2=f2_2*(I)f4;I f2f5_2=f2_2*(I)f5;I f2f6_2=f2_2*(I)f6;I f2f7_2=f2_2*(I)f7;I f2f8_38=f2_2*(I)f8_19;I f2f9_38=f2*(I)f9_38;I f3f3_2=f3_2*(I)f3;I f3f4_2=f3_2*(I)f4;I f3f5_4=f3_2*(I)f5_2;I f3f6_2=f3_2*(I)f6;I f3f7_76=f3_2*(I)f7_38;I f3f8_38=f3_2*(I)f8_19;I f3f9_76=f3_2*(I)f9_38;I f4f4=f4*(I)f4;I f4f5_2=f4_2*(I)f5;I f4f6_38=f4_2*(I)f6_19;I f4f7_38=f4*(I)f7_38;I f4f8_38=f4_2*(I)f8_19;I f4f9_38=f4*(I)f9_38;I f5f5_38=f5*(I)f5_38;I f5f6_38=f5_2*(I)f6_19;I f5f7_76=f5_2*(I)f7_38;I f5f8_38=f5_2*(I)f8_19;I f5f9_76=f5_2*(I)f9_38;I f6f6_19=f6*(I)f6_19;I f6f7_38=f6*(I)f7_38;I f6f8_38=f6_2*(I)f8_19;I f6f9_38=f6*(I)f9_38;I f7f7_38=f7*(I)f7_38;I f7f8_38=f7_2*(I)f8_19;I f7f9_76=f7_2*(I)f9_38;I f8f8_19=f8*(I)f8_19;I f8f9_38=f8*(I)f9_38;I f9f9_38=f9*(I)f9_38;I h0=f0f0+f1f9_76+f2f8_38+f3f7_76+f4f6_38+f5f5_38;I h1=f0f1_2+f2f9_38+f3f8_38+f4f7_38+f5f6_38;I h2=f0f2_2+f1f1_2+f3f9_76+f4f8_38+f5f7_76+f6f6_19;I h3=f0f3_2+f1f2_2+f4f9_38+f5f8_38+f6f7_38;I h4=f0f4_2+f1f3_4+f2f2+f5f9_76+f6f8_38+f7f7_38;I h5=f0f5_2+f1f4_2+f2f3_2+f6f9_38+f7f8_38;I h6=f0f6_2+f1f5_4+f2f4_2+f3f3_2+f7f9_76+f8f8_19;I h7=f0f7_2+f1f6_2+f2f5_2+f3f4_2+f8f9_38;I h8=f0f8_2+f1f7_4+f2f6_2+f3f5_4+f4f4+f9f9_38;I h9=f0f9_2+f1f8_2+f2f7_2+f3f6_2+f4f5_2;I L0;I L1;I L2;I L3;I L4;I L5;I L6;I L7;I L8;I L9;h0+=h0;h1+=h1;h2+=h2;h3+=h3;h4+=h4;h5+=h5;h6+=h6;h7+=h7;h8+=h8;h9+=h9;L0=(h0+(I)(1<<25))>>26;h1+=L0;h0-=L0<<26;L4=(h4+(I)(1<<25))>>26;h5+=L4;h4-=L4<<26;L1=(h1+(I)(1<<24))>>25;h2+=L1;h1-=L1<<25;L5=(h5+(I)(1<<24))>>25;h6+=L5;h5-=L5<<25;L2=(h2+(I)(1<<25))>>26;h3+=L2;h2-=L2<<26;L6=(h6+(I)(1<<25))>>26;h7+=L6;h6-=L6<<26;L3=(h3+(I)(1<<24))>>25;h4+=L3;h3-=L3<<25;L7=(h7+(I)(1<<24))>>25;h8+=L7;h7-=L7<<25;L4=(h4+(I)(1<<25))>>26;h5+=L4;h4-=L4<<26;L8=(h8+(I)(1<<25))>>26;h9+=L8;h8-=L8<<26;L9=(h9+(I)(1<<24))>>25;h0+=L9*19;h9-=L9<<25;L0=(h0+(I)(1<<25))>>26;h1+=L0;h0-=L0<<26;h[0]=(Q)h0;h[1]=(Q)h1;h[2]=(Q)h2;h[3]=(Q)h3;h[4]=(Q)h4;h[5]=(Q)h5;h[6]=(Q)h6;h[7]=(Q)h7;h[8]=(Q)h8;h[9]=(Q)h9;}void fe_sub(fe h,C fe f,C fe g){Q f0=f[0];Q f1=f[1];Q f2=f[2];Q f3=f[3];Q f4=f[4];Q f5=f[5];Q f6=f[6];Q f7=f[7];Q f8=f[8];Q f9=f[9];Q g0=g[0];Q g1=g[1];Q g2=g[2];Q g3=g[3];Q g4=g[4];Q g5=g[5];Q g6=g[6];Q g7=g[7];Q g8=g[8];Q g9=g[9];Q h0=f0-g0;Q h1=f1-g1;Q h2=f2-g2;Q h3=f3-g3;Q h4=f4-g4;Q h5=f5-g5;Q h6=f6-g6;Q h7=f7-g7;Q h8=f8-g8;Q h9=f9-g9;h[0]=h0;h[1]=h1;h[2]=h2;h[3]=h3;h[4]=h4;h[5]=h5;h[6]=h6;h[7]=h7;h[8]=h8;h[9]=h9;}void fe_tobytes(u8*s,C fe h){Q h0=h[0];Q h1=h[1];Q h2=h[2];Q h3=h[3];Q h4=h[4];Q h5=h[5];Q h6=h[6];Q h7=h[7];Q h8=h[8];Q h9=h[9];Q q;Q L0;Q L1;Q L2;Q L3;Q L4;Q L5;Q L6;Q L7;Q L8;Q L9;q=(19*h9+(((Q)1)<<24))>>25;q=(h0+q)>>26;q=(h1+q)>>25;q=(h2+q)>>26;q=(h3+q)>>25;q=(h4+q)>>26;q=(h5+q)>>25;q=(h6+q)>>26;q=(h7+q)>>25;q=(h8+q)>>26;q=(h9+q)>>25;h0+=19*q;L0=h0>>26;h1+=L0;h0-=L0<<26;L1=h1>>25;h2+=L1;h1-=L1<<25;L2=h2>>26;h3+=L2;h2-=L2<<26;L3=h3>>25;h4+=L3;h3-=L3<<25;L4=h4>>26;h5+=L4;h4-=L4<<26;L5=h5>>25;h6+=L5;h5-=L5<<25;L6=h6>>26;h7+=L6;h6-=L6<<26;L7=h7>>25;h8+=L7;h7-=L7<<25;L8=h8>>26;h9+=L8;h8-=L8<<26;L9=h9>>25;h9-=L9<<25;s[0]=(u8)(h0>>0);s[1]=(u8)(h0>>8);s[2]=(u8)(h0>>16);s[3]=(u8)((h0>>24)|(h1<<2));s[4]=(u8)(h1>>6);s[5]=(u8)(h1>>14);s[6]=(u8)((h1>>22)|(h2<<3));s[7]=(u8)(h2>>5);s[8]=(u8)(h2>>13);s[9]=(u8)((h2>>21)|(h3<<5));s[10]=(u8)(h3>>3);s[11]=(u8)(h3>>11);s[12]=(u8)((h3>>19)|(h4<<6));s[13]=(u8)(h4>>2);s[14]=(u8)(h4>>10);s[15]=(u8)(h4>>18);s[16]=(u8)(h5>>0);s[17]=(u8)(h5>>8);s[18]=(u8)(h5>>16);s[19]=(u8)((h5>>24)|(h6<<1));s[20]=(u8)(h6>>7);s[21]=(u8)(h6>>15);s[22]=(u8)((h6>>23)|(h7<<3));s[23]=(u8)(h7>>5);s[24]=(u8)(h7>>13);s[25]=(u8)((h7>>21)|(h8<<4));s[26]=(u8)(h8>>4);s[27]=(u8)(h8>>12);s[28]=(u8)((h8>>20)|(h9<<6));s[29]=(u8)(h9>>2);s[30]=(u8)(h9>>10);s[31]=(u8)(h9>>18);}
+#endif
+#include <stdlib.h>
+#include <string.h>
+typedef struct{fe X;fe Y;fe Z;}ge_p2;typedef struct{fe X;fe Y;fe Z;fe T;}ge_p3;typedef struct{fe X;fe Y;fe Z;fe T;}ge_p1p1;typedef struct{fe yplusx;fe yminusx;fe xy2d;}ge_precomp;typedef struct{fe YplusX;fe YminusX;fe Z;fe T2d;}ge_cached;void ge_p3_tobytes(u8*s,C ge_p3*h);int ge_p3_batch_tobytes(u8*s,C ge_p3*h,size_t n);void ge_tobytes(u8*s,C ge_p2*h);int ge_frombytes_negate_vartime(ge_p3*h,C u8*s);void ge_add(ge_p1p1*r,C ge_p3*p,C ge_cached*q);void ge_sub(ge_p1p1*r,C ge_p3*p,C ge_cached*q);void ge_double_scalarmult_vartime(ge_p2*r,C u8*a,C ge_p3*A,C u8*b);void ge_double_scalarmult_cached_vartime(ge_p2*r,C u8*a,C ge_cached*Ai,C u8*b);void ge_double_scalarmult_table_vartime(ge_p2*r,C u8*a,C ge_cached*Ai,C u8*b,C ge_precomp*Bt,int w);int ge_multi_scalarmult_vartime(ge_p2*r,C u8*a,C ge_p3*A,size_t n,C u8*b);void ge_madd(ge_p1p1*r,C ge_p3*p,C ge_precomp*q);void ge_msub(ge_p1p1*r,C ge_p3*p,C ge_precomp*q);void ge_scalarmult_base(ge_p3*h,C u8*a);int ge_select_init(void);int ge_select_check(void);
+#define GE_BASE_WIDE_MAX 12
+int ge_base_wide_init(size_t budget);int ge_base_wide_width(void);void ge_p1p1_to_p2(ge_p2*r,C ge_p1p1*p);void ge_p1p1_to_p3(ge_p3*r,C ge_p1p1*p);void ge_p2_0(ge_p2*h);void ge_p2_dbl(ge_p1p1*r,C ge_p2*p);void ge_p3_0(ge_p3*h);void ge_p3_dbl(ge_p1p1*r,C ge_p3*p);void ge_p3_to_cached(ge_cached*r,C ge_p3*p);void ge_p3_odd_multiples(ge_cached*Ai,C ge_p3*A);void ge_p3_to_p2(ge_p2*r,C ge_p3*p);
+#ifdef ED25519_STATIC_PRECOMP
+void LOOKT_write_lookup_table_to_flash(void){}
+#endif
+#ifndef ED25519_STATIC_PRECOMP
+static C ge_precomp Bi[8]={{FE(25967493,-14356035,29566456,3660896,-12694345,4014787,27544626,-11754271,-6079156,2047605),FE(-12545711,934262,-2722910,3049990,-727428,9406986,12720692,5043384,19500929,-15469378),FE(-8738181,4489570,9688441,-14785194,10184609,-12363380,29287919,11864899,-24514362,-4438546),},{FE(15636291,-9688557,24204773,-7912398,616977,-16685262,27787600,-14772189,28944400,-1550024),FE(16568933,4717097,-11556148,-1102322,15682896,-11807043,16354577,-11775962,7689662,11199574),FE(30464156,-5976125,-11779434,-15670865,23220365,15915852,7512774,10017326,-17749093,-9920357),},{FE(10861363,11473154,27284546,1981175,-30064349,12577861,32867885,14515107,-15438304,10819380),FE(4708026,6336745,20377586,9066809,-11272109,6594696,-25653668,12483688,-12668491,5581306),FE(19563160,16186464,-29386857,4097519,10237984,-4348115,28542350,13850243,-23678021,-15815942),},{FE(5153746,9909285,1723747,-2777874,30523605,5516873,19480852,5230134,-23952439,-15175766),FE(-30269007,-3463509,7665486,10083793,28475525,1649722,20654025,16520125,30598449,7715701),FE(28881845,14381568,9657904,3680757,-20181635,7843316,-31400660,1370708,29794553,-1409300),},{FE(-22518993,-6692182,14201702,-8745502,-23510406,8844726,18474211,-1361450,-13062696,13821877),FE(-6455177,-7839871,3374702,-4740862,-27098617,-10571707,31655028,-7212327,18853322,-14220951),FE(4566830,-12963868,-28974889,-12240689,-7602672,-2830569,-8514358,-10431137,2207753,-3209784),},{FE(-25154831,-4185821,29681144,7868801,-6854661,-9423865,-12437364,-663000,-31111463,-16132436),FE(25576264,-2703214,7349804,-11814844,16472782,9300885,3844789,15725684,171356,6466918),FE(23103977,13316479,9739013,-16149481,817875,-15038942,8965339,-14088058,-30714912,16193877),},{FE(-33521811,3180713,-2394130,14003687,-16903474,-16270840,17238398,4729455,-18074513,9256800),FE(-25182317,-4174131,32336398,5036987,-21236817,11360617,22616405,9761698,-19827198,630305),FE(-13720693,2639453,-24237460,-7406481,9494427,-5774029,-6554551,-15960994,-2449256,-14291300),},{FE(-3151181,-5046075,9282714,6866145,-31907062,-863023,-18940575,15033784,25105118,-7894876),FE(-24326370,15950226,-31801215,-14592823,-11662737,-5090925,1573892,-2625887,2198790,-15804619),FE(-3099351,10324967,-2241613,7453183,-5446979,-2735503,-13812022,-16236442,-32461234,-12290683),},};// didn't find full solution yet
+static ge_precomp base[32][8];static int active_row;void cached_to_precomp(ge_precomp*preComp,ge_cached*cached){fe inverse;fe_invert(inverse,cached->Z);fe_mul(preComp->yminusx,cached->YminusX,inverse);fe_mul(preComp->yplusx,cached->YplusX,inverse);fe_mul(preComp->xy2d,cached->T2d,inverse);}void compute_row(ge_cached*b){ge_precomp result;ge_p3 p3;ge_p3_0(&p3);int j;for(j=0;j < 8;j++){ge_p1p1 p1p1;ge_cached cached;ge_add(&p1p1,& p3,b);ge_p1p1_to_p3(& p3,& p1p1);ge_p3_to_cached(& cached,& p3);cached_to_precomp(&result,&cached);base[active_row][j]=result;}}void compute_lookup_table(ge_cached*b){ge_p3 p3;ge_p2 p2;ge_p1p1 p1p1;ge_cached cached;ge_p3_0(&p3);ge_add(&p1p1,&p3,b);ge_p1p1_to_p3(&p3,&p1p1);int i,k;for(i=0;i < 32;i++){active_row=i;ge_p3_to_cached(&cached,&p3);compute_row(&cached);ge_p3_to_p2(&p2,&p3);for(k=0;k < 7;k++){ge_p2_dbl(&p1p1,&p2);ge_p1p1_to_p2(&p2,&p1p1);}ge_p2_dbl(& p1p1,& p2);ge_p1p1_to_p3(& p3,& p1p1);}}void LOOKT_write_lookup_table_to_flash(void){fe ypx=FE(25967493,-14356035,29566456,3660896,-12694345,4014787,27544626,-11754271,-6079156,2047605);fe ymx=FE(-12545711,934262,-2722910,3049990,-727428,9406986,12720692,5043384,19500929,-15469378);fe T2d=FE(-8738181,4489570,9688441,-14785194,10184609,-12363380,29287919,11864899,-24514362,-4438546);fe Z;fe_1(Z);ge_cached Bi0;fe_copy(Bi0.YplusX,ypx);fe_copy(Bi0.YminusX,ymx);fe_copy(Bi0.T2d,T2d);fe_copy(Bi0.Z,Z);compute_lookup_table(&Bi0);}
+#endif
+void ge_add(ge_p1p1*r,C ge_p3*p,C ge_cached*q){fe t0;fe_add(r->X,p->Y,p->X);fe_sub(r->Y,p->Y,p->X);fe_mul(r->Z,r->X,q->YplusX);fe_mul(r->Y,r->Y,q->YminusX);fe_mul(r->T,q->T2d,p->T);fe_mul(r->X,p->Z,q->Z);fe_add(t0,r->X,r->X);fe_sub(r->X,r->Z,r->Y);fe_add(r->Y,r->Z,r->Y);fe_add(r->Z,t0,r->T);fe_sub(r->T,t0,r->T);}static void slide_w(short*r,C u8*a,int w){int i;int b;int k;int m=(1<<(w-1))-1;for(i=0;i < 256;++i){r[i]=1 &(a[i>>3]>>(i & 7));}for(i=0;i < 256;++i)if(r[i]){for(b=1;b <=w+1 && i+b < 256;++b){if(r[i+b]){if(r[i]+(r[i+b]<<b)<=m){r[i]+=r[i+b]<<b;r[i+b]=0;}else if(r[i]-(r[i+b]<<b)>=-m){r[i]-=r[i+b]<<b;for(k=i+b;k < 256;++k){if(!r[k]){r[k]=1;break;}r[k]=0;}}else{break;}}}}}static void slide(short*r,C u8*a){slide_w(r,a,5);}static ge_precomp*Bw=0;static int Bw_width=0;static void base_table(C ge_precomp**table,int*width){if(Bw_width){*table=Bw;*width=Bw_width;}else{*table=Bi;*width=5;}}int ge_base_wide_init(size_t budget){ge_p3 B;ge_p3 B2;ge_p3 u;ge_p1p1 t;ge_cached*Ci;fe*z;fe*zinv;size_t count=0;size_t i;int w;free(Bw);Bw=0;Bw_width=0;for(w=GE_BASE_WIDE_MAX;w > 5;--w){count=(size_t)1<<(w-2);if(count*sizeof(ge_precomp)<=budget){break;}}if(w==5){E 5;}Bw=(ge_precomp*)malloc(count*sizeof(ge_precomp));Ci=(ge_cached*)malloc(count*sizeof(ge_cached));z=(fe*)malloc(2*count*sizeof(fe));if(Bw==0||Ci==0||z==0){free(Bw);free(Ci);free(z);Bw=0;E 5;}ge_p3_0(&u);ge_madd(&t,&u,&Bi[0]);ge_p1p1_to_p3(&B,&t);ge_p3_to_cached(&Ci[0],&B);ge_p3_dbl(&t,&B);ge_p1p1_to_p3(&B2,&t);for(i=1;i < count;++i){ge_add(&t,&B2,&Ci[i-1]);ge_p1p1_to_p3(&u,&t);ge_p3_to_cached(&Ci[i],&u);}zinv=z+count;for(i=0;i < count;++i){fe_copy(z[i],Ci[i].Z);}fe_batch_invert(zinv,z,count);for(i=0;i < count;++i){fe_mul(Bw[i].yplusx,Ci[i].YplusX,zinv[i]);fe_mul(Bw[i].yminusx,Ci[i].YminusX,zinv[i]);fe_mul(Bw[i].xy2d,Ci[i].T2d,zinv[i]);}free(Ci);free(z);Bw_width=w;E w;}int ge_base_wide_width(void){E Bw_width ? Bw_width:5;}void ge_p3_odd_multiples(ge_cached*Ai,C ge_p3*A){ge_p1p1 t;ge_p3 u;ge_p3 A2;int i;ge_p3_to_cached(&Ai[0],A);ge_p3_dbl(&t,A);ge_p1p1_to_p3(&A2,&t);for(i=1;i < 8;++i){ge_add(&t,&A2,&Ai[i-1]);ge_p1p1_to_p3(&u,&t);ge_p3_to_cached(&Ai[i],&u);}}void ge_double_scalarmult_vartime(ge_p2*r,C u8*a,C ge_p3*A,C u8*b){ge_cached Ai[8];ge_p3_odd_multiples(Ai,A);ge_double_scalarmult_cached_vartime(r,a,Ai,b);}void ge_double_scalarmult_cached_vartime(ge_p2*r,C u8*a,C ge_cached*Ai,C u8*b){C ge_precomp*Bt;int w;base_table(&Bt,&w);ge_double_scalarmult_table_vartime(r,a,Ai,b,Bt,w);}void ge_double_scalarmult_table_vartime(ge_p2*r,C u8*a,C ge_cached*Ai,C u8*b,C ge_precomp*Bt,int w){short aslide[256];short bslide[256];ge_p1p1 t;ge_p3 u;int i;slide(aslide,a);slide_w(bslide,b,w);ge_p2_0(r);for(i=255;i >=0;--i){if(aslide[i]||bslide[i]){break;}}for(;i >=0;--i){ge_p2_dbl(&t,r);if(aslide[i] > 0){ge_p1p1_to_p3(&u,&t);ge_add(&t,&u,&Ai[aslide[i] / 2]);}else if(aslide[i] < 0){ge_p1p1_to_p3(&u,&t);ge_sub(&t,&u,&Ai[(-aslide[i])/ 2]);}if(bslide[i] > 0){ge_p1p1_to_p3(&u,&t);ge_madd(&t,&u,&Bt[bslide[i] / 2]);}else if(bslide[i] < 0){ge_p1p1_to_p3(&u,&t);ge_msub(&t,&u,&Bt[(-bslide[i])/ 2]);}ge_p1p1_to_p2(r,&t);}}int ge_multi_scalarmult_vartime(ge_p2*r,C u8*a,C ge_p3*A,size_t n,C u8*b){short*aslide;short bslide[256];ge_cached*Ai;ge_p1p1 t;ge_p3 u;short v;size_t j;int i;int top=-1;C ge_precomp*Bt;int w;aslide=(short*)malloc(n*256*sizeof(short));Ai=(ge_cached*)malloc(n*8*sizeof(ge_cached));if(aslide==0||Ai==0){free(aslide);free(Ai);E-1;}base_table(&Bt,&w);slide_w(bslide,b,w);for(i=255;i > top;--i){if(bslide[i]){top=i;}}for(j=0;j < n;++j){slide(aslide+256*j,a+32*j);ge_p3_odd_multiples(Ai+8*j,&A[j]);for(i=255;i > top;--i){if(aslide[256*j+i]){top=i;}}}ge_p2_0(r);for(i=top;i >=0;--i){ge_p2_dbl(&t,r);for(j=0;j < n;++j){v=aslide[256*j+i];if(v > 0){ge_p1p1_to_p3(&u,&t);ge_add(&t,&u,&Ai[8*j+v / 2]);}else if(v < 0){ge_p1p1_to_p3(&u,&t);ge_sub(&t,&u,&Ai[8*j+(-v)/ 2]);}}if(bslide[i] > 0){ge_p1p1_to_p3(&u,&t);ge_madd(&t,&u,&Bt[bslide[i] / 2]);}else if(bslide[i] < 0){ge_p1p1_to_p3(&u,&t);ge_msub(&t,&u,&Bt[(-bslide[i])/ 2]);}ge_p1p1_to_p2(r,&t);}free(aslide);free(Ai);E 0;}static C fe d=FE(-10913610,13857413,-15372611,6949391,114729,-8787816,-6275908,-3247719,-18696448,-12055116);static C fe sqrtm1=FE(-32595792,-7943725,9377950,3500415,12389472,-272473,-25146209,-2005654,326686,11406482);int ge_frombytes_negate_vartime(ge_p3*h,C u8*s){fe u;fe v;fe v3;fe vxx;fe check;fe_frombytes(h->Y,s);fe_1(h->Z);fe_sq(u,h->Y);fe_mul(v,u,d);fe_sub(u,u,h->Z);fe_add(v,v,h->Z);fe_sq(v3,v);fe_mul(v3,v3,v);fe_sq(h->X,v3);fe_mul(h->X,h->X,v);fe_mul(h->X,h->X,u);fe_pow22523(h->X,h->X);fe_mul(h->X,h->X,v3);fe_mul(h->X,h->X,u);fe_sq(vxx,h->X);fe_mul(vxx,vxx,v);fe_sub(check,vxx,u);if(fe_isnonzero(check)){fe_add(check,vxx,u);if(fe_isnonzero(check)){E-1;}fe_mul(h->X,h->X,sqrtm1);}if(fe_isnegative(h->X)==(s[31]>>7)){fe_neg(h->X,h->X);}fe_mul(h->T,h->X,h->Y);E 0;}void ge_madd(ge_p1p1*r,C ge_p3*p,C ge_precomp*q){fe t0;fe_add(r->X,p->Y,p->X);fe_sub(r->Y,p->Y,p->X);fe_mul(r->Z,r->X,q->yplusx);fe_mul(r->Y,r->Y,q->yminusx);fe_mul(r->T,q->xy2d,p->T);fe_add(t0,p->Z,p->Z);fe_sub(r->X,r->Z,r->Y);fe_add(r->Y,r->Z,r->Y);fe_add(r->Z,t0,r->T);fe_sub(r->T,t0,r->T);}void ge_msub(ge_p1p1*r,C ge_p3*p,C ge_precomp*q){fe t0;fe_add(r->X,p->Y,p->X);fe_sub(r->Y,p->Y,p->X);fe_mul(r->Z,r->X,q->yminusx);fe_mul(r->Y,r->Y,q->yplusx);fe_mul(r->T,q->xy2d,p->T);fe_add(t0,p->Z,p->Z);fe_sub(r->X,r->Z,r->Y);fe_add(r->Y,r->Z,r->Y);fe_sub(r->Z,t0,r->T);fe_add(r->T,t0,r->T);}void ge_p1p1_to_p2(ge_p2*r,C ge_p1p1*p){fe_mul(r->X,p->X,p->T);fe_mul(r->Y,p->Y,p->Z);fe_mul(r->Z,p->Z,p->T);}void ge_p1p1_to_p3(ge_p3*r,C ge_p1p1*p){fe_mul(r->X,p->X,p->T);fe_mul(r->Y,p->Y,p->Z);fe_mul(r->Z,p->Z,p->T);fe_mul(r->T,p->X,p->Y);}void ge_p2_0(ge_p2*h){fe_0(h->X);fe_1(h->Y);fe_1(h->Z);}void ge_p2_dbl(ge_p1p1*r,C ge_p2*p){fe t0;fe_sq(r->X,p->X);fe_sq(r->Z,p->Y);fe_sq2(r->T,p->Z);fe_add(r->Y,p->X,p->Y);fe_sq(t0,r->Y);fe_add(r->Y,r->Z,r->X);fe_sub(r->Z,r->Z,r->X);fe_sub(r->X,t0,r->Y);fe_sub(r->T,r->T,r->Z);}void ge_p3_0(ge_p3*h){fe_0(h->X);fe_1(h->Y);fe_1(h->Z);fe_0(h->T);}void ge_p3_dbl(ge_p1p1*r,C ge_p3*p){ge_p2 q;ge_p3_to_p2(&q,p);ge_p2_dbl(r,&q);}static C fe d2=FE(-21827239,-5839606,-30745221,13898782,229458,15978800,-12551817,-6495438,29715968,9444199);void ge_p3_to_cached(ge_cached*r,C ge_p3*p){fe_add(r->YplusX,p->Y,p->X);fe_sub(r->YminusX,p->Y,p->X);fe_copy(r->Z,p->Z);fe_mul(r->T2d,p->T,d2);}void ge_p3_to_p2(ge_p2*r,C ge_p3*p){fe_copy(r->X,p->X);fe_copy(r->Y,p->Y);fe_copy(r->Z,p->Z);}void ge_p3_tobytes(u8*s,C ge_p3*h){fe recip;fe x;fe y;fe_invert(recip,h->Z);fe_mul(x,h->X,recip);fe_mul(y,h->Y,recip);fe_tobytes(s,y);s[31]^=fe_isnegative(x)<<7;}int ge_p3_batch_tobytes(u8*s,C ge_p3*h,size_t n){fe*z;fe*recip;fe x;fe y;size_t i;z=(fe*)malloc(2*n*sizeof(fe));if(z==0){E-1;}recip=z+n;for(i=0;i < n;++i){fe_copy(z[i],h[i].Z);}fe_batch_invert(recip,z,n);for(i=0;i < n;++i){fe_mul(x,h[i].X,recip[i]);fe_mul(y,h[i].Y,recip[i]);fe_tobytes(s+32*i,y);s[32*i+31]^=fe_isnegative(x)<<7;}free(z);E 0;}static u8 equal(signed char b,signed char c){u8 ub=b;u8 uc=c;u8 x=ub^uc;u64 y=x;y-=1;y>>=63;E(u8)y;}static u8 negative(signed char b){u64 x=b;x>>=63;E(u8)x;}static void cmov(ge_precomp*t,C ge_precomp*u,u8 b){fe_cmov(t->yplusx,u->yplusx,b);fe_cmov(t->yminusx,u->yminusx,b);fe_cmov(t->xy2d,u->xy2d,b);}static void select_row_scalar(ge_precomp*t,C ge_precomp*row,u8 babs){fe_1(t->yplusx);fe_1(t->yminusx);fe_0(t->xy2d);cmov(t,&row[0],equal(babs,1));cmov(t,&row[1],equal(babs,2));cmov(t,&row[2],equal(babs,3));cmov(t,&row[3],equal(babs,4));cmov(t,&row[4],equal(babs,5));cmov(t,&row[5],equal(babs,6));cmov(t,&row[6],equal(babs,7));cmov(t,&row[7],equal(babs,8));}typedef u32 ge_v8u32 __attribute__((vector_size(32)));typedef char ge_precomp_is_4_chunks[sizeof(ge_precomp)> 96 && sizeof(ge_precomp)<=128 ? 1:-1];__attribute__((target("avx2")))static void select_row_avx2(ge_precomp*t,C ge_precomp*row,u8 babs){C size_t last=sizeof(ge_precomp)-32;ge_v8u32 a0,a1,a2,a3;ge_v8u32 v0,v1,v2,v3;ge_v8u32 mask;ge_v8u32 zero={0};C u8*p;int j;fe_1(t->yplusx);fe_1(t->yminusx);fe_0(t->xy2d);p=(C u8*)t;memcpy(&a0,p,32);memcpy(&a1,p+32,32);memcpy(&a2,p+64,32);memcpy(&a3,p+last,32);for(j=0;j < 8;++j){mask=zero-(u32)equal(babs,j+1);p=(C u8*)&row[j];memcpy(&v0,p,32);memcpy(&v1,p+32,32);memcpy(&v2,p+64,32);memcpy(&v3,p+last,32);a0^=(a0^v0)& mask;a1^=(a1^v1)& mask;a2^=(a2^v2)& mask;a3^=(a3^v3)& mask;}memcpy((u8*)t,&a0,32);memcpy((u8*)t+32,&a1,32);memcpy((u8*)t+64,&a2,32);memcpy((u8*)t+last,&a3,32);}typedef void(*select_row_fn)(ge_precomp*t,C ge_precomp*row,u8 babs);static select_row_fn select_row_kernel=0;static void select_with(ge_precomp*t,int pos,signed char b,select_row_fn kernel){ge_precomp minust;u8 bnegative=negative(b);u8 babs=b-(((-bnegative)& b)<<1);kernel(t,base[pos],babs);fe_copy(minust.yplusx,t->yminusx);fe_copy(minust.yminusx,t->yplusx);fe_neg(minust.xy2d,t->xy2d);cmov(t,&minust,bnegative);}static int select_mismatch_count(void){ge_precomp t0;ge_precomp t1;int pos;int b;int res=0;for(pos=0;pos < 32;++pos){for(b=-8;b <=8;++b){select_with(&t0,pos,b,select_row_scalar);select_with(&t1,pos,b,select_row_avx2);res+=memcmp(&t0,&t1,sizeof(ge_precomp))!=0;}}E res;}int ge_select_init(void){if(select_row_kernel !=0){E select_row_kernel==select_row_avx2;}__builtin_cpu_init();if(__builtin_cpu_supports("avx2")&& select_mismatch_count()==0){select_row_kernel=select_row_avx2;E 1;}select_row_kernel=select_row_scalar;E 0;}int ge_select_check(void){__builtin_cpu_init();if(!__builtin_cpu_supports("avx2")){E-1;}E select_mismatch_count();}static void select(ge_precomp*t,int pos,signed char b){select_with(t,pos,b,select_row_kernel);}void ge_scalarmult_base(ge_p3*h,C u8*a){signed char e[64];signed char L;ge_p1p1 r;ge_p2 s;ge_precomp t;int i;ge_select_init();for(i=0;i < 32;++i){e[2*i+0]=(a[i]>>0)& 15;e[2*i+1]=(a[i]>>4)& 15;}L=0;for(i=0;i < 63;++i){e[i]+=L;L=e[i]+8;L>>=4;e[i]-=L<<4;}e[63]+=L;ge_p3_0(h);for(i=1;i < 64;i+=2){select(&t,i / 2,e[i]);ge_madd(&r,h,&t);ge_p1p1_to_p3(h,&r);}ge_p3_dbl(&r,h);ge_p1p1_to_p2(&s,&r);ge_p2_dbl(&r,&s);ge_p1p1_to_p2(&s,&r);ge_p2_dbl(&r,&s);ge_p1p1_to_p2(&s,&r);ge_p2_dbl(&r,&s);ge_p1p1_to_p3(h,&r);for(i=0;i < 64;i+=2){select(&t,i / 2,e[i]);ge_madd(&r,h,&t);ge_p1p1_to_p3(h,&r);}}void ge_sub(ge_p1p1*r,C ge_p3*p,C ge_cached*q){fe t0;fe_add(r->X,p->Y,p->X);fe_sub(r->Y,p->Y,p->X);fe_mul(r->Z,r->X,q->YminusX);fe_mul(r->Y,r->Y,q->YplusX);fe_mul(r->T,q->T2d,p->T);fe_mul(r->X,p->Z,q->Z);fe_add(t0,r->X,r->X);fe_sub(r->X,r->Z,r->Y);fe_add(r->Y,r->Z,r->Y);fe_sub(r->Z,t0,r->T);fe_add(r->T,t0,r->T);}void ge_tobytes(u8*s,C ge_p2*h){fe recip;fe x;fe y;fe_invert(recip,h->Z);fe_mul(x,h->X,recip);fe_mul(y,h->Y,recip);fe_tobytes(s,y);s[31]^=fe_isnegative(x)<<7;}void sc_reduce(u8*s);void sc_muladd(u8*s,C u8*a,C u8*b,C u8*c);void sc_reduce(u8*s){I s0=2097151 & load_3(s);I s1=2097151 &(load_4(s+2)>>5);I s2=2097151 &(load_3(s+5)>>2);I s3=2097151 &(load_4(s+7)>>7);I s4=2097151 &(load_4(s+10)>>4);I s5=2097151 &(load_3(s+13)>>1);I s6=2097151 &(load_4(s+15)>>6);I s7=2097151 &(load_3(s+18)>>3);I s8=2097151 & load_3(s+21);I s9=2097151 &(load_4(s+23)>>5);I s10=2097151 &(load_3(s+26)>>2);I s11=2097151 &(load_4(s+28)>>7);I s12=2097151 &(load_4(s+31)>>4);I s13=2097151 &(load_3(s+34)>>1);I s14=2097151 &(load_4(s+36)>>6);I s15=2097151 &(load_3(s+39)>>3);I s16=2097151 & load_3(s+42);I s17=2097151 &(load_4(s+44)>>5);I s18=2097151 &(load_3(s+47)>>2);I s19=2097151 &(load_4(s+49)>>7);I s20=2097151 &(load_4(s+52)>>4);I s21=2097151 &(load_3(s+55)>>1);I s22=2097151 &(load_4(s+57)>>6);I s23=(load_4(s+60)>>3);I L0;I L1;I L2;I L3;I L4;I L5;I L6;I L7;I L8;I L9;I L10;I L11;I L12;I L13;I L14;I L15;I L16;s11+=s23*666643;s12+=s23*470296;s13+=s23*654183;s14-=s23*997805;s15+=s23*136657;s16-=s23*683901;s23=0;s10+=s22*666643;s11+=s22*470296;s12+=s22*654183;s13-=s22*997805;s14+=s22*136657;s15-=s22*683901;s22=0;s9+=s21*666643;s10+=s21*470296;s11+=s21*654183;s12-=s21*997805;s13+=s21*136657;s14-=s21*683901;s21=0;s8+=s20*666643;s9+=s20*470296;s10+=s20*654183;s11-=s20*997805;s12+=s20*136657;s13-=s20*683901;s20=0;s7+=s19*666643;s8+=s19*470296;s9+=s19*654183;s10-=s19*997805;s11+=s19*136657;s12-=s19*683901;s19=0;s6+=s18*666643;s7+=s18*470296;s8+=s18*654183;s9-=s18*997805;s10+=s18*136657;s11-=s18*683901;s18=0;L6=(s6+(1<<20))>>21;s7+=L6;s6-=L6<<21;L8=(s8+(1<<20))>>21;s9+=L8;s8-=L8<<21;L10=(s10+(1<<20))>>21;s11+=L10;s10-=L10<<21;L12=(s12+(1<<20))>>21;s13+=L12;s12-=L12<<21;L14=(s14+(1<<20))>>21;s15+=L14;s14-=L14<<21;L16=(s16+(1<<20))>>21;s17+=L16;s16-=L16<<21;L7=(s7+(1<<20))>>21;s8+=L7;s7-=L7<<21;L9=(s9+(1<<20))>>21;s10+=L9;s9-=L9<<21;L11=(s11+(1<<20))>>21;s12+=L11;s11-=L11<<21;L13=(s13+(1<<20))>>21;s14+=L13;s13-=L13<<21;L15=(s15+(1<<20))>>21;s16+=L15;s15-=L15<<21;s5+=s17*666643;s6+=s17*470296;s7+=s17*654183;s8-=s17*997805;s9+=s17*136657;s10-=s17*683901;s17=0;s4+=s16*666643;s5+=s16*470296;s6+=s16*654183;s7-=s16*997805;s8+=s16*136657;s9-=s16*683901;s16=0;s3+=s15*666643;s4+=s15*470296;s5+=s15*654183;s6-=s15*997805;s7+=s15*136657;s8-=s15*683901;s15=0;s2+=s14*666643;s3+=s14*470296;s4+=s14*654183;s5-=s14*997805;s6+=s14*136657;s7-=s14*683901;s14=0;s1+=s13*666643;s2+=s13*470296;s3+=s13*654183;s4-=s13*997805;s5+=s13*136657;s6-=s13*683901;s13=0;s0+=s12*666643;s1+=s12*470296;s2+=s12*654183;s3-=s12*997805;s4+=s12*136657;s5-=s12*683901;s12=0;L0=(s0+(1<<20))>>21;s1+=L0;s0-=L0<<21;L2=(s2+(1<<20))>>21;s3+=L2;s2-=L2<<21;L4=(s4+(1<<20))>>21;s5+=L4;s4-=L4<<21;L6=(s6+(1<<20))>>21;s7+=L6;s6-=L6<<21;L8=(s8+(1<<20))>>21;s9+=L8;s8-=L8<<21;L10=(s10+(1<<20))>>21;s11+=L10;s10-=L10<<21;L1=(s1+(1<<20))>>21;s2+=L1;s1-=L1<<21;L3=(s3+(1<<20))>>21;s4+=L3;s3-=L3<<21;L5=(s5+(1<<20))>>21;s6+=L5;s5-=L5<<21;L7=(s7+(1<<20))>>21;s8+=L7;s7-=L7<<21;L9=(s9+(1<<20))>>21;s10+=L9;s9-=L9<<21;L11=(s11+(1<<20))>>21;s12+=L11;s11-=L11<<21;s0+=s12*666643;s1+=s12*470296;s2+=s12*654183;s3-=s12*997805;s4+=s12*136657;s5-=s12*683901;s12=0;L0=s0>>21;s1+=L0;s0-=L0<<21;L1=s1>>21;s2+=L1;s1-=L1<<21;L2=s2>>21;s3+=L2;s2-=L2<<21;L3=s3>>21;s4+=L3;s3-=L3<<21;L4=s4>>21;s5+=L4;s4-=L4<<21;L5=s5>>21;s6+=L5;s5-=L5<<21;L6=s6>>21;s7+=L6;s6-=L6<<21;L7=s7>>21;s8+=L7;s7-=L7<<21;L8=s8>>21;s9+=L8;s8-=L8<<21;L9=s9>>21;s10+=L9;s9-=L9<<21;L10=s10>>21;s11+=L10;s10-=L10<<21;L11=s11>>21;s12+=L11;s11-=L11<<21;s0+=s12*666643;s1+=s12*470296;s2+=s12*654183;s3-=s12*997805;s4+=s12*136657;s5-=s12*683901;s12=0;L0=s0>>21;s1+=L0;s0-=L0<<21;L1=s1>>21;s2+=L1;s1-=L1<<21;L2=s2>>21;s3+=L2;s2-=L2<<21;L3=s3>>21;s4+=L3;s3-=L3<<21;L4=s4>>21;s5+=L4;s4-=L4<<21;L5=s5>>21;s6+=L5;s5-=L5<<21;L6=s6>>21;s7+=L6;s6-=L6<<21;L7=s7>>21;s8+=L7;s7-=L7<<21;L8=s8>>21;s9+=L8;s8-=L8<<21;L9=s9>>21;s10+=L9;s9-=L9<<21;L10=s10>>21;s11+=L10;s10-=L10<<21;s[0]=(u8)(s0>>0);s[1]=(u8)(s0>>8);s[2]=(u8)((s0>>16)|(s1<<5));s[3]=(u8)(s1>>3);s[4]=(u8)(s1>>11);s[5]=(u8)((s1>>19)|(s2<<2));s[6]=(u8)(s2>>6);s[7]=(u8)((s2>>14)|(s3<<7));s[8]=(u8)(s3>>1);s[9]=(u8)(s3>>9);s[10]=(u8)((s3>>17)|(s4<<4));s[11]=(u8)(s4>>4);s[12]=(u8)(s4>>12);s[13]=(u8)((s4>>20)|(s5<<1));s[14]=(u8)(s5>>7);s[15]=(u8)((s5>>15)|(s6<<6));s[16]=(u8)(s6>>2);s[17]=(u8)(s6>>10);s[18]=(u8)((s6>>18)|(s7<<3));s[19]=(u8)(s7>>5);s[20]=(u8)(s7>>13);s[21]=(u8)(s8>>0);s[22]=(u8)(s8>>8);s[23]=(u8)((s8>>16)|(s9<<5));s[24]=(u8)(s9>>3);s[25]=(u8)(s9>>11);s[26]=(u8)((s9>>19)|(s10<<2));s[27]=(u8)(s10>>6);s[28]=(u8)((s10>>14)|(s11<<7));s[29]=(u8)(s11>>1);s[30]=(u8)(s11>>9);s[31]=(u8)(s11>>17);}void sc_muladd(u8*s,C u8*a,C u8*b,C u8*c){I a0=2097151 & load_3(a);I a1=2097151 &(load_4(a+2)>>5);I a2=2097151 &(load_3(a+5)>>2);I a3=2097151 &(load_4(a+7)>>7);I a4=2097151 &(load_4(a+10)>>4);I a5=2097151 &(load_3(a+13)>>1);I a6=2097151 &(load_4(a+15)>>6);I a7=2097151 &(load_3(a+18)>>3);I a8=2097151 & load_3(a+21);I a9=2097151 &(load_4(a+23)>>5);I a10=2097151 &(load_3(a+26)>>2);I a11=(load_4(a+28)>>7);I b0=2097151 & load_3(b);I b1=2097151 &(load_4(b+2)>>5);I b2=2097151 &(load_3(b+5)>>2);I b3=2097151 &(load_4(b+7)>>7);I b4=2097151 &(load_4(b+10)>>4);I b5=2097151 &(load_3(b+13)>>1);I b6=2097151 &(load_4(b+15)>>6);I b7=2097151 &(load_3(b+18)>>3);I b8=2097151 & load_3(b+21);I b9=2097151 &(load_4(b+23)>>5);I b10=2097151 &(load_3(b+26)>>2);I b11=(load_4(b+28)>>7);I c0=2097151 & load_3(c);I c1=2097151 &(load_4(c+2)>>5);I c2=2097151 &(load_3(c+5)>>2);I c3=2097151 &(load_4(c+7)>>7);I c4=2097151 &(load_4(c+10)>>4);I c5=2097151 &(load_3(c+13)>>1);I c6=2097151 &(load_4(c+15)>>6);I c7=2097151 &(load_3(c+18)>>3);I c8=2097151 & load_3(c+21);I c9=2097151 &(load_4(c+23)>>5);I c10=2097151 &(load_3(c+26)>>2);I c11=(load_4(c+28)>>7);I s0;I s1;I s2;I s3;I s4;I s5;I s6;I s7;I s8;I s9;I s10;I s11;I s12;I s13;I s14;I s15;I s16;I s17;I s18;I s19;I s20;I s21;I s22;I s23;I L0;I L1;I L2;I L3;I L4;I L5;I L6;I L7;I L8;I L9;I L10;I L11;I L12;I L13;I L14;I L15;I L16;I L17;I L18;I L19;I L20;I L21;I L22;s0=c0+a0*b0;s1=c1+a0*b1+a1*b0;s2=c2+a0*b2+a1*b1+a2*b0;s3=c3+a0*b3+a1*b2+a2*b1+a3*b0;s4=c4+a0*b4+a1*b3+a2*b2+a3*b1+a4*b0;s5=c5+a0*b5+a1*b4+a2*b3+a3*b2+a4*b1+a5*b0;s6=c6+a0*b6+a1*b5+a2*b4+a3*b3+a4*b2+a5*b1+a6*b0;s7=c7+a0*b7+a1*b6+a2*b5+a3*b4+a4*b3+a5*b2+a6*b1+a7*b0;s8=c8+a0*b8+a1*b7+a2*b6+a3*b5+a4*b4+a5*b3+a6*b2+a7*b1+a8*b0;s9=c9+a0*b9+a1*b8+a2*b7+a3*b6+a4*b5+a5*b4+a6*b3+a7*b2+a8*b1+a9*b0;s10=c10+a0*b10+a1*b9+a2*b8+a3*b7+a4*b6+a5*b5+a6*b4+a7*b3+a8*b2+a9*b1+a10*b0;s11=c11+a0*b11+a1*b10+a2*b9+a3*b8+a4*b7+a5*b6+a6*b5+a7*b4+a8*b3+a9*b2+a10*b1+a11*b0;s12=a1*b11+a2*b10+a3*b9+a4*b8+a5*b7+a6*b6+a7*b5+a8*b4+a9*b3+a10*b2+a11*b1;s13=a2*b11+a3*b10+a4*b9+a5*b8+a6*b7+a7*b6+a8*b5+a9*b4+a10*b3+a11*b2;s14=a3*b11+a4*b10+a5*b9+a6*b8+a7*b7+a8*b6+a9*b5+a10*b4+a11*b3;s15=a4*b11+a5*b10+a6*b9+a7*b8+a8*b7+a9*b6+a10*b5+a11*b4;s16=a5*b11+a6*b10+a7*b9+a8*b8+a9*b7+a10*b6+a11*b5;s17=a6*b11+a7*b10+a8*b9+a9*b8+a10*b7+a11*b6;s18=a7*b11+a8*b10+a9*b9+a10*b8+a11*b7;s19=a8*b11+a9*b10+a10*b9+a11*b8;s20=a9*b11+a10*b10+a11*b9;s21=a10*b11+a11*b10;s22=a11*b11;s23=0;L0=(s0+(1<<20))>>21;s1+=L0;s0-=L0<<21;L2=(s2+(1<<20))>>21;s3+=L2;s2-=L2<<21;L4=(s4+(1<<20))>>21;s5+=L4;s4-=L4<<21;L6=(s6+(1<<20))>>21;s7+=L6;s6-=L6<<21;L8=(s8+(1<<20))>>21;s9+=L8;s8-=L8<<21;L10=(s10+(1<<20))>>21;s11+=L10;s10-=L10<<21;L12=(s12+(1<<20))>>21;s13+=L12;s12-=L12<<21;L14=(s14+(1<<20))>>21;s15+=L14;s14-=L14<<21;L16=(s16+(1<<20))>>21;s17+=L16;s16-=L16<<21;L18=(s18+(1<<20))>>21;s19+=L18;s18-=L18<<21;L20=(s20+(1<<20))>>21;s21+=L20;s20-=L20<<21;L22=(s22+(1<<20))>>21;s23+=L22;s22-=L22<<21;L1=(s1+(1<<20))>>21;s2+=L1;s1-=L1<<21;L3=(s3+(1<<20))>>21;s4+=L3;s3-=L3<<21;L5=(s5+(1<<20))>>21;s6+=L5;s5-=L5<<21;L7=(s7+(1<<20))>>21;s8+=L7;s7-=L7<<21;L9=(s9+(1<<20))>>21;s10+=L9;s9-=L9<<21;L11=(s11+(1<<20))>>21;s12+=L11;s11-=L11<<21;L13=(s13+(1<<20))>>21;s14+=L13;s13-=L13<<21;L15=(s15+(1<<20))>>21;s16+=L15;s15-=L15<<21;L17=(s17+(1<<20))>>21;s18+=L17;s17-=L17<<21;L19=(s19+(1<<20))>>21;s20+=L19;s19-=L19<<21;L21=(s21+(1<<20))>>21;s22+=L21;s21-=L21<<21;s11+=s23*666643;s12+=s23*470296;s13+=s23*654183;s14-=s23*997805;s15+=s23*136657;s16-=s23*683901;s23=0;s10+=s22*666643;s11+=s22*470296;s12+=s22*654183;s13-=s22*997805;s14+=s22*136657;s15-=s22*683901;s22=0;s9+=s21*666643;s10+=s21*470296;s11+=s21*654183;s12-=s21*997805;s13+=s21*136657;s14-=s21*683901;s21=0;s8+=s20*666643;s9+=s20*470296;s10+=s20*654183;s11-=s20*997805;s12+=s20*136657;s13-=s20*683901;s20=0;s7+=s19*666643;s8+=s19*470296;s9+=s19*654183;s10-=s19*997805;s11+=s19*136657;s12-=s19*683901;s19=0;s6+=s18*666643;s7+=s18*470296;s8+=s18*654183;s9-=s18*997805;s10+=s18*136657;s11-=s18*683901;s18=0;L6=(s6+(1<<20))>>21;s7+=L6;s6-=L6<<21;L8=(s8+(1<<20))>>21;s9+=L8;s8-=L8<<21;L10=(s10+(1<<20))>>21;s11+=L10;s10-=L10<<21;L12=(s12+(1<<20))>>21;s13+=L12;s12-=L12<<21;L14=(s14+(1<<20))>>21;s15+=L14;s14-=L14<<21;L16=(s16+(1<<20))>>21;s17+=L16;s16-=L16<<21;L7=(s7+(1<<20))>>21;s8+=L7;s7-=L7<<21;L9=(s9+(1<<20))>>21;s10+=L9;s9-=L9<<21;L11=(s11+(1<<20))>>21;s12+=L11;s11-=L11<<21;L13=(s13+(1<<20))>>21;s14+=L13;s13-=L13<<21;L15=(s15+(1<<20))>>21;s16+=L15;s15-=L15<<21;s5+=s17*666643;s6+=s17*470296;s7+=s17*654183;s8-=s17*997805;s9+=s17*136657;s10-=s17*683901;s17=0;s4+=s16*666643;s5+=s16*470296;s6+=s16*654183;s7-=s16*997805;s8+=s16*136657;s9-=s16*683901;s16=0;s3+=s15*666643;s4+=s15*470296;s5+=s15*654183;s6-=s15*997805;s7+=s15*136657;s8-=s15*683901;s15=0;s2+=s14*666643;s3+=s14*470296;s4+=s14*654183;s5-=s14*997805;s6+=s14*136657;s7-=s14*683901;s14=0;s1+=s13*666643;s2+=s13*470296;s3+=s13*654183;s4-=s13*997805;s5+=s13*136657;s6-=s13*683901;s13=0;s0+=s12*666643;s1+=s12*470296;s2+=s12*654183;s3-=s12*997805;s4+=s12*136657;s5-=s12*683901;s12=0;L0=(s0+(1<<20))>>21;s1+=L0;s0-=L0<<21;L2=(s2+(1<<20))>>21;s3+=L2;s2-=L2<<21;L4=(s4+(1<<20))>>21;s5+=L4;s4-=L4<<21;L6=(s6+(1<<20))>>21;s7+=L6;s6-=L6<<21;L8=(s8+(1<<20))>>21;s9+=L8;s8-=L8<<21;L10=(s10+(1<<20))>>21;s11+=L10;s10-=L10<<21;L1=(s1+(1<<20))>>21;s2+=L1;s1-=L1<<21;L3=(s3+(1<<20))>>21;s4+=L3;s3-=L3<<21;L5=(s5+(1<<20))>>21;s6+=L5;s5-=L5<<21;L7=(s7+(1<<20))>>21;s8+=L7;s7-=L7<<21;L9=(s9+(1<<20))>>21;s10+=L9;s9-=L9<<21;L11=(s11+(1<<20))>>21;s12+=L11;s11-=L11<<21;s0+=s12*666643;s1+=s12*470296;s2+=s12*654183;s3-=s12*997805;s4+=s12*136657;s5-=s12*683901;s12=0;L0=s0>>21;s1+=L0;s0-=L0<<21;L1=s1>>21;s2+=L1;s1-=L1<<21;L2=s2>>21;s3+=L2;s2-=L2<<21;L3=s3>>21;s4+=L3;s3-=L3<<21;L4=s4>>21;s5+=L4;s4-=L4<<21;L5=s5>>21;s6+=L5;s5-=L5<<21;L6=s6>>21;s7+=L6;s6-=L6<<21;L7=s7>>21;s8+=L7;s7-=L7<<21;L8=s8>>21;s9+=L8;s8-=L8<<21;L9=s9>>21;s10+=L9;s9-=L9<<21;L10=s10>>21;s11+=L10;s10-=L10<<21;L11=s11>>21;s12+=L11;s11-=L11<<21;s0+=s12*666643;s1+=s12*470296;s2+=s12*654183;s3-=s12*997805;s4+=s12*136657;s5-=s12*683901;s12=0;L0=s0>>21;s1+=L0;s0-=L0<<21;L1=s1>>21;s2+=L1;s1-=L1<<21;L2=s2>>21;s3+=L2;s2-=L2<<21;L3=s3>>21;s4+=L3;s3-=L3<<21;L4=s4>>21;s5+=L4;s4-=L4<<21;L5=s5>>21;s6+=L5;s5-=L5<<21;L6=s6>>21;s7+=L6;s6-=L6<<21;L7=s7>>21;s8+=L7;s7-=L7<<21;L8=s8>>21;s9+=L8;s8-=L8<<21;L9=s9>>21;s10+=L9;s9-=L9<<21;L10=s10>>21;s11+=L10;s10-=L10<<21;s[0]=(u8)(s0>>0);s[1]=(u8)(s0>>8);s[2]=(u8)((s0>>16)|(s1<<5));s[3]=(u8)(s1>>3);s[4]=(u8)(s1>>11);s[5]=(u8)((s1>>19)|(s2<<2));s[6]=(u8)(s2>>6);s[7]=(u8)((s2>>14)|(s3<<7));s[8]=(u8)(s3>>1);s[9]=(u8)(s3>>9);s[10]=(u8)((s3>>17)|(s4<<4));s[11]=(u8)(s4>>4);s[12]=(u8)(s4>>12);s[13]=(u8)((s4>>20)|(s5<<1));s[14]=(u8)(s5>>7);s[15]=(u8)((s5>>15)|(s6<<6));s[16]=(u8)(s6>>2);s[17]=(u8)(s6>>10);s[18]=(u8)((s6>>18)|(s7<<3));s[19]=(u8)(s7>>5);s[20]=(u8)(s7>>13);s[21]=(u8)(s8>>0);s[22]=(u8)(s8>>8);s[23]=(u8)((s8>>16)|(s9<<5));s[24]=(u8)(s9>>3);s[25]=(u8)(s9>>11);s[26]=(u8)((s9>>19)|(s10<<2));s[27]=(u8)(s10>>6);s[28]=(u8)((s10>>14)|(s11<<7));s[29]=(u8)(s11>>1);s[30]=(u8)(s11>>9);s[31]=(u8)(s11>>17);}
 #include <stddef.h>
-typedef struct sha512_context_{u64 length,state[8];size_t curlen;u8 buf[128];}sha512_context;int sha512_init(sha512_context*md);int sha512_final(sha512_context*md,u8*out);int sha512_update(sha512_context*md,C u8*in,size_t inlen);int sha512(C u8*message,size_t message_len,u8*out);void ed25519_create_keypair(u8*public_key,u8*private_key,C u8*seed){ge_p3 A;sha512(seed,32,private_key);private_key[0] &=248;private_key[31] &=63;private_key[31]|=64;ge_scalarmult_base(&A,private_key);ge_p3_tobytes(public_key,&A);}void ed25519_key_exchange(u8*shared_secret,C u8*public_key,C u8*private_key){u8 e[32];u32 i;fe x1;fe x2;fe z2;fe x3;fe z3;fe tmp0;fe tmp1;int pos;u32 swap;u32 b;for(i=0;i < 32;++i){e[i]=private_key[i];}e[0] &=248;e[31] &=63;e[31]|=64;fe_frombytes(x1,public_key);fe_1(tmp1);fe_add(tmp0,x1,tmp1);fe_sub(tmp1,tmp1,x1);fe_invert(tmp1,tmp1);fe_mul(x1,tmp0,tmp1);fe_1(x2);fe_0(z2);fe_copy(x3,x1);fe_1(z3);swap=0;for(pos=254;pos >=0;--pos){b=e[pos / 8]>>(pos & 7);b &=1;swap^=b;fe_cswap(x2,x3,swap);fe_cswap(z2,z3,swap);swap=b;fe_sub(tmp0,x3,z3);fe_sub(tmp1,x2,z2);fe_add(x2,x2,z2);fe_add(z2,x3,z3);fe_mul(z3,tmp0,x2);fe_mul(z2,z2,tmp1);fe_sq(tmp0,tmp1);fe_sq(tmp1,x2);fe_add(x3,z3,z2);fe_sub(z2,z3,z2);fe_mul(x2,tmp1,tmp0);fe_sub(tmp1,tmp1,tmp0);fe_sq(z2,z2);fe_mul121666(z3,tmp1);fe_sq(x3,x3);fe_add(tmp0,tmp0,z3);fe_mul(z3,x1,z2);fe_mul(z2,tmp1,tmp0);}fe_cswap(x2,x3,swap);fe_cswap(z2,z3,swap);fe_invert(z2,z2);fe_mul(x2,x2,z2);fe_tobytes(shared_secret,x2);}
+typedef struct sha512_context_{u64 length,state[8];size_t curlen;u8 buf[128];}sha512_context;int sha512_init(sha512_context*md);int sha512_final(sha512_context*md,u8*out);int sha512_update(sha512_context*md,C u8*in,size_t inlen);int sha512(C u8*message,size_t message_len,u8*out);size_t sha512_multi_init(void);void sha512_multi(C u8*C*messages,C size_t*message_lens,size_t num,u8*C*out);
+#include <stdlib.h>
+void ed25519_create_keypair(u8*public_key,u8*private_key,C u8*seed){ge_p3 A;sha512(seed,32,private_key);private_key[0] &=248;private_key[31] &=63;private_key[31]|=64;ge_scalarmult_base(&A,private_key);ge_p3_tobytes(public_key,&A);}int ed25519_create_keypairs(u8*public_keys,u8*private_keys,C u8*seeds,size_t num){ge_p3*A;u8*private_key;size_t i;int res;A=(ge_p3*)malloc(num*sizeof(ge_p3));if(A==0){E 1;}for(i=0;i < num;++i){private_key=private_keys+64*i;sha512(seeds+32*i,32,private_key);private_key[0] &=248;private_key[31] &=63;private_key[31]|=64;ge_scalarmult_base(&A[i],private_key);}res=ge_p3_batch_tobytes(public_keys,A,num)!=0;free(A);E res;}void ed25519_key_exchange(u8*shared_secret,C u8*public_key,C u8*private_key){u8 e[32];u32 i;fe x1;fe x2;fe z2;fe x3;fe z3;fe tmp0;fe tmp1;int pos;u32 swap;u32 b;for(i=0;i < 32;++i){e[i]=private_key[i];}e[0] &=248;e[31] &=63;e[31]|=64;fe_frombytes(x1,public_key);fe_1(tmp1);fe_add(tmp0,x1,tmp1);fe_sub(tmp1,tmp1,x1);fe_invert(tmp1,tmp1);fe_mul(x1,tmp0,tmp1);fe_1(x2);fe_0(z2);fe_copy(x3,x1);fe_1(z3);swap=0;for(pos=254;pos >=0;--pos){b=e[pos / 8]>>(pos & 7);b &=1;swap^=b;fe_cswap(x2,x3,swap);fe_cswap(z2,z3,swap);swap=b;fe_sub(tmp0,x3,z3);fe_sub(tmp1,x2,z2);fe_add(x2,x2,z2);fe_add(z2,x3,z3);fe_mul(z3,tmp0,x2);fe_mul(z2,z2,tmp1);fe_sq(tmp0,tmp1);fe_sq(tmp1,x2);fe_add(x3,z3,z2);fe_sub(z2,z3,z2);fe_mul(x2,tmp1,tmp0);fe_sub(tmp1,tmp1,tmp0);fe_sq(z2,z2);fe_mul121666(z3,tmp1);fe_sq(x3,x3);fe_add(tmp0,tmp0,z3);fe_mul(z3,x1,z2);fe_mul(z2,tmp1,tmp0);}fe_cswap(x2,x3,swap);fe_cswap(z2,z3,swap);fe_invert(z2,z2);fe_mul(x2,x2,z2);fe_tobytes(shared_secret,x2);}
 #include <stdio.h>
-int ed25519_create_seed(u8*seed){FILE*f=fopen("/dev/urandom","rb");if(f==0){E 1;}fread(seed,1,32,f);fclose(f);E 0;}void ed25519_sign(u8*signature,C u8*message,size_t message_len,C u8*public_key,C u8*private_key){sha512_context hash;u8 hram[64];u8 r[64];ge_p3 R;sha512_init(&hash);sha512_update(&hash,private_key+32,32);sha512_update(&hash,message,message_len);sha512_final(&hash,r);sc_reduce(r);ge_scalarmult_base(&R,r);ge_p3_tobytes(signature,&R);sha512_init(&hash);sha512_update(&hash,signature,32);sha512_update(&hash,public_key,32);sha512_update(&hash,message,message_len);sha512_final(&hash,hram);sc_reduce(hram);sc_muladd(signature+32,hram,private_key,r);}static int consttime_equal(C u8*x,C u8*y){u8 r=0;r=x[0]^y[0];
+#include <errno.h>
+#include <sys/random.h>
+int ed25519_create_seed(u8*seed){FILE*f=fopen("/dev/urandom","rb");if(f==0){E 1;}fread(seed,1,32,f);fclose(f);E 0;}int ed25519_create_seeds(u8*seeds,size_t num){size_t len=32*num;size_t done=0;ssize_t res;while(done < len){res=getrandom(seeds+done,len-done,0);if(res < 0){if(errno==EINTR){continue;}E 1;}done+=res;}E 0;}void ed25519_sign(u8*signature,C u8*message,size_t message_len,C u8*public_key,C u8*private_key){sha512_context hash;u8 hram[64];u8 r[64];ge_p3 R;sha512_init(&hash);sha512_update(&hash,private_key+32,32);sha512_update(&hash,message,message_len);sha512_final(&hash,r);sc_reduce(r);ge_scalarmult_base(&R,r);ge_p3_tobytes(signature,&R);sha512_init(&hash);sha512_update(&hash,signature,32);sha512_update(&hash,public_key,32);sha512_update(&hash,message,message_len);sha512_final(&hash,hram);sc_reduce(hram);sc_muladd(signature+32,hram,private_key,r);}
+#include <stdio.h>
+#include <string.h>
+static int consttime_equal(C u8*x,C u8*y){u8 r=0;r=x[0]^y[0];
 #define F(i)r|=x[i]^y[i]
 F(1);F(2);F(3);F(4);F(5);F(6);F(7);F(8);F(9);F(10);F(11);F(12);F(13);F(14);F(15);F(16);F(17);F(18);F(19);F(20);F(21);F(22);F(23);F(24);F(25);F(26);F(27);F(28);F(29);F(30);F(31);
 #undef F
-E !r;}int ed25519_verify(C u8*signature,C u8*message,size_t message_len,C u8*public_key){u8 h[64];u8 checker[32];sha512_context hash;ge_p3 A;ge_p2 R;if(signature[63] & 224){E 0;}if(ge_frombytes_negate_vartime(&A,public_key)!=0){E 0;}sha512_init(&hash);sha512_update(&hash,signature,32);sha512_update(&hash,public_key,32);sha512_update(&hash,message,message_len);sha512_final(&hash,h);sc_reduce(h);ge_double_scalarmult_vartime(&R,h,&A,signature+32);ge_tobytes(checker,&R);if(!consttime_equal(checker,signature)){E 0;}E 1;}
+E !r;}struct ed25519_verify_context{u8 public_key[32];ge_p3 A;ge_cached Ai[8];};int ed25519_verify_context_init(ed25519_verify_context*context,C u8*public_key){if(ge_frombytes_negate_vartime(&context->A,public_key)!=0){E 0;}memcpy(context->public_key,public_key,32);ge_p3_odd_multiples(context->Ai,&context->A);E 1;}static int signature_r_negate(ge_p3*r,C u8*signature){u8 check[32];fe x;if(ge_frombytes_negate_vartime(r,signature)!=0){E 0;}fe_tobytes(check,r->Y);fe_neg(x,r->X);check[31]^=fe_isnegative(x)<<7;E consttime_equal(check,signature);}static int ge_p2_is_small_order(ge_p2*p){ge_p1p1 t;fe x;ge_p2_dbl(&t,p);ge_p1p1_to_p2(p,&t);ge_p2_dbl(&t,p);ge_p1p1_to_p2(p,&t);ge_p2_dbl(&t,p);ge_p1p1_to_p2(p,&t);fe_sub(x,p->Y,p->Z);E !fe_isnonzero(p->X)&& !fe_isnonzero(x);}int ed25519_verify_with_context(C u8*signature,C u8*message,size_t message_len,C ed25519_verify_context*context){u8 h[64];sha512_context hash;ge_p3 neg_r;ge_p3 p;ge_cached c;ge_p1p1 t;ge_p2 R;if(signature[63] & 224){E 0;}if(!signature_r_negate(&neg_r,signature)){E 0;}sha512_init(&hash);sha512_update(&hash,signature,32);sha512_update(&hash,context->public_key,32);sha512_update(&hash,message,message_len);sha512_final(&hash,h);sc_reduce(h);ge_double_scalarmult_cached_vartime(&R,h,context->Ai,signature+32);fe_mul(p.X,R.X,R.Z);fe_mul(p.Y,R.Y,R.Z);fe_sq(p.Z,R.Z);fe_mul(p.T,R.X,R.Y);ge_p3_to_cached(&c,&neg_r);ge_add(&t,&p,&c);ge_p1p1_to_p2(&R,&t);E ge_p2_is_small_order(&R);}int ed25519_verify(C u8*signature,C u8*message,size_t message_len,C u8*public_key){ed25519_verify_context context;if(signature[63] & 224){E 0;}if(!ed25519_verify_context_init(&context,public_key)){E 0;}E ed25519_verify_with_context(signature,message,message_len,&context);}
+#define ED25519_BATCH_MAX 64
+static int batch_chunk_verify(C u8**signatures,C u8**messages,C size_t*message_lens,C u8**public_keys,size_t num){static C u8 zero[32]={0};u8 z[ED25519_BATCH_MAX][32];u8 scalars[2*ED25519_BATCH_MAX][32];ge_p3 points[2*ED25519_BATCH_MAX];u8 b[32]={0};u8 h[64];sha512_context hash;ge_p2 r;size_t i;if(ed25519_create_seeds(z[0],num)!=0){E 0;}for(i=0;i < num;++i){memset(z[i]+16,0,16);z[i][0]|=1;}for(i=0;i < num;++i){if(signatures[i][63] & 224){E 0;}if(ge_frombytes_negate_vartime(&points[2*i],public_keys[i])!=0){E 0;}if(!signature_r_negate(&points[2*i+1],signatures[i])){E 0;}sha512_init(&hash);sha512_update(&hash,signatures[i],32);sha512_update(&hash,public_keys[i],32);sha512_update(&hash,messages[i],message_lens[i]);sha512_final(&hash,h);sc_reduce(h);sc_muladd(scalars[2*i],z[i],h,zero);memcpy(scalars[2*i+1],z[i],32);sc_muladd(b,z[i],signatures[i]+32,b);}if(ge_multi_scalarmult_vartime(&r,(C u8*)scalars,points,2*num,b)!=0){E 0;}E ge_p2_is_small_order(&r);}int ed25519_verify_batch(C u8**signatures,C u8**messages,C size_t*message_lens,C u8**public_keys,size_t num,int*valid){size_t i;size_t j;size_t len;int res=1;for(i=0;i < num;i+=len){len=num-i;if(len > ED25519_BATCH_MAX){len=ED25519_BATCH_MAX;}if(batch_chunk_verify(signatures+i,messages+i,message_lens+i,public_keys+i,len)){for(j=i;j < i+len;++j){valid[j]=1;}continue;}for(j=i;j < i+len;++j){valid[j]=ed25519_verify(signatures[j],messages[j],message_lens[j],public_keys[j]);res &=valid[j];}}E res;}
 #define Y UINT64_C
 static C u64 K[80]={Y(0x428a2f98d728ae22),Y(0x7137449123ef65cd),Y(0xb5c0fbcfec4d3b2f),Y(0xe9b5dba58189dbbc),Y(0x3956c25bf348b538),Y(0x59f111f1b605d019),Y(0x923f82a4af194f9b),Y(0xab1c5ed5da6d8118),Y(0xd807aa98a3030242),Y(0x12835b0145706fbe),Y(0x243185be4ee4b28c),Y(0x550c7dc3d5ffb4e2),Y(0x72be5d74f27b896f),Y(0x80deb1fe3b1696b1),Y(0x9bdc06a725c71235),Y(0xc19bf174cf692694),Y(0xe49b69c19ef14ad2),Y(0xefbe4786384f25e3),Y(0x0fc19dc68b8cd5b5),Y(0x240ca1cc77ac9c65),Y(0x2de92c6f592b0275),Y(0x4a7484aa6ea6e483),Y(0x5cb0a9dcbd41fbd4),Y(0x76f988da831153b5),Y(0x983e5152ee66dfab),Y(0xa831c66d2db43210),Y(0xb00327c898fb213f),Y(0xbf597fc7beef0ee4),Y(0xc6e00bf33da88fc2),Y(0xd5a79147930aa725),Y(0x06ca6351e003826f),Y(0x142929670a0e6e70),Y(0x27b70a8546d22ffc),Y(0x2e1b21385c26c926),Y(0x4d2c6dfc5ac42aed),Y(0x53380d139d95b3df),Y(0x650a73548baf63de),Y(0x766a0abb3c77b2a8),Y(0x81c2c92e47edaee6),Y(0x92722c851482353b),Y(0xa2bfe8a14cf10364),Y(0xa81a664bbc423001),Y(0xc24b8b70d0f89791),Y(0xc76c51a30654be30),Y(0xd192e819d6ef5218),Y(0xd69906245565a910),Y(0xf40e35855771202a),Y(0x106aa07032bbd1b8),Y(0x19a4c116b8d2d0c8),Y(0x1e376c085141ab53),Y(0x2748774cdf8eeb99),Y(0x34b0bcb5e19b48a8),Y(0x391c0cb3c5c95a63),Y(0x4ed8aa4ae3418acb),Y(0x5b9cca4f7763e373),Y(0x682e6ff3d6b2b8a3),Y(0x748f82ee5defb2fc),Y(0x78a5636f43172f60),Y(0x84c87814a1f0ab72),Y(0x8cc702081a6439ec),Y(0x90befffa23631e28),Y(0xa4506cebde82bde9),Y(0xbef9a3f7b2c67915),Y(0xc67178f2e372532b),Y(0xca273eceea26619c),Y(0xd186b8c721c0c207),Y(0xeada7dd6cde0eb1e),Y(0xf57d4f7fee6ed178),Y(0x06f067aa72176fba),Y(0x0a637dc5a2c898a6),Y(0x113f9804bef90dae),Y(0x1b710b35131c471b),Y(0x28db77f523047d84),Y(0x32caab7b40c72493),Y(0x3c9ebe0a15c9bebc),Y(0x431d67c49c100d4c),Y(0x4cc5d4becb3e42b6),Y(0x597f299cfc657e2a),Y(0x5fcb6fab3ad6faec),Y(0x6c44198c4a475817)};
 #define ROR64c(x,y)(((((x)&Y(0xFFFFFFFFFFFFFFFF))>>((u64)(y)&Y(63)))|((x)<<((u64)(64-((y)&Y(63))))))& Y(0xFFFFFFFFFFFFFFFF))
@@ -61,30 +128,29 @@ static int sha512_compress(sha512_context*md,u8*buf){u64 S[8],W[80],t0,t1;int i;
 #define RND(a,b,c,d,e,f,g,h,i)t0=h+Sigma1(e)+Ch(e,f,g)+K[i]+W[i];  t1=Sigma0(a)+Maj(a,b,c); d+=t0;  h=t0+t1;
 for(i=0;i < 80;i+=8){RND(S[0],S[1],S[2],S[3],S[4],S[5],S[6],S[7],i+0);RND(S[7],S[0],S[1],S[2],S[3],S[4],S[5],S[6],i+1);RND(S[6],S[7],S[0],S[1],S[2],S[3],S[4],S[5],i+2);RND(S[5],S[6],S[7],S[0],S[1],S[2],S[3],S[4],i+3);RND(S[4],S[5],S[6],S[7],S[0],S[1],S[2],S[3],i+4);RND(S[3],S[4],S[5],S[6],S[7],S[0],S[1],S[2],i+5);RND(S[2],S[3],S[4],S[5],S[6],S[7],S[0],S[1],i+6);RND(S[1],S[2],S[3],S[4],S[5],S[6],S[7],S[0],i+7);}
 #undef RND
-for(i=0;i < 8;i++){md->state[i]=md->state[i]+S[i];}E 0;}int sha512_init(sha512_context*md){if(md==0)E 1;md->curlen=0;md->length=0;md->state[0]=Y(0x6a09e667f3bcc908);md->state[1]=Y(0xbb67ae8584caa73b);md->state[2]=Y(0x3c6ef372fe94f82b);md->state[3]=Y(0xa54ff53a5f1d36f1);md->state[4]=Y(0x510e527fade682d1);md->state[5]=Y(0x9b05688c2b3e6c1f);md->state[6]=Y(0x1f83d9abfb41bd6b);md->state[7]=Y(0x5be0cd19137e2179);E 0;}int sha512_update(sha512_context*md,C u8*in,size_t inlen){size_t n;size_t i;int err;if(md==0)E 1;if(in==0)E 1;if(md->curlen > sizeof(md->buf)){E 1;}while(inlen > 0){if(md->curlen==0 && inlen >=128){if((err=sha512_compress(md,(u8*)in))!=0){E err;}md->length+=128*8;in+=128;inlen-=128;}else{n=min(inlen,(128-md->curlen));for(i=0;i < n;i++){md->buf[i+md->curlen]=in[i];}md->curlen+=n;in+=n;inlen-=n;if(md->curlen==128){if((err=sha512_compress(md,md->buf))!=0){E err;}md->length+=8*128;md->curlen=0;}}}E 0;}int sha512_final(sha512_context*md,u8*out){int i;if(md==0)E 1;if(out==0)E 1;if(md->curlen >=sizeof(md->buf)){E 1;}md->length+=md->curlen*Y(8);md->buf[md->curlen++]=(u8)0x80;if(md->curlen > 112){while(md->curlen < 128){md->buf[md->curlen++]=(u8)0;}sha512_compress(md,md->buf);md->curlen=0;}while(md->curlen < 120){md->buf[md->curlen++]=(u8)0;}STORE64H(md->length,md->buf+120);sha512_compress(md,md->buf);for(i=0;i < 8;i++){STORE64H(md->state[i],out+(8*i));}E 0;}int sha512(C u8*message,size_t message_len,u8*out){sha512_context ctx;int ret;if((ret=sha512_init(&ctx)))E ret;if((ret=sha512_update(&ctx,message,message_len)))E ret;if((ret=sha512_final(&ctx,out)))E ret;E 0;}
+for(i=0;i < 8;i++){md->state[i]=md->state[i]+S[i];}E 0;}int sha512_init(sha512_context*md){if(md==0)E 1;md->curlen=0;md->length=0;md->state[0]=Y(0x6a09e667f3bcc908);md->state[1]=Y(0xbb67ae8584caa73b);md->state[2]=Y(0x3c6ef372fe94f82b);md->state[3]=Y(0xa54ff53a5f1d36f1);md->state[4]=Y(0x510e527fade682d1);md->state[5]=Y(0x9b05688c2b3e6c1f);md->state[6]=Y(0x1f83d9abfb41bd6b);md->state[7]=Y(0x5be0cd19137e2179);E 0;}int sha512_update(sha512_context*md,C u8*in,size_t inlen){size_t n;size_t i;int err;if(md==0)E 1;if(in==0)E 1;if(md->curlen > sizeof(md->buf)){E 1;}while(inlen > 0){if(md->curlen==0 && inlen >=128){if((err=sha512_compress(md,(u8*)in))!=0){E err;}md->length+=128*8;in+=128;inlen-=128;}else{n=min(inlen,(128-md->curlen));for(i=0;i < n;i++){md->buf[i+md->curlen]=in[i];}md->curlen+=n;in+=n;inlen-=n;if(md->curlen==128){if((err=sha512_compress(md,md->buf))!=0){E err;}md->length+=8*128;md->curlen=0;}}}E 0;}int sha512_final(sha512_context*md,u8*out){int i;if(md==0)E 1;if(out==0)E 1;if(md->curlen >=sizeof(md->buf)){E 1;}md->length+=md->curlen*Y(8);md->buf[md->curlen++]=(u8)0x80;if(md->curlen > 112){while(md->curlen < 128){md->buf[md->curlen++]=(u8)0;}sha512_compress(md,md->buf);md->curlen=0;}while(md->curlen < 120){md->buf[md->curlen++]=(u8)0;}STORE64H(md->length,md->buf+120);sha512_compress(md,md->buf);for(i=0;i < 8;i++){STORE64H(md->state[i],out+(8*i));}E 0;}int sha512(C u8*message,size_t message_len,u8*out){sha512_context ctx;int ret;if((ret=sha512_init(&ctx)))E ret;if((ret=sha512_update(&ctx,message,message_len)))E ret;if((ret=sha512_final(&ctx,out)))E ret;E 0;}typedef struct{C u8*in;size_t inlen;size_t full;size_t blocks;u8 tail[256];}sha512_lane;static void sha512_lane_init(sha512_lane*l,C u8*in,size_t inlen){size_t rem=inlen & 127;l->in=in;l->inlen=inlen;l->full=inlen>>7;l->blocks=l->full+(rem < 112 ? 1:2);memset(l->tail,0,sizeof(l->tail));memcpy(l->tail,in+128*l->full,rem);l->tail[rem]=(u8)0x80;STORE64H((u64)inlen*8,l->tail+128*(l->blocks-l->full)-8);}static C u8*sha512_lane_block(C sha512_lane*l,size_t k){if(k < l->full)E l->in+128*k;if(k < l->blocks)E l->tail+128*(k-l->full);E l->tail;}
+#define MB_RND(a,b,c,d,e,f,g,h,i)t0=h+Sigma1(e)+Ch(e,f,g)+K[i]+W[i];  t1=Sigma0(a)+Maj(a,b,c); d+=t0;  h=t0+t1;
+#define SHA512_MB_KERNEL(name,target_,lanes)typedef u64 name##_v __attribute__((vector_size(8*(lanes)))); __attribute__((target(target_)))static void name(const sha512_lane*l,size_t num,u8*const*out){name##_v st[8],S[8],W[80],t0,t1,zero={0};  u64 w[16][lanes];  sha512_context iv;  const u8*p;  size_t k,j,max=0;  int i;  sha512_init(&iv);  for(i=0; i < 8; i++){st[i]=zero+iv.state[i];}for(j=0; j < num; j++){if(l[j].blocks > max)max=l[j].blocks;}for(k=0; k < max; k++){for(j=0; j < lanes; j++){p=sha512_lane_block(&l[j < num ? j:0],k);  for(i=0; i < 16; i++){LOAD64H(w[i][j],p+8*i);}}for(i=0; i < 16; i++){memcpy(&W[i],w[i],sizeof(W[i]));}for(i=16; i < 80; i++){W[i]=Gamma1(W[i-2])+W[i-7]+Gamma0(W[i-15])+W[i-16];}for(i=0; i < 8; i++){S[i]=st[i];}for(i=0; i < 80; i+=8){MB_RND(S[0],S[1],S[2],S[3],S[4],S[5],S[6],S[7],i+0);  MB_RND(S[7],S[0],S[1],S[2],S[3],S[4],S[5],S[6],i+1);  MB_RND(S[6],S[7],S[0],S[1],S[2],S[3],S[4],S[5],i+2);  MB_RND(S[5],S[6],S[7],S[0],S[1],S[2],S[3],S[4],i+3);  MB_RND(S[4],S[5],S[6],S[7],S[0],S[1],S[2],S[3],i+4);  MB_RND(S[3],S[4],S[5],S[6],S[7],S[0],S[1],S[2],i+5);  MB_RND(S[2],S[3],S[4],S[5],S[6],S[7],S[0],S[1],i+6);  MB_RND(S[1],S[2],S[3],S[4],S[5],S[6],S[7],S[0],i+7);}for(i=0; i < 8; i++){st[i]+=S[i];}for(j=0; j < num; j++){if(l[j].blocks !=k+1)continue;  for(i=0; i < 8; i++){STORE64H(st[i][j],out[j]+8*i);}}}}
+SHA512_MB_KERNEL(sha512_mb_sse4,"sse4.2",2)SHA512_MB_KERNEL(sha512_mb_avx2,"avx2",4)SHA512_MB_KERNEL(sha512_mb_avx512,"avx512f",8)static void sha512_mb_scalar(C sha512_lane*l,size_t num,u8*C*out){size_t j;for(j=0;j < num;j++){sha512(l[j].in,l[j].inlen,out[j]);}}static void(*sha512_mb_kernel)(C sha512_lane*l,size_t num,u8*C*out)=0;static size_t sha512_mb_lanes=1;size_t sha512_multi_init(void){if(sha512_mb_kernel !=0)E sha512_mb_lanes;__builtin_cpu_init();if(__builtin_cpu_supports("avx512f")){sha512_mb_lanes=8;sha512_mb_kernel=sha512_mb_avx512;}else if(__builtin_cpu_supports("avx2")){sha512_mb_lanes=4;sha512_mb_kernel=sha512_mb_avx2;}else if(__builtin_cpu_supports("sse4.2")){sha512_mb_lanes=2;sha512_mb_kernel=sha512_mb_sse4;}else{sha512_mb_lanes=1;sha512_mb_kernel=sha512_mb_scalar;}E sha512_mb_lanes;}void sha512_multi(C u8*C*messages,C size_t*message_lens,size_t num,u8*C*out){sha512_lane l[8];size_t i,j,len;sha512_multi_init();for(i=0;i < num;i+=len){len=min(num-i,sha512_mb_lanes);for(j=0;j < len;j++){sha512_lane_init(&l[j],messages[i+j],message_lens[i+j]);}sha512_mb_kernel(l,len,out+i);}}
 #include <sys/stat.h>
-bool file_exists(string& name){struct stat buffer;E(stat(name.c_str(),&buffer)==0);}bool file_save(string& path,u8*buf,u32 len){FILE*fh=fopen(path.c_str(),"wb");if(!fh)E 0;fwrite(buf,1,len,fh);if(ferror(fh))E 0;fclose(fh);if(ferror(fh))E 0;E true;}bool file_load(string& path,u8*buf,u32 len){FILE*fh=fopen(path.c_str(),"rb");if(!fh)E 0;fread(buf,1,len,fh);if(ferror(fh))E 0;fclose(fh);if(ferror(fh))E 0;E true;}bool address_json_parse(Value t,u32 &res){C char*tmp=t.asString().c_str();char*tmp_p;C char*end=tmp+strlen(tmp);res=strtol(tmp,&tmp_p,10);E tmp_p==end;}
-#define T_ARR(name,size_)const u32 name##_size=size_;  typedef u8 name##_buf[size_];  struct name{u8 b[size_]={0};};  bool operator!=(const name& a,const name& b){return memcmp(a.b,b.b,sizeof(a.b));}bool operator<(const name& a,const name& b){return memcmp(a.b,b.b,sizeof(a.b)<0);}bool operator>(const name& a,const name& b){return memcmp(a.b,b.b,sizeof(a.b)>0);}bool str2##name(const string &str,name &key){const u32 L=2*size_;  if(str.size()!=L){return false;}for(int i=0;i<L;i++){char ch=str[i];  if('0' <=ch && ch <='9')continue;  if('a' <=ch && ch <='f')continue;  if('A' <=ch && ch <='A')continue;  return false;}char tmp[3]={0};  char*tmp_p;  u32 dst=0;  for(int i=0;i<L;){tmp[0]=str[i++];  tmp[1]=str[i++];  key.b[dst++]=strtol((char*)&tmp,&tmp_p,16);}return true;}string name##2str(name &t){string res="";  char buf[10]={0};  for(int i=0;i<name##_size;i++){sprintf(buf,"%02x",t.b[i]);  res+=buf;}return res;}void name##_print(const char*prefix_str,name &t){printf("%s%s\n",prefix_str,name##2str(t).c_str());}
-T_ARR(t_hash,64)T_ARR(t_sign,64)T_ARR(t_pub_key,32)T_ARR(t_prv_key,64)struct Block_header{u32 id=0;u32 version=0;t_hash prev_hash;t_hash merkle_tree;u32 issuer_addr=0;t_pub_key issuer_pub_key;u32 nonce=0;t_hash hash;t_sign sign;u64 weight=0;};struct Tx{u32 type=0;u32 amount=0;u32 send_addr=0;u32 recv_addr=0;t_pub_key bind_pub_key={0};u32 nonce=0;t_hash hash;t_sign sign;u64 weight=0;};struct Block{struct Block_header header;vector<Tx> tx_list;u64 weight=0;};C u32 tx_fee=10;C u32 mining_reward=10;C u32 hot_potato_penalty=1;string pub_key_path="./pub.key";string prv_key_path="./prv.key";bool i_am_seed_node=0;struct Acc_weight_pair{u32 account;u64 weight;};struct MemState{bool ready=0;u32 target_bc_height=0;u32 main_chain_block_offset=0;vector<Block> main_chain_block_list;vector<Tx> tx_list;bool is_proposal_valid=0;Block proposed_block;unordered_map<string,Tx> done_tx_hash;vector<t_pub_key> a2pk;vector<u32> B;vector<Acc_weight_pair*> w_weak_list;vector<Acc_weight_pair> aw_sort_list;}gms;u32 my_primary_address;t_pub_key my_pub_key;t_prv_key my_prv_key;bool tx_mining_mode=0;void gms_account_new(t_pub_key &pub_key){gms.a2pk.push_back(pub_key);gms.B.push_back(0);gms.w_weak_list.push_back(0);}u32 bc_height(){E gms.main_chain_block_offset+gms.main_chain_block_list.size();}bool key_gen(t_pub_key &pub_key,t_prv_key &prv_key){u8 seed[32];if(ed25519_create_seed(seed)){E 0;}ed25519_create_keypair(pub_key.b,prv_key.b,seed);E true;}u32 RPC_PRV_PORT=10002;u32 RPC_PUB_PORT=10001;string seed_ip_port="http://192.168.2.3:10001";struct NetNode{bool is_self=0;string ip_port;bool is_proposal_valid=0;Block proposed_block;};struct NetState{u32 ask_offset=0;u32 broadcast_offset=0;vector<NetNode> node_list;}gns;void block_broadcast();u64 hash2weight(t_hash &hash){u64 res=0;for(int i=0;i<t_hash_size;i++){u32 loc=__builtin_clz(hash.b[i]);res+=loc;if(loc !=32)break;}E res;}
-#define SL1  const int len=(sizeof(u32)+sizeof(u32)+sizeof(t_hash)+sizeof(t_hash)+sizeof(u32)+sizeof(t_pub_key)+sizeof(u32));  u8 buffer[len];  u8*buf_ptr=(u8*)&buffer;  u32 s=0;  memcpy(buf_ptr,&header.id,s=sizeof(header.id));buf_ptr+=s;  memcpy(buf_ptr,&header.version,s=sizeof(header.version));buf_ptr+=s;  memcpy(buf_ptr,&header.prev_hash,s=sizeof(header.prev_hash));buf_ptr+=s;  memcpy(buf_ptr,&header.merkle_tree,s=sizeof(header.merkle_tree));buf_ptr+=s;  memcpy(buf_ptr,&header.issuer_addr,s=sizeof(header.issuer_addr));buf_ptr+=s;  memcpy(buf_ptr,&header.issuer_pub_key.b,s=sizeof(header.issuer_pub_key.b));buf_ptr+=s;  memcpy(buf_ptr,&header.nonce,s=sizeof(header.nonce));/*buf_ptr+=s;*/ sha512_context ctx;  sha512_init(&ctx);  sha512_update(&ctx,(u8*)&buffer,len); 
-void block_header_sign(Block_header &header,t_pub_key &pub_key,t_prv_key &prv_key){SL1
-sha512_final(&ctx,(u8*)&header.hash);ed25519_sign(header.sign.b,(u8*)&buffer,len,pub_key.b,prv_key.b);}bool block_header_validate(Block_header &header){if(gms.main_chain_block_list.size()){if(header.id-1 !=gms.main_chain_block_list.back().header.id)E 0;}if(header.issuer_addr >=gms.a2pk.size())E 0;if(header.issuer_pub_key !=gms.a2pk[header.issuer_addr])E 0;SL1
-t_hash cmp_hash;sha512_final(&ctx,(u8*)&cmp_hash);if(cmp_hash !=header.hash)E 0;E ed25519_verify(header.sign.b,(u8*)&buffer,len,header.issuer_pub_key.b);}void block_header_to_json(Block_header &header,Value &value){value["id"]=header.id;value["version"]=header.version;value["prev_hash"]=t_hash2str(header.prev_hash);value["merkle_tree"]=t_hash2str(header.merkle_tree);value["issuer_addr"]=header.issuer_addr;value["issuer_pub_key"]=t_pub_key2str(header.issuer_pub_key);value["nonce"]=header.nonce;value["hash"]=t_hash2str(header.hash);value["sign"]=t_sign2str(header.sign);value["weight"]=header.weight;}bool json_to_block_header(C Value &value,Block_header &header){bool res=true;header.id=value["id"].asInt();header.version=value["version"].asInt();res &=str2t_hash(value["prev_hash" ].asString(),header.prev_hash);res &=str2t_hash(value["merkle_tree"].asString(),header.merkle_tree);header.issuer_addr=value["issuer_addr"].asInt();res &=str2t_pub_key(value["issuer_pub_key"].asString(),header.issuer_pub_key);header.nonce=value["nonce"].asInt();res &=str2t_hash(value["hash" ].asString(),header.hash);res &=str2t_sign(value["sign" ].asString(),header.sign);header.weight=value["weight"].asInt();E res;}
-#define SL2  const int len=(sizeof(u32)+sizeof(u32)+sizeof(u32)+sizeof(u32)+sizeof(u32));  u8 buffer[len];  u8*buf_ptr=(u8*)&buffer;  u32 s=0;  memcpy(buf_ptr,&tx.type,s=sizeof(u32));buf_ptr+=s;  memcpy(buf_ptr,&tx.amount,s=sizeof(u32));buf_ptr+=s;  memcpy(buf_ptr,&tx.send_addr,s=sizeof(u32));buf_ptr+=s;  memcpy(buf_ptr,&tx.recv_addr,s=sizeof(u32));buf_ptr+=s;  memcpy(buf_ptr,&tx.bind_pub_key.b,s=sizeof(t_pub_key_size));buf_ptr+=s;  memcpy(buf_ptr,&tx.nonce,s=sizeof(u32));/*buf_ptr+=s;*/  sha512_context ctx;  sha512_init(&ctx);  sha512_update(&ctx,(u8*)&buffer,len); 
-void tx_sign(Tx &tx,t_pub_key &pub_key,t_prv_key &prv_key){SL2
-sha512_final(&ctx,(u8*)&tx.hash);ed25519_sign(tx.sign.b,(u8*)&buffer,len,pub_key.b,prv_key.b);}int tx_validate_reason=0;
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+bool file_exists(string& name){struct stat buffer;E(stat(name.c_str(),&buffer)==0);}bool file_save(string& path,u8*buf,u32 len){FILE*fh=fopen(path.c_str(),"wb");if(!fh)E 0;fwrite(buf,1,len,fh);if(ferror(fh))E 0;fclose(fh);if(ferror(fh))E 0;E true;}bool file_save_atomic(string& path,C u8*buf,size_t len){string tmp_path=path+".tmp";int fd=open(tmp_path.c_str(),O_WRONLY|O_CREAT|O_TRUNC,0644);if(fd < 0)E 0;bool res=write(fd,buf,len)==len && !fsync(fd);close(fd);E res && !rename(tmp_path.c_str(),path.c_str());}bool file_load(string& path,u8*buf,u32 len){FILE*fh=fopen(path.c_str(),"rb");if(!fh)E 0;fread(buf,1,len,fh);if(ferror(fh))E 0;fclose(fh);if(ferror(fh))E 0;E true;}struct Crc32c_table{u32 t[256];Crc32c_table(){for(u32 i=0;i<256;i++){u32 c=i;for(int k=0;k<8;k++)c=c & 1 ?(c>>1)^0x82f63b78:c>>1;t[i]=c;}}}crc32c_table;u32 crc32c_scalar(u32 crc,C u8*buf,size_t len){crc=~crc;for(size_t i=0;i<len;i++)crc=crc32c_table.t[(crc^buf[i])& 0xff]^(crc>>8);E ~crc;}__attribute__((target("sse4.2")))u32 crc32c_sse42(u32 crc,C u8*buf,size_t len){u64 c=~crc;size_t i=0;for(;i+8<=len;i+=8){u64 v;memcpy(&v,buf+i,8);c=__builtin_ia32_crc32di(c,v);}for(;i<len;i++)c=__builtin_ia32_crc32qi(c,buf[i]);E ~(u32)c;}u32(*crc32c_kernel)(u32 crc,C u8*buf,size_t len)=0;u32 crc32c(C u8*buf,size_t len){if(!crc32c_kernel){__builtin_cpu_init();crc32c_kernel=__builtin_cpu_supports("sse4.2")? crc32c_sse42:crc32c_scalar;}E crc32c_kernel(0,buf,len);}bool address_json_parse(Value t,u32 &res){C char*tmp=t.asString().c_str();char*tmp_p;C char*end=tmp+strlen(tmp);res=strtol(tmp,&tmp_p,10);E tmp_p==end;}struct Hex_table{char enc[256][2];u8 dec[256];Hex_table(){C char*digit="0123456789abcdef";for(int i=0;i<256;i++){enc[i][0]=digit[i>>4];enc[i][1]=digit[i & 15];dec[i]=0x80;}for(int i=0;i<10;i++)dec['0'+i]=i;for(int i=0;i<6;i++)dec['a'+i]=dec['A'+i]=10+i;}}hex_table;void hex_encode_scalar(char*dst,C u8*src,u32 len){for(u32 i=0;i<len;i++){memcpy(dst+2*i,hex_table.enc[src[i]],2);}}bool hex_decode_scalar(u8*dst,C char*src,u32 len){u8 bad=0;for(u32 i=0;i<len;i++){u8 hi=hex_table.dec[(u8)src[2*i ]];u8 lo=hex_table.dec[(u8)src[2*i+1]];bad|=hi|lo;dst[i]=hi<<4|lo;}E !(bad & 0x80);}typedef u8 hex_v32u8 __attribute__((vector_size(32)));typedef unsigned short hex_v16u16 __attribute__((vector_size(32)));typedef u8 hex_v16u8 __attribute__((vector_size(16)));__attribute__((target("avx2")))void hex_encode_avx2(char*dst,C u8*src,u32 len){u32 i=0;for(;i+16<=len;i+=16){hex_v16u8 v;memcpy(&v,src+i,16);hex_v16u16 w=__builtin_convertvector(v,hex_v16u16);hex_v16u16 hi=w>>4,lo=w & 15;hi+='0'+((hex_v16u16)(hi > 9)& 39);lo+='0'+((hex_v16u16)(lo > 9)& 39);w=hi|lo<<8;memcpy(dst+2*i,&w,32);}hex_encode_scalar(dst+2*i,src+i,len-i);}__attribute__((target("avx2")))bool hex_decode_avx2(u8*dst,C char*src,u32 len){hex_v32u8 bad={0};u32 i=0;for(;i+16<=len;i+=16){hex_v32u8 c,lower,digit,alpha,val;memcpy(&c,src+2*i,32);digit=c-'0';lower=c|0x20;alpha=lower-'a';hex_v32u8 is_digit=(hex_v32u8)(digit < 10);hex_v32u8 is_alpha=(hex_v32u8)(alpha < 6);val=(digit & is_digit)|((alpha+10)& is_alpha);bad|=~(is_digit|is_alpha);hex_v16u16 w=(hex_v16u16)val;w=(w & 0xff)<<4|w>>8;hex_v16u8 out=__builtin_convertvector(w,hex_v16u8);memcpy(dst+i,&out,16);}for(u32 k=0;k<32;k++){if(bad[k])E 0;}E hex_decode_scalar(dst+i,src+2*i,len-i);}void(*hex_encode_kernel)(char*dst,C u8*src,u32 len)=0;bool(*hex_decode_kernel)(u8*dst,C char*src,u32 len)=0;void hex_init(){if(hex_encode_kernel)E;__builtin_cpu_init();bool avx2=__builtin_cpu_supports("avx2");hex_decode_kernel=avx2 ? hex_decode_avx2:hex_decode_scalar;hex_encode_kernel=avx2 ? hex_encode_avx2:hex_encode_scalar;}void hex_encode(char*dst,C u8*src,u32 len){hex_init();hex_encode_kernel(dst,src,len);}bool hex_decode(u8*dst,C char*src,u32 len){hex_init();E hex_decode_kernel(dst,src,len);}string buf2hex(C u8*buf,u32 len){string res(2*len,'0');hex_encode(&res[0],buf,len);E res;}bool hex2buf(C string &str,vector<u8> &res){u32 len=str.size();if(len % 2)E 0;res.resize(len/2);E hex_decode(res.data(),str.data(),len/2);}
+#define T_ARR(name,size_)const u32 name##_size=size_;  typedef u8 name##_buf[size_];  struct name{u8 b[size_]={0};};  bool operator!=(const name& a,const name& b){return memcmp(a.b,b.b,sizeof(a.b));}bool operator<(const name& a,const name& b){return memcmp(a.b,b.b,sizeof(a.b)<0);}bool operator>(const name& a,const name& b){return memcmp(a.b,b.b,sizeof(a.b)>0);}bool str2##name(const string &str,name &key){if(str.size()!=2*size_)return false;  return hex_decode(key.b,str.data(),size_);}string name##2str(name &t){string res(2*size_,'0');  hex_encode(&res[0],t.b,size_);  return res;}void name##_print(const char*prefix_str,name &t){char buf[2*size_+1];  hex_encode(buf,t.b,size_);  buf[2*size_]=0;  printf("%s%s\n",prefix_str,buf);}
+T_ARR(t_hash,64)T_ARR(t_sign,64)T_ARR(t_pub_key,32)T_ARR(t_prv_key,64)struct Block_header{u32 id=0;u32 version=0;t_hash prev_hash;t_hash merkle_tree;u32 issuer_addr=0;t_pub_key issuer_pub_key;u32 nonce=0;t_hash hash;t_sign sign;u64 weight=0;};struct Tx{u32 type=0;u32 amount=0;u32 send_addr=0;u32 recv_addr=0;t_pub_key bind_pub_key={0};u32 tx_epoch=0;u32 nonce=0;t_hash hash;t_sign sign;u64 weight=0;};struct Block{struct Block_header header;vector<Tx> tx_list;u64 weight=0;};struct Merkle_tree{vector<vector<t_hash>>level_list;};C u32 block_codec_version=2;C u32 tx_body_size=4*4+t_pub_key_size+4*2;C u32 tx_pack_size=tx_body_size+t_hash_size+t_sign_size;C u32 block_header_body_size=4*2+2*t_hash_size+4+t_pub_key_size+4;C u32 block_header_pack_size=block_header_body_size+t_hash_size+t_sign_size;C u32 block_pack_head_size=4+block_header_pack_size+4;C u32 tx_off_type=0;C u32 tx_off_amount=4;C u32 tx_off_send_addr=8;C u32 tx_off_recv_addr=12;C u32 tx_off_bind_pub_key=16;C u32 tx_off_tx_epoch=16+t_pub_key_size;C u32 tx_off_nonce=20+t_pub_key_size;C u32 tx_off_hash=tx_body_size;C u32 tx_off_sign=tx_body_size+t_hash_size;C u32 header_off_id=0;C u32 header_off_version=4;C u32 header_off_prev_hash=8;C u32 header_off_merkle_tree=8+t_hash_size;C u32 header_off_issuer_addr=8+2*t_hash_size;C u32 header_off_issuer_pub_key=12+2*t_hash_size;C u32 header_off_nonce=12+2*t_hash_size+t_pub_key_size;C u32 header_off_hash=block_header_body_size;C u32 header_off_sign=block_header_body_size+t_hash_size;struct Block_view{C u8*header;u32 tx_count=0;C u8*tx_list;};C u32 block_version=2;C u32 tx_fee=10;C u32 mining_reward=10;C u32 hot_potato_penalty=1;C u32 tx_epoch_blocks=256;C u32 tx_epoch_window=2;string pub_key_path="./pub.key";string prv_key_path="./prv.key";bool i_am_seed_node=0;struct Block_wire{t_hash hash;Value json;string bin;u64 size=0;};struct Block_wire_cache{mutex lock;map<u32,shared_ptr<Block_wire>>id_hash;shared_ptr<Block_wire> proposal;u64 size=0;u64 size_limit=64<<20;}block_wire_cache;void block_wire_cache_put(Block &block);void block_wire_proposal_set(Block &block);shared_ptr<Block_wire> block_wire_get(u32 id);shared_ptr<Block_wire> block_wire_proposal_get();void block_wire_cache_drop_from(u32 id);string chain_path="./chain";C u32 block_log_magic=0x474c4b42;C u32 block_log_version=1;C u32 block_log_segment_size=1<<28;C u32 block_log_frame_head_size=8;struct Block_log_pos{u32 segment;u32 offset;u32 len;u32 crc;u8 key[16];};struct Block_log_idx_head{u32 magic;u32 version;u32 count;u32 capacity;};struct Block_log{mutex lock;string path;vector<int> seg_fd;u32 seg_size=0;int height_fd=-1;Block_log_idx_head*height_head=0;Block_log_pos*height=0;int hash_fd=-1;Block_log_idx_head*hash_head=0;u32*hash=0;u32 sync_segment=0;}block_log;bool block_log_append(Block &block);u32 durability=1;struct Persist_state{mutex lock;condition_variable wake;condition_variable done;u64 seq_appended=0;u64 seq_durable=0;deque<chrono::steady_clock::time_point> pending_time;bool dir_dirty=0;bool running=0;bool stop=0;u64 commit_count=0;u64 batch_max=0;u64 latency_sum_us=0;u64 latency_max_us=0;u64 latency_last_us=0;}persist;void persist_dir_dirty();C u32 pack_magic=0x4b434150;C u32 pack_version=1;C u32 pack_block_count=1024;C u32 pack_head_size=4*4+8*(pack_block_count+1);C u32 pack_tx_size=tx_pack_size-t_hash_size;C u32 pack_finality=64;struct Pack_state{mutex lock;u32 count=0;bool building=0;u32 generation=0;}pack_state;void pack_build_start();void pack_drop_from(u32 height);struct Verify_ctx_cache{mutex lock;list<pair<u32,ed25519_verify_context>>lru;unordered_map<u32,list<pair<u32,ed25519_verify_context>>::iterator> addr_hash;};C u32 verify_ctx_cache_size=1024;C u32 replay_key_size=16;struct Replay_key{u8 b[replay_key_size];};struct Replay_table{u32 tx_epoch=0;u32 count=0;vector<Replay_key> slot_list;};struct Replay_set{Replay_table table_list[tx_epoch_window+1];};struct State_overlay{u32 demurrage_height;unordered_map<u32,u32> B;unordered_map<u32,t_pub_key> a2pk;Replay_set done_tx;};struct Undo_balance{u32 addr;u32 B;u32 balance_height;};struct Undo_a2pk{u32 addr;t_pub_key pub_key;};struct Undo_replay{u32 tx_epoch;Replay_key key;};struct Undo_block{vector<Undo_balance> balance_list;vector<Undo_a2pk> a2pk_list;vector<Undo_replay> replay_list;vector<Replay_table> replay_reset_list;u32 account_count;};C u32 undo_depth=pack_finality;struct MemState{bool ready=0;u32 target_bc_height=0;u32 main_chain_block_offset=0;mutex main_chain_lock;deque<Block> main_chain_block_list;bool is_proposal_valid=0;Block proposed_block;Replay_set done_tx;vector<t_pub_key> a2pk;Verify_ctx_cache a2vc;vector<u32> B;vector<u32> balance_height;u32 demurrage_height=0;deque<Undo_block> undo_list;}gms;u32 main_chain_tail_size=1024;C u32 snapshot_magic=0x50414e53;C u32 snapshot_version=2;u32 snapshot_interval=1000;pid_t snapshot_pid=0;bool snapshot_poll();void snapshot_start();bool chain_rollback(u32 count);bool chain_fork_switch(u32 n,vector<Block> &branch);struct Mempool_sender{deque<string> queue;u64 spend=0;};struct Mempool_tx{Tx tx;t_pub_key pub_key;};C u32 mempool_tx_size=sizeof(Mempool_tx)+2*t_hash_size;struct Mempool{mutex lock;unordered_map<string,Mempool_tx> hash_index;unordered_map<u32,Mempool_sender> sender_hash;set<pair<u32,u32>>sender_size;u32 count_limit=100000;u64 byte_limit=64<<20;u64 byte_count=0;u64 push_count,duplicate_count,spend_reject_count,evict_count,drop_count;u32 pack_count_last;u64 pack_us_last;}mempool;u32 block_tx_limit=10000;int mempool_push(Tx &tx);void mempool_block_remove(Block &block);void mempool_tx_drop(Tx &tx);u32 my_primary_address;t_pub_key my_pub_key;t_prv_key my_prv_key;bool tx_mining_mode=0;typedef pair<u64,u32> Weight_key;// key,account
+typedef __gnu_pbds::tree<Weight_key,__gnu_pbds::null_type,greater<Weight_key>,__gnu_pbds::rb_tree_tag,__gnu_pbds::tree_order_statistics_node_update> Weight_tree;struct Weight_index{mutex lock;Weight_tree tree;vector<u64> key_list;}weight_index;u64 weight_key(u32 addr){E gms.B[addr]+(u64)hot_potato_penalty*gms.balance_height[addr];}u64 weight_from_key(u64 key){u64 penalty=(u64)hot_potato_penalty*gms.demurrage_height;E key > penalty ? key-penalty:0;}void weight_index_update(u32 addr){auto &w=weight_index;lock_guard<mutex> guard(w.lock);if(addr < w.key_list.size()){w.tree.erase(Weight_key(w.key_list[addr],addr));}else{w.key_list.resize(addr+1);}w.key_list[addr]=weight_key(addr);w.tree.insert(Weight_key(w.key_list[addr],addr));}void weight_index_truncate(u32 count){auto &w=weight_index;lock_guard<mutex> guard(w.lock);for(u32 addr=count;addr<w.key_list.size();addr++){w.tree.erase(Weight_key(w.key_list[addr],addr));}w.key_list.resize(min<size_t>(count,w.key_list.size()));}void weight_index_rebuild(){auto &w=weight_index;lock_guard<mutex> guard(w.lock);w.tree.clear();w.key_list.resize(gms.B.size());for(u32 addr=0;addr<w.key_list.size();addr++){w.key_list[addr]=weight_key(addr);w.tree.insert(Weight_key(w.key_list[addr],addr));}}void gms_account_new(t_pub_key &pub_key){gms.a2pk.push_back(pub_key);gms.B.push_back(0);gms.balance_height.push_back(gms.demurrage_height);weight_index_update(gms.B.size()-1);}u32 balance_get(u32 addr){u64 penalty=(u64)hot_potato_penalty*(gms.demurrage_height-gms.balance_height[addr]);u32 B=gms.B[addr];E B > penalty ? B-penalty:0;}void balance_set(u32 addr,u32 B){gms.B[addr]=B;gms.balance_height[addr]=gms.demurrage_height;weight_index_update(addr);}u32 bc_height(){E gms.main_chain_block_offset+gms.main_chain_block_list.size();}u32 tx_epoch_now(){E bc_height()/ tx_epoch_blocks;}bool key_gen(t_pub_key &pub_key,t_prv_key &prv_key){u8 seed[32];if(ed25519_create_seed(seed)){E 0;}ed25519_create_keypair(pub_key.b,prv_key.b,seed);E true;}u32 RPC_PRV_PORT=10002;u32 RPC_PUB_PORT=10001;u32 RPC_PACK_PORT=10003;C u32 pack_io_timeout_sec=10;C u32 pack_con_limit=16;string seed_ip_port="http://192.168.2.3:10001";struct NetNode{bool is_self=0;string ip_port;bool is_proposal_valid=0;Block proposed_block;};struct NetState{u32 ask_offset=0;u32 broadcast_offset=0;vector<NetNode> node_list;}gns;void block_broadcast();u64 hash2weight(t_hash &hash){u64 res=0;for(int i=0;i<t_hash_size;i++){u32 loc=__builtin_clz(hash.b[i]);res+=loc;if(loc !=32)break;}E res;}struct Work_pool{mutex lock;condition_variable wake;deque<function<void()>>job_list;once_flag start;};Work_pool &work_pool=*new Work_pool;thread_local bool work_pool_worker=0;void work_pool_run(){work_pool_worker=true;auto &p=work_pool;while(true){function<void()> job;{unique_lock<mutex> lk(p.lock);p.wake.wait(lk,[&]{E !p.job_list.empty();});job=move(p.job_list.front());p.job_list.pop_front();}job();}}template<class F> void par_range(u32 n,u32 thread_min,F fn){u32 thread_count=min(thread::hardware_concurrency(),n/thread_min);if(thread_count < 2||work_pool_worker){fn(0,n);E;}auto &p=work_pool;call_once(p.start,[](){for(u32 i=1;i<thread::hardware_concurrency();i++)thread(work_pool_run).detach();});u32 step=(n+thread_count-1)/thread_count;mutex done_lock;condition_variable done;u32 left=0;{lock_guard<mutex> guard(p.lock);for(u32 from=step;from<n;from+=step){u32 to=min(n,from+step);left++;p.job_list.push_back([&,from,to](){fn(from,to);lock_guard<mutex> guard(done_lock);if(!--left)done.notify_one();});}}p.wake.notify_all();fn(0,min(n,step));unique_lock<mutex> lk(done_lock);done.wait(lk,[&]{E !left;});}bool verify_ctx_verify(u32 addr,t_pub_key &pub_key,C u8*sign,C u8*msg,size_t msg_len){auto &cache=gms.a2vc;ed25519_verify_context ctx;bool hit=0;{lock_guard<mutex> guard(cache.lock);auto it=cache.addr_hash.find(addr);if(it !=cache.addr_hash.end()&& !memcmp(it->second->second.public_key,pub_key.b,t_pub_key_size)){cache.lru.splice(cache.lru.begin(),cache.lru,it->second);ctx=it->second->second;hit=true;}}if(!hit && !ed25519_verify_context_init(&ctx,pub_key.b))E 0;if(!ed25519_verify_with_context(sign,msg,msg_len,&ctx))E 0;if(hit)E true;lock_guard<mutex> guard(cache.lock);auto it=cache.addr_hash.find(addr);if(it !=cache.addr_hash.end()){it->second->second=ctx;cache.lru.splice(cache.lru.begin(),cache.lru,it->second);E true;}if(cache.lru.size()>=verify_ctx_cache_size){cache.addr_hash.erase(cache.lru.back().first);cache.lru.pop_back();}cache.lru.emplace_front(addr,ctx);cache.addr_hash[addr]=cache.lru.begin();E true;}void verify_ctx_drop(u32 addr){auto &cache=gms.a2vc;lock_guard<mutex> guard(cache.lock);auto it=cache.addr_hash.find(addr);if(it==cache.addr_hash.end())E;cache.lru.erase(it->second);cache.addr_hash.erase(it);}void pack_u32(u8*&p,u32 v){p[0]=v;p[1]=v>>8;p[2]=v>>16;p[3]=v>>24;p+=4;}void pack_buf(u8*&p,C u8*src,u32 len){memcpy(p,src,len);p+=len;}u32 unpack_u32(C u8*p){E p[0]|p[1]<<8|p[2]<<16|(u32)p[3]<<24;}void block_header_body_pack(Block_header &header,u8*p){pack_u32(p,header.id);pack_u32(p,header.version);pack_buf(p,header.prev_hash.b,t_hash_size);pack_buf(p,header.merkle_tree.b,t_hash_size);pack_u32(p,header.issuer_addr);pack_buf(p,header.issuer_pub_key.b,t_pub_key_size);pack_u32(p,header.nonce);}void block_header_pack(Block_header &header,u8*p){block_header_body_pack(header,p);p+=block_header_body_size;pack_buf(p,header.hash.b,t_hash_size);pack_buf(p,header.sign.b,t_sign_size);}void block_header_unpack(C u8*p,Block_header &header){header.id=unpack_u32(p+header_off_id);header.version=unpack_u32(p+header_off_version);memcpy(header.prev_hash.b,p+header_off_prev_hash,t_hash_size);memcpy(header.merkle_tree.b,p+header_off_merkle_tree,t_hash_size);header.issuer_addr=unpack_u32(p+header_off_issuer_addr);memcpy(header.issuer_pub_key.b,p+header_off_issuer_pub_key,t_pub_key_size);header.nonce=unpack_u32(p+header_off_nonce);memcpy(header.hash.b,p+header_off_hash,t_hash_size);memcpy(header.sign.b,p+header_off_sign,t_sign_size);}void tx_body_pack(Tx &tx,u8*p){pack_u32(p,tx.type);pack_u32(p,tx.amount);pack_u32(p,tx.send_addr);pack_u32(p,tx.recv_addr);pack_buf(p,tx.bind_pub_key.b,t_pub_key_size);pack_u32(p,tx.tx_epoch);pack_u32(p,tx.nonce);}void tx_pack(Tx &tx,u8*p){tx_body_pack(tx,p);p+=tx_body_size;pack_buf(p,tx.hash.b,t_hash_size);pack_buf(p,tx.sign.b,t_sign_size);}void tx_unpack(C u8*p,Tx &tx){tx.type=unpack_u32(p+tx_off_type);tx.amount=unpack_u32(p+tx_off_amount);tx.send_addr=unpack_u32(p+tx_off_send_addr);tx.recv_addr=unpack_u32(p+tx_off_recv_addr);memcpy(tx.bind_pub_key.b,p+tx_off_bind_pub_key,t_pub_key_size);tx.tx_epoch=unpack_u32(p+tx_off_tx_epoch);tx.nonce=unpack_u32(p+tx_off_nonce);memcpy(tx.hash.b,p+tx_off_hash,t_hash_size);memcpy(tx.sign.b,p+tx_off_sign,t_sign_size);}bool block_view_parse(C u8*buf,u32 len,Block_view &view){if(len < block_pack_head_size)E 0;if(unpack_u32(buf)!=block_codec_version)E 0;view.header=buf+4;view.tx_count=unpack_u32(buf+4+block_header_pack_size);view.tx_list=buf+block_pack_head_size;E(u64)view.tx_count*tx_pack_size==len-block_pack_head_size;}void block_header_sign(Block_header &header,t_pub_key &pub_key,t_prv_key &prv_key){u8 buffer[block_header_body_size];block_header_body_pack(header,buffer);sha512(buffer,block_header_body_size,header.hash.b);ed25519_sign(header.sign.b,buffer,block_header_body_size,pub_key.b,prv_key.b);}bool block_header_sign_check(Block_header &header){u8 buffer[block_header_body_size];block_header_body_pack(header,buffer);t_hash cmp_hash;sha512(buffer,block_header_body_size,cmp_hash.b);if(cmp_hash !=header.hash)E 0;E ed25519_verify(header.sign.b,buffer,block_header_body_size,header.issuer_pub_key.b);}bool block_header_validate(Block_header &header){if(gms.main_chain_block_list.size()){if(header.id-1 !=gms.main_chain_block_list.back().header.id)E 0;}if(header.issuer_addr >=gms.a2pk.size())E 0;if(header.issuer_pub_key !=gms.a2pk[header.issuer_addr])E 0;u8 buffer[block_header_body_size];block_header_body_pack(header,buffer);t_hash cmp_hash;sha512(buffer,block_header_body_size,cmp_hash.b);if(cmp_hash !=header.hash)E 0;E verify_ctx_verify(header.issuer_addr,header.issuer_pub_key,header.sign.b,buffer,block_header_body_size);}void block_header_to_json(Block_header &header,Value &value){value["id"]=header.id;value["version"]=header.version;value["prev_hash"]=t_hash2str(header.prev_hash);value["merkle_tree"]=t_hash2str(header.merkle_tree);value["issuer_addr"]=header.issuer_addr;value["issuer_pub_key"]=t_pub_key2str(header.issuer_pub_key);value["nonce"]=header.nonce;value["hash"]=t_hash2str(header.hash);value["sign"]=t_sign2str(header.sign);value["weight"]=header.weight;}bool json_to_block_header(C Value &value,Block_header &header){bool res=true;header.id=value["id"].asInt();header.version=value["version"].asInt();res &=str2t_hash(value["prev_hash" ].asString(),header.prev_hash);res &=str2t_hash(value["merkle_tree"].asString(),header.merkle_tree);header.issuer_addr=value["issuer_addr"].asInt();res &=str2t_pub_key(value["issuer_pub_key"].asString(),header.issuer_pub_key);header.nonce=value["nonce"].asInt();res &=str2t_hash(value["hash" ].asString(),header.hash);res &=str2t_sign(value["sign" ].asString(),header.sign);header.weight=value["weight"].asInt();E res;}void tx_sign(Tx &tx,t_pub_key &pub_key,t_prv_key &prv_key){u8 buffer[tx_body_size];tx_body_pack(tx,buffer);sha512(buffer,tx_body_size,tx.hash.b);ed25519_sign(tx.sign.b,buffer,tx_body_size,pub_key.b,prv_key.b);}C u32 sig_cache_shard_count=16;C u32 sig_cache_shard_size=4096;struct Sig_cache_entry{t_sign sign;t_pub_key pub_key;};struct Sig_cache_shard{mutex lock;unordered_map<string,Sig_cache_entry> hash;deque<string> order;};Sig_cache_shard sig_cache[sig_cache_shard_count];Sig_cache_shard& sig_cache_shard(t_hash &hash){E sig_cache[hash.b[0] % sig_cache_shard_count];}bool sig_cache_find(Tx &tx,t_pub_key &pub_key){auto &shard=sig_cache_shard(tx.hash);lock_guard<mutex> guard(shard.lock);auto it=shard.hash.find(string((char*)tx.hash.b,t_hash_size));if(it==shard.hash.end())E 0;E !(it->second.sign !=tx.sign)&& !(it->second.pub_key !=pub_key);}void sig_cache_add(Tx &tx,t_pub_key &pub_key){auto &shard=sig_cache_shard(tx.hash);lock_guard<mutex> guard(shard.lock);string key((char*)tx.hash.b,t_hash_size);auto ins=shard.hash.insert({key,{tx.sign,pub_key}});if(!ins.second){ins.first->second={tx.sign,pub_key};E;}shard.order.push_back(key);if(shard.order.size()> sig_cache_shard_size){shard.hash.erase(shard.order.front());shard.order.pop_front();}}Replay_table &replay_table(Replay_set &set,u32 tx_epoch){E set.table_list[tx_epoch %(tx_epoch_window+1)];}u32 replay_slot(C Replay_key &key,u32 mask){u32 res;memcpy(&res,key.b,4);E res & mask;}bool replay_key_empty(C Replay_key &key){for(u32 i=0;i<replay_key_size;i++){if(key.b[i])E 0;}E true;}bool replay_find(Replay_set &set,Tx &tx){Replay_table &table=replay_table(set,tx.tx_epoch);if(table.tx_epoch !=tx.tx_epoch||!table.count)E 0;Replay_key key;memcpy(key.b,tx.hash.b,replay_key_size);u32 mask=table.slot_list.size()-1;for(u32 i=replay_slot(key,mask);;i=(i+1)& mask){Replay_key &slot=table.slot_list[i];if(!memcmp(slot.b,key.b,replay_key_size))E true;if(replay_key_empty(slot))E 0;}}void replay_table_put(Replay_table &table,C Replay_key &key){u32 mask=table.slot_list.size()-1;u32 i=replay_slot(key,mask);while(!replay_key_empty(table.slot_list[i]))i=(i+1)& mask;table.slot_list[i]=key;}void replay_insert(Replay_set &set,u32 tx_epoch,C Replay_key &key,Undo_block*undo=0){Replay_table &table=replay_table(set,tx_epoch);if(table.tx_epoch !=tx_epoch){if(undo && table.count)undo->replay_reset_list.push_back(table);table.tx_epoch=tx_epoch;table.count=0;fill(table.slot_list.begin(),table.slot_list.end(),Replay_key{});}if(2*(table.count+1)> table.slot_list.size()){vector<Replay_key> old_list(max<size_t>(64,2*table.slot_list.size()));swap(old_list,table.slot_list);FOR_COL(it,old_list){if(!replay_key_empty(*it))replay_table_put(table,*it);}}replay_table_put(table,key);table.count++;if(undo)undo->replay_list.push_back({tx_epoch,key});}void replay_erase(Replay_set &set,u32 tx_epoch,C Replay_key &key){Replay_table &table=replay_table(set,tx_epoch);if(table.tx_epoch !=tx_epoch||!table.count)E;u32 mask=table.slot_list.size()-1;u32 i=replay_slot(key,mask);while(memcmp(table.slot_list[i].b,key.b,replay_key_size)){if(replay_key_empty(table.slot_list[i]))E;i=(i+1)& mask;}for(u32 j=(i+1)& mask;!replay_key_empty(table.slot_list[j]);j=(j+1)& mask){u32 home=replay_slot(table.slot_list[j],mask);if(((j-home)& mask)>=((j-i)& mask)){table.slot_list[i]=table.slot_list[j];i=j;}}table.slot_list[i]=Replay_key{};table.count--;}void replay_insert(Replay_set &set,Tx &tx){Replay_key key;memcpy(key.b,tx.hash.b,replay_key_size);replay_insert(set,tx.tx_epoch,key);}void overlay_init(State_overlay &overlay){overlay.demurrage_height=gms.demurrage_height;overlay.B.clear();overlay.a2pk.clear();overlay.done_tx=Replay_set();}u32 &overlay_balance(State_overlay &overlay,u32 addr){auto it=overlay.B.find(addr);if(it !=overlay.B.end())E it->second;E overlay.B[addr]=balance_get(addr);}u32 overlay_balance_get(State_overlay*overlay,u32 addr){if(!overlay)E balance_get(addr);auto it=overlay->B.find(addr);E it !=overlay->B.end()? it->second:balance_get(addr);}t_pub_key &overlay_a2pk_get(State_overlay*overlay,u32 addr){if(!overlay)E gms.a2pk[addr];auto it=overlay->a2pk.find(addr);E it !=overlay->a2pk.end()? it->second:gms.a2pk[addr];}void undo_balance_save(Undo_block &undo,u32 addr){undo.balance_list.push_back({addr,gms.B[addr],gms.balance_height[addr]});}void overlay_commit(State_overlay &overlay,vector<Tx> &tx_list,Undo_block &undo){if(overlay.demurrage_height !=gms.demurrage_height){throw new Exception("stale state overlay");}FOR_COL(it,overlay.B){undo_balance_save(undo,it->first);balance_set(it->first,it->second);}FOR_COL(it,overlay.a2pk){undo.a2pk_list.push_back({it->first,gms.a2pk[it->first]});gms.a2pk[it->first]=it->second;verify_ctx_drop(it->first);}FOR_COL(it,tx_list){Replay_key key;memcpy(key.b,it->hash.b,replay_key_size);replay_insert(gms.done_tx,it->tx_epoch,key,&undo);}}int tx_validate_reason=0;
 #define RET(x){tx_validate_reason=x;return false;}
-bool tx_validate(Tx &tx){int L=gms.a2pk.size();if(tx.send_addr >=L)RET(1)if(tx.recv_addr >=L)RET(2)auto send_pub_key=gms.a2pk[tx.send_addr];switch(tx.type){case 1:// transfer
-if(gms.B[tx.send_addr] < max(tx.amount,tx.amount+tx_fee))RET(10)break;case 2:// address_transfer
-if(gms.B[tx.send_addr] < tx_fee)RET(20)if(tx.recv_addr >=L)RET(21)if(send_pub_key !=gms.a2pk[tx.recv_addr])RET(22)break;default:RET(30)}SL2
-t_hash cmp_hash;sha512_final(&ctx,(u8*)&cmp_hash);if(cmp_hash !=tx.hash)RET(3)if(gms.done_tx_hash.find(string((char*)&tx.hash.b))!=gms.done_tx_hash.end())RET(4)if(!ed25519_verify(tx.sign.b,(u8*)&buffer,len,send_pub_key.b))RET(5)E true;}void tx_apply(Tx &tx){switch(tx.type){case 1:// transfer
-gms.B[tx.send_addr]-=tx.amount+tx_fee;gms.B[tx.recv_addr]+=tx.amount;break;case 2:// address_transfer
-gms.B[tx.send_addr]-=tx_fee;gms.a2pk[tx.recv_addr]=tx.bind_pub_key;break;}gms.done_tx_hash[string((char*)&tx.hash.b)]=tx;}void tx_to_json(Tx &tx,Value &value){value["type"]=tx.type;value["amount"]=tx.amount;value["send_addr"]=tx.send_addr;value["recv_addr"]=tx.recv_addr;value["bind_pub_key"]=t_pub_key2str(tx.bind_pub_key);value["nonce"]=tx.nonce;}bool json_to_tx(C Value &value,Tx &tx){bool res=true;tx.type=value["type"].asInt();tx.amount=value["amount"].asInt();tx.send_addr=value["send_addr"].asInt();tx.recv_addr=value["recv_addr"].asInt();res &=str2t_pub_key(value["bind_pub_key"].asString(),tx.bind_pub_key);tx.nonce=value["nonce"].asInt();E res;}void merkle_tree_calc(vector<Tx> &tx_list,t_hash &res){memset(res.b,0,sizeof(t_hash));FOR_COL(it,tx_list){sha512_context ctx;sha512_init(&ctx);sha512_update(&ctx,res.b,sizeof(res.b));sha512_update(&ctx,it->sign.b,sizeof(res.b));sha512_final(&ctx,(u8*)&res.b);}}bool block_validate(Block &block){block_header_validate(block.header);FOR_COL(it,block.tx_list){if(!tx_validate(*it))E 0;}t_hash merkle_tree;merkle_tree_calc(block.tx_list,merkle_tree);if(merkle_tree !=block.header.merkle_tree)E 0;E true;}void block_sign(Block &block,t_pub_key &pub_key,t_prv_key &prv_key){merkle_tree_calc(block.tx_list,block.header.merkle_tree);block_header_sign(block.header,pub_key,prv_key);}void block_apply(Block &block){FOR_COL(it,block.tx_list){tx_apply(*it);}gms.B[block.header.issuer_addr]+=mining_reward+tx_fee*block.tx_list.size();FOR_COL(it,gms.B){if(*it==0)continue;// do not write optimisation
-if(*it > hot_potato_penalty){*it-=hot_potato_penalty;}else{*it=0;}}gms_account_new(block.header.issuer_pub_key);gms.main_chain_block_list.push_back(block);FOR_COL(it,gns.node_list){it->is_proposal_valid=0;}}void block_weight_calc(Block &block){u32 weight=0;FOR_COL(it,block.tx_list){weight+=it->weight=hash2weight(it->hash);}weight+=block.header.weight=hash2weight(block.header.hash);block.weight=weight;}void block_to_json(Block &block,Value &value){Value header;block_header_to_json(block.header,header);Value tx_list;FOR_COL(it,block.tx_list){Value tx;tx_to_json(*it,tx);tx_list.append(tx);}value["header"]=header;value["tx_list"]=tx_list;value["weight"]=block.weight;}bool json_to_block(C Value &value,Block &block){bool res=true;res &=json_to_block_header(value["header"],block.header);Value tx_list=value["tx_list"];u32 i=0,len=tx_list.size();block.tx_list.resize(len);for(;i<len;i++){res &=json_to_tx(tx_list[i],block.tx_list[i]);}block.weight=value["weight"].asInt();E res;}int block_pack_size(Block &block){int res=0;E res;}void block_pack(Block &block){}void block_unpack(Block &block){}void gms_init(){gms_account_new(my_pub_key);gms.B[0]=1e6;Block block;block.header.id=0;block.header.version=1;block.header.issuer_addr=0;block.header.issuer_pub_key=my_pub_key;block.header.nonce=0;block_sign(block,my_pub_key,my_prv_key);block_weight_calc(block);if(!block_validate(block)){throw new Exception("block validation failed for our own block");}block_apply(block);gms.ready=true;}void proposed_block_replace(Block &block){if(!gms.is_proposal_valid||gms.proposed_block.header.hash > block.header.hash){gms.is_proposal_valid=true;gms.proposed_block=block;block_broadcast();}}void block_propose(){if(!gms.ready)E;auto last=gms.main_chain_block_list.back();Block block;block.header.id=last.header.id+1;block.header.version=1;block.header.prev_hash=last.header.hash;block.header.issuer_addr=my_primary_address;block.header.issuer_pub_key=my_pub_key;block.header.nonce=0;block.tx_list=gms.tx_list;gms.tx_list.clear();block_sign(block,my_pub_key,my_prv_key);block_weight_calc(block);if(!block_validate(block)){throw new Exception("block validation failed for our own block");}proposed_block_replace(block);}void rpc_bc_height(C Value &rq,Value &rs){rs=bc_height();}void rpc_get_node_list(C Value &rq,Value &rs){FOR_COL(it,gns.node_list){Value node;node["is_self"]=it->is_self;node["ip_port"]=it->ip_port;rs.append(node);}}void rpc_get_block_number(C Value &rq,Value &rs){I id=rq["id"].asInt();if(id < 0){rs="fail";E;}if(id >=gms.main_chain_block_list.size()){rs="fail";E;}block_to_json(gms.main_chain_block_list[id],rs);}void rpc_tx_push(C Value &rq,Value &rs){Tx tx;tx.type=rq["type"].asInt();tx.amount=rq["amount"].asInt();if(!address_json_parse(rq["send_addr"],tx.send_addr)){rs="fail";E;}if(!address_json_parse(rq["recv_addr"],tx.recv_addr)){rs="fail";E;}if(!str2t_pub_key(rq["bind_pub_key"].asString(),tx.bind_pub_key)){rs="fail";E;}tx.nonce=rq["nonce"].asInt();if(!str2t_hash(rq["hash"].asString(),tx.hash)){rs="fail";E;}if(!str2t_sign(rq["sign"].asString(),tx.sign)){rs="fail";E;}if(!tx_validate(tx)){rs="fail";E;}gms.tx_list.push_back(tx);}class LS:public AbstractServer<LS>{public:bool work=true;LS(ASC &c,sVt type=JSONRPC_SERVER_V2):AbstractServer<LS>(c,type){bM(Procedure("bc_height",PARAMS_BY_NAME,JSON_INTEGER,0),&LS::bc_heightI);bM(Procedure("get_node_list",PARAMS_BY_NAME,JSON_ARRAY,0),&LS::get_node_listI);bM(Procedure("get_balance",PARAMS_BY_NAME,JSON_INTEGER,"address",JS,0),&LS::B);bM(Procedure("transfer",PARAMS_BY_NAME,JS,"amount",JSON_INTEGER,"from_address",JS,"to_address",JS,0),&LS::transferI);bM(Procedure("address_transfer",PARAMS_BY_NAME,JS,"address",JS,"pub_key",JS,0),&LS::address_transferI);bM(Procedure("shutdown",PARAMS_BY_NAME,JS,0),&LS::shutdownI);bM(Procedure("set_tx_mining_mode",PARAMS_BY_NAME,JS,"enabled",JSON_INTEGER,0),&LS::set_tx_mining_modeI);bM(Procedure("get_tx_mining_mode",PARAMS_BY_NAME,JSON_INTEGER,0),&LS::get_tx_mining_modeI);bM(Procedure("get_my_weight",PARAMS_BY_NAME,JSON_INTEGER,0),&LS::get_my_weightI);bM(Procedure("debug_set_key",PARAMS_BY_NAME,JS,"address",JS,"pub_key",JS,"prv_key",JS,0),&LS::debug_set_keyI);bM(Procedure("debug_key_gen",PARAMS_BY_NAME,JS,0),&LS::debug_key_genI);}void bc_heightI(C Value &rq,Value &rs){rpc_bc_height(rq,rs);}void get_node_listI(C Value &rq,Value &rs){rpc_get_node_list(rq,rs);}void B(C Value &rq,Value &rs){u32 A;if(!address_json_parse(rq["address"],A)){rs=0;E;}if(A >=gms.B.size()){rs=0;E;}rs=gms.B[A];}void shutdownI(C Value &rq,Value &rs){printf("shutdown scheduled\n");work=0;rs="ok";}void set_tx_mining_modeI(C Value &rq,Value &rs){tx_mining_mode=rq["enabled"].asInt();rs="ok";}void get_tx_mining_modeI(C Value &rq,Value &rs){rs=tx_mining_mode;}void get_my_weightI(C Value &rq,Value &rs){FOR_COL(it,gms.aw_sort_list){if(it->account==my_primary_address){rs=it->weight;E;}}rs=0;}void transferI(C Value &rq,Value &rs){u32 amount=rq["amount"].asInt();u32 fA;if(!address_json_parse(rq["from_address"],fA)){rs="fail";E;}if(fA >=gms.B.size()){rs="fail";E;}u32 tA;if(!address_json_parse(rq["to_address"],tA)){rs="fail";E;}if(tA >=gms.B.size()){rs="fail";E;}if(gms.a2pk[fA] !=my_pub_key){rs="fail";E;}if(gms.B[fA] < max(amount,amount+tx_fee)){rs="fail";E;}Tx tx;tx.type=1;tx.amount=amount;tx.send_addr=fA;tx.recv_addr=tA;tx.nonce=0;tx_sign(tx,my_pub_key,my_prv_key);if(!tx_validate(tx)){printf("tx_validate_reason=%d\n",tx_validate_reason);rs="fail";E;}printf("tx transfer %d coin %d-> %d\n",amount,fA,tA);gms.tx_list.push_back(tx);rs="ok";}void address_transferI(C Value &rq,Value &rs){u32 A;if(!address_json_parse(rq["address"],A)){rs="fail";E;}if(A >=gms.a2pk.size()){rs="fail";E;}if(gms.a2pk[A] !=my_pub_key){printf("you don't own address %d\n",A);t_pub_key_print("my_pub_key=",my_pub_key);t_pub_key_print("gms.a2pk[address]=",gms.a2pk[A]);rs="fail";E;}string hex_pub_key=rq["pub_key"].asString();if(hex_pub_key.size()!=2*t_pub_key_size){rs="fail";E;}for(int i=0;i<2*t_pub_key_size;i++){char ch=hex_pub_key[i];if('0' <=ch && ch <='9')continue;if('a' <=ch && ch <='f')continue;if('A' <=ch && ch <='A')continue;rs="fail";E;}Tx tx;tx.type=2;tx.amount=0;tx.send_addr=my_primary_address;tx.recv_addr=A;str2t_pub_key(hex_pub_key,tx.bind_pub_key);tx.nonce=0;tx_sign(tx,my_pub_key,my_prv_key);if(!tx_validate(tx)){printf("tx_validate_reason=%d\n",tx_validate_reason);rs="fail";E;}printf("address transfer owner=%d address=%d pub_key=%s\n",my_primary_address,A,hex_pub_key.c_str());gms.tx_list.push_back(tx);rs="ok";}void debug_set_keyI(C Value &rq,Value &rs){u32 A;if(!address_json_parse(rq["address"],A)){rs="fail";E;}if(A >=gms.B.size()){rs="fail";E;}string hex_pub_key=rq["pub_key"].asString();if(hex_pub_key.size()!=2*t_pub_key_size){rs="fail";E;}for(int i=0;i<2*t_pub_key_size;i++){char ch=hex_pub_key[i];if('0' <=ch && ch <='9')continue;if('a' <=ch && ch <='f')continue;if('A' <=ch && ch <='A')continue;rs="fail";E;}string hex_prv_key=rq["prv_key"].asString();if(hex_prv_key.size()!=2*t_prv_key_size){rs="fail";E;}for(int i=0;i<2*t_prv_key_size;i++){char ch=hex_prv_key[i];if('0' <=ch && ch <='9')continue;if('a' <=ch && ch <='f')continue;if('A' <=ch && ch <='A')continue;rs="fail";E;}t_pub_key pub_key;t_prv_key prv_key;str2t_pub_key(hex_pub_key,pub_key);str2t_prv_key(hex_prv_key,prv_key);if(gms.a2pk[A] !=pub_key){printf("debug_set_keyI %d\n",A);t_pub_key_print("pub_key=",pub_key);t_pub_key_print("gms.a2pk[address]=",gms.a2pk[A]);rs="fail";E;}my_primary_address=A;my_pub_key=pub_key;my_prv_key=prv_key;t_pub_key_print("my_pub_key=",my_pub_key);t_prv_key_print("my_prv_key=",my_prv_key);rs="ok";}void debug_key_genI(C Value &rq,Value &rs){t_pub_key pub_key;t_prv_key prv_key;if(!key_gen(pub_key,prv_key)){rs="fail";E;}t_pub_key_print("pub_key=",pub_key);t_prv_key_print("prv_key=",prv_key);rs["pub_key"]=t_pub_key2str(pub_key);rs["prv_key"]=t_prv_key2str(prv_key);}};class GS:public AbstractServer<GS>{public:bool work=true;GS(ASC &c,sVt type=JSONRPC_SERVER_V2):AbstractServer<GS>(c,type){bM(Procedure("bc_height",PARAMS_BY_NAME,JSON_INTEGER,0),&GS::bc_heightI);bM(Procedure("get_node_list",PARAMS_BY_NAME,JSON_ARRAY,0),&GS::get_node_listI);bM(Procedure("get_block_number",PARAMS_BY_NAME,JSON_OBJECT,0),&GS::get_block_numberI);bM(Procedure("tx_push",PARAMS_BY_NAME,JSON_OBJECT,"type",JSON_INTEGER,"amount",JSON_INTEGER,"send_addr",JS,"recv_addr",JS,"bind_pub_key",JS,"tx_epoch",JSON_INTEGER,"nonce",JSON_INTEGER,"hash",JS,"sign",JS,0),&GS::tx_pushI);bM(Procedure("handshake",PARAMS_BY_NAME,JS,"rev_ip_port",JS,0),&GS::handshakeI);bM(Procedure("get_proposed_block",PARAMS_BY_NAME,JSON_OBJECT,0),&GS::get_proposed_blockI);bM(Procedure("proposed_block_push",PARAMS_BY_NAME,JS,"header",JSON_OBJECT,"tx_list",JSON_ARRAY,"hash",JS,"sign",JS,0),&GS::proposed_block_pushI);bM(Procedure("get_balance",PARAMS_BY_NAME,JSON_INTEGER,"address",JS,0),&GS::B);bM(Procedure("transfer",PARAMS_BY_NAME,JS,"amount",JSON_INTEGER,"from_address",JS,"to_address",JS,0),&GS::transferI);bM(Procedure("address_transfer",PARAMS_BY_NAME,JS,"address",JS,"pub_key",JS,0),&GS::address_transferI);}void bc_heightI(C Value &rq,Value &rs){rpc_bc_height(rq,rs);}void get_node_listI(C Value &rq,Value &rs){rpc_get_node_list(rq,rs);}void get_block_numberI(C Value &rq,Value &rs){rpc_get_block_number(rq,rs);}void tx_pushI(C Value &rq,Value &rs){rpc_tx_push(rq,rs);}void handshakeI(C Value &rq,Value &rs){string rev_ip_port=rq["rev_ip_port"].asString();if(rev_ip_port.size()> 100){rs="fail";E;}auto end=gns.node_list.end();bool found=0;FOR_COL(it,gns.node_list){if(it->ip_port==rev_ip_port){found=true;break;}}if(!found){NetNode node;node.ip_port=rev_ip_port;gns.node_list.push_back(node);}rs="ok";}void get_proposed_blockI(C Value &rq,Value &rs){block_to_json(gms.proposed_block,rs);}void proposed_block_pushI(C Value &rq,Value &rs){Block block;if(!json_to_block(rq,block)){rs="fail";E;}proposed_block_replace(block);rs="ok";}void B(C Value &rq,Value &rs){u32 A;if(!address_json_parse(rq["address"],A)){rs=0;E;}if(A >=gms.B.size()){rs=0;E;}rs=gms.B[A];}void transferI(C Value &rq,Value &rs){u32 amount=rq["amount"].asInt();u32 fA;if(!address_json_parse(rq["from_address"],fA)){rs="fail";E;}if(fA >=gms.B.size()){rs="fail";E;}u32 tA;if(!address_json_parse(rq["to_address"],tA)){rs="fail";E;}if(tA >=gms.B.size()){rs="fail";E;}if(gms.a2pk[fA] !=my_pub_key){rs="fail";E;}if(gms.B[fA] < max(amount,amount+tx_fee)){rs="fail";E;}Tx tx;tx.type=1;tx.amount=amount;tx.send_addr=fA;tx.recv_addr=tA;tx.nonce=0;tx_sign(tx,my_pub_key,my_prv_key);if(!tx_validate(tx)){printf("tx_validate_reason=%d\n",tx_validate_reason);rs="fail";E;}printf("tx transfer %d coin %d-> %d\n",amount,fA,tA);gms.tx_list.push_back(tx);rs="ok";}void address_transferI(C Value &rq,Value &rs){u32 A;if(!address_json_parse(rq["address"],A)){rs="fail";E;}if(A >=gms.a2pk.size()){rs="fail";E;}if(gms.a2pk[A] !=my_pub_key){printf("you don't own address %d\n",A);t_pub_key_print("my_pub_key=",my_pub_key);t_pub_key_print("gms.a2pk[address]=",gms.a2pk[A]);rs="fail";E;}Tx tx;tx.type=2;tx.amount=0;tx.send_addr=my_primary_address;tx.recv_addr=A;string pub_key=rq["pub_key"].asString();if(!str2t_pub_key(pub_key,tx.bind_pub_key)){rs="fail";E;}tx.nonce=0;tx_sign(tx,my_pub_key,my_prv_key);if(!tx_validate(tx)){printf("tx_validate_reason=%d\n",tx_validate_reason);rs="fail";E;}printf("address transfer owner=%d address=%d pub_key=%s\n",my_primary_address,A,pub_key.c_str());gms.tx_list.push_back(tx);rs="ok";}};
+bool tx_validate(Tx &tx,bool check_crypto=true,State_overlay*overlay=0){int L=gms.a2pk.size();if(tx.send_addr >=L)RET(1)if(tx.recv_addr >=L)RET(2)auto send_pub_key=overlay_a2pk_get(overlay,tx.send_addr);switch(tx.type){case 1:// transfer
+if(overlay_balance_get(overlay,tx.send_addr)< max(tx.amount,tx.amount+tx_fee))RET(10)break;case 2:// address_transfer
+if(overlay_balance_get(overlay,tx.send_addr)< tx_fee)RET(20)if(tx.recv_addr >=L)RET(21)if(send_pub_key !=overlay_a2pk_get(overlay,tx.recv_addr))RET(22)break;default:RET(30)}u32 tx_epoch=tx_epoch_now();if(tx.tx_epoch > tx_epoch||tx_epoch-tx.tx_epoch > tx_epoch_window)RET(6)if(replay_find(gms.done_tx,tx))RET(4)if(overlay && replay_find(overlay->done_tx,tx))RET(4)if(!check_crypto)E true;u8 buffer[tx_body_size];tx_body_pack(tx,buffer);t_hash cmp_hash;sha512(buffer,tx_body_size,cmp_hash.b);if(cmp_hash !=tx.hash)RET(3)if(sig_cache_find(tx,send_pub_key))E true;if(overlay && overlay->a2pk.count(tx.send_addr)){if(!ed25519_verify(tx.sign.b,buffer,tx_body_size,send_pub_key.b))RET(5)sig_cache_add(tx,send_pub_key);E true;}if(!verify_ctx_verify(tx.send_addr,send_pub_key,tx.sign.b,buffer,tx_body_size))RET(5)sig_cache_add(tx,send_pub_key);E true;}int tx_range_verify(vector<Tx> &tx_list,vector<t_pub_key> &send_pub_key_list,u32 from,u32 to){u32 n=to-from;vector<u8> msg_buf(n*tx_body_size);vector<size_t> msg_len_list(n,tx_body_size);vector<C u8*> sign_list(n),msg_list(n),pub_key_list(n);vector<t_hash> hash_list(n);vector<u8*> hash_ptr_list(n);vector<int> valid_list(n);for(u32 i=0;i<n;i++){Tx &tx=tx_list[from+i];msg_list[i]=msg_buf.data()+i*tx_body_size;tx_body_pack(tx,msg_buf.data()+i*tx_body_size);sign_list[i]=tx.sign.b;pub_key_list[i]=send_pub_key_list[from+i].b;hash_ptr_list[i]=hash_list[i].b;}sha512_multi(msg_list.data(),msg_len_list.data(),n,hash_ptr_list.data());vector<u32> idx_list;for(u32 i=0;i<n;i++){Tx &tx=tx_list[from+i];if(hash_list[i] !=tx.hash)E 3;if(sig_cache_find(tx,send_pub_key_list[from+i]))continue;u32 j=idx_list.size();sign_list[j]=sign_list[i];msg_list[j]=msg_list[i];msg_len_list[j]=msg_len_list[i];pub_key_list[j]=pub_key_list[i];idx_list.push_back(from+i);}u32 m=idx_list.size();if(!m)E 0;bool res=ed25519_verify_batch(sign_list.data(),msg_list.data(),msg_len_list.data(),pub_key_list.data(),m,valid_list.data());for(u32 j=0;j<m;j++){Tx &tx=tx_list[idx_list[j]];if(valid_list[j])sig_cache_add(tx,send_pub_key_list[idx_list[j]]);}E res ? 0:5;}C u32 tx_verify_chunk=256;bool tx_list_verify(vector<Tx> &tx_list,vector<t_pub_key> &send_pub_key_list){u32 n=tx_list.size();if(!n)E true;sha512_multi_init();u32 chunk_count=(n+tx_verify_chunk-1)/tx_verify_chunk;atomic<int> reason(0);atomic<u32> next_chunk(0);par_range(chunk_count,1,[&](u32 from,u32 to){for(u32 i;!reason &&(i=next_chunk++)< chunk_count;){int res=tx_range_verify(tx_list,send_pub_key_list,i*tx_verify_chunk,min(n,(i+1)*tx_verify_chunk));if(res)reason=res;}});if(reason)RET(reason)E true;}void tx_apply(Tx &tx,State_overlay &overlay){switch(tx.type){case 1:// transfer
+overlay_balance(overlay,tx.send_addr)-=tx.amount+tx_fee;overlay_balance(overlay,tx.recv_addr)+=tx.amount;break;case 2:// address_transfer
+overlay_balance(overlay,tx.send_addr)-=tx_fee;overlay.a2pk[tx.recv_addr]=tx.bind_pub_key;break;}replay_insert(overlay.done_tx,tx);}void tx_schedule(vector<Tx> &tx_list,vector<vector<u32>>&batch_list){unordered_map<u32,u32> parent;auto find=[&](u32 addr){auto it=parent.find(addr);if(it==parent.end()){parent[addr]=addr;E addr;}while(parent[addr] !=addr){parent[addr]=parent[parent[addr]];addr=parent[addr];}E addr;};FOR_COL(it,tx_list){u32 a=find(it->send_addr);u32 b=find(it->recv_addr);if(a !=b)parent[b]=a;}unordered_map<u32,u32> root_batch;batch_list.clear();for(u32 i=0;i<tx_list.size();i++){auto ins=root_batch.insert({find(tx_list[i].send_addr),batch_list.size()});if(ins.second)batch_list.push_back(vector<u32>());batch_list[ins.first->second].push_back(i);}}C u32 tx_apply_thread_min=1024;u32 tx_apply_thread_count=0;void tx_list_apply(vector<Tx> &tx_list,State_overlay &overlay){u32 thread_count=tx_apply_thread_count ? tx_apply_thread_count:min<u32>(thread::hardware_concurrency(),tx_list.size()/tx_apply_thread_min);vector<vector<u32>>batch_list;if(thread_count >=2)tx_schedule(tx_list,batch_list);if(batch_list.size()< 2){FOR_COL(it,tx_list){tx_apply(*it,overlay);}E;}u32 part_count=min<u32>(thread_count,batch_list.size());vector<u32> order(batch_list.size());for(u32 i=0;i<order.size();i++)order[i]=i;sort(order.begin(),order.end(),[&](u32 a,u32 b){E batch_list[a].size()> batch_list[b].size();});vector<vector<u32>>part_list(part_count);FOR_COL(it,order){u32 p=0;for(u32 i=1;i<part_count;i++){if(part_list[i].size()< part_list[p].size())p=i;}part_list[p].insert(part_list[p].end(),batch_list[*it].begin(),batch_list[*it].end());}vector<State_overlay> shard_list(part_count);par_range(part_count,1,[&](u32 from,u32 to){for(u32 p=from;p<to;p++){overlay_init(shard_list[p]);sort(part_list[p].begin(),part_list[p].end());FOR_COL(it,part_list[p]){tx_apply(tx_list[*it],shard_list[p]);}}});FOR_COL(shard,shard_list){overlay.B.insert(shard->B.begin(),shard->B.end());overlay.a2pk.insert(shard->a2pk.begin(),shard->a2pk.end());}FOR_COL(it,tx_list){replay_insert(overlay.done_tx,*it);}}void tx_to_json(Tx &tx,Value &value){value["type"]=tx.type;value["amount"]=tx.amount;value["send_addr"]=tx.send_addr;value["recv_addr"]=tx.recv_addr;value["bind_pub_key"]=t_pub_key2str(tx.bind_pub_key);value["tx_epoch"]=tx.tx_epoch;value["nonce"]=tx.nonce;value["hash"]=t_hash2str(tx.hash);value["sign"]=t_sign2str(tx.sign);}bool json_to_tx(C Value &value,Tx &tx){bool res=true;tx.type=value["type"].asInt();tx.amount=value["amount"].asInt();tx.send_addr=value["send_addr"].asInt();tx.recv_addr=value["recv_addr"].asInt();res &=str2t_pub_key(value["bind_pub_key"].asString(),tx.bind_pub_key);tx.tx_epoch=value["tx_epoch"].asInt();tx.nonce=value["nonce"].asInt();res &=str2t_hash(value["hash"].asString(),tx.hash);res &=str2t_sign(value["sign"].asString(),tx.sign);E res;}void merkle_chain_calc(vector<Tx> &tx_list,t_hash &res){memset(res.b,0,sizeof(t_hash));FOR_COL(it,tx_list){sha512_context ctx;sha512_init(&ctx);sha512_update(&ctx,res.b,sizeof(res.b));sha512_update(&ctx,it->sign.b,sizeof(res.b));sha512_final(&ctx,(u8*)&res.b);}}C u32 merkle_node_len=1+2*t_hash_size;C u32 merkle_thread_min=1024;void merkle_hash_list(vector<u8> &msg_buf,u32 n,t_hash*res){vector<C u8*> msg_list(n);vector<size_t> msg_len_list(n,merkle_node_len);vector<u8*> res_list(n);for(u32 i=0;i<n;i++){msg_list[i]=msg_buf.data()+i*merkle_node_len;res_list[i]=res[i].b;}sha512_multi(msg_list.data(),msg_len_list.data(),n,res_list.data());}void merkle_leaf_range(vector<Tx> &tx_list,vector<t_hash> &leaf_list,u32 from,u32 to){vector<u8> msg_buf((to-from)*merkle_node_len);u8*buf_ptr=msg_buf.data();for(u32 i=from;i<to;i++){*buf_ptr++=0;memcpy(buf_ptr,tx_list[i].hash.b,t_hash_size);buf_ptr+=t_hash_size;memcpy(buf_ptr,tx_list[i].sign.b,t_sign_size);buf_ptr+=t_sign_size;}merkle_hash_list(msg_buf,to-from,&leaf_list[from]);}void merkle_node_range(vector<t_hash> &child_list,vector<t_hash> &node_list,u32 from,u32 to){u32 child_count=child_list.size();if(to*2 > child_count){to--;node_list[to]=child_list[2*to];}if(from >=to)E;vector<u8> msg_buf((to-from)*merkle_node_len);u8*buf_ptr=msg_buf.data();for(u32 i=from;i<to;i++){*buf_ptr++=1;memcpy(buf_ptr,child_list[2*i ].b,t_hash_size);buf_ptr+=t_hash_size;memcpy(buf_ptr,child_list[2*i+1].b,t_hash_size);buf_ptr+=t_hash_size;}merkle_hash_list(msg_buf,to-from,&node_list[from]);}void merkle_tree_build(vector<Tx> &tx_list,Merkle_tree &tree){tree.level_list.clear();u32 n=tx_list.size();if(!n)E;tree.level_list.push_back(vector<t_hash>(n));par_range(n,merkle_thread_min,[&](u32 from,u32 to){merkle_leaf_range(tx_list,tree.level_list[0],from,to);});while(n > 1){n=(n+1)/2;tree.level_list.push_back(vector<t_hash>(n));auto &child_list=tree.level_list[tree.level_list.size()-2];auto &node_list=tree.level_list.back();par_range(n,merkle_thread_min,[&](u32 from,u32 to){merkle_node_range(child_list,node_list,from,to);});}}void merkle_tree_push(Merkle_tree &tree,Tx &tx){vector<Tx> tx_list(1,tx);vector<t_hash> leaf_list(1);merkle_leaf_range(tx_list,leaf_list,0,1);if(!tree.level_list.size())tree.level_list.resize(1);tree.level_list[0].push_back(leaf_list[0]);for(u32 k=0;tree.level_list[k].size()> 1;k++){if(k+1==tree.level_list.size())tree.level_list.resize(k+2);auto &child_list=tree.level_list[k];auto &node_list=tree.level_list[k+1];u32 i=(child_list.size()-1)/2;node_list.resize(i+1);merkle_node_range(child_list,node_list,i,i+1);}}void merkle_tree_root(Merkle_tree &tree,t_hash &res){if(!tree.level_list.size()){memset(res.b,0,sizeof(t_hash));E;}res=tree.level_list.back()[0];}bool merkle_tree_proof(Merkle_tree &tree,u32 idx,vector<t_hash> &path){path.clear();if(!tree.level_list.size()||idx >=tree.level_list[0].size())E 0;for(u32 k=0;k+1<tree.level_list.size();k++){auto &level=tree.level_list[k];if((idx^1)< level.size())path.push_back(level[idx^1]);idx>>=1;}E true;}bool merkle_proof_verify(t_hash &leaf,u32 idx,u32 n,vector<t_hash> &path,t_hash &root){t_hash cur=leaf;u32 p=0;u8 buf[merkle_node_len];buf[0]=1;for(;n > 1;n=(n+1)/2,idx>>=1){if((idx^1)>=n)continue;if(p >=path.size())E 0;t_hash &left=idx&1 ? path[p]:cur;t_hash &right=idx&1 ? cur:path[p];memcpy(buf+1,left.b,t_hash_size);memcpy(buf+1+t_hash_size,right.b,t_hash_size);sha512(buf,merkle_node_len,cur.b);p++;}E p==path.size()&& !(cur !=root);}void merkle_tree_calc(Block &block,t_hash &res){if(block.header.version < 2){merkle_chain_calc(block.tx_list,res);E;}Merkle_tree tree;merkle_tree_build(block.tx_list,tree);merkle_tree_root(tree,res);}bool block_validate(Block &block,State_overlay*overlay=0){if(bc_height()==0){if(block.header.id !=0||!block_header_sign_check(block.header))E 0;}else{if(!block_header_validate(block.header))E 0;}if(block.header.version > block_version)E 0;State_overlay tmp_overlay;if(!overlay)overlay=&tmp_overlay;overlay_init(*overlay);vector<t_pub_key> send_pub_key_list;send_pub_key_list.reserve(block.tx_list.size());FOR_COL(it,block.tx_list){if(!tx_validate(*it,0,overlay))E 0;send_pub_key_list.push_back(overlay_a2pk_get(overlay,it->send_addr));tx_apply(*it,*overlay);}if(!tx_list_verify(block.tx_list,send_pub_key_list))E 0;t_hash merkle_tree;merkle_tree_calc(block,merkle_tree);if(merkle_tree !=block.header.merkle_tree)E 0;E true;}void block_sign(Block &block,t_pub_key &pub_key,t_prv_key &prv_key){merkle_tree_calc(block,block.header.merkle_tree);block_header_sign(block.header,pub_key,prv_key);}void block_state_apply(Block &block,State_overlay*overlay=0){State_overlay tmp_overlay;if(!overlay){overlay=&tmp_overlay;overlay_init(*overlay);tx_list_apply(block.tx_list,*overlay);}Undo_block undo;undo.account_count=gms.a2pk.size();overlay_commit(*overlay,block.tx_list,undo);undo_balance_save(undo,block.header.issuer_addr);balance_set(block.header.issuer_addr,balance_get(block.header.issuer_addr)+mining_reward+tx_fee*block.tx_list.size());gms.demurrage_height++;gms_account_new(block.header.issuer_pub_key);gms.undo_list.push_back(move(undo));if(gms.undo_list.size()> undo_depth)gms.undo_list.pop_front();}void block_state_undo(Undo_block &undo){for(u32 addr=undo.account_count;addr<gms.a2pk.size();addr++)verify_ctx_drop(addr);gms.a2pk.resize(undo.account_count);gms.B.resize(undo.account_count);gms.balance_height.resize(undo.account_count);weight_index_truncate(undo.account_count);gms.demurrage_height--;for(auto it=undo.balance_list.rbegin();it !=undo.balance_list.rend();it++){gms.B[it->addr]=it->B;gms.balance_height[it->addr]=it->balance_height;weight_index_update(it->addr);}for(auto it=undo.a2pk_list.rbegin();it !=undo.a2pk_list.rend();it++){gms.a2pk[it->addr]=it->pub_key;verify_ctx_drop(it->addr);}for(auto it=undo.replay_list.rbegin();it !=undo.replay_list.rend();it++){replay_erase(gms.done_tx,it->tx_epoch,it->key);}for(auto it=undo.replay_reset_list.rbegin();it !=undo.replay_reset_list.rend();it++){replay_table(gms.done_tx,it->tx_epoch)=*it;}}void main_chain_push(Block &block){lock_guard<mutex> guard(gms.main_chain_lock);gms.main_chain_block_list.push_back(block);while(gms.main_chain_block_list.size()> main_chain_tail_size){gms.main_chain_block_list.pop_front();gms.main_chain_block_offset++;}}void block_apply(Block &block,State_overlay*overlay=0){block_state_apply(block,overlay);if(!block_log_append(block)){throw new Exception("block log append failed");}main_chain_push(block);block_wire_cache_put(block);mempool_block_remove(block);FOR_COL(it,gns.node_list){it->is_proposal_valid=0;}snapshot_poll();if(snapshot_interval && bc_height()% snapshot_interval==0){snapshot_start();}if(bc_height()% pack_block_count==pack_finality){pack_build_start();}}void block_weight_calc(Block &block){u32 weight=0;FOR_COL(it,block.tx_list){weight+=it->weight=hash2weight(it->hash);}weight+=block.header.weight=hash2weight(block.header.hash);block.weight=weight;}void block_to_json(Block &block,Value &value){Value header;block_header_to_json(block.header,header);Value tx_list;FOR_COL(it,block.tx_list){Value tx;tx_to_json(*it,tx);tx_list.append(tx);}value["header"]=header;value["tx_list"]=tx_list;value["weight"]=block.weight;}bool json_to_block(C Value &value,Block &block){bool res=true;res &=json_to_block_header(value["header"],block.header);Value tx_list=value["tx_list"];u32 i=0,len=tx_list.size();block.tx_list.resize(len);for(;i<len;i++){res &=json_to_tx(tx_list[i],block.tx_list[i]);}block.weight=value["weight"].asInt();E res;}u32 block_pack_size(Block &block){E block_pack_head_size+block.tx_list.size()*tx_pack_size;}void block_pack(Block &block,vector<u8> &buf){buf.resize(block_pack_size(block));u8*p=buf.data();pack_u32(p,block_codec_version);block_header_pack(block.header,p);p+=block_header_pack_size;pack_u32(p,block.tx_list.size());FOR_COL(it,block.tx_list){tx_pack(*it,p);p+=tx_pack_size;}}bool block_unpack(C u8*buf,u32 len,Block &block){Block_view view;if(!block_view_parse(buf,len,view))E 0;block_header_unpack(view.header,block.header);block.tx_list.resize(view.tx_count);for(u32 i=0;i<view.tx_count;i++){tx_unpack(view.tx_list+i*tx_pack_size,block.tx_list[i]);}block_weight_calc(block);E true;}string block_to_hex(Block &block){vector<u8> buf;block_pack(block,buf);E buf2hex(buf.data(),buf.size());}bool hex_to_block(C string &str,Block &block){vector<u8> buf;if(!hex2buf(str,buf))E 0;E block_unpack(buf.data(),buf.size(),block);}shared_ptr<Block_wire> block_wire_make(Block &block){auto wire=make_shared<Block_wire>();wire->hash=block.header.hash;block_to_json(block,wire->json);wire->bin=block_to_hex(block);wire->size=sizeof(Block_wire)+4*wire->bin.size();E wire;}void block_wire_cache_put(Block &block){auto &c=block_wire_cache;shared_ptr<Block_wire> wire;{lock_guard<mutex> guard(c.lock);if(c.proposal && !(c.proposal->hash !=block.header.hash))wire=c.proposal;}if(!wire)wire=block_wire_make(block);lock_guard<mutex> guard(c.lock);auto &slot=c.id_hash[block.header.id];if(slot)c.size-=slot->size;slot=wire;c.size+=wire->size;while(c.size > c.size_limit && c.id_hash.size()> 1){auto it=c.id_hash.begin();c.size-=it->second->size;c.id_hash.erase(it);}}void block_wire_proposal_set(Block &block){auto wire=block_wire_make(block);lock_guard<mutex> guard(block_wire_cache.lock);block_wire_cache.proposal=wire;}shared_ptr<Block_wire> block_wire_get(u32 id){lock_guard<mutex> guard(block_wire_cache.lock);auto it=block_wire_cache.id_hash.find(id);if(it==block_wire_cache.id_hash.end())E nullptr;E it->second;}shared_ptr<Block_wire> block_wire_proposal_get(){lock_guard<mutex> guard(block_wire_cache.lock);E block_wire_cache.proposal;}void block_wire_cache_drop_from(u32 id){auto &c=block_wire_cache;lock_guard<mutex> guard(c.lock);for(auto it=c.id_hash.lower_bound(id);it !=c.id_hash.end();){c.size-=it->second->size;it=c.id_hash.erase(it);}}void persist_append(){if(!durability)E;unique_lock<mutex> lk(persist.lock);u64 seq=++persist.seq_appended;persist.pending_time.push_back(chrono::steady_clock::now());persist.wake.notify_one();if(durability==2 && persist.running){persist.done.wait(lk,[seq](){E persist.seq_durable >=seq;});}}void persist_dir_dirty(){if(!durability)E;lock_guard<mutex> guard(persist.lock);persist.dir_dirty=true;persist.wake.notify_one();}void persist_writer(){unique_lock<mutex> lk(persist.lock);persist.running=true;while(true){persist.wake.wait(lk,[](){E persist.seq_appended > persist.seq_durable||persist.dir_dirty||persist.stop;});u64 target=persist.seq_appended;bool dir=persist.dir_dirty;persist.dir_dirty=0;lk.unlock();vector<int> fd_list;{lock_guard<mutex> guard(block_log.lock);for(u32 i=block_log.sync_segment;i<block_log.seg_fd.size();i++){fd_list.push_back(dup(block_log.seg_fd[i]));}block_log.sync_segment=block_log.seg_fd.size()-1;fd_list.push_back(dup(block_log.height_fd));fd_list.push_back(dup(block_log.hash_fd));}FOR_COL(it,fd_list){if(*it < 0)continue;fdatasync(*it);close(*it);}if(dir){int dir_fd=open(chain_path.c_str(),O_RDONLY|O_DIRECTORY);if(dir_fd >=0){fsync(dir_fd);close(dir_fd);}}auto now=chrono::steady_clock::now();lk.lock();u64 batch=target-persist.seq_durable;for(u64 i=0;i<batch;i++){u64 us=chrono::duration_cast<chrono::microseconds>(now-persist.pending_time.front()).count();persist.pending_time.pop_front();persist.latency_sum_us+=us;persist.latency_max_us=max(persist.latency_max_us,us);persist.latency_last_us=us;}persist.seq_durable=target;persist.commit_count++;persist.batch_max=max(persist.batch_max,batch);if(persist.stop && persist.seq_appended==target && !persist.dir_dirty){persist.running=0;persist.done.notify_all();E;}persist.done.notify_all();}}void persist_stop(){unique_lock<mutex> lk(persist.lock);if(!persist.running)E;persist.stop=true;persist.wake.notify_one();persist.done.wait(lk,[](){E !persist.running;});}string block_log_seg_path(u32 segment){char name[32];snprintf(name,sizeof(name),"/seg_%06u.log",segment);E block_log.path+name;}bool block_log_idx_map(int fd,Block_log_idx_head*&head,u32 entry_size,u32 capacity){size_t len=sizeof(Block_log_idx_head)+(size_t)entry_size*capacity;Block_log_idx_head old;bool fresh=!head;if(head){old=*head;munmap(head,sizeof(Block_log_idx_head)+(size_t)entry_size*head->capacity);head=0;}if(ftruncate(fd,len))E 0;void*p=mmap(0,len,PROT_READ|PROT_WRITE,MAP_SHARED,fd,0);if(p==MAP_FAILED)E 0;head=(Block_log_idx_head*)p;if(!fresh)*head=old;head->capacity=capacity;E true;}bool block_log_idx_open(C string &path,int &fd,Block_log_idx_head*&head,u32 entry_size,u32 capacity){fd=open(path.c_str(),O_RDWR|O_CREAT,0644);if(fd < 0)E 0;struct stat st;if(fstat(fd,&st))E 0;Block_log_idx_head tmp={0};if(st.st_size >=sizeof(tmp))pread(fd,&tmp,sizeof(tmp),0);bool valid=tmp.magic==block_log_magic && tmp.version==block_log_version &&
+st.st_size==sizeof(tmp)+(size_t)entry_size*tmp.capacity && tmp.count <=tmp.capacity;if(valid)capacity=tmp.capacity;if(!block_log_idx_map(fd,head,entry_size,capacity))E 0;if(!valid){head->magic=block_log_magic;head->version=block_log_version;head->count=0;}E true;}u32 block_log_hash_slot(C u8*key){u32 res;memcpy(&res,key,4);E res;}void block_log_hash_insert(u32 id){u32 mask=block_log.hash_head->capacity-1;u32 i=block_log_hash_slot(block_log.height[id].key)& mask;while(block_log.hash[i])i=(i+1)& mask;block_log.hash[i]=id+1;block_log.hash_head->count++;}bool block_log_hash_rebuild(u32 capacity){if(!block_log_idx_map(block_log.hash_fd,block_log.hash_head,sizeof(u32),capacity))E 0;block_log.hash=(u32*)(block_log.hash_head+1);memset(block_log.hash,0,sizeof(u32)*capacity);block_log.hash_head->count=0;for(u32 i=0;i<block_log.height_head->count;i++)block_log_hash_insert(i);E true;}bool block_log_seg_open(u32 segment,bool trunc){int fd=open(block_log_seg_path(segment).c_str(),O_RDWR|O_CREAT|(trunc ? O_TRUNC:0),0644);if(fd < 0)E 0;block_log.seg_fd.push_back(fd);E true;}bool block_log_frame_read(Block_log_pos &pos,vector<u8> &buf){if(pos.segment >=block_log.seg_fd.size())E 0;u32 head[2];int fd=block_log.seg_fd[pos.segment];if(pread(fd,head,sizeof(head),pos.offset)!=sizeof(head))E 0;if(head[0] !=pos.len||head[1] !=pos.crc)E 0;buf.resize(pos.len);if(pread(fd,buf.data(),pos.len,pos.offset+block_log_frame_head_size)!=pos.len)E 0;E crc32c(buf.data(),buf.size())==pos.crc;}void block_log_cut(u32 count){auto &l=block_log;if(count > l.height_head->count)E;u32 segment=0,end=0;if(count){Block_log_pos &pos=l.height[count-1];segment=pos.segment;end=pos.offset+block_log_frame_head_size+pos.len;}while(l.seg_fd.size()> segment+1){close(l.seg_fd.back());unlink(block_log_seg_path(l.seg_fd.size()-1).c_str());l.seg_fd.pop_back();}ftruncate(l.seg_fd[segment],end);l.seg_size=end;l.sync_segment=min(l.sync_segment,segment);l.height_head->count=count;block_log_hash_rebuild(l.hash_head->capacity);}bool block_log_open(C string &path){auto &l=block_log;lock_guard<mutex> guard(l.lock);l.path=path;mkdir(path.c_str(),0755);if(!block_log_idx_open(path+"/height.idx",l.height_fd,l.height_head,sizeof(Block_log_pos),1024))E 0;l.height=(Block_log_pos*)(l.height_head+1);if(!block_log_idx_open(path+"/hash.idx",l.hash_fd,l.hash_head,sizeof(u32),2048))E 0;l.hash=(u32*)(l.hash_head+1);u32 count=l.height_head->count;u32 last_segment=count ? l.height[count-1].segment:0;for(u32 i=0;i<=last_segment;i++){if(!block_log_seg_open(i,0))E 0;}vector<u8> buf;while(count && !block_log_frame_read(l.height[count-1],buf))count--;block_log_cut(count);E true;}void block_log_truncate(u32 count){{lock_guard<mutex> guard(block_log.lock);block_log_cut(count);}pack_drop_from(count);persist_dir_dirty();}bool block_log_write(Block &block){auto &l=block_log;vector<u8> buf(block_log_frame_head_size);{vector<u8> body;block_pack(block,body);buf.insert(buf.end(),body.begin(),body.end());}Block_log_pos pos;pos.len=buf.size()-block_log_frame_head_size;pos.crc=crc32c(buf.data()+block_log_frame_head_size,pos.len);memcpy(pos.key,block.header.hash.b,sizeof(pos.key));memcpy(buf.data(),&pos.len,4);memcpy(buf.data()+4,&pos.crc,4);lock_guard<mutex> guard(l.lock);if(!l.height_head)E 0;if(l.seg_size && l.seg_size+buf.size()> block_log_segment_size){if(!block_log_seg_open(l.seg_fd.size(),true))E 0;l.seg_size=0;}pos.segment=l.seg_fd.size()-1;pos.offset=l.seg_size;if(pwrite(l.seg_fd[pos.segment],buf.data(),buf.size(),pos.offset)!=buf.size())E 0;l.seg_size+=buf.size();u32 id=l.height_head->count;if(id==l.height_head->capacity){if(!block_log_idx_map(l.height_fd,l.height_head,sizeof(Block_log_pos),2*id))E 0;l.height=(Block_log_pos*)(l.height_head+1);}l.height[id]=pos;l.height_head->count=id+1;if(2*(id+1)> l.hash_head->capacity){E block_log_hash_rebuild(2*l.hash_head->capacity);}block_log_hash_insert(id);E true;}bool block_log_append(Block &block){if(!block_log_write(block))E 0;persist_append();E true;}bool block_log_read(u32 id,vector<u8> &buf){lock_guard<mutex> guard(block_log.lock);if(!block_log.height_head||id >=block_log.height_head->count)E 0;E block_log_frame_read(block_log.height[id],buf);}bool block_log_find(t_hash &hash,u32 &id){auto &l=block_log;lock_guard<mutex> guard(l.lock);if(!l.hash_head)E 0;u32 mask=l.hash_head->capacity-1;for(u32 i=block_log_hash_slot(hash.b)& mask;l.hash[i];i=(i+1)& mask){Block_log_pos &pos=l.height[l.hash[i]-1];if(!memcmp(pos.key,hash.b,sizeof(pos.key))){id=l.hash[i]-1;E true;}}E 0;}bool main_chain_tail_get(u32 id,Block &block){lock_guard<mutex> guard(gms.main_chain_lock);if(id < gms.main_chain_block_offset||id-gms.main_chain_block_offset >=gms.main_chain_block_list.size())E 0;block=gms.main_chain_block_list[id-gms.main_chain_block_offset];E true;}bool block_get(u32 id,Block &block){if(id >=bc_height())E 0;if(main_chain_tail_get(id,block))E true;vector<u8> buf;if(!block_log_read(id,buf))E 0;E block_unpack(buf.data(),buf.size(),block);}string pack_path(u32 pack_id){char name[32];snprintf(name,sizeof(name),"/pack_%06u.bin",pack_id);E chain_path+name;}bool pack_block_strip(C vector<u8> &buf,vector<u8> &res){Block_view view;if(!block_view_parse(buf.data(),buf.size(),view))E 0;res.resize(block_pack_head_size+view.tx_count*pack_tx_size);memcpy(res.data(),buf.data(),block_pack_head_size);u8*p=res.data()+block_pack_head_size;for(u32 i=0;i<view.tx_count;i++){C u8*tx=view.tx_list+i*tx_pack_size;pack_buf(p,tx,tx_body_size);pack_buf(p,tx+tx_off_sign,t_sign_size);}E true;}bool pack_block_restore(C u8*buf,u32 len,vector<u8> &res){if(len < block_pack_head_size)E 0;u32 tx_count=unpack_u32(buf+4+block_header_pack_size);if((u64)tx_count*pack_tx_size !=len-block_pack_head_size)E 0;res.resize(block_pack_head_size+tx_count*tx_pack_size);memcpy(res.data(),buf,block_pack_head_size);u8*p=res.data()+block_pack_head_size;buf+=block_pack_head_size;for(u32 i=0;i<tx_count;i++){memcpy(p,buf,tx_body_size);sha512(buf,tx_body_size,p+tx_off_hash);memcpy(p+tx_off_sign,buf+tx_body_size,t_sign_size);p+=tx_pack_size;buf+=pack_tx_size;}E true;}bool pack_build(u32 pack_id,vector<u8> &file){file.assign(pack_head_size,0);u8*p=file.data();pack_u32(p,pack_magic);pack_u32(p,pack_version);pack_u32(p,pack_id*pack_block_count);pack_u32(p,pack_block_count);vector<u8> buf,raw;vector<u64> offset_list;for(u32 i=0;i<pack_block_count;i++){offset_list.push_back(file.size());if(!block_log_read(pack_id*pack_block_count+i,buf))E 0;if(!pack_block_strip(buf,raw))E 0;uLongf len=compressBound(raw.size());size_t offset=file.size();file.resize(offset+4+len);p=file.data()+offset;pack_u32(p,raw.size());if(compress2(p,&len,raw.data(),raw.size(),Z_BEST_SPEED)!=Z_OK)E 0;file.resize(offset+4+len);}offset_list.push_back(file.size());p=file.data()+4*4;FOR_COL(it,offset_list){memcpy(p,&*it,8);p+=8;}size_t offset=file.size();file.resize(offset+4);p=file.data()+offset;pack_u32(p,crc32c(file.data(),offset));E true;}u64 pack_raw_max(){E block_pack_head_size+(u64)block_tx_limit*tx_pack_size;}u64 pack_size_max(){E pack_head_size+4+pack_block_count*(4+(u64)compressBound(pack_raw_max()));}bool pack_unpack(C u8*buf,size_t len,u32 pack_id,vector<Block> &block_list){if(len < pack_head_size+4)E 0;if(unpack_u32(buf+len-4)!=crc32c(buf,len-4))E 0;if(unpack_u32(buf)!=pack_magic||unpack_u32(buf+4)!=pack_version)E 0;if(unpack_u32(buf+8)!=pack_id*pack_block_count||unpack_u32(buf+12)!=pack_block_count)E 0;u64 offset_list[pack_block_count+1];memcpy(offset_list,buf+4*4,sizeof(offset_list));if(offset_list[0] !=pack_head_size||offset_list[pack_block_count] !=len-4)E 0;block_list.resize(pack_block_count);vector<u8> raw,full;for(u32 i=0;i<pack_block_count;i++){u64 from=offset_list[i],to=offset_list[i+1];if(to < from+4||to > len-4)E 0;uLongf raw_len=unpack_u32(buf+from);if(raw_len > pack_raw_max())E 0;raw.resize(raw_len);if(uncompress(raw.data(),&raw_len,buf+from+4,to-from-4)!=Z_OK)E 0;if(raw_len !=raw.size())E 0;if(!pack_block_restore(raw.data(),raw.size(),full))E 0;if(!block_unpack(full.data(),full.size(),block_list[i]))E 0;}E true;}u32 pack_ready_count(){lock_guard<mutex> guard(block_log.lock);u32 count=block_log.height_head ? block_log.height_head->count:0;E count < pack_finality ? 0:(count-pack_finality)/pack_block_count;}void pack_build_start(){u32 ready=pack_ready_count();u32 generation;{lock_guard<mutex> guard(pack_state.lock);if(pack_state.building||pack_state.count >=ready)E;pack_state.building=true;generation=pack_state.generation;}thread([ready,generation](){vector<u8> file;while(true){u32 pack_id;{lock_guard<mutex> guard(pack_state.lock);pack_id=pack_state.count;if(pack_id >=ready||pack_state.generation !=generation)break;}string path=pack_path(pack_id);if(!pack_build(pack_id,file)||!file_save_atomic(path,file.data(),file.size()))break;lock_guard<mutex> guard(pack_state.lock);if(pack_state.generation !=generation){unlink(pack_path(pack_id).c_str());break;}pack_state.count++;persist_dir_dirty();}lock_guard<mutex> guard(pack_state.lock);pack_state.building=0;}).detach();}void pack_scan(){u32 ready=pack_ready_count(),count=0;while(count < ready){string path=pack_path(count);if(!file_exists(path))break;count++;}{lock_guard<mutex> guard(pack_state.lock);pack_state.count=count;}pack_build_start();}void pack_drop_from(u32 height){lock_guard<mutex> guard(pack_state.lock);pack_state.generation++;while(pack_state.count && pack_state.count*pack_block_count > height){pack_state.count--;unlink(pack_path(pack_state.count).c_str());}}C u32 key_gen_bulk_chunk=256;bool key_gen_bulk(u32 count,vector<t_pub_key> &pub_key_list,vector<t_prv_key> &prv_key_list){pub_key_list.resize(count);prv_key_list.resize(count);ge_select_init();u32 chunk_count=(count+key_gen_bulk_chunk-1)/key_gen_bulk_chunk;vector<u8> chunk_ok(chunk_count,0);par_range(chunk_count,1,[&](u32 from,u32 to){vector<u8> seed_list(32*key_gen_bulk_chunk);for(u32 i=from;i<to;i++){u32 offset=i*key_gen_bulk_chunk;u32 len=min(key_gen_bulk_chunk,count-offset);if(ed25519_create_seeds(seed_list.data(),len))continue;if(ed25519_create_keypairs(pub_key_list[offset].b,prv_key_list[offset].b,seed_list.data(),len))continue;chunk_ok[i]=1;}memset(seed_list.data(),0,seed_list.size());});FOR_COL(it,chunk_ok){if(!*it)E 0;}E true;}void gms_init(){gms_account_new(my_pub_key);balance_set(0,1e6);Block block;block.header.id=0;block.header.version=block_version;block.header.issuer_addr=0;block.header.issuer_pub_key=my_pub_key;block.header.nonce=0;block_sign(block,my_pub_key,my_prv_key);block_weight_calc(block);if(!block_validate(block)){throw new Exception("block validation failed for our own block");}block_apply(block);gms.ready=true;}void snapshot_pack(vector<u8> &buf){u32 account_count=gms.a2pk.size();buf.resize(4*4+t_hash_size+account_count*(t_pub_key_size+4));u8*p=buf.data();pack_u32(p,snapshot_magic);pack_u32(p,snapshot_version);pack_u32(p,bc_height());pack_buf(p,gms.main_chain_block_list.back().header.hash.b,t_hash_size);pack_u32(p,account_count);FOR_COL(it,gms.a2pk)pack_buf(p,it->b,t_pub_key_size);for(u32 addr=0;addr<account_count;addr++)pack_u32(p,balance_get(addr));for(u32 i=0;i<=tx_epoch_window;i++){Replay_table*it=&gms.done_tx.table_list[i];size_t offset=buf.size();buf.resize(offset+4*3+it->slot_list.size()*sizeof(Replay_key));p=buf.data()+offset;pack_u32(p,it->tx_epoch);pack_u32(p,it->count);pack_u32(p,it->slot_list.size());pack_buf(p,(C u8*)it->slot_list.data(),it->slot_list.size()*sizeof(Replay_key));}size_t offset=buf.size();buf.resize(offset+4);p=buf.data()+offset;pack_u32(p,crc32c(buf.data(),offset));}bool snapshot_write(string path){vector<u8> buf;snapshot_pack(buf);E file_save_atomic(path,buf.data(),buf.size());}bool snapshot_poll(){if(!snapshot_pid)E true;int status;if(waitpid(snapshot_pid,&status,WNOHANG)==0)E 0;snapshot_pid=0;if(WIFEXITED(status)&& !WEXITSTATUS(status))persist_dir_dirty();E true;}void snapshot_start(){if(!snapshot_poll())E;if(!gms.main_chain_block_list.size())E;pid_t pid=fork();if(pid==0){_exit(snapshot_write(chain_path+"/snapshot.bin")? 0:1);}if(pid > 0)snapshot_pid=pid;}u32 snapshot_load(C string &path){FILE*fh=fopen(path.c_str(),"rb");if(!fh)E 0;vector<u8> buf;fseek(fh,0,SEEK_END);long len=ftell(fh);fseek(fh,0,SEEK_SET);if(len > 0){buf.resize(len);if(fread(buf.data(),1,len,fh)!=len)buf.clear();}fclose(fh);C u8*p=buf.data(),*end=p+buf.size();u32 head_size=4*4+t_hash_size;if(buf.size()< head_size+4)E 0;if(unpack_u32(end-4)!=crc32c(p,buf.size()-4))E 0;end-=4;if(unpack_u32(p)!=snapshot_magic||unpack_u32(p+4)!=snapshot_version)E 0;u32 height=unpack_u32(p+8);t_hash hash;memcpy(hash.b,p+12,t_hash_size);u32 account_count=unpack_u32(p+12+t_hash_size);p+=head_size;Block last;vector<u8> block_buf;if(!height||!block_log_read(height-1,block_buf))E 0;if(!block_unpack(block_buf.data(),block_buf.size(),last))E 0;if(last.header.hash !=hash)E 0;if(end-p <(I)account_count*(t_pub_key_size+4))E 0;gms.a2pk.resize(account_count);gms.B.resize(account_count);gms.demurrage_height=0;gms.balance_height.assign(account_count,0);FOR_COL(it,gms.a2pk){memcpy(it->b,p,t_pub_key_size);p+=t_pub_key_size;}FOR_COL(it,gms.B){*it=unpack_u32(p);p+=4;}for(u32 i=0;i<=tx_epoch_window;i++){Replay_table*it=&gms.done_tx.table_list[i];if(end-p < 4*3)E 0;it->tx_epoch=unpack_u32(p);it->count=unpack_u32(p+4);u32 capacity=unpack_u32(p+8);p+=4*3;if(capacity &(capacity-1)||2*(u64)it->count > capacity)E 0;if(end-p <(I)capacity*sizeof(Replay_key))E 0;it->slot_list.resize(capacity);memcpy(it->slot_list.data(),p,capacity*sizeof(Replay_key));p+=capacity*sizeof(Replay_key);}if(p !=end)E 0;E height;}void chain_state_reset(){gms.undo_list.clear();gms.a2pk.clear();gms.B.clear();gms.balance_height.clear();gms.demurrage_height=0;gms.done_tx=Replay_set();weight_index_rebuild();}bool chain_replay_block(u32 id,vector<u8> &buf,Block &block){if(!block_log_read(id,buf)||!block_unpack(buf.data(),buf.size(),block))E 0;if(id==0){gms_account_new(block.header.issuer_pub_key);balance_set(0,1e6);}block_state_apply(block);E true;}u32 chain_restore(){gms.undo_list.clear();u32 count;{lock_guard<mutex> guard(block_log.lock);count=block_log.height_head->count;}u32 height=snapshot_load(chain_path+"/snapshot.bin");if(!height||height > count){height=0;chain_state_reset();}weight_index_rebuild();vector<u8> buf;Block block;for(u32 id=height;id<count;id++){if(!chain_replay_block(id,buf,block)){block_log_truncate(id);count=id;break;}}lock_guard<mutex> guard(gms.main_chain_lock);gms.main_chain_block_list.clear();gms.main_chain_block_offset=count-min(count,main_chain_tail_size);for(u32 id=gms.main_chain_block_offset;id<count;id++){if(!block_log_read(id,buf)||!block_unpack(buf.data(),buf.size(),block))break;gms.main_chain_block_list.push_back(block);}if(bc_height()!=count){throw new Exception("block log tail read failed");}E count;}u32 state_crc(){vector<u8> buf;u32 account_count=gms.a2pk.size();buf.resize(4+account_count*(t_pub_key_size+4));u8*p=buf.data();pack_u32(p,account_count);FOR_COL(it,gms.a2pk)pack_buf(p,it->b,t_pub_key_size);for(u32 addr=0;addr<account_count;addr++)pack_u32(p,balance_get(addr));for(u32 i=0;i<=tx_epoch_window;i++){Replay_table &table=gms.done_tx.table_list[i];if(!table.count)continue;vector<Replay_key> key_list;FOR_COL(it,table.slot_list){if(!replay_key_empty(*it))key_list.push_back(*it);}sort(key_list.begin(),key_list.end(),[](C Replay_key &a,C Replay_key &b){E memcmp(a.b,b.b,replay_key_size)< 0;});u8 head[8];p=head;pack_u32(p,table.tx_epoch);pack_u32(p,table.count);buf.insert(buf.end(),head,head+8);buf.insert(buf.end(),(u8*)key_list.data(),(u8*)(key_list.data()+key_list.size()));}E crc32c(buf.data(),buf.size());}void demurrage_eager_apply(vector<u32> &B,Block &block,bool genesis){if(genesis)B.push_back(1e6);FOR_COL(it,block.tx_list){switch(it->type){case 1:B[it->send_addr]-=it->amount+tx_fee;B[it->recv_addr]+=it->amount;break;case 2:B[it->send_addr]-=tx_fee;break;}}B[block.header.issuer_addr]+=mining_reward+tx_fee*block.tx_list.size();FOR_COL(it,B){*it=*it > hot_potato_penalty ?*it-hot_potato_penalty:0;}B.push_back(0);}bool replay_check(){u32 count=bc_height();u32 live_crc=state_crc();vector<u32> eager;u32 eager_mismatch=0;vector<u8> buf;Block block;auto replay=[&](u32 thread_count,bool eager_check)-> bool{tx_apply_thread_count=thread_count;chain_state_reset();auto t0=chrono::steady_clock::now();for(u32 id=0;id<count;id++){if(!chain_replay_block(id,buf,block)){printf("replay check:block %u unreadable\n",id);E 0;}if(!eager_check)continue;demurrage_eager_apply(eager,block,id==0);auto check=[&](u32 addr){if(eager[addr] !=balance_get(addr))eager_mismatch++;};FOR_COL(it,block.tx_list){check(it->send_addr);check(it->recv_addr);}check(block.header.issuer_addr);}for(u32 addr=0;eager_check && addr<eager.size();addr++){if(eager[addr] !=balance_get(addr))eager_mismatch++;}auto t1=chrono::steady_clock::now();printf("replay check:%u blocks %u accounts,%u threads in %.0f ms\n",count,(u32)gms.a2pk.size(),thread_count,chrono::duration<double,milli>(t1-t0).count());E true;};bool ok=replay(1,true);u32 serial_crc=state_crc();ok=ok && replay(max(2u,thread::hardware_concurrency()),0);u32 par_crc=state_crc();tx_apply_thread_count=0;printf("replay check:eager demurrage mismatch %u\n",eager_mismatch);printf("replay check:state crc live %08x serial %08x sharded %08x\n",live_crc,serial_crc,par_crc);E ok && !eager_mismatch && serial_crc==live_crc && par_crc==live_crc;}bool chain_rollback(u32 count){if(count > gms.undo_list.size()||count >=bc_height())E 0;for(u32 i=0;i<count;i++){block_state_undo(gms.undo_list.back());gms.undo_list.pop_back();lock_guard<mutex> guard(gms.main_chain_lock);gms.main_chain_block_list.pop_back();if(gms.main_chain_block_list.empty()){vector<u8> buf;Block block;u32 id=gms.main_chain_block_offset-1;if(!block_log_read(id,buf)||!block_unpack(buf.data(),buf.size(),block)){throw new Exception("block log read failed");}gms.main_chain_block_list.push_back(block);gms.main_chain_block_offset--;}}block_log_truncate(bc_height());block_wire_cache_drop_from(bc_height());gms.is_proposal_valid=0;FOR_COL(it,gns.node_list){it->is_proposal_valid=0;}E true;}bool chain_fork_switch(u32 n,vector<Block> &branch){u32 fork_id=bc_height()-n;Block prev;if(!n||branch.empty()||branch.size()> undo_depth||!block_get(fork_id-1,prev))E 0;vector<Block> orphan_list(n);u64 local_weight=0,remote_weight=0;for(u32 i=0;i<n;i++){if(!block_get(fork_id+i,orphan_list[i]))E 0;block_weight_calc(orphan_list[i]);local_weight+=orphan_list[i].weight;}for(u32 i=0;i<branch.size();i++){Block_header &header=branch[i].header;if(header.id !=fork_id+i)E 0;if(header.prev_hash !=(i ? branch[i-1].header.hash:prev.header.hash))E 0;if(!block_header_sign_check(header))E 0;t_hash merkle_tree;merkle_tree_calc(branch[i],merkle_tree);if(merkle_tree !=header.merkle_tree)E 0;block_weight_calc(branch[i]);remote_weight+=branch[i].weight;}if(remote_weight <=local_weight)E 0;if(!chain_rollback(n))E 0;u32 applied=0;FOR_COL(it,branch){State_overlay overlay;if(!block_validate(*it,&overlay))break;block_apply(*it,&overlay);applied++;}if(applied < branch.size()){printf("fork at %u:peer block %u invalid,staying on ours\n",fork_id,fork_id+applied);chain_rollback(applied);FOR_COL(it,orphan_list){State_overlay overlay;if(!block_validate(*it,&overlay)){throw new Exception("fork restore failed");}block_apply(*it,&overlay);}E 0;}printf("fork at %u:%u blocks replaced with %u\n",fork_id,n,(u32)branch.size());FOR_COL(block,orphan_list){FOR_COL(it,block->tx_list){if(tx_validate(*it))mempool_push(*it);}}E true;}void proposed_block_replace(Block &block){if(!gms.is_proposal_valid||gms.proposed_block.header.hash > block.header.hash){gms.is_proposal_valid=true;gms.proposed_block=block;block_wire_proposal_set(block);block_broadcast();}}u64 mempool_tx_spend(Tx &tx){E tx.type==1 ?(u64)tx.amount+tx_fee:tx_fee;}void mempool_sender_resize(u32 sender,u32 old_size){auto &m=mempool;u32 size=m.sender_hash[sender].queue.size();if(old_size)m.sender_size.erase({old_size,sender});if(size){m.sender_size.insert({size,sender});}else{m.sender_hash.erase(sender);}}void mempool_remove(C string &key,bool from_front){auto &m=mempool;auto it=m.hash_index.find(key);Tx &tx=it->second.tx;u32 sender=tx.send_addr;auto &s=m.sender_hash[sender];u32 old_size=s.queue.size();if(from_front && s.queue.front()==key){s.queue.pop_front();}else if(s.queue.back()==key){s.queue.pop_back();}else{s.queue.erase(find(s.queue.begin(),s.queue.end(),key));}s.spend-=mempool_tx_spend(tx);m.hash_index.erase(it);m.byte_count-=mempool_tx_size;mempool_sender_resize(sender,old_size);}int mempool_push(Tx &tx){auto &m=mempool;lock_guard<mutex> guard(m.lock);string key((char*)tx.hash.b,t_hash_size);if(m.hash_index.count(key)){m.duplicate_count++;E 1;}auto &s=m.sender_hash[tx.send_addr];if(s.spend+mempool_tx_spend(tx)> balance_get(tx.send_addr)){m.spend_reject_count++;mempool_sender_resize(tx.send_addr,s.queue.size());E 2;}u32 old_size=s.queue.size();s.queue.push_back(key);s.spend+=mempool_tx_spend(tx);auto &entry=m.hash_index[key];entry.tx=tx;entry.tx.weight=hash2weight(tx.hash);entry.pub_key=overlay_a2pk_get(0,tx.send_addr);m.byte_count+=mempool_tx_size;mempool_sender_resize(tx.send_addr,old_size);m.push_count++;while(m.hash_index.size()> m.count_limit||m.byte_count > m.byte_limit){u32 sender=m.sender_size.rbegin()->second;string evict_key=m.sender_hash[sender].queue.back();mempool_remove(evict_key,0);m.evict_count++;if(evict_key==key)E 3;}E 0;}void mempool_block_remove(Block &block){auto &m=mempool;lock_guard<mutex> guard(m.lock);FOR_COL(it,block.tx_list){string key((char*)it->hash.b,t_hash_size);if(m.hash_index.count(key))mempool_remove(key,true);}}void mempool_tx_drop(Tx &tx){auto &m=mempool;lock_guard<mutex> guard(m.lock);string key((char*)tx.hash.b,t_hash_size);if(!m.hash_index.count(key))E;mempool_remove(key,0);m.drop_count++;}void mempool_pack(u32 limit,State_overlay &overlay,vector<Tx> &res){auto &m=mempool;lock_guard<mutex> guard(m.lock);auto t0=chrono::steady_clock::now();priority_queue<tuple<u64,u32,u32>>head_list;FOR_COL(it,m.sender_hash){head_list.push({m.hash_index[it->second.queue.front()].tx.weight,it->first,0});}vector<string> drop_list;while(res.size()< limit && !head_list.empty()){auto [weight,sender,pos]=head_list.top();head_list.pop();auto &queue=m.sender_hash[sender].queue;auto &entry=m.hash_index[queue[pos]];Tx &tx=entry.tx;bool ok=tx_validate(tx,0,&overlay);if(ok && overlay_a2pk_get(&overlay,tx.send_addr)!=entry.pub_key){ok=tx_validate(tx,true,&overlay);}if(ok){tx_apply(tx,overlay);res.push_back(tx);}else{drop_list.push_back(queue[pos]);}if(++pos < queue.size())head_list.push({m.hash_index[queue[pos]].tx.weight,sender,pos});}FOR_COL(it,drop_list){mempool_remove(*it,0);}m.drop_count+=drop_list.size();m.pack_count_last=res.size();m.pack_us_last=chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now()-t0).count();}void block_propose(){if(!gms.ready)E;auto last=gms.main_chain_block_list.back();Block block;block.header.id=last.header.id+1;block.header.version=block_version;block.header.prev_hash=last.header.hash;block.header.issuer_addr=my_primary_address;block.header.issuer_pub_key=my_pub_key;block.header.nonce=0;State_overlay overlay;overlay_init(overlay);mempool_pack(block_tx_limit,overlay,block.tx_list);merkle_tree_calc(block,block.header.merkle_tree);block_header_sign(block.header,my_pub_key,my_prv_key);block_weight_calc(block);if(!block_validate(block)){State_overlay check_overlay;overlay_init(check_overlay);u32 bad_count=0;FOR_COL(it,block.tx_list){if(tx_validate(*it,true,&check_overlay)){tx_apply(*it,check_overlay);}else{mempool_tx_drop(*it);bad_count++;}}printf("own block invalid,%u tx dropped from mempool\n",bad_count);if(!bad_count){throw new Exception("block validation failed for our own block");}E;}proposed_block_replace(block);}void rpc_bc_height(C Value &rq,Value &rs){rs=bc_height();}void rpc_get_node_list(C Value &rq,Value &rs){FOR_COL(it,gns.node_list){Value node;node["is_self"]=it->is_self;node["ip_port"]=it->ip_port;rs.append(node);}}void rpc_get_block_number(C Value &rq,Value &rs){I id=rq["id"].asInt();if(id < 0){rs="fail";E;}if(id >=bc_height()){rs="fail";E;}auto wire=block_wire_get(id);if(wire){rs=wire->json;E;}Block block;if(!block_get(id,block)){rs="fail";E;}block_to_json(block,rs);}void rpc_get_block_by_hash(C Value &rq,Value &rs){t_hash hash;u32 id;if(!str2t_hash(rq["hash"].asString(),hash)||!block_log_find(hash,id)){rs="fail";E;}Value param;param["id"]=id;rpc_get_block_number(param,rs);}void rpc_get_block_bin(C Value &rq,Value &rs){I id=rq["id"].asInt();if(id < 0||id >=bc_height()){rs="fail";E;}auto wire=block_wire_get(id);if(wire){rs=wire->bin;E;}Block block;if(main_chain_tail_get(id,block)){rs=block_to_hex(block);E;}vector<u8> buf;if(!block_log_read(id,buf)){rs="fail";E;}rs=buf2hex(buf.data(),buf.size());}void rpc_get_pack_info(C Value &rq,Value &rs){I id=rq["id"].asInt();u32 count;{lock_guard<mutex> guard(pack_state.lock);count=pack_state.count;}struct stat st;if(id < 0||id >=count||stat(pack_path(id).c_str(),&st)){rs="fail";E;}rs["id"]=(u32)id;rs["first_id"]=(u32)id*pack_block_count;rs["block_count"]=pack_block_count;rs["pack_count"]=count;rs["size"]=(u64)st.st_size;rs["port"]=RPC_PACK_PORT;}void rpc_get_weight_rank(C Value &rq,Value &rs){u32 A;if(!address_json_parse(rq["address"],A)){rs="fail";E;}auto &w=weight_index;lock_guard<mutex> guard(w.lock);if(A >=w.key_list.size()){rs="fail";E;}Weight_key key(w.key_list[A],A);rs["address"]=A;rs["weight"]=weight_from_key(key.first);rs["rank"]=(u32)w.tree.order_of_key(key)+1;rs["account_count"]=(u32)w.tree.size();}C u32 top_weights_limit=1000;void rpc_get_top_weights(C Value &rq,Value &rs){I count=rq["count"].asInt();if(count <=0||count > top_weights_limit){rs="fail";E;}auto &w=weight_index;lock_guard<mutex> guard(w.lock);rs=Value(arrayValue);for(auto it=w.tree.begin();it !=w.tree.end()&& count--;it++){Value item;item["address"]=it->second;item["weight"]=weight_from_key(it->first);rs.append(item);}}void rpc_get_tx_proof(C Value &rq,Value &rs){I id=rq["id"].asInt();Block block;if(id < 0||!block_get(id,block)){rs="fail";E;}t_hash hash;if(!str2t_hash(rq["hash"].asString(),hash)){rs="fail";E;}if(block.header.version < 2){rs="fail";E;}u32 idx=0,len=block.tx_list.size();while(idx < len && block.tx_list[idx].hash !=hash)idx++;if(idx==len){rs="fail";E;}Merkle_tree tree;merkle_tree_build(block.tx_list,tree);vector<t_hash> path;merkle_tree_proof(tree,idx,path);Tx &tx=block.tx_list[idx];Value json_tx;tx_to_json(tx,json_tx);Value json_path(arrayValue);FOR_COL(it,path){json_path.append(t_hash2str(*it));}rs["tx"]=json_tx;rs["tx_index"]=idx;rs["tx_count"]=len;rs["leaf"]=t_hash2str(tree.level_list[0][idx]);rs["path"]=json_path;rs["merkle_tree"]=t_hash2str(block.header.merkle_tree);}void rpc_tx_push(C Value &rq,Value &rs){Tx tx;tx.type=rq["type"].asInt();tx.amount=rq["amount"].asInt();if(!address_json_parse(rq["send_addr"],tx.send_addr)){rs="fail";E;}if(!address_json_parse(rq["recv_addr"],tx.recv_addr)){rs="fail";E;}if(!str2t_pub_key(rq["bind_pub_key"].asString(),tx.bind_pub_key)){rs="fail";E;}tx.tx_epoch=rq["tx_epoch"].asInt();tx.nonce=rq["nonce"].asInt();if(!str2t_hash(rq["hash"].asString(),tx.hash)){rs="fail";E;}if(!str2t_sign(rq["sign"].asString(),tx.sign)){rs="fail";E;}if(!tx_validate(tx)){rs="fail";E;}if(mempool_push(tx)){rs="fail";E;}}class LS:public AbstractServer<LS>{public:bool work=true;LS(ASC &c,sVt type=JSONRPC_SERVER_V2):AbstractServer<LS>(c,type){bM(Procedure("bc_height",PARAMS_BY_NAME,JSON_INTEGER,0),&LS::bc_heightI);bM(Procedure("get_node_list",PARAMS_BY_NAME,JSON_ARRAY,0),&LS::get_node_listI);bM(Procedure("get_balance",PARAMS_BY_NAME,JSON_INTEGER,"address",JS,0),&LS::B);bM(Procedure("transfer",PARAMS_BY_NAME,JS,"amount",JSON_INTEGER,"from_address",JS,"to_address",JS,0),&LS::transferI);bM(Procedure("address_transfer",PARAMS_BY_NAME,JS,"address",JS,"pub_key",JS,0),&LS::address_transferI);bM(Procedure("shutdown",PARAMS_BY_NAME,JS,0),&LS::shutdownI);bM(Procedure("set_tx_mining_mode",PARAMS_BY_NAME,JS,"enabled",JSON_INTEGER,0),&LS::set_tx_mining_modeI);bM(Procedure("get_tx_mining_mode",PARAMS_BY_NAME,JSON_INTEGER,0),&LS::get_tx_mining_modeI);bM(Procedure("get_my_weight",PARAMS_BY_NAME,JSON_INTEGER,0),&LS::get_my_weightI);bM(Procedure("debug_set_key",PARAMS_BY_NAME,JS,"address",JS,"pub_key",JS,"prv_key",JS,0),&LS::debug_set_keyI);bM(Procedure("debug_key_gen",PARAMS_BY_NAME,JS,0),&LS::debug_key_genI);bM(Procedure("debug_key_gen_bulk",PARAMS_BY_NAME,JSON_ARRAY,"count",JSON_INTEGER,0),&LS::debug_key_gen_bulkI);bM(Procedure("debug_verify_bench",PARAMS_BY_NAME,JSON_OBJECT,"count",JSON_INTEGER,0),&LS::debug_verify_benchI);bM(Procedure("debug_chain_rollback",PARAMS_BY_NAME,JSON_OBJECT,"count",JSON_INTEGER,0),&LS::debug_chain_rollbackI);bM(Procedure("get_persist_stats",PARAMS_BY_NAME,JSON_OBJECT,0),&LS::get_persist_statsI);bM(Procedure("get_mempool_stats",PARAMS_BY_NAME,JSON_OBJECT,0),&LS::get_mempool_statsI);}void bc_heightI(C Value &rq,Value &rs){rpc_bc_height(rq,rs);}void get_node_listI(C Value &rq,Value &rs){rpc_get_node_list(rq,rs);}void B(C Value &rq,Value &rs){u32 A;if(!address_json_parse(rq["address"],A)){rs=0;E;}if(A >=gms.B.size()){rs=0;E;}rs=balance_get(A);}void shutdownI(C Value &rq,Value &rs){printf("shutdown scheduled\n");work=0;rs="ok";}void set_tx_mining_modeI(C Value &rq,Value &rs){tx_mining_mode=rq["enabled"].asInt();rs="ok";}void get_tx_mining_modeI(C Value &rq,Value &rs){rs=tx_mining_mode;}void get_my_weightI(C Value &rq,Value &rs){auto &w=weight_index;lock_guard<mutex> guard(w.lock);if(my_primary_address >=w.key_list.size()){rs=0;E;}rs=weight_from_key(w.key_list[my_primary_address]);}void get_persist_statsI(C Value &rq,Value &rs){lock_guard<mutex> guard(persist.lock);u64 block_count=persist.seq_durable;rs["durability"]=durability;rs["commit_count"]=persist.commit_count;rs["block_count"]=block_count;rs["pending"]=persist.seq_appended-persist.seq_durable;rs["batch_avg"]=persist.commit_count ?(double)block_count/persist.commit_count:0.0;rs["batch_max"]=persist.batch_max;rs["latency_avg_us"]=block_count ? persist.latency_sum_us/block_count:0;rs["latency_max_us"]=persist.latency_max_us;rs["latency_last_us"]=persist.latency_last_us;}void get_mempool_statsI(C Value &rq,Value &rs){lock_guard<mutex> guard(mempool.lock);rs["count"]=(u64)mempool.hash_index.size();rs["bytes"]=mempool.byte_count;rs["sender_count"]=(u64)mempool.sender_hash.size();rs["count_limit"]=mempool.count_limit;rs["byte_limit"]=mempool.byte_limit;rs["push_count"]=mempool.push_count;rs["duplicate_count"]=mempool.duplicate_count;rs["spend_reject_count"]=mempool.spend_reject_count;rs["evict_count"]=mempool.evict_count;rs["drop_count"]=mempool.drop_count;rs["pack_count_last"]=mempool.pack_count_last;rs["pack_us_last"]=mempool.pack_us_last;rs["block_tx_limit"]=block_tx_limit;}void transferI(C Value &rq,Value &rs){u32 amount=rq["amount"].asInt();u32 fA;if(!address_json_parse(rq["from_address"],fA)){rs="fail";E;}if(fA >=gms.B.size()){rs="fail";E;}u32 tA;if(!address_json_parse(rq["to_address"],tA)){rs="fail";E;}if(tA >=gms.B.size()){rs="fail";E;}if(gms.a2pk[fA] !=my_pub_key){rs="fail";E;}if(balance_get(fA)< max(amount,amount+tx_fee)){rs="fail";E;}Tx tx;tx.type=1;tx.amount=amount;tx.send_addr=fA;tx.recv_addr=tA;tx.tx_epoch=tx_epoch_now();tx.nonce=0;tx_sign(tx,my_pub_key,my_prv_key);if(!tx_validate(tx)){printf("tx_validate_reason=%d\n",tx_validate_reason);rs="fail";E;}printf("tx transfer %d coin %d-> %d\n",amount,fA,tA);if(mempool_push(tx)){rs="fail";E;}rs="ok";}void address_transferI(C Value &rq,Value &rs){u32 A;if(!address_json_parse(rq["address"],A)){rs="fail";E;}if(A >=gms.a2pk.size()){rs="fail";E;}if(gms.a2pk[A] !=my_pub_key){printf("you don't own address %d\n",A);t_pub_key_print("my_pub_key=",my_pub_key);t_pub_key_print("gms.a2pk[address]=",gms.a2pk[A]);rs="fail";E;}string hex_pub_key=rq["pub_key"].asString();if(hex_pub_key.size()!=2*t_pub_key_size){rs="fail";E;}Tx tx;if(!str2t_pub_key(hex_pub_key,tx.bind_pub_key)){rs="fail";E;}tx.type=2;tx.amount=0;tx.send_addr=my_primary_address;tx.recv_addr=A;tx.tx_epoch=tx_epoch_now();tx.nonce=0;tx_sign(tx,my_pub_key,my_prv_key);if(!tx_validate(tx)){printf("tx_validate_reason=%d\n",tx_validate_reason);rs="fail";E;}printf("address transfer owner=%d address=%d pub_key=%s\n",my_primary_address,A,hex_pub_key.c_str());if(mempool_push(tx)){rs="fail";E;}rs="ok";}void debug_set_keyI(C Value &rq,Value &rs){u32 A;if(!address_json_parse(rq["address"],A)){rs="fail";E;}if(A >=gms.B.size()){rs="fail";E;}string hex_pub_key=rq["pub_key"].asString();if(hex_pub_key.size()!=2*t_pub_key_size){rs="fail";E;}string hex_prv_key=rq["prv_key"].asString();if(hex_prv_key.size()!=2*t_prv_key_size){rs="fail";E;}t_pub_key pub_key;t_prv_key prv_key;if(!str2t_pub_key(hex_pub_key,pub_key)){rs="fail";E;}if(!str2t_prv_key(hex_prv_key,prv_key)){rs="fail";E;}if(gms.a2pk[A] !=pub_key){printf("debug_set_keyI %d\n",A);t_pub_key_print("pub_key=",pub_key);t_pub_key_print("gms.a2pk[address]=",gms.a2pk[A]);rs="fail";E;}my_primary_address=A;my_pub_key=pub_key;my_prv_key=prv_key;t_pub_key_print("my_pub_key=",my_pub_key);t_prv_key_print("my_prv_key=",my_prv_key);rs="ok";}void debug_key_genI(C Value &rq,Value &rs){t_pub_key pub_key;t_prv_key prv_key;if(!key_gen(pub_key,prv_key)){rs="fail";E;}t_pub_key_print("pub_key=",pub_key);t_prv_key_print("prv_key=",prv_key);rs["pub_key"]=t_pub_key2str(pub_key);rs["prv_key"]=t_prv_key2str(prv_key);}void debug_key_gen_bulkI(C Value &rq,Value &rs){u32 count=rq["count"].asInt();if(count==0||count > 100000){rs="fail";E;}vector<t_pub_key> pub_key_list;vector<t_prv_key> prv_key_list;if(!key_gen_bulk(count,pub_key_list,prv_key_list)){rs="fail";E;}rs=Value(arrayValue);for(u32 i=0;i<count;i++){Value key;key["pub_key"]=t_pub_key2str(pub_key_list[i]);key["prv_key"]=t_prv_key2str(prv_key_list[i]);rs.append(key);}}void debug_verify_benchI(C Value &rq,Value &rs){u32 count=rq["count"].asInt();if(count==0||count > 100000){rs="fail";E;}ed25519_verify_context ctx;if(!ed25519_verify_context_init(&ctx,my_pub_key.b)){rs="fail";E;}C u32 scalar_count=64;u8 a[scalar_count][64],b[scalar_count][64];for(u32 i=0;i<scalar_count;i++){ed25519_create_seed(a[i]);ed25519_create_seed(a[i]+32);ed25519_create_seed(b[i]);ed25519_create_seed(b[i]+32);sc_reduce(a[i]);sc_reduce(b[i]);}ge_p2 r;u8 res_narrow[32],res_wide[32];auto t0=chrono::steady_clock::now();for(u32 i=0;i<count;i++){ge_double_scalarmult_table_vartime(&r,a[i%scalar_count],ctx.Ai,b[i%scalar_count],Bi,5);}ge_tobytes(res_narrow,&r);auto t1=chrono::steady_clock::now();for(u32 i=0;i<count;i++){ge_double_scalarmult_cached_vartime(&r,a[i%scalar_count],ctx.Ai,b[i%scalar_count]);}ge_tobytes(res_wide,&r);auto t2=chrono::steady_clock::now();rs["width"]=ge_base_wide_width();rs["narrow_us"]=chrono::duration<double,micro>(t1-t0).count()/count;rs["wide_us"]=chrono::duration<double,micro>(t2-t1).count()/count;rs["match"]=!memcmp(res_narrow,res_wide,32);rs["select_avx2"]=ge_select_init();rs["select_mismatch"]=ge_select_check();}void debug_chain_rollbackI(C Value &rq,Value &rs){u32 count=rq["count"].asInt();auto t0=chrono::steady_clock::now();if(!chain_rollback(count)){rs="fail";E;}auto t1=chrono::steady_clock::now();rs["bc_height"]=bc_height();rs["undo_us"]=chrono::duration<double,micro>(t1-t0).count();}};class GS:public AbstractServer<GS>{public:bool work=true;GS(ASC &c,sVt type=JSONRPC_SERVER_V2):AbstractServer<GS>(c,type){bM(Procedure("bc_height",PARAMS_BY_NAME,JSON_INTEGER,0),&GS::bc_heightI);bM(Procedure("get_node_list",PARAMS_BY_NAME,JSON_ARRAY,0),&GS::get_node_listI);bM(Procedure("get_block_number",PARAMS_BY_NAME,JSON_OBJECT,0),&GS::get_block_numberI);bM(Procedure("get_block_bin",PARAMS_BY_NAME,JS,"id",JSON_INTEGER,0),&GS::get_block_binI);bM(Procedure("get_block_by_hash",PARAMS_BY_NAME,JSON_OBJECT,"hash",JS,0),&GS::get_block_by_hashI);bM(Procedure("get_pack_info",PARAMS_BY_NAME,JSON_OBJECT,"id",JSON_INTEGER,0),&GS::get_pack_infoI);bM(Procedure("get_weight_rank",PARAMS_BY_NAME,JSON_OBJECT,"address",JS,0),&GS::get_weight_rankI);bM(Procedure("get_top_weights",PARAMS_BY_NAME,JSON_ARRAY,"count",JSON_INTEGER,0),&GS::get_top_weightsI);bM(Procedure("get_tx_proof",PARAMS_BY_NAME,JSON_OBJECT,"id",JSON_INTEGER,"hash",JS,0),&GS::get_tx_proofI);bM(Procedure("tx_push",PARAMS_BY_NAME,JSON_OBJECT,"type",JSON_INTEGER,"amount",JSON_INTEGER,"send_addr",JS,"recv_addr",JS,"bind_pub_key",JS,"tx_epoch",JSON_INTEGER,"nonce",JSON_INTEGER,"hash",JS,"sign",JS,0),&GS::tx_pushI);bM(Procedure("handshake",PARAMS_BY_NAME,JS,"rev_ip_port",JS,0),&GS::handshakeI);bM(Procedure("get_proposed_block",PARAMS_BY_NAME,JSON_OBJECT,0),&GS::get_proposed_blockI);bM(Procedure("get_proposed_block_bin",PARAMS_BY_NAME,JS,0),&GS::get_proposed_block_binI);bM(Procedure("proposed_block_push",PARAMS_BY_NAME,JS,"header",JSON_OBJECT,"tx_list",JSON_ARRAY,"hash",JS,"sign",JS,0),&GS::proposed_block_pushI);bM(Procedure("get_balance",PARAMS_BY_NAME,JSON_INTEGER,"address",JS,0),&GS::B);bM(Procedure("transfer",PARAMS_BY_NAME,JS,"amount",JSON_INTEGER,"from_address",JS,"to_address",JS,0),&GS::transferI);bM(Procedure("address_transfer",PARAMS_BY_NAME,JS,"address",JS,"pub_key",JS,0),&GS::address_transferI);}void bc_heightI(C Value &rq,Value &rs){rpc_bc_height(rq,rs);}void get_node_listI(C Value &rq,Value &rs){rpc_get_node_list(rq,rs);}void get_block_numberI(C Value &rq,Value &rs){rpc_get_block_number(rq,rs);}void get_block_binI(C Value &rq,Value &rs){rpc_get_block_bin(rq,rs);}void get_block_by_hashI(C Value &rq,Value &rs){rpc_get_block_by_hash(rq,rs);}void get_pack_infoI(C Value &rq,Value &rs){rpc_get_pack_info(rq,rs);}void get_weight_rankI(C Value &rq,Value &rs){rpc_get_weight_rank(rq,rs);}void get_top_weightsI(C Value &rq,Value &rs){rpc_get_top_weights(rq,rs);}void get_tx_proofI(C Value &rq,Value &rs){rpc_get_tx_proof(rq,rs);}void tx_pushI(C Value &rq,Value &rs){rpc_tx_push(rq,rs);}void handshakeI(C Value &rq,Value &rs){string rev_ip_port=rq["rev_ip_port"].asString();if(rev_ip_port.size()> 100){rs="fail";E;}auto end=gns.node_list.end();bool found=0;FOR_COL(it,gns.node_list){if(it->ip_port==rev_ip_port){found=true;break;}}if(!found){NetNode node;node.ip_port=rev_ip_port;gns.node_list.push_back(node);}rs="ok";}void get_proposed_blockI(C Value &rq,Value &rs){auto wire=block_wire_proposal_get();if(wire){rs=wire->json;E;}block_to_json(gms.proposed_block,rs);}void get_proposed_block_binI(C Value &rq,Value &rs){auto wire=block_wire_proposal_get();if(wire){rs=wire->bin;E;}rs=block_to_hex(gms.proposed_block);}void proposed_block_pushI(C Value &rq,Value &rs){Block block;if(!json_to_block(rq,block)){rs="fail";E;}proposed_block_replace(block);rs="ok";}void B(C Value &rq,Value &rs){u32 A;if(!address_json_parse(rq["address"],A)){rs=0;E;}if(A >=gms.B.size()){rs=0;E;}rs=balance_get(A);}void transferI(C Value &rq,Value &rs){u32 amount=rq["amount"].asInt();u32 fA;if(!address_json_parse(rq["from_address"],fA)){rs="fail";E;}if(fA >=gms.B.size()){rs="fail";E;}u32 tA;if(!address_json_parse(rq["to_address"],tA)){rs="fail";E;}if(tA >=gms.B.size()){rs="fail";E;}if(gms.a2pk[fA] !=my_pub_key){rs="fail";E;}if(balance_get(fA)< max(amount,amount+tx_fee)){rs="fail";E;}Tx tx;tx.type=1;tx.amount=amount;tx.send_addr=fA;tx.recv_addr=tA;tx.tx_epoch=tx_epoch_now();tx.nonce=0;tx_sign(tx,my_pub_key,my_prv_key);if(!tx_validate(tx)){printf("tx_validate_reason=%d\n",tx_validate_reason);rs="fail";E;}printf("tx transfer %d coin %d-> %d\n",amount,fA,tA);if(mempool_push(tx)){rs="fail";E;}rs="ok";}void address_transferI(C Value &rq,Value &rs){u32 A;if(!address_json_parse(rq["address"],A)){rs="fail";E;}if(A >=gms.a2pk.size()){rs="fail";E;}if(gms.a2pk[A] !=my_pub_key){printf("you don't own address %d\n",A);t_pub_key_print("my_pub_key=",my_pub_key);t_pub_key_print("gms.a2pk[address]=",gms.a2pk[A]);rs="fail";E;}Tx tx;tx.type=2;tx.amount=0;tx.send_addr=my_primary_address;tx.recv_addr=A;string pub_key=rq["pub_key"].asString();if(!str2t_pub_key(pub_key,tx.bind_pub_key)){rs="fail";E;}tx.tx_epoch=tx_epoch_now();tx.nonce=0;tx_sign(tx,my_pub_key,my_prv_key);if(!tx_validate(tx)){printf("tx_validate_reason=%d\n",tx_validate_reason);rs="fail";E;}printf("address transfer owner=%d address=%d pub_key=%s\n",my_primary_address,A,pub_key.c_str());if(mempool_push(tx)){rs="fail";E;}rs="ok";}};
 #define throw(...)
 #include <jsonrpccpp/client.h>
 #include <jsonrpccpp/client/connectors/httpclient.h>
 #undef throw
 u32 pseudo_broadcast_limit=1;// DEBUG
-void net_ask_con(NetNode &node){try{HttpClient c1(node.ip_port);Client c(c1);Value params;params["rev_ip_port"]=gns.node_list[0].ip_port;c.CallMethod("handshake",params);Value res=c.CallMethod("get_node_list",nullValue);for(u32 i=0,len=res.size();i<len;i++){NetNode node;Value val=res[i];node.ip_port=val["ip_port"].asString();bool found=0;FOR_COL(it,gns.node_list){if(it->ip_port==node.ip_port){found=true;break;}}if(!found){gns.node_list.push_back(node);}}u32 remote_bc_height=c.CallMethod("bc_height",nullValue).asInt();u32 bh=bc_height();u32 limit=40;if(!gms.ready && remote_bc_height==bh){gms.ready=true;}else{while(remote_bc_height > bh && limit--){gms.target_bc_height=remote_bc_height;Value param;param["id"]=bh;Value json_block=c.CallMethod("get_block_number",param);Block tmp;if(!json_to_block(json_block,tmp))E;if(!block_validate(tmp))E;if(bh==0){gms_account_new(tmp.header.issuer_pub_key);gms.B[0]=1e6;}block_apply(tmp);bh++;}E;}{Value json_block=c.CallMethod("get_proposed_block",nullValue);Block tmp;if(!json_to_block(json_block,tmp)){node.is_proposal_valid=0;E;}node.is_proposal_valid=block_validate(tmp);if(!node.is_proposal_valid){E;}proposed_block_replace(tmp);}}catch(...){}}void net_broadcast_con(NetNode &node){try{HttpClient c1(node.ip_port);Client c(c1);Value json_block;c.CallMethod("block_push",json_block);}catch(...){}}void block_broadcast(){for(int i=0;i<pseudo_broadcast_limit;i++){gns.broadcast_offset=(gns.broadcast_offset+1)%gns.node_list.size();u32 idx=0;FOR_COL(it,gns.node_list){if(it->is_self)continue;if(idx++==gns.broadcast_offset){net_broadcast_con(*it);break;}}}}void net_tick(){for(int i=0;i<pseudo_broadcast_limit;i++){gns.ask_offset=(gns.ask_offset+1)%gns.node_list.size();u32 idx=0;FOR_COL(it,gns.node_list){if(it->is_self)continue;if(idx++==gns.ask_offset){net_ask_con(*it);break;}}}}int main(int argc,char**argv){LOOKT_write_lookup_table_to_flash();int option_index=0;static struct option long_options[]={{"rpc_pub_port",1,0,0},{"rpc_prv_port",1,0,0},{"seed_ip_port",1,0,0},{"pub_key_path",1,0,0},{"prv_key_path",1,0,0},{"drop_keys",0,0,0},{0,0,0,0}};bool drop_keys=0;while(1){int c=getopt_long(argc,argv,"",long_options,&option_index);if(c==-1)break;switch(option_index){case 0:RPC_PUB_PORT=atoi(optarg);break;case 1:RPC_PRV_PORT=atoi(optarg);break;case 2:seed_ip_port=optarg;break;case 3:pub_key_path=optarg;break;case 4:prv_key_path=optarg;break;case 5:drop_keys=true;break;}}if(drop_keys){printf("drop keys\n");remove(pub_key_path.c_str());remove(prv_key_path.c_str());}{struct ifaddrs*ifAddrStruct=0;struct ifaddrs*ifa=0;void*tmpAddrPtr=0;getifaddrs(&ifAddrStruct);for(ifa=ifAddrStruct;ifa !=0;ifa=ifa->ifa_next){if(!ifa->ifa_addr){continue;}if(ifa->ifa_addr->sa_family==AF_INET){// check it is IP4
-tmpAddrPtr=&((struct sockaddr_in*)ifa->ifa_addr)->sin_addr;char addressBuffer[INET_ADDRSTRLEN];inet_ntop(AF_INET,tmpAddrPtr,addressBuffer,INET_ADDRSTRLEN);if(!strcmp(addressBuffer,"127.0.0.1"))continue;printf("%s IP Address %s\n",ifa->ifa_name,addressBuffer);string addr_port="http://";addr_port+=addressBuffer;addr_port+=":";addr_port+=to_string(RPC_PUB_PORT);NetNode node;node.is_self=true;node.ip_port=addr_port;gns.node_list.push_back(node);}}if(ifAddrStruct!=0)freeifaddrs(ifAddrStruct);}FOR_COL(it,gns.node_list){if(it->ip_port==seed_ip_port){i_am_seed_node=true;}}bool pub_exists=file_exists(pub_key_path);bool prv_exists=file_exists(prv_key_path);if(pub_exists && prv_exists){printf("load keys\n");if(!file_load(pub_key_path,my_pub_key.b,t_pub_key_size)){printf("failed to load pub key\n");E 1;}if(!file_load(prv_key_path,my_prv_key.b,t_prv_key_size)){printf("failed to load prv key\n");E 1;}}else if(!pub_exists && !prv_exists){printf("generate keys\n");if(!key_gen(my_pub_key,my_prv_key)){printf("error while generating keypair");E 1;}printf("save keys\n");if(!file_save(pub_key_path,my_pub_key.b,t_pub_key_size)){printf("failed to save pub key\n");E 1;}if(!file_save(prv_key_path,my_prv_key.b,t_prv_key_size)){printf("failed to save prv key\n");E 1;}}else{printf("invalid situation\n");printf("pub_key %s\n",pub_exists?"present":"missing");printf("prv_key %s\n",prv_exists?"present":"missing");E 1;}if(i_am_seed_node){gms_init();}else{NetNode node;node.ip_port=seed_ip_port;gns.node_list.push_back(node);}HttpServer hs1(RPC_PRV_PORT);LS s1(hs1,JSONRPC_SERVER_V1V2);HttpServer hs2(RPC_PUB_PORT);GS s2(hs2,JSONRPC_SERVER_V1V2);s1.StartListening();s2.StartListening();printf("pub server port %d\n",RPC_PUB_PORT);printf("prv server port %d\n",RPC_PRV_PORT);printf("seed_ip_port___ %s\n",seed_ip_port.c_str());printf("i_am_seed_node_ %d\n",i_am_seed_node);printf("welcome to UTON HACK!\n");u32 last_bc=0;while(s1.work){net_tick();if(!gms.ready){u32 new_bc=bc_height();if(last_bc==new_bc){this_thread::sleep_for(chrono::milliseconds(1000));}else{last_bc=new_bc;this_thread::sleep_for(chrono::milliseconds(1));}printf("node is not ready bc_height=%d / %d\n",bc_height(),gms.target_bc_height);}else{block_propose();for(int i=0;i<5;i++){net_tick();this_thread::sleep_for(chrono::milliseconds(20));}printf("new block %d\n",gms.proposed_block.header.id);if(!gms.is_proposal_valid){throw new Exception("bad assert gms.is_proposal_valid");}block_apply(gms.proposed_block);gms.is_proposal_valid=0;}}s1.StopListening();s2.StopListening();E 0;}
\ No newline at end of file
+void socket_timeout_set(int fd,u32 sec){struct timeval tv={0};tv.tv_sec=sec;setsockopt(fd,SOL_SOCKET,SO_RCVTIMEO,&tv,sizeof(tv));setsockopt(fd,SOL_SOCKET,SO_SNDTIMEO,&tv,sizeof(tv));}void pack_serve_con(int fd){char req[256];u32 len=0;while(len < sizeof(req)-1){ssize_t n=read(fd,req+len,sizeof(req)-1-len);if(n <=0)break;len+=n;req[len]=0;if(strstr(req,"\r\n\r\n"))break;}req[len]=0;u32 pack_id;int file_fd=-1;if(sscanf(req,"GET /pack/%u ",&pack_id)==1){lock_guard<mutex> guard(pack_state.lock);if(pack_id < pack_state.count)file_fd=open(pack_path(pack_id).c_str(),O_RDONLY);}struct stat st;if(file_fd < 0||fstat(file_fd,&st)){C char*res="HTTP/1.0 404 Not Found\r\nContent-Length:0\r\n\r\n";write(fd,res,strlen(res));}else{string head="HTTP/1.0 200 OK\r\nContent-Type:application/octet-stream\r\nContent-Length:"+to_string(st.st_size)+"\r\n\r\n";off_t offset=0;if(write(fd,head.data(),head.size())==head.size()){while(offset < st.st_size && sendfile(fd,file_fd,&offset,st.st_size-offset)> 0);}}if(file_fd >=0)close(file_fd);close(fd);}void pack_server(){int fd=socket(AF_INET,SOCK_STREAM,0);if(fd < 0)E;int one=1;setsockopt(fd,SOL_SOCKET,SO_REUSEADDR,&one,sizeof(one));struct sockaddr_in addr={0};addr.sin_family=AF_INET;addr.sin_addr.s_addr=htonl(INADDR_ANY);addr.sin_port=htons(RPC_PACK_PORT);if(bind(fd,(struct sockaddr*)&addr,sizeof(addr))||listen(fd,16)){printf("pack server failed on port %d\n",RPC_PACK_PORT);close(fd);E;}static atomic<u32> con_count(0);while(true){int con=accept(fd,0,0);if(con < 0)continue;if(con_count >=pack_con_limit){close(con);continue;}socket_timeout_set(con,pack_io_timeout_sec);con_count++;thread([con](){pack_serve_con(con);con_count--;}).detach();}}bool pack_fetch(C string &ip_port,u32 port,u32 pack_id,vector<u8> &buf){size_t from=ip_port.find("//"),to=ip_port.rfind(':');if(from==string::npos||to==string::npos||to < from)E 0;string host=ip_port.substr(from+2,to-from-2);struct sockaddr_in addr={0};addr.sin_family=AF_INET;addr.sin_port=htons(port);if(inet_pton(AF_INET,host.c_str(),&addr.sin_addr)!=1)E 0;int fd=socket(AF_INET,SOCK_STREAM,0);if(fd < 0)E 0;socket_timeout_set(fd,pack_io_timeout_sec);string req="GET /pack/"+to_string(pack_id)+" HTTP/1.0\r\n\r\n";if(connect(fd,(struct sockaddr*)&addr,sizeof(addr))||write(fd,req.data(),req.size())!=req.size()){close(fd);E 0;}string head;size_t body=string::npos;char chunk[1<<16];ssize_t n;while(body==string::npos && head.size()< 4096 &&(n=read(fd,chunk,sizeof(chunk)))> 0){head.append(chunk,n);body=head.find("\r\n\r\n");}size_t field=head.find("Content-Length:");bool res=body !=string::npos && !head.compare(0,12,"HTTP/1.0 200")&& field < body;u64 size=res ? strtoull(head.c_str()+field+15,0,10):0;res=res && size && size <=pack_size_max()&& head.size()-body-4 <=size;if(res){buf.assign(head.begin()+body+4,head.end());size_t len=buf.size();buf.resize(size);while(len < size &&(n=read(fd,buf.data()+len,size-len))> 0)len+=n;res=len==size;}close(fd);E res;}bool net_block_apply(Block &block){State_overlay overlay;if(!block_validate(block,&overlay))E 0;if(bc_height()==0){gms_account_new(block.header.issuer_pub_key);balance_set(0,1e6);}block_apply(block,&overlay);E true;}void net_ask_con(NetNode &node){try{HttpClient c1(node.ip_port);Client c(c1);Value params;params["rev_ip_port"]=gns.node_list[0].ip_port;c.CallMethod("handshake",params);Value res=c.CallMethod("get_node_list",nullValue);for(u32 i=0,len=res.size();i<len;i++){NetNode node;Value val=res[i];node.ip_port=val["ip_port"].asString();bool found=0;FOR_COL(it,gns.node_list){if(it->ip_port==node.ip_port){found=true;break;}}if(!found){gns.node_list.push_back(node);}}u32 remote_bc_height=c.CallMethod("bc_height",nullValue).asInt();u32 bh=bc_height();u32 limit=40;if(!gms.ready && remote_bc_height==bh){gms.ready=true;}else{if(gms.ready && remote_bc_height > bh && bh > 1){u32 n=0;while(true){Value param;param["id"]=bh-1-n;Block remote_block,local_block;if(!hex_to_block(c.CallMethod("get_block_bin",param).asString(),remote_block))E;if(!block_get(bh-1-n,local_block))E;if(!(remote_block.header.hash !=local_block.header.hash))break;if(++n > gms.undo_list.size()||n >=bh)E;}if(n){u32 fork_id=bh-n;u32 count=min(remote_bc_height-fork_id,undo_depth);vector<Block> branch(count);for(u32 i=0;i<count;i++){Value param;param["id"]=fork_id+i;if(!hex_to_block(c.CallMethod("get_block_bin",param).asString(),branch[i]))E;}if(!chain_fork_switch(n,branch))E;bh=bc_height();}}while(bh % pack_block_count==0 && remote_bc_height >=bh+pack_block_count+pack_finality){Value param;param["id"]=bh / pack_block_count;Value info=c.CallMethod("get_pack_info",param);if(!info.isObject())break;vector<u8> buf;vector<Block> block_list;if(!pack_fetch(node.ip_port,info["port"].asUInt(),bh / pack_block_count,buf))break;if(!pack_unpack(buf.data(),buf.size(),bh / pack_block_count,block_list))break;gms.target_bc_height=remote_bc_height;FOR_COL(it,block_list){if(!net_block_apply(*it))E;bh++;}}while(remote_bc_height > bh && limit--){gms.target_bc_height=remote_bc_height;Value param;param["id"]=bh;Value bin_block=c.CallMethod("get_block_bin",param);Block tmp;if(!hex_to_block(bin_block.asString(),tmp))E;if(!net_block_apply(tmp))E;bh++;}E;}{Value bin_block=c.CallMethod("get_proposed_block_bin",nullValue);Block tmp;if(!hex_to_block(bin_block.asString(),tmp)){node.is_proposal_valid=0;E;}node.is_proposal_valid=block_validate(tmp);if(!node.is_proposal_valid){E;}proposed_block_replace(tmp);}}catch(...){}}void net_broadcast_con(NetNode &node){try{HttpClient c1(node.ip_port);Client c(c1);Value json_block;c.CallMethod("block_push",json_block);}catch(...){}}void block_broadcast(){for(int i=0;i<pseudo_broadcast_limit;i++){gns.broadcast_offset=(gns.broadcast_offset+1)%gns.node_list.size();u32 idx=0;FOR_COL(it,gns.node_list){if(it->is_self)continue;if(idx++==gns.broadcast_offset){net_broadcast_con(*it);break;}}}}void net_tick(){for(int i=0;i<pseudo_broadcast_limit;i++){gns.ask_offset=(gns.ask_offset+1)%gns.node_list.size();u32 idx=0;FOR_COL(it,gns.node_list){if(it->is_self)continue;if(idx++==gns.ask_offset){net_ask_con(*it);break;}}}}int main(int argc,char**argv){LOOKT_write_lookup_table_to_flash();int option_index=0;static struct option long_options[]={{"rpc_pub_port",1,0,0},{"rpc_prv_port",1,0,0},{"seed_ip_port",1,0,0},{"pub_key_path",1,0,0},{"prv_key_path",1,0,0},{"drop_keys",0,0,0},{"verify_table_kb",1,0,0},{"block_cache_mb",1,0,0},{"chain_path",1,0,0},{"block_tail",1,0,0},{"snapshot_interval",1,0,0},{"rpc_pack_port",1,0,0},{"durability",1,0,0},{"mempool_mb",1,0,0},{"mempool_tx",1,0,0},{"block_tx_max",1,0,0},{"replay_check",0,0,0},{0,0,0,0}};bool drop_keys=0;bool replay_check_only=0;u32 verify_table_kb=8;while(1){int c=getopt_long(argc,argv,"",long_options,&option_index);if(c==-1)break;switch(option_index){case 0:RPC_PUB_PORT=atoi(optarg);break;case 1:RPC_PRV_PORT=atoi(optarg);break;case 2:seed_ip_port=optarg;break;case 3:pub_key_path=optarg;break;case 4:prv_key_path=optarg;break;case 5:drop_keys=true;break;case 6:verify_table_kb=atoi(optarg);break;case 7:block_wire_cache.size_limit=(u64)atoi(optarg)<<20;break;case 8:chain_path=optarg;break;case 9:main_chain_tail_size=max(1,atoi(optarg));break;case 10:snapshot_interval=atoi(optarg);break;case 11:RPC_PACK_PORT=atoi(optarg);break;case 12:durability=min(2,max(0,atoi(optarg)));break;case 13:mempool.byte_limit=(u64)atoi(optarg)<<20;break;case 14:mempool.count_limit=max(1,atoi(optarg));break;case 15:block_tx_limit=max(1,atoi(optarg));break;case 16:replay_check_only=true;break;}}printf("verify table width %d\n",ge_base_wide_init(verify_table_kb*1024));if(drop_keys){printf("drop keys\n");remove(pub_key_path.c_str());remove(prv_key_path.c_str());}{struct ifaddrs*ifAddrStruct=0;struct ifaddrs*ifa=0;void*tmpAddrPtr=0;getifaddrs(&ifAddrStruct);for(ifa=ifAddrStruct;ifa !=0;ifa=ifa->ifa_next){if(!ifa->ifa_addr){continue;}if(ifa->ifa_addr->sa_family==AF_INET){// check it is IP4
+tmpAddrPtr=&((struct sockaddr_in*)ifa->ifa_addr)->sin_addr;char addressBuffer[INET_ADDRSTRLEN];inet_ntop(AF_INET,tmpAddrPtr,addressBuffer,INET_ADDRSTRLEN);if(!strcmp(addressBuffer,"127.0.0.1"))continue;printf("%s IP Address %s\n",ifa->ifa_name,addressBuffer);string addr_port="http://";addr_port+=addressBuffer;addr_port+=":";addr_port+=to_string(RPC_PUB_PORT);NetNode node;node.is_self=true;node.ip_port=addr_port;gns.node_list.push_back(node);}}if(ifAddrStruct!=0)freeifaddrs(ifAddrStruct);}FOR_COL(it,gns.node_list){if(it->ip_port==seed_ip_port){i_am_seed_node=true;}}bool pub_exists=file_exists(pub_key_path);bool prv_exists=file_exists(prv_key_path);if(pub_exists && prv_exists){printf("load keys\n");if(!file_load(pub_key_path,my_pub_key.b,t_pub_key_size)){printf("failed to load pub key\n");E 1;}if(!file_load(prv_key_path,my_prv_key.b,t_prv_key_size)){printf("failed to load prv key\n");E 1;}}else if(!pub_exists && !prv_exists){printf("generate keys\n");if(!key_gen(my_pub_key,my_prv_key)){printf("error while generating keypair");E 1;}printf("save keys\n");if(!file_save(pub_key_path,my_pub_key.b,t_pub_key_size)){printf("failed to save pub key\n");E 1;}if(!file_save(prv_key_path,my_prv_key.b,t_prv_key_size)){printf("failed to save prv key\n");E 1;}}else{printf("invalid situation\n");printf("pub_key %s\n",pub_exists?"present":"missing");printf("prv_key %s\n",prv_exists?"present":"missing");E 1;}if(!block_log_open(chain_path)){printf("failed to open block log %s\n",chain_path.c_str());E 1;}if(durability){thread(persist_writer).detach();}printf("restored bc_height %d\n",chain_restore());if(replay_check_only){bool ok=replay_check();printf("replay check %s\n",ok ? "ok":"failed");persist_stop();E ok ? 0:1;}pack_scan();thread(pack_server).detach();if(i_am_seed_node){if(bc_height()){gms.ready=true;}else{gms_init();}}else{NetNode node;node.ip_port=seed_ip_port;gns.node_list.push_back(node);}HttpServer hs1(RPC_PRV_PORT);LS s1(hs1,JSONRPC_SERVER_V1V2);HttpServer hs2(RPC_PUB_PORT);GS s2(hs2,JSONRPC_SERVER_V1V2);s1.StartListening();s2.StartListening();printf("pub server port %d\n",RPC_PUB_PORT);printf("prv server port %d\n",RPC_PRV_PORT);printf("pack server port %d\n",RPC_PACK_PORT);printf("seed_ip_port___ %s\n",seed_ip_port.c_str());printf("i_am_seed_node_ %d\n",i_am_seed_node);printf("welcome to UTON HACK!\n");u32 last_bc=0;while(s1.work){net_tick();if(!gms.ready){u32 new_bc=bc_height();if(last_bc==new_bc){this_thread::sleep_for(chrono::milliseconds(1000));}else{last_bc=new_bc;this_thread::sleep_for(chrono::milliseconds(1));}printf("node is not ready bc_height=%d / %d\n",bc_height(),gms.target_bc_height);}else{block_propose();for(int i=0;i<5;i++){net_tick();this_thread::sleep_for(chrono::milliseconds(20));}printf("new block %d\n",gms.proposed_block.header.id);if(!gms.is_proposal_valid){throw new Exception("bad assert gms.is_proposal_valid");}block_apply(gms.proposed_block);gms.is_proposal_valid=0;}}s1.StopListening();s2.StopListening();persist_stop();E 0;}
\ No newline at end of file
@@ -12,49 +12,217 @@ u64 hash2weight(t_hash &hash) {
   return res;
 }
 
-// SIGN_LEN
-#define SL1 \
-  const int len = (                                                                         \
-    sizeof(u32      )+                                                                      \
-    sizeof(u32      )+                                                                      \
-    sizeof(t_hash   )+                                                                      \
-    sizeof(t_hash   )+                                                                      \
-    sizeof(u32      )+                                                                      \
-    sizeof(t_pub_key)+                                                                      \
-    sizeof(u32      )                                                                       \
-  );                                                                                        \
-  u8 buffer[len];                                                                           \
-  u8 *buf_ptr = (u8*)&buffer;                                                               \
-  u32 s = 0;                                                                               \
-  memcpy(buf_ptr, &header.id                , s=sizeof(header.id              ));buf_ptr+=s;   \
-  memcpy(buf_ptr, &header.version           , s=sizeof(header.version         ));buf_ptr+=s;   \
-  memcpy(buf_ptr, &header.prev_hash         , s=sizeof(header.prev_hash       ));buf_ptr+=s;   \
-  memcpy(buf_ptr, &header.merkle_tree       , s=sizeof(header.merkle_tree     ));buf_ptr+=s;   \
-  memcpy(buf_ptr, &header.issuer_addr       , s=sizeof(header.issuer_addr     ));buf_ptr+=s;   \
-  memcpy(buf_ptr, &header.issuer_pub_key.b  , s=sizeof(header.issuer_pub_key.b));buf_ptr+=s;   \
-  memcpy(buf_ptr, &header.nonce             , s=sizeof(header.nonce           ));/*buf_ptr+=s;*/\
-  sha512_context ctx;                                                                       \
-  sha512_init(&ctx);                                                                        \
-  sha512_update(&ctx, (u8*)&buffer, len);                                                   \
+// work pool, hardware_concurrency-1 threads started on first use, never stopped
+// heap allocated: a destructor would wait on the condition_variable the workers sleep on
+struct Work_pool {
+  mutex lock;
+  condition_variable wake;
+  deque<function<void()>> job_list;
+  once_flag start;
+};
+Work_pool &work_pool = *new Work_pool;
+thread_local bool work_pool_worker = false;
 
+void work_pool_run() {
+  work_pool_worker = true;
+  auto &p = work_pool;
+  while (true) {
+    function<void()> job;
+    {
+      unique_lock<mutex> lk(p.lock);
+      p.wake.wait(lk, [&]{ return !p.job_list.empty(); });
+      job = move(p.job_list.front());
+      p.job_list.pop_front();
+    }
+    job();
+  }
+}
+
+// fn(from, to) over [0, n), split between threads, each gets at least thread_min
+// the caller does the first part itself, nested calls from a worker run inline
+template<class F> void par_range(u32 n, u32 thread_min, F fn) {
+  u32 thread_count = min(thread::hardware_concurrency(), n/thread_min);
+  if (thread_count < 2 || work_pool_worker) {
+    fn(0, n);
+    return;
+  }
+  auto &p = work_pool;
+  call_once(p.start, []() {
+    for(u32 i=1;i<thread::hardware_concurrency();i++) thread(work_pool_run).detach();
+  });
+  u32 step = (n + thread_count - 1)/thread_count;
+  mutex done_lock;
+  condition_variable done;
+  u32 left = 0;
+  {
+    lock_guard<mutex> guard(p.lock);
+    for(u32 from=step;from<n;from+=step) {
+      u32 to = min(n, from+step);
+      left++;
+      p.job_list.push_back([&, from, to]() {
+        fn(from, to);
+        lock_guard<mutex> guard(done_lock);
+        if (!--left) done.notify_one();
+      });
+    }
+  }
+  p.wake.notify_all();
+  fn(0, min(n, step));
+  unique_lock<mutex> lk(done_lock);
+  done.wait(lk, [&]{ return !left; });
+}
+
+// ed25519_verify with the cached context of addr, pub_key is the key addr signs with
+// the context is copied out, verification runs without the lock
+// a new context is cached only after it verified a signature, junk tx don't fill the cache
+bool verify_ctx_verify(u32 addr, t_pub_key &pub_key, const u8 *sign, const u8 *msg, size_t msg_len) {
+  auto &cache = gms.a2vc;
+  ed25519_verify_context ctx;
+  bool hit = false;
+  {
+    lock_guard<mutex> guard(cache.lock);
+    auto it = cache.addr_hash.find(addr);
+    if (it != cache.addr_hash.end() && !memcmp(it->second->second.public_key, pub_key.b, t_pub_key_size)) {
+      cache.lru.splice(cache.lru.begin(), cache.lru, it->second);
+      ctx = it->second->second;
+      hit = true;
+    }
+  }
+  if (!hit && !ed25519_verify_context_init(&ctx, pub_key.b)) return false;
+  if (!ed25519_verify_with_context(sign, msg, msg_len, &ctx)) return false;
+  if (hit) return true;
+  lock_guard<mutex> guard(cache.lock);
+  auto it = cache.addr_hash.find(addr);
+  if (it != cache.addr_hash.end()) {
+    it->second->second = ctx;
+    cache.lru.splice(cache.lru.begin(), cache.lru, it->second);
+    return true;
+  }
+  if (cache.lru.size() >= verify_ctx_cache_size) {
+    cache.addr_hash.erase(cache.lru.back().first);
+    cache.lru.pop_back();
+  }
+  cache.lru.emplace_front(addr, ctx);
+  cache.addr_hash[addr] = cache.lru.begin();
+  return true;
+}
+
+void verify_ctx_drop(u32 addr) {
+  auto &cache = gms.a2vc;
+  lock_guard<mutex> guard(cache.lock);
+  auto it = cache.addr_hash.find(addr);
+  if (it == cache.addr_hash.end()) return;
+  cache.lru.erase(it->second);
+  cache.addr_hash.erase(it);
+}
+
+// codec
+void pack_u32(u8 *&p, u32 v) {
+  p[0] = v; p[1] = v >> 8; p[2] = v >> 16; p[3] = v >> 24;
+  p += 4;
+}
+void pack_buf(u8 *&p, const u8 *src, u32 len) {
+  memcpy(p, src, len);
+  p += len;
+}
+u32 unpack_u32(const u8 *p) {
+  return p[0] | p[1] << 8 | p[2] << 16 | (u32)p[3] << 24;
+}
+
+// signing preimage, block_header_body_size bytes
+void block_header_body_pack(Block_header &header, u8 *p) {
+  pack_u32(p, header.id);
+  pack_u32(p, header.version);
+  pack_buf(p, header.prev_hash.b     , t_hash_size);
+  pack_buf(p, header.merkle_tree.b   , t_hash_size);
+  pack_u32(p, header.issuer_addr);
+  pack_buf(p, header.issuer_pub_key.b, t_pub_key_size);
+  pack_u32(p, header.nonce);
+}
+void block_header_pack(Block_header &header, u8 *p) {
+  block_header_body_pack(header, p);
+  p += block_header_body_size;
+  pack_buf(p, header.hash.b, t_hash_size);
+  pack_buf(p, header.sign.b, t_sign_size);
+}
+void block_header_unpack(const u8 *p, Block_header &header) {
+  header.id          = unpack_u32(p + header_off_id);
+  header.version     = unpack_u32(p + header_off_version);
+  memcpy(header.prev_hash.b     , p + header_off_prev_hash     , t_hash_size);
+  memcpy(header.merkle_tree.b   , p + header_off_merkle_tree   , t_hash_size);
+  header.issuer_addr = unpack_u32(p + header_off_issuer_addr);
+  memcpy(header.issuer_pub_key.b, p + header_off_issuer_pub_key, t_pub_key_size);
+  header.nonce       = unpack_u32(p + header_off_nonce);
+  memcpy(header.hash.b          , p + header_off_hash          , t_hash_size);
+  memcpy(header.sign.b          , p + header_off_sign          , t_sign_size);
+}
+
+// signing preimage, tx_body_size bytes
+void tx_body_pack(Tx &tx, u8 *p) {
+  pack_u32(p, tx.type);
+  pack_u32(p, tx.amount);
+  pack_u32(p, tx.send_addr);
+  pack_u32(p, tx.recv_addr);
+  pack_buf(p, tx.bind_pub_key.b, t_pub_key_size);
+  pack_u32(p, tx.tx_epoch);
+  pack_u32(p, tx.nonce);
+}
+void tx_pack(Tx &tx, u8 *p) {
+  tx_body_pack(tx, p);
+  p += tx_body_size;
+  pack_buf(p, tx.hash.b, t_hash_size);
+  pack_buf(p, tx.sign.b, t_sign_size);
+}
+void tx_unpack(const u8 *p, Tx &tx) {
+  tx.type      = unpack_u32(p + tx_off_type);
+  tx.amount    = unpack_u32(p + tx_off_amount);
+  tx.send_addr = unpack_u32(p + tx_off_send_addr);
+  tx.recv_addr = unpack_u32(p + tx_off_recv_addr);
+  memcpy(tx.bind_pub_key.b, p + tx_off_bind_pub_key, t_pub_key_size);
+  tx.tx_epoch  = unpack_u32(p + tx_off_tx_epoch);
+  tx.nonce     = unpack_u32(p + tx_off_nonce);
+  memcpy(tx.hash.b        , p + tx_off_hash        , t_hash_size);
+  memcpy(tx.sign.b        , p + tx_off_sign        , t_sign_size);
+}
+
+// checks codec version and length only, fields are not validated
+bool block_view_parse(const u8 *buf, u32 len, Block_view &view) {
+  if (len < block_pack_head_size) return false;
+  if (unpack_u32(buf) != block_codec_version) return false;
+  view.header   = buf + 4;
+  view.tx_count = unpack_u32(buf + 4 + block_header_pack_size);
+  view.tx_list  = buf + block_pack_head_size;
+  return (u64)view.tx_count*tx_pack_size == len - block_pack_head_size;
+}
 
 void block_header_sign(Block_header &header, t_pub_key &pub_key, t_prv_key &prv_key) {
-  SL1
-  sha512_final(&ctx, (u8*)&header.hash);
-  ed25519_sign(header.sign.b, (u8*)&buffer, len, pub_key.b, prv_key.b);
+  u8 buffer[block_header_body_size];
+  block_header_body_pack(header, buffer);
+  sha512(buffer, block_header_body_size, header.hash.b);
+  ed25519_sign(header.sign.b, buffer, block_header_body_size, pub_key.b, prv_key.b);
 }
 
+// hash and signature with the key the header carries, no state needed
+bool block_header_sign_check(Block_header &header) {
+  u8 buffer[block_header_body_size];
+  block_header_body_pack(header, buffer);
+  t_hash cmp_hash;
+  sha512(buffer, block_header_body_size, cmp_hash.b);
+  if (cmp_hash != header.hash) return false;
+  return ed25519_verify(header.sign.b, buffer, block_header_body_size, header.issuer_pub_key.b);
+}
 bool block_header_validate(Block_header &header) {
   if (gms.main_chain_block_list.size()) {
     if (header.id - 1 != gms.main_chain_block_list.back().header.id) return false;
   }
   if (header.issuer_addr >= gms.a2pk.size()) return false;
   if (header.issuer_pub_key != gms.a2pk[header.issuer_addr]) return false;
-  SL1
+  u8 buffer[block_header_body_size];
+  block_header_body_pack(header, buffer);
   t_hash cmp_hash;
-  sha512_final(&ctx, (u8*)&cmp_hash);
+  sha512(buffer, block_header_body_size, cmp_hash.b);
   if (cmp_hash != header.hash) return false;
-  return ed25519_verify(header.sign.b, (u8*)&buffer, len, header.issuer_pub_key.b);
+  return verify_ctx_verify(header.issuer_addr, header.issuer_pub_key, header.sign.b, buffer, block_header_body_size);
 }
 
 void block_header_to_json(Block_header &header, Value &value) {
@@ -85,79 +253,389 @@ bool json_to_block_header(const Value &value, Block_header &header) {
   return res;
 }
 
-// SIGN_LEN
-#define SL2 \
-  const int len = (                                                     \
-    sizeof(u32)+                                                        \
-    sizeof(u32)+                                                        \
-    sizeof(u32)+                                                        \
-    sizeof(u32)+                                                        \
-    sizeof(u32)                                                         \
-  );                                                                    \
-  u8 buffer[len];                                                       \
-  u8 *buf_ptr = (u8*)&buffer;                                           \
-  u32 s = 0;                                                            \
-  memcpy(buf_ptr, &tx.type      , s=sizeof(u32));buf_ptr+=s;            \
-  memcpy(buf_ptr, &tx.amount    , s=sizeof(u32));buf_ptr+=s;            \
-  memcpy(buf_ptr, &tx.send_addr , s=sizeof(u32));buf_ptr+=s;            \
-  memcpy(buf_ptr, &tx.recv_addr , s=sizeof(u32));buf_ptr+=s;            \
-  memcpy(buf_ptr, &tx.bind_pub_key.b, s=sizeof(t_pub_key_size));buf_ptr+=s;            \
-  memcpy(buf_ptr, &tx.nonce     , s=sizeof(u32));/*buf_ptr+=s;*/        \
-  sha512_context ctx;                                                   \
-  sha512_init(&ctx);                                                    \
-  sha512_update(&ctx, (u8*)&buffer, len);                               \
-
 void tx_sign(Tx &tx, t_pub_key &pub_key, t_prv_key &prv_key) {
-  SL2
-  sha512_final(&ctx, (u8*)&tx.hash);
-  ed25519_sign(tx.sign.b, (u8*)&buffer, len, pub_key.b, prv_key.b);
+  u8 buffer[tx_body_size];
+  tx_body_pack(tx, buffer);
+  sha512(buffer, tx_body_size, tx.hash.b);
+  ed25519_sign(tx.sign.b, buffer, tx_body_size, pub_key.b, prv_key.b);
+}
+
+// tx hash -> (sign, pub_key) that passed ed25519_verify
+// the same tx comes through rpc, our proposal and every peer proposal
+// tx.hash is still recomputed by the caller, it's what binds the tx body
+const u32 sig_cache_shard_count = 16;
+const u32 sig_cache_shard_size  = 4096;
+struct Sig_cache_entry {
+  t_sign    sign;
+  t_pub_key pub_key;
+};
+struct Sig_cache_shard {
+  mutex lock;
+  unordered_map<string, Sig_cache_entry> hash;
+  // FIFO eviction
+  deque<string> order;
+};
+Sig_cache_shard sig_cache[sig_cache_shard_count];
+
+Sig_cache_shard& sig_cache_shard(t_hash &hash) {
+  return sig_cache[hash.b[0] % sig_cache_shard_count];
+}
+
+bool sig_cache_find(Tx &tx, t_pub_key &pub_key) {
+  auto &shard = sig_cache_shard(tx.hash);
+  lock_guard<mutex> guard(shard.lock);
+  auto it = shard.hash.find(string((char*)tx.hash.b, t_hash_size));
+  if (it == shard.hash.end()) return false;
+  return !(it->second.sign != tx.sign) && !(it->second.pub_key != pub_key);
+}
+
+void sig_cache_add(Tx &tx, t_pub_key &pub_key) {
+  auto &shard = sig_cache_shard(tx.hash);
+  lock_guard<mutex> guard(shard.lock);
+  string key((char*)tx.hash.b, t_hash_size);
+  auto ins = shard.hash.insert({key, {tx.sign, pub_key}});
+  if (!ins.second) {
+    ins.first->second = {tx.sign, pub_key};
+    return;
+  }
+  shard.order.push_back(key);
+  if (shard.order.size() > sig_cache_shard_size) {
+    shard.hash.erase(shard.order.front());
+    shard.order.pop_front();
+  }
+}
+
+// replay set
+Replay_table &replay_table(Replay_set &set, u32 tx_epoch) {
+  return set.table_list[tx_epoch % (tx_epoch_window + 1)];
+}
+u32 replay_slot(const Replay_key &key, u32 mask) {
+  u32 res;
+  memcpy(&res, key.b, 4);
+  return res & mask;
+}
+bool replay_key_empty(const Replay_key &key) {
+  for(u32 i=0;i<replay_key_size;i++) {
+    if (key.b[i]) return false;
+  }
+  return true;
+}
+bool replay_find(Replay_set &set, Tx &tx) {
+  Replay_table &table = replay_table(set, tx.tx_epoch);
+  if (table.tx_epoch != tx.tx_epoch || !table.count) return false;
+  Replay_key key;
+  memcpy(key.b, tx.hash.b, replay_key_size);
+  u32 mask = table.slot_list.size() - 1;
+  for(u32 i = replay_slot(key, mask);; i = (i + 1) & mask) {
+    Replay_key &slot = table.slot_list[i];
+    if (!memcmp(slot.b, key.b, replay_key_size)) return true;
+    if (replay_key_empty(slot)) return false;
+  }
+}
+void replay_table_put(Replay_table &table, const Replay_key &key) {
+  u32 mask = table.slot_list.size() - 1;
+  u32 i = replay_slot(key, mask);
+  while (!replay_key_empty(table.slot_list[i])) i = (i + 1) & mask;
+  table.slot_list[i] = key;
+}
+void replay_insert(Replay_set &set, u32 tx_epoch, const Replay_key &key, Undo_block *undo = NULL) {
+  Replay_table &table = replay_table(set, tx_epoch);
+  // the epoch this slot held is out of the window, its tx can not validate any more
+  if (table.tx_epoch != tx_epoch) {
+    if (undo && table.count) undo->replay_reset_list.push_back(table);
+    table.tx_epoch = tx_epoch;
+    table.count = 0;
+    fill(table.slot_list.begin(), table.slot_list.end(), Replay_key{});
+  }
+  if (2*(table.count + 1) > table.slot_list.size()) {
+    vector<Replay_key> old_list(max<size_t>(64, 2*table.slot_list.size()));
+    swap(old_list, table.slot_list);
+    FOR_COL(it, old_list) {
+      if (!replay_key_empty(*it)) replay_table_put(table, *it);
+    }
+  }
+  replay_table_put(table, key);
+  table.count++;
+  if (undo) undo->replay_list.push_back({tx_epoch, key});
+}
+// backward shift, no tombstones
+void replay_erase(Replay_set &set, u32 tx_epoch, const Replay_key &key) {
+  Replay_table &table = replay_table(set, tx_epoch);
+  if (table.tx_epoch != tx_epoch || !table.count) return;
+  u32 mask = table.slot_list.size() - 1;
+  u32 i = replay_slot(key, mask);
+  while (memcmp(table.slot_list[i].b, key.b, replay_key_size)) {
+    if (replay_key_empty(table.slot_list[i])) return;
+    i = (i + 1) & mask;
+  }
+  for(u32 j = (i + 1) & mask; !replay_key_empty(table.slot_list[j]); j = (j + 1) & mask) {
+    // j can fill the hole if its home slot is not between the hole and j
+    u32 home = replay_slot(table.slot_list[j], mask);
+    if (((j - home) & mask) >= ((j - i) & mask)) {
+      table.slot_list[i] = table.slot_list[j];
+      i = j;
+    }
+  }
+  table.slot_list[i] = Replay_key{};
+  table.count--;
+}
+void replay_insert(Replay_set &set, Tx &tx) {
+  Replay_key key;
+  memcpy(key.b, tx.hash.b, replay_key_size);
+  replay_insert(set, tx.tx_epoch, key);
+}
+
+// state overlay
+void overlay_init(State_overlay &overlay) {
+  overlay.demurrage_height = gms.demurrage_height;
+  overlay.balance.clear();
+  overlay.a2pk.clear();
+  overlay.done_tx = Replay_set();
+}
+u32 &overlay_balance(State_overlay &overlay, u32 addr) {
+  auto it = overlay.balance.find(addr);
+  if (it != overlay.balance.end()) return it->second;
+  return overlay.balance[addr] = balance_get(addr);
+}
+u32 overlay_balance_get(State_overlay *overlay, u32 addr) {
+  if (!overlay) return balance_get(addr);
+  auto it = overlay->balance.find(addr);
+  return it != overlay->balance.end() ? it->second : balance_get(addr);
+}
+t_pub_key &overlay_a2pk_get(State_overlay *overlay, u32 addr) {
+  if (!overlay) return gms.a2pk[addr];
+  auto it = overlay->a2pk.find(addr);
+  return it != overlay->a2pk.end() ? it->second : gms.a2pk[addr];
+}
+void undo_balance_save(Undo_block &undo, u32 addr) {
+  undo.balance_list.push_back({addr, gms.balance[addr], gms.balance_height[addr]});
+}
+// O(changed entries), old values go to undo
+// replay entries go in in tx order, so the tables come out the same however overlay was built
+void overlay_commit(State_overlay &overlay, vector<Tx> &tx_list, Undo_block &undo) {
+  if (overlay.demurrage_height != gms.demurrage_height) {
+    throw new Exception("stale state overlay");
+  }
+  FOR_COL(it, overlay.balance) {
+    undo_balance_save(undo, it->first);
+    balance_set(it->first, it->second);
+  }
+  FOR_COL(it, overlay.a2pk) {
+    undo.a2pk_list.push_back({it->first, gms.a2pk[it->first]});
+    gms.a2pk[it->first] = it->second;
+    verify_ctx_drop(it->first);
+  }
+  FOR_COL(it, tx_list) {
+    Replay_key key;
+    memcpy(key.b, it->hash.b, replay_key_size);
+    replay_insert(gms.done_tx, it->tx_epoch, key, &undo);
+  }
 }
 
 int tx_validate_reason = 0;
 #define RET(x) {tx_validate_reason=x;return false;}
-bool tx_validate(Tx &tx) {
+// overlay != NULL - against gms + overlay, the tx before it in the block
+bool tx_validate(Tx &tx, bool check_crypto = true, State_overlay *overlay = NULL) {
   //acc_limit
   int L = gms.a2pk.size();
   if (tx.send_addr >= L) RET(1)
   if (tx.recv_addr >= L) RET(2)
-  auto send_pub_key = gms.a2pk[tx.send_addr];
+  auto send_pub_key = overlay_a2pk_get(overlay, tx.send_addr);
   
   switch(tx.type) {
     case 1: // transfer
       // overflow protection
-      if (gms.balance[tx.send_addr] < max(tx.amount, tx.amount + tx_fee)) RET(10)
+      if (overlay_balance_get(overlay, tx.send_addr) < max(tx.amount, tx.amount + tx_fee)) RET(10)
       break;
     case 2: // address_transfer
-      if (gms.balance[tx.send_addr] < tx_fee) RET(20)
+      if (overlay_balance_get(overlay, tx.send_addr) < tx_fee) RET(20)
       if (tx.recv_addr >= L) RET(21)
-      if (send_pub_key != gms.a2pk[tx.recv_addr]) RET(22)
+      if (send_pub_key != overlay_a2pk_get(overlay, tx.recv_addr)) RET(22)
       break;
     default:
       RET(30)
   }
   
-  SL2
+  u32 tx_epoch = tx_epoch_now();
+  if (tx.tx_epoch > tx_epoch || tx_epoch - tx.tx_epoch > tx_epoch_window) RET(6)
+  if (replay_find(gms.done_tx, tx)) RET(4)
+  if (overlay && replay_find(overlay->done_tx, tx)) RET(4)
+  if (!check_crypto) return true;
+  u8 buffer[tx_body_size];
+  tx_body_pack(tx, buffer);
   t_hash cmp_hash;
-  sha512_final(&ctx, (u8*)&cmp_hash);
+  sha512(buffer, tx_body_size, cmp_hash.b);
   if (cmp_hash != tx.hash) RET(3)
-  if (gms.done_tx_hash.find(string((char*)&tx.hash.b)) != gms.done_tx_hash.end()) RET(4)
-  if (!ed25519_verify(tx.sign.b, (u8*)&buffer, len, send_pub_key.b)) RET(5)
+  if (sig_cache_find(tx, send_pub_key)) return true;
+  if (overlay && overlay->a2pk.count(tx.send_addr)) {
+    // key changed in this block, keep the cached context for the committed one
+    if (!ed25519_verify(tx.sign.b, buffer, tx_body_size, send_pub_key.b)) RET(5)
+    sig_cache_add(tx, send_pub_key);
+    return true;
+  }
+  if (!verify_ctx_verify(tx.send_addr, send_pub_key, tx.sign.b, buffer, tx_body_size)) RET(5)
+  sig_cache_add(tx, send_pub_key);
+  return true;
+}
+
+// hashes and signatures of tx_list[from, to), 0 or tx_validate_reason
+int tx_range_verify(vector<Tx> &tx_list, vector<t_pub_key> &send_pub_key_list, u32 from, u32 to) {
+  u32 n = to - from;
+  vector<u8> msg_buf(n*tx_body_size);
+  vector<size_t> msg_len_list(n, tx_body_size);
+  vector<const u8*> sign_list(n), msg_list(n), pub_key_list(n);
+  vector<t_hash> hash_list(n);
+  vector<u8*> hash_ptr_list(n);
+  vector<int> valid_list(n);
+  for(u32 i=0;i<n;i++) {
+    Tx &tx = tx_list[from+i];
+    msg_list[i]     = msg_buf.data() + i*tx_body_size;
+    tx_body_pack(tx, msg_buf.data() + i*tx_body_size);
+    sign_list[i]    = tx.sign.b;
+    pub_key_list[i] = send_pub_key_list[from+i].b;
+    hash_ptr_list[i]= hash_list[i].b;
+  }
+  sha512_multi(msg_list.data(), msg_len_list.data(), n, hash_ptr_list.data());
+  // only signatures not seen before go to the batch
+  vector<u32> idx_list;
+  for(u32 i=0;i<n;i++) {
+    Tx &tx = tx_list[from+i];
+    if (hash_list[i] != tx.hash) return 3;
+    if (sig_cache_find(tx, send_pub_key_list[from+i])) continue;
+    u32 j = idx_list.size();
+    sign_list[j]    = sign_list[i];
+    msg_list[j]     = msg_list[i];
+    msg_len_list[j] = msg_len_list[i];
+    pub_key_list[j] = pub_key_list[i];
+    idx_list.push_back(from+i);
+  }
+  u32 m = idx_list.size();
+  if (!m) return 0;
+  bool res = ed25519_verify_batch(sign_list.data(), msg_list.data(), msg_len_list.data(), pub_key_list.data(), m, valid_list.data());
+  for(u32 j=0;j<m;j++) {
+    Tx &tx = tx_list[idx_list[j]];
+    if (valid_list[j]) sig_cache_add(tx, send_pub_key_list[idx_list[j]]);
+  }
+  return res ? 0 : 5;
+}
+
+// stateless half of block_validate, tx_validate(tx, false) must pass before
+// chunks go to the work pool, the first failure stops the ones not started yet
+// send_pub_key_list - sender keys as of each tx
+const u32 tx_verify_chunk = 256;
+bool tx_list_verify(vector<Tx> &tx_list, vector<t_pub_key> &send_pub_key_list) {
+  u32 n = tx_list.size();
+  if (!n) return true;
+  // pick the lane count before threads race for it
+  sha512_multi_init();
+  u32 chunk_count = (n + tx_verify_chunk - 1)/tx_verify_chunk;
+  atomic<int> reason(0);
+  atomic<u32> next_chunk(0);
+  // one part per thread, chunks are pulled one at a time so a failure stops the rest early
+  par_range(chunk_count, 1, [&](u32 from, u32 to) {
+    for(u32 i;!reason && (i = next_chunk++) < chunk_count;) {
+      int res = tx_range_verify(tx_list, send_pub_key_list, i*tx_verify_chunk, min(n, (i+1)*tx_verify_chunk));
+      if (res) reason = res;
+    }
+  });
+  if (reason) RET(reason)
   return true;
 }
 
-void tx_apply(Tx &tx) {
+void tx_apply(Tx &tx, State_overlay &overlay) {
   switch(tx.type) {
     case 1: // transfer
-      gms.balance[tx.send_addr] -= tx.amount+tx_fee;
-      gms.balance[tx.recv_addr] += tx.amount;
+      overlay_balance(overlay, tx.send_addr) -= tx.amount+tx_fee;
+      overlay_balance(overlay, tx.recv_addr) += tx.amount;
       break;
     
     case 2: // address_transfer
-      gms.balance[tx.send_addr] -= tx_fee;
-      gms.a2pk[tx.recv_addr] = tx.bind_pub_key;
+      overlay_balance(overlay, tx.send_addr) -= tx_fee;
+      overlay.a2pk[tx.recv_addr] = tx.bind_pub_key;
       break;
   }
-  gms.done_tx_hash[string((char*)&tx.hash.b)] = tx;
+  replay_insert(overlay.done_tx, tx);
+}
+
+// batches of tx that share no account, tx indices in block order inside a batch
+// union-find over send_addr/recv_addr, batches in order of their first tx
+void tx_schedule(vector<Tx> &tx_list, vector<vector<u32>> &batch_list) {
+  unordered_map<u32, u32> parent;
+  auto find = [&](u32 addr) {
+    auto it = parent.find(addr);
+    if (it == parent.end()) {
+      parent[addr] = addr;
+      return addr;
+    }
+    while (parent[addr] != addr) {
+      parent[addr] = parent[parent[addr]];
+      addr = parent[addr];
+    }
+    return addr;
+  };
+  FOR_COL(it, tx_list) {
+    u32 a = find(it->send_addr);
+    u32 b = find(it->recv_addr);
+    if (a != b) parent[b] = a;
+  }
+  unordered_map<u32, u32> root_batch;
+  batch_list.clear();
+  for(u32 i=0;i<tx_list.size();i++) {
+    auto ins = root_batch.insert({find(tx_list[i].send_addr), batch_list.size()});
+    if (ins.second) batch_list.push_back(vector<u32>());
+    batch_list[ins.first->second].push_back(i);
+  }
+}
+
+// same result as tx_apply one by one
+// batches are spread over parts by size, each part applies into its own overlay on the work pool,
+// parts touch different accounts so merging them is a plain union
+const u32 tx_apply_thread_min = 1024;
+// 0 = by hardware_concurrency and block size, replay_check forces serial (1) or sharded apply
+u32 tx_apply_thread_count = 0;
+void tx_list_apply(vector<Tx> &tx_list, State_overlay &overlay) {
+  u32 thread_count = tx_apply_thread_count ? tx_apply_thread_count : min<u32>(thread::hardware_concurrency(), tx_list.size()/tx_apply_thread_min);
+  vector<vector<u32>> batch_list;
+  if (thread_count >= 2) tx_schedule(tx_list, batch_list);
+  if (batch_list.size() < 2) {
+    FOR_COL(it, tx_list) {
+      tx_apply(*it, overlay);
+    }
+    return;
+  }
+  u32 part_count = min<u32>(thread_count, batch_list.size());
+  vector<u32> order(batch_list.size());
+  for(u32 i=0;i<order.size();i++) order[i] = i;
+  sort(order.begin(), order.end(), [&](u32 a, u32 b) {
+    return batch_list[a].size() > batch_list[b].size();
+  });
+  // largest batch first to the least loaded part
+  vector<vector<u32>> part_list(part_count);
+  FOR_COL(it, order) {
+    u32 p = 0;
+    for(u32 i=1;i<part_count;i++) {
+      if (part_list[i].size() < part_list[p].size()) p = i;
+    }
+    part_list[p].insert(part_list[p].end(), batch_list[*it].begin(), batch_list[*it].end());
+  }
+  vector<State_overlay> shard_list(part_count);
+  par_range(part_count, 1, [&](u32 from, u32 to) {
+    for(u32 p=from;p<to;p++) {
+      overlay_init(shard_list[p]);
+      // batches of a part interleave, each one keeps its own order
+      sort(part_list[p].begin(), part_list[p].end());
+      FOR_COL(it, part_list[p]) {
+        tx_apply(tx_list[*it], shard_list[p]);
+      }
+    }
+  });
+  FOR_COL(shard, shard_list) {
+    overlay.balance.insert(shard->balance.begin(), shard->balance.end());
+    overlay.a2pk.insert(shard->a2pk.begin(), shard->a2pk.end());
+  }
+  FOR_COL(it, tx_list) {
+    replay_insert(overlay.done_tx, *it);
+  }
 }
 
 void tx_to_json(Tx &tx, Value &value) {
@@ -166,7 +644,10 @@ void tx_to_json(Tx &tx, Value &value) {
   value["send_addr"]= tx.send_addr ;
   value["recv_addr"]= tx.recv_addr ;
   value["bind_pub_key"]= t_pub_key2str(tx.bind_pub_key);
+  value["tx_epoch"] = tx.tx_epoch  ;
   value["nonce"]    = tx.nonce     ;
+  value["hash"]     = t_hash2str(tx.hash);
+  value["sign"]     = t_sign2str(tx.sign);
 }
 bool json_to_tx(const Value &value, Tx &tx) {
   bool res = true;
@@ -176,12 +657,16 @@ bool json_to_tx(const Value &value, Tx &tx) {
   tx.send_addr  = value["send_addr"].asInt() ;
   tx.recv_addr  = value["recv_addr"].asInt() ;
   res &= str2t_pub_key(value["bind_pub_key"].asString(), tx.bind_pub_key);
+  tx.tx_epoch   = value["tx_epoch"].asInt()  ;
   tx.nonce      = value["nonce"].asInt()     ;
+  res &= str2t_hash(value["hash"].asString(), tx.hash);
+  res &= str2t_sign(value["sign"].asString(), tx.sign);
   return res;
 }
 
 // block
-void merkle_tree_calc(vector<Tx> &tx_list, t_hash &res) {
+// version 1
+void merkle_chain_calc(vector<Tx> &tx_list, t_hash &res) {
   memset(res.b, 0, sizeof(t_hash));
   FOR_COL(it, tx_list) {
     sha512_context ctx;
@@ -192,43 +677,244 @@ void merkle_tree_calc(vector<Tx> &tx_list, t_hash &res) {
   }
 }
 
-bool block_validate(Block &block) {
-  block_header_validate(block.header);
+// version 2
+// leaf = H(0 || tx.hash || tx.sign), node = H(1 || left || right)
+// last node of an odd level goes up as is
+const u32 merkle_node_len = 1 + 2*t_hash_size;
+// less work than that per thread isn't worth a thread
+const u32 merkle_thread_min = 1024;
+
+void merkle_hash_list(vector<u8> &msg_buf, u32 n, t_hash *res) {
+  vector<const u8*> msg_list(n);
+  vector<size_t> msg_len_list(n, merkle_node_len);
+  vector<u8*> res_list(n);
+  for(u32 i=0;i<n;i++) {
+    msg_list[i] = msg_buf.data() + i*merkle_node_len;
+    res_list[i] = res[i].b;
+  }
+  sha512_multi(msg_list.data(), msg_len_list.data(), n, res_list.data());
+}
+
+void merkle_leaf_range(vector<Tx> &tx_list, vector<t_hash> &leaf_list, u32 from, u32 to) {
+  vector<u8> msg_buf((to-from)*merkle_node_len);
+  u8 *buf_ptr = msg_buf.data();
+  for(u32 i=from;i<to;i++) {
+    *buf_ptr++ = 0;
+    memcpy(buf_ptr, tx_list[i].hash.b, t_hash_size);buf_ptr+=t_hash_size;
+    memcpy(buf_ptr, tx_list[i].sign.b, t_sign_size);buf_ptr+=t_sign_size;
+  }
+  merkle_hash_list(msg_buf, to-from, &leaf_list[from]);
+}
+
+void merkle_node_range(vector<t_hash> &child_list, vector<t_hash> &node_list, u32 from, u32 to) {
+  u32 child_count = child_list.size();
+  if (to*2 > child_count) {
+    // odd tail
+    to--;
+    node_list[to] = child_list[2*to];
+  }
+  if (from >= to) return;
+  vector<u8> msg_buf((to-from)*merkle_node_len);
+  u8 *buf_ptr = msg_buf.data();
+  for(u32 i=from;i<to;i++) {
+    *buf_ptr++ = 1;
+    memcpy(buf_ptr, child_list[2*i  ].b, t_hash_size);buf_ptr+=t_hash_size;
+    memcpy(buf_ptr, child_list[2*i+1].b, t_hash_size);buf_ptr+=t_hash_size;
+  }
+  merkle_hash_list(msg_buf, to-from, &node_list[from]);
+}
+
+void merkle_tree_build(vector<Tx> &tx_list, Merkle_tree &tree) {
+  tree.level_list.clear();
+  u32 n = tx_list.size();
+  if (!n) return;
+  tree.level_list.push_back(vector<t_hash>(n));
+  par_range(n, merkle_thread_min, [&](u32 from, u32 to) {
+    merkle_leaf_range(tx_list, tree.level_list[0], from, to);
+  });
+  while(n > 1) {
+    n = (n+1)/2;
+    tree.level_list.push_back(vector<t_hash>(n));
+    auto &child_list = tree.level_list[tree.level_list.size()-2];
+    auto &node_list  = tree.level_list.back();
+    par_range(n, merkle_thread_min, [&](u32 from, u32 to) {
+      merkle_node_range(child_list, node_list, from, to);
+    });
+  }
+}
+
+// O(log n), only the rightmost path changes
+void merkle_tree_push(Merkle_tree &tree, Tx &tx) {
+  vector<Tx> tx_list(1, tx);
+  vector<t_hash> leaf_list(1);
+  merkle_leaf_range(tx_list, leaf_list, 0, 1);
+  if (!tree.level_list.size()) tree.level_list.resize(1);
+  tree.level_list[0].push_back(leaf_list[0]);
+  for(u32 k=0;tree.level_list[k].size() > 1;k++) {
+    if (k+1 == tree.level_list.size()) tree.level_list.resize(k+2);
+    auto &child_list = tree.level_list[k];
+    auto &node_list  = tree.level_list[k+1];
+    u32 i = (child_list.size()-1)/2;
+    node_list.resize(i+1);
+    merkle_node_range(child_list, node_list, i, i+1);
+  }
+}
+
+void merkle_tree_root(Merkle_tree &tree, t_hash &res) {
+  if (!tree.level_list.size()) {
+    memset(res.b, 0, sizeof(t_hash));
+    return;
+  }
+  res = tree.level_list.back()[0];
+}
+
+// siblings from leaf to root, levels where the node went up alone have none
+bool merkle_tree_proof(Merkle_tree &tree, u32 idx, vector<t_hash> &path) {
+  path.clear();
+  if (!tree.level_list.size() || idx >= tree.level_list[0].size()) return false;
+  for(u32 k=0;k+1<tree.level_list.size();k++) {
+    auto &level = tree.level_list[k];
+    if ((idx^1) < level.size()) path.push_back(level[idx^1]);
+    idx >>= 1;
+  }
+  return true;
+}
+
+// what a light client does with merkle_tree_proof output
+bool merkle_proof_verify(t_hash &leaf, u32 idx, u32 n, vector<t_hash> &path, t_hash &root) {
+  t_hash cur = leaf;
+  u32 p = 0;
+  u8 buf[merkle_node_len];
+  buf[0] = 1;
+  for(;n > 1;n = (n+1)/2, idx >>= 1) {
+    if ((idx^1) >= n) continue;
+    if (p >= path.size()) return false;
+    t_hash &left  = idx&1 ? path[p] : cur;
+    t_hash &right = idx&1 ? cur : path[p];
+    memcpy(buf+1            , left.b , t_hash_size);
+    memcpy(buf+1+t_hash_size, right.b, t_hash_size);
+    sha512(buf, merkle_node_len, cur.b);
+    p++;
+  }
+  return p == path.size() && !(cur != root);
+}
+
+void merkle_tree_calc(Block &block, t_hash &res) {
+  if (block.header.version < 2) {
+    merkle_chain_calc(block.tx_list, res);
+    return;
+  }
+  Merkle_tree tree;
+  merkle_tree_build(block.tx_list, tree);
+  merkle_tree_root(tree, res);
+}
+
+// two phases: tx are applied in order to overlay (or a temporary one), block_apply can commit it,
+// then hashes and signatures in parallel. the serial phase is the cheap one, it goes first
+bool block_validate(Block &block, State_overlay *overlay = NULL) {
+  if (bc_height() == 0) {
+    // genesis, a2pk may still be empty: its issuer key is the one it brings
+    if (block.header.id != 0 || !block_header_sign_check(block.header)) return false;
+  } else {
+    if (!block_header_validate(block.header)) return false;
+  }
+  if (block.header.version > block_version) return false;
+  State_overlay tmp_overlay;
+  if (!overlay) overlay = &tmp_overlay;
+  overlay_init(*overlay);
+  vector<t_pub_key> send_pub_key_list;
+  send_pub_key_list.reserve(block.tx_list.size());
   FOR_COL(it, block.tx_list) {
-    if (!tx_validate(*it)) return false;
+    if (!tx_validate(*it, false, overlay)) return false;
+    send_pub_key_list.push_back(overlay_a2pk_get(overlay, it->send_addr));
+    tx_apply(*it, *overlay);
   }
+  if (!tx_list_verify(block.tx_list, send_pub_key_list)) return false;
   
   t_hash merkle_tree;
-  merkle_tree_calc(block.tx_list, merkle_tree);
+  merkle_tree_calc(block, merkle_tree);
   if (merkle_tree != block.header.merkle_tree) return false;
   return true;
 }
 
 void block_sign(Block &block, t_pub_key &pub_key, t_prv_key &prv_key) {
-  merkle_tree_calc(block.tx_list, block.header.merkle_tree);
+  merkle_tree_calc(block, block.header.merkle_tree);
   block_header_sign(block.header, pub_key, prv_key);
 }
-void block_apply(Block &block) {
+// balances, keys and replay set only, shared by block_apply and chain_restore
+// overlay - from block_validate of this block against the current state, NULL = apply tx here
+void block_state_apply(Block &block, State_overlay *overlay = NULL) {
   // all tx
-  FOR_COL(it, block.tx_list) {
-    tx_apply(*it);
+  State_overlay tmp_overlay;
+  if (!overlay) {
+    overlay = &tmp_overlay;
+    overlay_init(*overlay);
+    tx_list_apply(block.tx_list, *overlay);
   }
+  Undo_block undo;
+  undo.account_count = gms.a2pk.size();
+  overlay_commit(*overlay, block.tx_list, undo);
   // лёгкий способ быстро просуммировать все tx_fee
-  gms.balance[block.header.issuer_addr] += mining_reward + tx_fee*block.tx_list.size();
-  FOR_COL(it, gms.balance) {
-    if (*it == 0) continue;// do not write optimisation
-    if (*it > hot_potato_penalty) {
-      *it -= hot_potato_penalty;
-    } else {
-      *it = 0;
-    }
-  }
+  undo_balance_save(undo, block.header.issuer_addr);
+  balance_set(block.header.issuer_addr, balance_get(block.header.issuer_addr) + mining_reward + tx_fee*block.tx_list.size());
+  // hot potato for every balance, balance_get does the rest
+  gms.demurrage_height++;
   // issue 1 addr
   gms_account_new(block.header.issuer_pub_key);
+  
+  gms.undo_list.push_back(move(undo));
+  if (gms.undo_list.size() > undo_depth) gms.undo_list.pop_front();
+}
+// block_state_apply backwards, undo must be the journal of the last applied block
+void block_state_undo(Undo_block &undo) {
+  for(u32 addr=undo.account_count;addr<gms.a2pk.size();addr++) verify_ctx_drop(addr);
+  gms.a2pk.resize(undo.account_count);
+  gms.balance.resize(undo.account_count);
+  gms.balance_height.resize(undo.account_count);
+  weight_index_truncate(undo.account_count);
+  gms.demurrage_height--;
+  for(auto it = undo.balance_list.rbegin(); it != undo.balance_list.rend(); it++) {
+    gms.balance[it->addr] = it->balance;
+    gms.balance_height[it->addr] = it->balance_height;
+    weight_index_update(it->addr);
+  }
+  for(auto it = undo.a2pk_list.rbegin(); it != undo.a2pk_list.rend(); it++) {
+    gms.a2pk[it->addr] = it->pub_key;
+    verify_ctx_drop(it->addr);
+  }
+  for(auto it = undo.replay_list.rbegin(); it != undo.replay_list.rend(); it++) {
+    replay_erase(gms.done_tx, it->tx_epoch, it->key);
+  }
+  for(auto it = undo.replay_reset_list.rbegin(); it != undo.replay_reset_list.rend(); it++) {
+    replay_table(gms.done_tx, it->tx_epoch) = *it;
+  }
+}
+void main_chain_push(Block &block) {
+  lock_guard<mutex> guard(gms.main_chain_lock);
   gms.main_chain_block_list.push_back(block);
+  while (gms.main_chain_block_list.size() > main_chain_tail_size) {
+    gms.main_chain_block_list.pop_front();
+    gms.main_chain_block_offset++;
+  }
+}
+void block_apply(Block &block, State_overlay *overlay = NULL) {
+  block_state_apply(block, overlay);
+  if (!block_log_append(block)) {
+    throw new Exception("block log append failed");
+  }
+  main_chain_push(block);
+  block_wire_cache_put(block);
+  mempool_block_remove(block);
   FOR_COL(it, gns.node_list) {
     it->is_proposal_valid = false;
   }
+  snapshot_poll();
+  if (snapshot_interval && bc_height() % snapshot_interval == 0) {
+    snapshot_start();
+  }
+  if (bc_height() % pack_block_count == pack_finality) {
+    pack_build_start();
+  }
 }
 
 void block_weight_calc(Block &block) {
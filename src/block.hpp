@@ -1,3 +1,116 @@
+// hex, caller-provided buffers, nothing allocated
+// hex_encode writes 2*len chars (no '\0'), hex_decode reads 2*len chars
+// and fails if any of them is not [0-9a-fA-F] (dst is garbage then)
+
+// byte -> 2 chars, char -> nibble or 0x80 if not hex
+struct Hex_table {
+  char enc[256][2];
+  u8   dec[256];
+  Hex_table() {
+    const char *digit = "0123456789abcdef";
+    for(int i=0;i<256;i++) {
+      enc[i][0] = digit[i >> 4];
+      enc[i][1] = digit[i & 15];
+      dec[i] = 0x80;
+    }
+    for(int i=0;i<10;i++) dec['0'+i] = i;
+    for(int i=0;i<6;i++) dec['a'+i] = dec['A'+i] = 10+i;
+  }
+} hex_table;
+
+void hex_encode_scalar(char *dst, const u8 *src, u32 len) {
+  for(u32 i=0;i<len;i++) {
+    memcpy(dst + 2*i, hex_table.enc[src[i]], 2);
+  }
+}
+bool hex_decode_scalar(u8 *dst, const char *src, u32 len) {
+  u8 bad = 0;
+  for(u32 i=0;i<len;i++) {
+    u8 hi = hex_table.dec[(u8)src[2*i  ]];
+    u8 lo = hex_table.dec[(u8)src[2*i+1]];
+    bad |= hi | lo;
+    dst[i] = hi << 4 | lo;
+  }
+  return !(bad & 0x80);
+}
+
+// 16 bytes <-> 32 chars per step, a u16 lane holds one byte as its two chars
+typedef u8  hex_v32u8  __attribute__((vector_size(32)));
+typedef unsigned short hex_v16u16 __attribute__((vector_size(32)));
+typedef u8  hex_v16u8  __attribute__((vector_size(16)));
+
+__attribute__((target("avx2")))
+void hex_encode_avx2(char *dst, const u8 *src, u32 len) {
+  u32 i = 0;
+  for(;i+16<=len;i+=16) {
+    hex_v16u8 v;
+    memcpy(&v, src+i, 16);
+    hex_v16u16 w = __builtin_convertvector(v, hex_v16u16);
+    hex_v16u16 hi = w >> 4, lo = w & 15;
+    hi += '0' + ((hex_v16u16)(hi > 9) & 39);
+    lo += '0' + ((hex_v16u16)(lo > 9) & 39);
+    w = hi | lo << 8;
+    memcpy(dst+2*i, &w, 32);
+  }
+  hex_encode_scalar(dst+2*i, src+i, len-i);
+}
+__attribute__((target("avx2")))
+bool hex_decode_avx2(u8 *dst, const char *src, u32 len) {
+  hex_v32u8 bad = {0};
+  u32 i = 0;
+  for(;i+16<=len;i+=16) {
+    hex_v32u8 c, lower, digit, alpha, val;
+    memcpy(&c, src+2*i, 32);
+    digit = c - '0';
+    lower = c | 0x20;
+    alpha = lower - 'a';
+    // unsigned compares, everything below '0' / 'a' wraps around
+    hex_v32u8 is_digit = (hex_v32u8)(digit < 10);
+    hex_v32u8 is_alpha = (hex_v32u8)(alpha < 6);
+    val  = (digit & is_digit) | ((alpha + 10) & is_alpha);
+    bad |= ~(is_digit | is_alpha);
+    hex_v16u16 w = (hex_v16u16)val;
+    w = (w & 0xff) << 4 | w >> 8;
+    hex_v16u8 out = __builtin_convertvector(w, hex_v16u8);
+    memcpy(dst+i, &out, 16);
+  }
+  for(u32 k=0;k<32;k++) {
+    if (bad[k]) return false;
+  }
+  return hex_decode_scalar(dst+i, src+2*i, len-i);
+}
+
+void (*hex_encode_kernel)(char *dst, const u8 *src, u32 len) = NULL;
+bool (*hex_decode_kernel)(u8 *dst, const char *src, u32 len) = NULL;
+void hex_init() {
+  if (hex_encode_kernel) return;
+  __builtin_cpu_init();
+  bool avx2 = __builtin_cpu_supports("avx2");
+  hex_decode_kernel = avx2 ? hex_decode_avx2 : hex_decode_scalar;
+  hex_encode_kernel = avx2 ? hex_encode_avx2 : hex_encode_scalar;
+}
+void hex_encode(char *dst, const u8 *src, u32 len) {
+  hex_init();
+  hex_encode_kernel(dst, src, len);
+}
+bool hex_decode(u8 *dst, const char *src, u32 len) {
+  hex_init();
+  return hex_decode_kernel(dst, src, len);
+}
+
+// packed blocks on the wire
+string buf2hex(const u8 *buf, u32 len) {
+  string res(2*len, '0');
+  hex_encode(&res[0], buf, len);
+  return res;
+}
+bool hex2buf(const string &str, vector<u8> &res) {
+  u32 len = str.size();
+  if (len % 2) return false;
+  res.resize(len/2);
+  return hex_decode(res.data(), str.data(), len/2);
+}
+
 #define T_ARR(name, size_) \
   const u32 name##_size = size_;                                                        \
   typedef u8 name##_buf[size_];                                                         \
@@ -8,38 +121,19 @@
   bool operator<(const name& a, const name& b){return memcmp(a.b, b.b, sizeof(a.b)<0);} \
   bool operator>(const name& a, const name& b){return memcmp(a.b, b.b, sizeof(a.b)>0);} \
   bool str2##name(const string &str, name &key) {                                       \
-    const u32 L = 2*size_;                                                              \
-    if (str.size() != L) {                                                              \
-      return false;                                                                     \
-    }                                                                                   \
-    for(int i=0;i<L;i++) {                                                              \
-      char ch = str[i];                                                                 \
-      if ('0' <= ch && ch <= '9') continue;                                             \
-      if ('a' <= ch && ch <= 'f') continue;                                             \
-      if ('A' <= ch && ch <= 'A') continue;                                             \
-      return false;                                                                     \
-    }                                                                                   \
-    char tmp[3] = {0};                                                                  \
-    char *tmp_p;                                                                        \
-    u32 dst = 0;                                                                        \
-    for(int i=0;i<L;) {                                                                 \
-      tmp[0] = str[i++];                                                                \
-      tmp[1] = str[i++];                                                                \
-      key.b[dst++] = strtol((char*)&tmp, &tmp_p, 16);                                   \
-    }                                                                                   \
-    return true;                                                                        \
+    if (str.size() != 2*size_) return false;                                            \
+    return hex_decode(key.b, str.data(), size_);                                        \
   }                                                                                     \
   string name##2str(name &t) {                                                          \
-    string res = "";                                                                    \
-    char buf[10] = {0};                                                                 \
-    for(int i=0;i<name##_size;i++) {                                                    \
-      sprintf(buf, "%02x", t.b[i]);                                                     \
-      res += buf;                                                                       \
-    }                                                                                   \
+    string res(2*size_, '0');                                                           \
+    hex_encode(&res[0], t.b, size_);                                                    \
     return res;                                                                         \
   }                                                                                     \
   void name##_print(const char *prefix_str, name &t) {                                  \
-    printf("%s%s\n", prefix_str, name##2str(t).c_str());                                \
+    char buf[2*size_+1];                                                                \
+    hex_encode(buf, t.b, size_);                                                        \
+    buf[2*size_] = 0;                                                                   \
+    printf("%s%s\n", prefix_str, buf);                                                  \
   }                                                                                     \
 
 T_ARR(t_hash, 64)
@@ -85,6 +179,7 @@ struct Tx {
   u32     send_addr       = 0;
   u32     recv_addr       = 0;
   t_pub_key bind_pub_key  = {0};
+  u32     tx_epoch        = 0;
   u32     nonce           = 0;
   // end of block
   t_hash  hash            ;
@@ -100,6 +195,61 @@ struct Block {
   u64     weight = 0;
 };
 
+// binary merkle tree over tx, pending tx of a block template or a whole block
+struct Merkle_tree {
+  // level_list[0] = leaves, back() = {root}
+  vector<vector<t_hash>> level_list;
+};
+
+// binary codec, fixed layout, little-endian
+// the *_body part is what gets hashed and signed
+// Tx:           type u32, amount u32, send_addr u32, recv_addr u32, bind_pub_key, tx_epoch u32, nonce u32 | hash, sign
+// Block_header: id u32, version u32, prev_hash, merkle_tree, issuer_addr u32, issuer_pub_key, nonce u32 | hash, sign
+// Block:        codec_version u32, Block_header, tx_count u32, Tx * tx_count
+// weight fields are cache, not packed, block_weight_calc restores them
+// 2: tx_epoch in Tx
+const u32 block_codec_version = 2;
+const u32 tx_body_size            = 4*4 + t_pub_key_size + 4*2;
+const u32 tx_pack_size            = tx_body_size + t_hash_size + t_sign_size;
+const u32 block_header_body_size  = 4*2 + 2*t_hash_size + 4 + t_pub_key_size + 4;
+const u32 block_header_pack_size  = block_header_body_size + t_hash_size + t_sign_size;
+const u32 block_pack_head_size    = 4 + block_header_pack_size + 4;
+
+// field offsets inside a packed Tx / Block_header
+const u32 tx_off_type             = 0;
+const u32 tx_off_amount           = 4;
+const u32 tx_off_send_addr        = 8;
+const u32 tx_off_recv_addr        = 12;
+const u32 tx_off_bind_pub_key     = 16;
+const u32 tx_off_tx_epoch         = 16 + t_pub_key_size;
+const u32 tx_off_nonce            = 20 + t_pub_key_size;
+const u32 tx_off_hash             = tx_body_size;
+const u32 tx_off_sign             = tx_body_size + t_hash_size;
+const u32 header_off_id           = 0;
+const u32 header_off_version      = 4;
+const u32 header_off_prev_hash    = 8;
+const u32 header_off_merkle_tree  = 8 + t_hash_size;
+const u32 header_off_issuer_addr  = 8 + 2*t_hash_size;
+const u32 header_off_issuer_pub_key = 12 + 2*t_hash_size;
+const u32 header_off_nonce        = 12 + 2*t_hash_size + t_pub_key_size;
+const u32 header_off_hash         = block_header_body_size;
+const u32 header_off_sign         = block_header_body_size + t_hash_size;
+
+// zero-copy view of a packed block, the buffer must outlive it
+struct Block_view {
+  const u8 *header;
+  u32 tx_count = 0;
+  // tx i at tx_list + i*tx_pack_size
+  const u8 *tx_list;
+};
+
+// 1: merkle_tree is a hash chain over tx signs
+// 2: merkle_tree is the root of a binary Merkle_tree
+const u32 block_version = 2;
 const u32 tx_fee = 10;
 const u32 mining_reward = 10;
 const u32 hot_potato_penalty = 1;
+// tx_epoch = chain height / tx_epoch_blocks when the tx was made
+// a tx is valid for tx_epoch_window epochs after its own, replay entries live as long
+const u32 tx_epoch_blocks = 256;
+const u32 tx_epoch_window = 2;
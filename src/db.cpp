@@ -1,30 +1,584 @@
 #include "db.hpp"
 #include "net.hpp"
 // single block
-int block_pack_size(Block &block) {
-  int res = 0;
+// layout in block.hpp, same bytes for disk and wire
+u32 block_pack_size(Block &block) {
+  return block_pack_head_size + block.tx_list.size()*tx_pack_size;
+}
+void block_pack(Block &block, vector<u8> &buf) {
+  buf.resize(block_pack_size(block));
+  u8 *p = buf.data();
+  pack_u32(p, block_codec_version);
+  block_header_pack(block.header, p);
+  p += block_header_pack_size;
+  pack_u32(p, block.tx_list.size());
+  FOR_COL(it, block.tx_list) {
+    tx_pack(*it, p);
+    p += tx_pack_size;
+  }
+}
+bool block_unpack(const u8 *buf, u32 len, Block &block) {
+  Block_view view;
+  if (!block_view_parse(buf, len, view)) return false;
+  block_header_unpack(view.header, block.header);
+  block.tx_list.resize(view.tx_count);
+  for(u32 i=0;i<view.tx_count;i++) {
+    tx_unpack(view.tx_list + i*tx_pack_size, block.tx_list[i]);
+  }
+  block_weight_calc(block);
+  return true;
+}
+string block_to_hex(Block &block) {
+  vector<u8> buf;
+  block_pack(block, buf);
+  return buf2hex(buf.data(), buf.size());
+}
+bool hex_to_block(const string &str, Block &block) {
+  vector<u8> buf;
+  if (!hex2buf(str, buf)) return false;
+  return block_unpack(buf.data(), buf.size(), block);
+}
+shared_ptr<Block_wire> block_wire_make(Block &block) {
+  auto wire = make_shared<Block_wire>();
+  wire->hash = block.header.hash;
+  block_to_json(block, wire->json);
+  wire->bin = block_to_hex(block);
+  wire->size = sizeof(Block_wire) + 4*wire->bin.size();
+  return wire;
+}
+void block_wire_cache_put(Block &block) {
+  auto &c = block_wire_cache;
+  shared_ptr<Block_wire> wire;
+  {
+    lock_guard<mutex> guard(c.lock);
+    // committed proposal, already encoded
+    if (c.proposal && !(c.proposal->hash != block.header.hash)) wire = c.proposal;
+  }
+  if (!wire) wire = block_wire_make(block);
   
+  lock_guard<mutex> guard(c.lock);
+  auto &slot = c.id_hash[block.header.id];
+  if (slot) c.size -= slot->size;
+  slot = wire;
+  c.size += wire->size;
+  while (c.size > c.size_limit && c.id_hash.size() > 1) {
+    auto it = c.id_hash.begin();
+    c.size -= it->second->size;
+    c.id_hash.erase(it);
+  }
+}
+void block_wire_proposal_set(Block &block) {
+  auto wire = block_wire_make(block);
+  lock_guard<mutex> guard(block_wire_cache.lock);
+  block_wire_cache.proposal = wire;
+}
+shared_ptr<Block_wire> block_wire_get(u32 id) {
+  lock_guard<mutex> guard(block_wire_cache.lock);
+  auto it = block_wire_cache.id_hash.find(id);
+  if (it == block_wire_cache.id_hash.end()) return nullptr;
+  return it->second;
+}
+shared_ptr<Block_wire> block_wire_proposal_get() {
+  lock_guard<mutex> guard(block_wire_cache.lock);
+  return block_wire_cache.proposal;
+}
+void block_wire_cache_drop_from(u32 id) {
+  auto &c = block_wire_cache;
+  lock_guard<mutex> guard(c.lock);
+  for(auto it = c.id_hash.lower_bound(id); it != c.id_hash.end();) {
+    c.size -= it->second->size;
+    it = c.id_hash.erase(it);
+  }
+}
+
+// group commit
+void persist_append() {
+  if (!durability) return;
+  unique_lock<mutex> lk(persist.lock);
+  u64 seq = ++persist.seq_appended;
+  persist.pending_time.push_back(chrono::steady_clock::now());
+  persist.wake.notify_one();
+  if (durability == 2 && persist.running) {
+    persist.done.wait(lk, [seq]() { return persist.seq_durable >= seq; });
+  }
+}
+void persist_dir_dirty() {
+  if (!durability) return;
+  lock_guard<mutex> guard(persist.lock);
+  persist.dir_dirty = true;
+  persist.wake.notify_one();
+}
+void persist_writer() {
+  unique_lock<mutex> lk(persist.lock);
+  persist.running = true;
+  while (true) {
+    persist.wake.wait(lk, []() { return persist.seq_appended > persist.seq_durable || persist.dir_dirty || persist.stop; });
+    u64 target = persist.seq_appended;
+    bool dir = persist.dir_dirty;
+    persist.dir_dirty = false;
+    lk.unlock();
+    // dups, a truncate may close the originals meanwhile
+    // segments first, the index must not point at frames that are not on disk
+    vector<int> fd_list;
+    {
+      lock_guard<mutex> guard(block_log.lock);
+      for(u32 i=block_log.sync_segment;i<block_log.seg_fd.size();i++) {
+        fd_list.push_back(dup(block_log.seg_fd[i]));
+      }
+      block_log.sync_segment = block_log.seg_fd.size() - 1;
+      fd_list.push_back(dup(block_log.height_fd));
+      fd_list.push_back(dup(block_log.hash_fd));
+    }
+    FOR_COL(it, fd_list) {
+      if (*it < 0) continue;
+      fdatasync(*it);
+      close(*it);
+    }
+    if (dir) {
+      int dir_fd = open(chain_path.c_str(), O_RDONLY | O_DIRECTORY);
+      if (dir_fd >= 0) {
+        fsync(dir_fd);
+        close(dir_fd);
+      }
+    }
+    auto now = chrono::steady_clock::now();
+    lk.lock();
+    u64 batch = target - persist.seq_durable;
+    for(u64 i=0;i<batch;i++) {
+      u64 us = chrono::duration_cast<chrono::microseconds>(now - persist.pending_time.front()).count();
+      persist.pending_time.pop_front();
+      persist.latency_sum_us += us;
+      persist.latency_max_us = max(persist.latency_max_us, us);
+      persist.latency_last_us = us;
+    }
+    persist.seq_durable = target;
+    persist.commit_count++;
+    persist.batch_max = max(persist.batch_max, batch);
+    if (persist.stop && persist.seq_appended == target && !persist.dir_dirty) {
+      persist.running = false;
+      persist.done.notify_all();
+      return;
+    }
+    persist.done.notify_all();
+  }
+}
+// last commit, then the writer is gone before the globals it waits on
+void persist_stop() {
+  unique_lock<mutex> lk(persist.lock);
+  if (!persist.running) return;
+  persist.stop = true;
+  persist.wake.notify_one();
+  persist.done.wait(lk, []() { return !persist.running; });
+}
+
+// block log, callers hold block_log.lock
+string block_log_seg_path(u32 segment) {
+  char name[32];
+  snprintf(name, sizeof(name), "/seg_%06u.log", segment);
+  return block_log.path + name;
+}
+// (re)maps a whole index file, head first
+bool block_log_idx_map(int fd, Block_log_idx_head *&head, u32 entry_size, u32 capacity) {
+  size_t len = sizeof(Block_log_idx_head) + (size_t)entry_size*capacity;
+  Block_log_idx_head old;
+  bool fresh = !head;
+  if (head) {
+    old = *head;
+    munmap(head, sizeof(Block_log_idx_head) + (size_t)entry_size*head->capacity);
+    head = NULL;
+  }
+  if (ftruncate(fd, len)) return false;
+  void *p = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (p == MAP_FAILED) return false;
+  head = (Block_log_idx_head*)p;
+  if (!fresh) *head = old;
+  head->capacity = capacity;
+  return true;
+}
+bool block_log_idx_open(const string &path, int &fd, Block_log_idx_head *&head, u32 entry_size, u32 capacity) {
+  fd = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+  if (fd < 0) return false;
+  struct stat st;
+  if (fstat(fd, &st)) return false;
+  Block_log_idx_head tmp = {0};
+  if (st.st_size >= sizeof(tmp)) pread(fd, &tmp, sizeof(tmp), 0);
+  bool valid = tmp.magic == block_log_magic && tmp.version == block_log_version &&
+    st.st_size == sizeof(tmp) + (size_t)entry_size*tmp.capacity && tmp.count <= tmp.capacity;
+  if (valid) capacity = tmp.capacity;
+  if (!block_log_idx_map(fd, head, entry_size, capacity)) return false;
+  if (!valid) {
+    head->magic = block_log_magic;
+    head->version = block_log_version;
+    head->count = 0;
+  }
+  return true;
+}
+u32 block_log_hash_slot(const u8 *key) {
+  u32 res;
+  memcpy(&res, key, 4);
   return res;
 }
-void block_pack(Block &block) {
-  
+void block_log_hash_insert(u32 id) {
+  u32 mask = block_log.hash_head->capacity - 1;
+  u32 i = block_log_hash_slot(block_log.height[id].key) & mask;
+  while (block_log.hash[i]) i = (i + 1) & mask;
+  block_log.hash[i] = id + 1;
+  block_log.hash_head->count++;
+}
+bool block_log_hash_rebuild(u32 capacity) {
+  if (!block_log_idx_map(block_log.hash_fd, block_log.hash_head, sizeof(u32), capacity)) return false;
+  block_log.hash = (u32*)(block_log.hash_head + 1);
+  memset(block_log.hash, 0, sizeof(u32)*capacity);
+  block_log.hash_head->count = 0;
+  for(u32 i=0;i<block_log.height_head->count;i++) block_log_hash_insert(i);
+  return true;
+}
+bool block_log_seg_open(u32 segment, bool trunc) {
+  int fd = open(block_log_seg_path(segment).c_str(), O_RDWR | O_CREAT | (trunc ? O_TRUNC : 0), 0644);
+  if (fd < 0) return false;
+  block_log.seg_fd.push_back(fd);
+  return true;
+}
+bool block_log_frame_read(Block_log_pos &pos, vector<u8> &buf) {
+  if (pos.segment >= block_log.seg_fd.size()) return false;
+  u32 head[2];
+  int fd = block_log.seg_fd[pos.segment];
+  if (pread(fd, head, sizeof(head), pos.offset) != sizeof(head)) return false;
+  if (head[0] != pos.len || head[1] != pos.crc) return false;
+  buf.resize(pos.len);
+  if (pread(fd, buf.data(), pos.len, pos.offset + block_log_frame_head_size) != pos.len) return false;
+  return crc32c(buf.data(), buf.size()) == pos.crc;
+}
+// drops heights >= count together with their frames
+void block_log_cut(u32 count) {
+  auto &l = block_log;
+  if (count > l.height_head->count) return;
+  u32 segment = 0, end = 0;
+  if (count) {
+    Block_log_pos &pos = l.height[count-1];
+    segment = pos.segment;
+    end = pos.offset + block_log_frame_head_size + pos.len;
+  }
+  while (l.seg_fd.size() > segment + 1) {
+    close(l.seg_fd.back());
+    unlink(block_log_seg_path(l.seg_fd.size()-1).c_str());
+    l.seg_fd.pop_back();
+  }
+  ftruncate(l.seg_fd[segment], end);
+  l.seg_size = end;
+  l.sync_segment = min(l.sync_segment, segment);
+  l.height_head->count = count;
+  block_log_hash_rebuild(l.hash_head->capacity);
+}
+
+bool block_log_open(const string &path) {
+  auto &l = block_log;
+  lock_guard<mutex> guard(l.lock);
+  l.path = path;
+  mkdir(path.c_str(), 0755);
+  if (!block_log_idx_open(path + "/height.idx", l.height_fd, l.height_head, sizeof(Block_log_pos), 1024)) return false;
+  l.height = (Block_log_pos*)(l.height_head + 1);
+  if (!block_log_idx_open(path + "/hash.idx", l.hash_fd, l.hash_head, sizeof(u32), 2048)) return false;
+  l.hash = (u32*)(l.hash_head + 1);
+  u32 count = l.height_head->count;
+  u32 last_segment = count ? l.height[count-1].segment : 0;
+  for(u32 i=0;i<=last_segment;i++) {
+    if (!block_log_seg_open(i, false)) return false;
+  }
+  // torn tail: index entry written, frame not (or the other way around)
+  vector<u8> buf;
+  while (count && !block_log_frame_read(l.height[count-1], buf)) count--;
+  block_log_cut(count);
+  return true;
 }
-void block_unpack(Block &block) {
+void block_log_truncate(u32 count) {
+  {
+    lock_guard<mutex> guard(block_log.lock);
+    block_log_cut(count);
+  }
+  pack_drop_from(count);
+  persist_dir_dirty();
+}
+bool block_log_write(Block &block) {
+  auto &l = block_log;
+  vector<u8> buf(block_log_frame_head_size);
+  {
+    vector<u8> body;
+    block_pack(block, body);
+    buf.insert(buf.end(), body.begin(), body.end());
+  }
+  Block_log_pos pos;
+  pos.len = buf.size() - block_log_frame_head_size;
+  pos.crc = crc32c(buf.data() + block_log_frame_head_size, pos.len);
+  memcpy(pos.key, block.header.hash.b, sizeof(pos.key));
+  memcpy(buf.data(), &pos.len, 4);
+  memcpy(buf.data() + 4, &pos.crc, 4);
+  
+  lock_guard<mutex> guard(l.lock);
+  if (!l.height_head) return false;
+  if (l.seg_size && l.seg_size + buf.size() > block_log_segment_size) {
+    if (!block_log_seg_open(l.seg_fd.size(), true)) return false;
+    l.seg_size = 0;
+  }
+  pos.segment = l.seg_fd.size() - 1;
+  pos.offset = l.seg_size;
+  if (pwrite(l.seg_fd[pos.segment], buf.data(), buf.size(), pos.offset) != buf.size()) return false;
+  l.seg_size += buf.size();
   
+  u32 id = l.height_head->count;
+  if (id == l.height_head->capacity) {
+    if (!block_log_idx_map(l.height_fd, l.height_head, sizeof(Block_log_pos), 2*id)) return false;
+    l.height = (Block_log_pos*)(l.height_head + 1);
+  }
+  l.height[id] = pos;
+  // count last, a crash before it leaves the frame unreferenced
+  l.height_head->count = id + 1;
+  if (2*(id + 1) > l.hash_head->capacity) {
+    return block_log_hash_rebuild(2*l.hash_head->capacity);
+  }
+  block_log_hash_insert(id);
+  return true;
+}
+bool block_log_append(Block &block) {
+  if (!block_log_write(block)) return false;
+  persist_append();
+  return true;
+}
+bool block_log_read(u32 id, vector<u8> &buf) {
+  lock_guard<mutex> guard(block_log.lock);
+  if (!block_log.height_head || id >= block_log.height_head->count) return false;
+  return block_log_frame_read(block_log.height[id], buf);
+}
+bool block_log_find(t_hash &hash, u32 &id) {
+  auto &l = block_log;
+  lock_guard<mutex> guard(l.lock);
+  if (!l.hash_head) return false;
+  u32 mask = l.hash_head->capacity - 1;
+  for(u32 i = block_log_hash_slot(hash.b) & mask; l.hash[i]; i = (i + 1) & mask) {
+    Block_log_pos &pos = l.height[l.hash[i] - 1];
+    if (!memcmp(pos.key, hash.b, sizeof(pos.key))) {
+      id = l.hash[i] - 1;
+      return true;
+    }
+  }
+  return false;
+}
+// copy of block id if it is in the memory tail, safe from any thread
+bool main_chain_tail_get(u32 id, Block &block) {
+  lock_guard<mutex> guard(gms.main_chain_lock);
+  if (id < gms.main_chain_block_offset || id - gms.main_chain_block_offset >= gms.main_chain_block_list.size()) return false;
+  block = gms.main_chain_block_list[id - gms.main_chain_block_offset];
+  return true;
+}
+// tail from memory, the rest from the log
+bool block_get(u32 id, Block &block) {
+  if (id >= bc_height()) return false;
+  if (main_chain_tail_get(id, block)) return true;
+  vector<u8> buf;
+  if (!block_log_read(id, buf)) return false;
+  return block_unpack(buf.data(), buf.size(), block);
 }
 
 // 1024 block pack 
+string pack_path(u32 pack_id) {
+  char name[32];
+  snprintf(name, sizeof(name), "/pack_%06u.bin", pack_id);
+  return chain_path + name;
+}
+// block_pack <-> the same without tx hashes
+bool pack_block_strip(const vector<u8> &buf, vector<u8> &res) {
+  Block_view view;
+  if (!block_view_parse(buf.data(), buf.size(), view)) return false;
+  res.resize(block_pack_head_size + view.tx_count*pack_tx_size);
+  memcpy(res.data(), buf.data(), block_pack_head_size);
+  u8 *p = res.data() + block_pack_head_size;
+  for(u32 i=0;i<view.tx_count;i++) {
+    const u8 *tx = view.tx_list + i*tx_pack_size;
+    pack_buf(p, tx, tx_body_size);
+    pack_buf(p, tx + tx_off_sign, t_sign_size);
+  }
+  return true;
+}
+bool pack_block_restore(const u8 *buf, u32 len, vector<u8> &res) {
+  if (len < block_pack_head_size) return false;
+  u32 tx_count = unpack_u32(buf + 4 + block_header_pack_size);
+  if ((u64)tx_count*pack_tx_size != len - block_pack_head_size) return false;
+  res.resize(block_pack_head_size + tx_count*tx_pack_size);
+  memcpy(res.data(), buf, block_pack_head_size);
+  u8 *p = res.data() + block_pack_head_size;
+  buf += block_pack_head_size;
+  for(u32 i=0;i<tx_count;i++) {
+    memcpy(p, buf, tx_body_size);
+    sha512(buf, tx_body_size, p + tx_off_hash);
+    memcpy(p + tx_off_sign, buf + tx_body_size, t_sign_size);
+    p += tx_pack_size;
+    buf += pack_tx_size;
+  }
+  return true;
+}
 
+bool pack_build(u32 pack_id, vector<u8> &file) {
+  file.assign(pack_head_size, 0);
+  u8 *p = file.data();
+  pack_u32(p, pack_magic);
+  pack_u32(p, pack_version);
+  pack_u32(p, pack_id*pack_block_count);
+  pack_u32(p, pack_block_count);
+  vector<u8> buf, raw;
+  vector<u64> offset_list;
+  for(u32 i=0;i<pack_block_count;i++) {
+    offset_list.push_back(file.size());
+    if (!block_log_read(pack_id*pack_block_count + i, buf)) return false;
+    if (!pack_block_strip(buf, raw)) return false;
+    uLongf len = compressBound(raw.size());
+    size_t offset = file.size();
+    file.resize(offset + 4 + len);
+    p = file.data() + offset;
+    pack_u32(p, raw.size());
+    if (compress2(p, &len, raw.data(), raw.size(), Z_BEST_SPEED) != Z_OK) return false;
+    file.resize(offset + 4 + len);
+  }
+  offset_list.push_back(file.size());
+  p = file.data() + 4*4;
+  FOR_COL(it, offset_list) {
+    memcpy(p, &*it, 8);
+    p += 8;
+  }
+  size_t offset = file.size();
+  file.resize(offset + 4);
+  p = file.data() + offset;
+  pack_u32(p, crc32c(file.data(), offset));
+  return true;
+}
+// upper bounds for what a peer sends, checked before anything is allocated
+u64 pack_raw_max() {
+  return block_pack_head_size + (u64)block_tx_limit*tx_pack_size;
+}
+u64 pack_size_max() {
+  return pack_head_size + 4 + pack_block_count*(4 + (u64)compressBound(pack_raw_max()));
+}
+bool pack_unpack(const u8 *buf, size_t len, u32 pack_id, vector<Block> &block_list) {
+  if (len < pack_head_size + 4) return false;
+  if (unpack_u32(buf + len - 4) != crc32c(buf, len - 4)) return false;
+  if (unpack_u32(buf) != pack_magic || unpack_u32(buf+4) != pack_version) return false;
+  if (unpack_u32(buf+8) != pack_id*pack_block_count || unpack_u32(buf+12) != pack_block_count) return false;
+  u64 offset_list[pack_block_count + 1];
+  memcpy(offset_list, buf + 4*4, sizeof(offset_list));
+  if (offset_list[0] != pack_head_size || offset_list[pack_block_count] != len - 4) return false;
+  block_list.resize(pack_block_count);
+  vector<u8> raw, full;
+  for(u32 i=0;i<pack_block_count;i++) {
+    u64 from = offset_list[i], to = offset_list[i+1];
+    if (to < from + 4 || to > len - 4) return false;
+    uLongf raw_len = unpack_u32(buf + from);
+    if (raw_len > pack_raw_max()) return false;
+    raw.resize(raw_len);
+    if (uncompress(raw.data(), &raw_len, buf + from + 4, to - from - 4) != Z_OK) return false;
+    if (raw_len != raw.size()) return false;
+    if (!pack_block_restore(raw.data(), raw.size(), full)) return false;
+    if (!block_unpack(full.data(), full.size(), block_list[i])) return false;
+  }
+  return true;
+}
 
+u32 pack_ready_count() {
+  lock_guard<mutex> guard(block_log.lock);
+  u32 count = block_log.height_head ? block_log.height_head->count : 0;
+  return count < pack_finality ? 0 : (count - pack_finality)/pack_block_count;
+}
+// builds every pack the log has blocks for, one background thread at a time
+void pack_build_start() {
+  u32 ready = pack_ready_count();
+  u32 generation;
+  {
+    lock_guard<mutex> guard(pack_state.lock);
+    if (pack_state.building || pack_state.count >= ready) return;
+    pack_state.building = true;
+    generation = pack_state.generation;
+  }
+  thread([ready, generation]() {
+    vector<u8> file;
+    while (true) {
+      u32 pack_id;
+      {
+        lock_guard<mutex> guard(pack_state.lock);
+        pack_id = pack_state.count;
+        if (pack_id >= ready || pack_state.generation != generation) break;
+      }
+      string path = pack_path(pack_id);
+      if (!pack_build(pack_id, file) || !file_save_atomic(path, file.data(), file.size())) break;
+      lock_guard<mutex> guard(pack_state.lock);
+      if (pack_state.generation != generation) {
+        unlink(pack_path(pack_id).c_str());
+        break;
+      }
+      pack_state.count++;
+      persist_dir_dirty();
+    }
+    lock_guard<mutex> guard(pack_state.lock);
+    pack_state.building = false;
+  }).detach();
+}
+// packs the log still covers
+void pack_scan() {
+  u32 ready = pack_ready_count(), count = 0;
+  while (count < ready) {
+    string path = pack_path(count);
+    if (!file_exists(path)) break;
+    count++;
+  }
+  {
+    lock_guard<mutex> guard(pack_state.lock);
+    pack_state.count = count;
+  }
+  pack_build_start();
+}
+// log cut back to height
+void pack_drop_from(u32 height) {
+  lock_guard<mutex> guard(pack_state.lock);
+  pack_state.generation++;
+  while (pack_state.count && pack_state.count*pack_block_count > height) {
+    pack_state.count--;
+    unlink(pack_path(pack_state.count).c_str());
+  }
+}
+
+// keys
+// seeds are drawn per chunk, one getrandom and one shared inversion each
+const u32 key_gen_bulk_chunk = 256;
+
+bool key_gen_bulk(u32 count, vector<t_pub_key> &pub_key_list, vector<t_prv_key> &prv_key_list) {
+  pub_key_list.resize(count);
+  prv_key_list.resize(count);
+  // pick the select kernel before threads race for it
+  ge_select_init();
+  u32 chunk_count = (count + key_gen_bulk_chunk - 1)/key_gen_bulk_chunk;
+  vector<u8> chunk_ok(chunk_count, 0);
+  par_range(chunk_count, 1, [&](u32 from, u32 to) {
+    vector<u8> seed_list(32*key_gen_bulk_chunk);
+    for(u32 i=from;i<to;i++) {
+      u32 offset = i*key_gen_bulk_chunk;
+      u32 len = min(key_gen_bulk_chunk, count - offset);
+      if (ed25519_create_seeds(seed_list.data(), len)) continue;
+      if (ed25519_create_keypairs(pub_key_list[offset].b, prv_key_list[offset].b, seed_list.data(), len)) continue;
+      chunk_ok[i] = 1;
+    }
+    memset(seed_list.data(), 0, seed_list.size());
+  });
+  FOR_COL(it, chunk_ok) {
+    if (!*it) return false;
+  }
+  return true;
+}
 
 // mem state
 void gms_init() {
   gms_account_new(my_pub_key);
-  gms.balance[0] = 1e6;
+  balance_set(0, 1e6);
   
   Block block;
   block.header.id = 0;
-  block.header.version = 1;
+  block.header.version = block_version;
   block.header.issuer_addr = 0;
   block.header.issuer_pub_key = my_pub_key;
   block.header.nonce = 0;
@@ -37,31 +591,541 @@ void gms_init() {
   gms.ready = true;
 }
 
+// snapshot
+void snapshot_pack(vector<u8> &buf) {
+  u32 account_count = gms.a2pk.size();
+  buf.resize(4*4 + t_hash_size + account_count*(t_pub_key_size + 4));
+  u8 *p = buf.data();
+  pack_u32(p, snapshot_magic);
+  pack_u32(p, snapshot_version);
+  pack_u32(p, bc_height());
+  pack_buf(p, gms.main_chain_block_list.back().header.hash.b, t_hash_size);
+  pack_u32(p, account_count);
+  FOR_COL(it, gms.a2pk) pack_buf(p, it->b, t_pub_key_size);
+  for(u32 addr=0;addr<account_count;addr++) pack_u32(p, balance_get(addr));
+  // replay tables as they are, loading is a copy
+  for(u32 i=0;i<=tx_epoch_window;i++) {
+    Replay_table *it = &gms.done_tx.table_list[i];
+    size_t offset = buf.size();
+    buf.resize(offset + 4*3 + it->slot_list.size()*sizeof(Replay_key));
+    p = buf.data() + offset;
+    pack_u32(p, it->tx_epoch);
+    pack_u32(p, it->count);
+    pack_u32(p, it->slot_list.size());
+    pack_buf(p, (const u8*)it->slot_list.data(), it->slot_list.size()*sizeof(Replay_key));
+  }
+  size_t offset = buf.size();
+  buf.resize(offset + 4);
+  p = buf.data() + offset;
+  pack_u32(p, crc32c(buf.data(), offset));
+}
+bool snapshot_write(string path) {
+  vector<u8> buf;
+  snapshot_pack(buf);
+  return file_save_atomic(path, buf.data(), buf.size());
+}
+// one writer at a time, the child works on its copy-on-write view of gms
+// reaps the writer, true if none is running
+bool snapshot_poll() {
+  if (!snapshot_pid) return true;
+  int status;
+  if (waitpid(snapshot_pid, &status, WNOHANG) == 0) return false;
+  snapshot_pid = 0;
+  // snapshot marker, the rename goes into the next group commit
+  if (WIFEXITED(status) && !WEXITSTATUS(status)) persist_dir_dirty();
+  return true;
+}
+void snapshot_start() {
+  if (!snapshot_poll()) return;
+  if (!gms.main_chain_block_list.size()) return;
+  pid_t pid = fork();
+  if (pid == 0) {
+    _exit(snapshot_write(chain_path + "/snapshot.bin") ? 0 : 1);
+  }
+  if (pid > 0) snapshot_pid = pid;
+}
+// fills gms state, returns its bc_height or 0
+u32 snapshot_load(const string &path) {
+  FILE *fh = fopen(path.c_str(), "rb");
+  if (!fh) return 0;
+  vector<u8> buf;
+  fseek(fh, 0, SEEK_END);
+  long len = ftell(fh);
+  fseek(fh, 0, SEEK_SET);
+  if (len > 0) {
+    buf.resize(len);
+    if (fread(buf.data(), 1, len, fh) != len) buf.clear();
+  }
+  fclose(fh);
+  
+  const u8 *p = buf.data(), *end = p + buf.size();
+  u32 head_size = 4*4 + t_hash_size;
+  if (buf.size() < head_size + 4) return 0;
+  if (unpack_u32(end - 4) != crc32c(p, buf.size() - 4)) return 0;
+  end -= 4;
+  if (unpack_u32(p) != snapshot_magic || unpack_u32(p+4) != snapshot_version) return 0;
+  u32 height = unpack_u32(p+8);
+  t_hash hash;
+  memcpy(hash.b, p+12, t_hash_size);
+  u32 account_count = unpack_u32(p + 12 + t_hash_size);
+  p += head_size;
+  // must be the block our log has at that height
+  Block last;
+  vector<u8> block_buf;
+  if (!height || !block_log_read(height-1, block_buf)) return 0;
+  if (!block_unpack(block_buf.data(), block_buf.size(), last)) return 0;
+  if (last.header.hash != hash) return 0;
+  
+  if (end - p < (i64)account_count*(t_pub_key_size + 4)) return 0;
+  gms.a2pk.resize(account_count);
+  gms.balance.resize(account_count);
+  // snapshot balances are settled, demurrage starts over
+  gms.demurrage_height = 0;
+  gms.balance_height.assign(account_count, 0);
+  FOR_COL(it, gms.a2pk) {
+    memcpy(it->b, p, t_pub_key_size);
+    p += t_pub_key_size;
+  }
+  FOR_COL(it, gms.balance) {
+    *it = unpack_u32(p);
+    p += 4;
+  }
+  for(u32 i=0;i<=tx_epoch_window;i++) {
+    Replay_table *it = &gms.done_tx.table_list[i];
+    if (end - p < 4*3) return 0;
+    it->tx_epoch = unpack_u32(p);
+    it->count = unpack_u32(p+4);
+    u32 capacity = unpack_u32(p+8);
+    p += 4*3;
+    // power of 2, at most half full
+    if (capacity & (capacity - 1) || 2*(u64)it->count > capacity) return 0;
+    if (end - p < (i64)capacity*sizeof(Replay_key)) return 0;
+    it->slot_list.resize(capacity);
+    memcpy(it->slot_list.data(), p, capacity*sizeof(Replay_key));
+    p += capacity*sizeof(Replay_key);
+  }
+  if (p != end) return 0;
+  return height;
+}
+// state before genesis
+void chain_state_reset() {
+  gms.undo_list.clear();
+  gms.a2pk.clear();
+  gms.balance.clear();
+  gms.balance_height.clear();
+  gms.demurrage_height = 0;
+  gms.done_tx = Replay_set();
+  weight_index_rebuild();
+}
+// block id from the log applied to gms, false if it can't be read
+bool chain_replay_block(u32 id, vector<u8> &buf, Block &block) {
+  if (!block_log_read(id, buf) || !block_unpack(buf.data(), buf.size(), block)) return false;
+  if (id == 0) {
+    // genesis костыль, как в net_ask_con
+    gms_account_new(block.header.issuer_pub_key);
+    balance_set(0, 1e6);
+  }
+  block_state_apply(block);
+  return true;
+}
+// latest snapshot, then the blocks the log has after it
+u32 chain_restore() {
+  // journals are relative to the state they were made on
+  gms.undo_list.clear();
+  u32 count;
+  {
+    lock_guard<mutex> guard(block_log.lock);
+    count = block_log.height_head->count;
+  }
+  u32 height = snapshot_load(chain_path + "/snapshot.bin");
+  if (!height || height > count) {
+    height = 0;
+    chain_state_reset();
+  }
+  weight_index_rebuild();
+  vector<u8> buf;
+  Block block;
+  for(u32 id=height;id<count;id++) {
+    if (!chain_replay_block(id, buf, block)) {
+      // state is good up to id, forget the rest
+      block_log_truncate(id);
+      count = id;
+      break;
+    }
+  }
+  lock_guard<mutex> guard(gms.main_chain_lock);
+  gms.main_chain_block_list.clear();
+  gms.main_chain_block_offset = count - min(count, main_chain_tail_size);
+  for(u32 id=gms.main_chain_block_offset;id<count;id++) {
+    if (!block_log_read(id, buf) || !block_unpack(buf.data(), buf.size(), block)) break;
+    gms.main_chain_block_list.push_back(block);
+  }
+  if (bc_height() != count) {
+    // tail unreadable after a good replay, nothing sane to serve
+    throw new Exception("block log tail read failed");
+  }
+  return count;
+}
+
+// replay check, --replay_check, runs instead of the node
+// crc32c of what consensus depends on: keys, balances after demurrage, applied tx hashes
+// replay tables go in as sorted key lists, their slot layout depends on the insert/erase history
+u32 state_crc() {
+  vector<u8> buf;
+  u32 account_count = gms.a2pk.size();
+  buf.resize(4 + account_count*(t_pub_key_size + 4));
+  u8 *p = buf.data();
+  pack_u32(p, account_count);
+  FOR_COL(it, gms.a2pk) pack_buf(p, it->b, t_pub_key_size);
+  for(u32 addr=0;addr<account_count;addr++) pack_u32(p, balance_get(addr));
+  for(u32 i=0;i<=tx_epoch_window;i++) {
+    Replay_table &table = gms.done_tx.table_list[i];
+    if (!table.count) continue;
+    vector<Replay_key> key_list;
+    FOR_COL(it, table.slot_list) {
+      if (!replay_key_empty(*it)) key_list.push_back(*it);
+    }
+    sort(key_list.begin(), key_list.end(), [](const Replay_key &a, const Replay_key &b) {
+      return memcmp(a.b, b.b, replay_key_size) < 0;
+    });
+    u8 head[8];
+    p = head;
+    pack_u32(p, table.tx_epoch);
+    pack_u32(p, table.count);
+    buf.insert(buf.end(), head, head + 8);
+    buf.insert(buf.end(), (u8*)key_list.data(), (u8*)(key_list.data() + key_list.size()));
+  }
+  return crc32c(buf.data(), buf.size());
+}
+// hot potato the way it was before balance_height: every block takes penalty off every balance
+// reference for balance_get, O(accounts) per block
+void demurrage_eager_apply(vector<u32> &balance, Block &block, bool genesis) {
+  if (genesis) balance.push_back(1e6);
+  FOR_COL(it, block.tx_list) {
+    switch(it->type) {
+      case 1:
+        balance[it->send_addr] -= it->amount+tx_fee;
+        balance[it->recv_addr] += it->amount;
+        break;
+      case 2:
+        balance[it->send_addr] -= tx_fee;
+        break;
+    }
+  }
+  balance[block.header.issuer_addr] += mining_reward + tx_fee*block.tx_list.size();
+  FOR_COL(it, balance) {
+    *it = *it > hot_potato_penalty ? *it - hot_potato_penalty : 0;
+  }
+  balance.push_back(0);
+}
+// rebuilds gms from the whole log twice, tx applied one by one and then sharded over the work pool
+// first pass: the eager engine runs alongside and is compared to balance_get
+// for the accounts of every block and for all of them at the end
+// both results are compared to the live state
+bool replay_check() {
+  u32 count = bc_height();
+  u32 live_crc = state_crc();
+  vector<u32> eager;
+  u32 eager_mismatch = 0;
+  vector<u8> buf;
+  Block block;
+  auto replay = [&](u32 thread_count, bool eager_check) -> bool {
+    tx_apply_thread_count = thread_count;
+    chain_state_reset();
+    auto t0 = chrono::steady_clock::now();
+    for(u32 id=0;id<count;id++) {
+      if (!chain_replay_block(id, buf, block)) {
+        printf("replay check: block %u unreadable\n", id);
+        return false;
+      }
+      if (!eager_check) continue;
+      demurrage_eager_apply(eager, block, id == 0);
+      auto check = [&](u32 addr) {
+        if (eager[addr] != balance_get(addr)) eager_mismatch++;
+      };
+      FOR_COL(it, block.tx_list) {
+        check(it->send_addr);
+        check(it->recv_addr);
+      }
+      check(block.header.issuer_addr);
+    }
+    for(u32 addr=0;eager_check && addr<eager.size();addr++) {
+      if (eager[addr] != balance_get(addr)) eager_mismatch++;
+    }
+    auto t1 = chrono::steady_clock::now();
+    printf("replay check: %u blocks %u accounts, %u threads in %.0f ms\n", count, (u32)gms.a2pk.size(), thread_count, chrono::duration<double, milli>(t1-t0).count());
+    return true;
+  };
+  bool ok = replay(1, true);
+  u32 serial_crc = state_crc();
+  // sharded even for small blocks and on one core, the split and merge are what is checked
+  ok = ok && replay(max(2u, thread::hardware_concurrency()), false);
+  u32 par_crc = state_crc();
+  tx_apply_thread_count = 0;
+  printf("replay check: eager demurrage mismatch %u\n", eager_mismatch);
+  printf("replay check: state crc live %08x serial %08x sharded %08x\n", live_crc, serial_crc, par_crc);
+  return ok && !eager_mismatch && serial_crc == live_crc && par_crc == live_crc;
+}
+
+// drop the last count blocks, state goes back through their undo journals
+bool chain_rollback(u32 count) {
+  if (count > gms.undo_list.size() || count >= bc_height()) return false;
+  for(u32 i=0;i<count;i++) {
+    block_state_undo(gms.undo_list.back());
+    gms.undo_list.pop_back();
+    lock_guard<mutex> guard(gms.main_chain_lock);
+    gms.main_chain_block_list.pop_back();
+    if (gms.main_chain_block_list.empty()) {
+      // short tail, the last block is needed for prev_hash
+      vector<u8> buf;
+      Block block;
+      u32 id = gms.main_chain_block_offset - 1;
+      if (!block_log_read(id, buf) || !block_unpack(buf.data(), buf.size(), block)) {
+        throw new Exception("block log read failed");
+      }
+      gms.main_chain_block_list.push_back(block);
+      gms.main_chain_block_offset--;
+    }
+  }
+  block_log_truncate(bc_height());
+  block_wire_cache_drop_from(bc_height());
+  gms.is_proposal_valid = false;
+  FOR_COL(it, gns.node_list) {
+    it->is_proposal_valid = false;
+  }
+  return true;
+}
+
+// replace the last n blocks with branch, a peer's chain from the same fork point on
+// before anything is rolled back: branch links to our block before the fork, headers are signed by
+// their issuer keys, merkle roots match, and it outweighs our n blocks.
+// then it is applied block by block with full checks, on a failure our blocks are applied back
+// tx of our orphaned blocks that are still valid go back to the mempool
+bool chain_fork_switch(u32 n, vector<Block> &branch) {
+  u32 fork_id = bc_height() - n;
+  Block prev;
+  // undo_depth: a failed branch must be rolled back again
+  if (!n || branch.empty() || branch.size() > undo_depth || !block_get(fork_id - 1, prev)) return false;
+  vector<Block> orphan_list(n);
+  u64 local_weight = 0, remote_weight = 0;
+  for(u32 i=0;i<n;i++) {
+    if (!block_get(fork_id + i, orphan_list[i])) return false;
+    block_weight_calc(orphan_list[i]);
+    local_weight += orphan_list[i].weight;
+  }
+  for(u32 i=0;i<branch.size();i++) {
+    Block_header &header = branch[i].header;
+    if (header.id != fork_id + i) return false;
+    if (header.prev_hash != (i ? branch[i-1].header.hash : prev.header.hash)) return false;
+    if (!block_header_sign_check(header)) return false;
+    t_hash merkle_tree;
+    merkle_tree_calc(branch[i], merkle_tree);
+    if (merkle_tree != header.merkle_tree) return false;
+    block_weight_calc(branch[i]);
+    remote_weight += branch[i].weight;
+  }
+  if (remote_weight <= local_weight) return false;
+  if (!chain_rollback(n)) return false;
+  u32 applied = 0;
+  FOR_COL(it, branch) {
+    State_overlay overlay;
+    if (!block_validate(*it, &overlay)) break;
+    block_apply(*it, &overlay);
+    applied++;
+  }
+  if (applied < branch.size()) {
+    printf("fork at %u: peer block %u invalid, staying on ours\n", fork_id, fork_id + applied);
+    chain_rollback(applied);
+    FOR_COL(it, orphan_list) {
+      State_overlay overlay;
+      if (!block_validate(*it, &overlay)) {
+        throw new Exception("fork restore failed");
+      }
+      block_apply(*it, &overlay);
+    }
+    return false;
+  }
+  printf("fork at %u: %u blocks replaced with %u\n", fork_id, n, (u32)branch.size());
+  // the branch may have some of them already, replay_find refuses those
+  FOR_COL(block, orphan_list) {
+    FOR_COL(it, block->tx_list) {
+      if (tx_validate(*it)) mempool_push(*it);
+    }
+  }
+  return true;
+}
+
 void proposed_block_replace(Block &block) {
   if (!gms.is_proposal_valid || gms.proposed_block.header.hash > block.header.hash) {
     // так заходи в гости
     gms.is_proposal_valid = true;
     gms.proposed_block = block;
+    block_wire_proposal_set(block);
     // И пусть все узнают
     block_broadcast();
   }
 }
+// mempool
+u64 mempool_tx_spend(Tx &tx) {
+  return tx.type == 1 ? (u64)tx.amount + tx_fee : tx_fee;
+}
+void mempool_sender_resize(u32 sender, u32 old_size) {
+  auto &m = mempool;
+  u32 size = m.sender_hash[sender].queue.size();
+  if (old_size) m.sender_size.erase({old_size, sender});
+  if (size) {
+    m.sender_size.insert({size, sender});
+  } else {
+    m.sender_hash.erase(sender);
+  }
+}
+// lock held, key must be in the sender queue
+void mempool_remove(const string &key, bool from_front) {
+  auto &m = mempool;
+  auto it = m.hash_index.find(key);
+  Tx &tx = it->second.tx;
+  u32 sender = tx.send_addr;
+  auto &s = m.sender_hash[sender];
+  u32 old_size = s.queue.size();
+  if (from_front && s.queue.front() == key) {
+    s.queue.pop_front();
+  } else if (s.queue.back() == key) {
+    s.queue.pop_back();
+  } else {
+    s.queue.erase(find(s.queue.begin(), s.queue.end(), key));
+  }
+  s.spend -= mempool_tx_spend(tx);
+  m.hash_index.erase(it);
+  m.byte_count -= mempool_tx_size;
+  mempool_sender_resize(sender, old_size);
+}
+// tx_validate(tx) must pass before
+int mempool_push(Tx &tx) {
+  auto &m = mempool;
+  lock_guard<mutex> guard(m.lock);
+  string key((char*)tx.hash.b, t_hash_size);
+  if (m.hash_index.count(key)) {
+    m.duplicate_count++;
+    return 1;
+  }
+  auto &s = m.sender_hash[tx.send_addr];
+  if (s.spend + mempool_tx_spend(tx) > balance_get(tx.send_addr)) {
+    m.spend_reject_count++;
+    mempool_sender_resize(tx.send_addr, s.queue.size());
+    return 2;
+  }
+  u32 old_size = s.queue.size();
+  s.queue.push_back(key);
+  s.spend += mempool_tx_spend(tx);
+  auto &entry = m.hash_index[key];
+  entry.tx = tx;
+  entry.tx.weight = hash2weight(tx.hash);
+  entry.pub_key = overlay_a2pk_get(NULL, tx.send_addr);
+  m.byte_count += mempool_tx_size;
+  mempool_sender_resize(tx.send_addr, old_size);
+  m.push_count++;
+  while (m.hash_index.size() > m.count_limit || m.byte_count > m.byte_limit) {
+    u32 sender = m.sender_size.rbegin()->second;
+    string evict_key = m.sender_hash[sender].queue.back();
+    mempool_remove(evict_key, false);
+    m.evict_count++;
+    if (evict_key == key) return 3;
+  }
+  return 0;
+}
+// the block is in the chain, its tx are done
+void mempool_block_remove(Block &block) {
+  auto &m = mempool;
+  lock_guard<mutex> guard(m.lock);
+  FOR_COL(it, block.tx_list) {
+    string key((char*)it->hash.b, t_hash_size);
+    if (m.hash_index.count(key)) mempool_remove(key, true);
+  }
+}
+// tx that broke our own block
+void mempool_tx_drop(Tx &tx) {
+  auto &m = mempool;
+  lock_guard<mutex> guard(m.lock);
+  string key((char*)tx.hash.b, t_hash_size);
+  if (!m.hash_index.count(key)) return;
+  mempool_remove(key, false);
+  m.drop_count++;
+}
+// up to limit tx that fit together on top of the current state, into overlay
+// heaviest sender head first, a sender's tx keep their order
+// tx that do not fit any more (balance, expired tx_epoch, key changed) leave the mempool
+void mempool_pack(u32 limit, State_overlay &overlay, vector<Tx> &res) {
+  auto &m = mempool;
+  lock_guard<mutex> guard(m.lock);
+  auto t0 = chrono::steady_clock::now();
+  // (weight, sender, position in queue)
+  priority_queue<tuple<u64, u32, u32>> head_list;
+  FOR_COL(it, m.sender_hash) {
+    head_list.push({m.hash_index[it->second.queue.front()].tx.weight, it->first, 0});
+  }
+  vector<string> drop_list;
+  while (res.size() < limit && !head_list.empty()) {
+    auto [weight, sender, pos] = head_list.top();
+    head_list.pop();
+    auto &queue = m.sender_hash[sender].queue;
+    auto &entry = m.hash_index[queue[pos]];
+    Tx &tx = entry.tx;
+    bool ok = tx_validate(tx, false, &overlay);
+    // sender rebound since push or earlier in this block, the signature was checked with the old key
+    if (ok && overlay_a2pk_get(&overlay, tx.send_addr) != entry.pub_key) {
+      ok = tx_validate(tx, true, &overlay);
+    }
+    if (ok) {
+      tx_apply(tx, overlay);
+      res.push_back(tx);
+    } else {
+      drop_list.push_back(queue[pos]);
+    }
+    if (++pos < queue.size()) head_list.push({m.hash_index[queue[pos]].tx.weight, sender, pos});
+  }
+  FOR_COL(it, drop_list) {
+    mempool_remove(*it, false);
+  }
+  m.drop_count += drop_list.size();
+  m.pack_count_last = res.size();
+  m.pack_us_last = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - t0).count();
+}
+
 void block_propose() {
   if (!gms.ready) return;
   auto last = gms.main_chain_block_list.back();
   Block block;
   block.header.id = last.header.id+1;
-  block.header.version = 1;
+  block.header.version = block_version;
   block.header.prev_hash = last.header.hash;
   block.header.issuer_addr = my_primary_address;
   block.header.issuer_pub_key = my_pub_key;
   block.header.nonce = 0;
-  block.tx_list = gms.tx_list;
-  gms.tx_list.clear();
-  block_sign(block, my_pub_key, my_prv_key);
+  // tx stay in the mempool until a block with them is applied, ours may lose
+  State_overlay overlay;
+  overlay_init(overlay);
+  mempool_pack(block_tx_limit, overlay, block.tx_list);
+  merkle_tree_calc(block, block.header.merkle_tree);
+  block_header_sign(block.header, my_pub_key, my_prv_key);
   block_weight_calc(block);
   if (!block_validate(block)) {
-    throw new Exception("block validation failed for our own block");
+    // should not happen, find the tx with full checks, drop them and try on the next tick
+    State_overlay check_overlay;
+    overlay_init(check_overlay);
+    u32 bad_count = 0;
+    FOR_COL(it, block.tx_list) {
+      if (tx_validate(*it, true, &check_overlay)) {
+        tx_apply(*it, check_overlay);
+      } else {
+        mempool_tx_drop(*it);
+        bad_count++;
+      }
+    }
+    printf("own block invalid, %u tx dropped from mempool\n", bad_count);
+    if (!bad_count) {
+      throw new Exception("block validation failed for our own block");
+    }
+    return;
   }
   proposed_block_replace(block);
   // block_apply(block);
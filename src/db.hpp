@@ -3,55 +3,351 @@ string pub_key_path = "./pub.key";
 string prv_key_path = "./prv.key";
 bool i_am_seed_node = false;
 // single block
+// wire encodings made once when a block is accepted, RPC replies copy them
+struct Block_wire {
+  t_hash hash;
+  Value json;
+  string bin;
+  // rough, json tree nodes cost more than their text
+  u64 size = 0;
+};
+// oldest heights go first once size > size_limit, misses are encoded on the fly
+struct Block_wire_cache {
+  mutex lock;
+  map<u32, shared_ptr<Block_wire>> id_hash;
+  shared_ptr<Block_wire> proposal;
+  u64 size = 0;
+  u64 size_limit = 64 << 20;
+} block_wire_cache;
+void block_wire_cache_put(Block &block);
+void block_wire_proposal_set(Block &block);
+shared_ptr<Block_wire> block_wire_get(u32 id);
+shared_ptr<Block_wire> block_wire_proposal_get();
+void block_wire_cache_drop_from(u32 id);
 
+// append-only block log in chain_path
+//   seg_NNNNNN.log frames [u32 len][u32 crc32c][block_pack], next segment past block_log_segment_size
+//   height.idx     mmap, head + Block_log_pos per height
+//   hash.idx       mmap, head + open addressing u32 slots (height+1, 0 empty) keyed by Block_log_pos.key
+string chain_path = "./chain";
+const u32 block_log_magic = 0x474c4b42;
+const u32 block_log_version = 1;
+const u32 block_log_segment_size = 1 << 28;
+const u32 block_log_frame_head_size = 8;
+struct Block_log_pos {
+  u32 segment;
+  u32 offset;
+  u32 len;
+  u32 crc;
+  // block hash prefix
+  u8 key[16];
+};
+struct Block_log_idx_head {
+  u32 magic;
+  u32 version;
+  u32 count;
+  u32 capacity;
+};
+struct Block_log {
+  mutex lock;
+  string path;
+  vector<int> seg_fd;
+  // end of the last segment
+  u32 seg_size = 0;
+  int height_fd = -1;
+  Block_log_idx_head *height_head = NULL;
+  Block_log_pos *height = NULL;
+  int hash_fd = -1;
+  Block_log_idx_head *hash_head = NULL;
+  u32 *hash = NULL;
+  // segments from here on have writes not synced yet
+  u32 sync_segment = 0;
+} block_log;
+bool block_log_append(Block &block);
 
+// group commit, persist_writer syncs everything appended so far with one fdatasync per file
+//   0 none   - no syncs, the page cache decides
+//   1 batch  - synced in the background, block_apply does not wait
+//   2 strict - block_apply returns once its block is durable
+u32 durability = 1;
+struct Persist_state {
+  mutex lock;
+  condition_variable wake;
+  condition_variable done;
+  u64 seq_appended = 0;
+  u64 seq_durable = 0;
+  // append time of every seq not durable yet
+  deque<chrono::steady_clock::time_point> pending_time;
+  // a rename or truncate in chain_path, needs the directory synced
+  bool dir_dirty = false;
+  bool running = false;
+  bool stop = false;
+  // stats
+  u64 commit_count = 0;
+  u64 batch_max = 0;
+  u64 latency_sum_us = 0;
+  u64 latency_max_us = 0;
+  u64 latency_last_us = 0;
+} persist;
+void persist_dir_dirty();
 
-// 1024 block pack 
 
 
+// 1024 block pack 
+// chain_path/pack_NNNNNN.bin, immutable once renamed into place
+//   [u32 magic][u32 version][u32 first id][u32 block count]
+//   [u64 frame offset...][u64 end], from the start of the file
+//   frames: [u32 raw len][deflate(block_pack without tx hashes, they are sha512 of the tx body)]
+//   [u32 crc32c of all the above]
+const u32 pack_magic = 0x4b434150;
+const u32 pack_version = 1;
+const u32 pack_block_count = 1024;
+const u32 pack_head_size = 4*4 + 8*(pack_block_count + 1);
+const u32 pack_tx_size = tx_pack_size - t_hash_size;
+// a pack is built this many blocks after its last one, shallow rollbacks do not touch it
+const u32 pack_finality = 64;
+struct Pack_state {
+  mutex lock;
+  // packs 0..count-1 are on disk
+  u32 count = 0;
+  bool building = false;
+  // bumped by pack_drop_from, a build started before it is thrown away
+  u32 generation = 0;
+} pack_state;
+void pack_build_start();
+void pack_drop_from(u32 height);
 
 // mem state
-struct Acc_weight_pair {
-  u32 account;
-  u64 weight;
+// verify contexts of recently seen senders, LRU
+// rpc threads and the main loop verify at the same time, lock guards lru and addr_hash
+// an entry is used only if its key matches the one asked for, so a stale one is just a miss
+struct Verify_ctx_cache {
+  mutex lock;
+  list<pair<u32, ed25519_verify_context>> lru;
+  unordered_map<u32, list<pair<u32, ed25519_verify_context>>::iterator> addr_hash;
+};
+// ~1.5 KB per account
+const u32 verify_ctx_cache_size = 1024;
+
+// applied tx of the live tx epochs, one open addressing table per epoch, slot = epoch % size
+// keyed on the first 16 bytes of the hash, a sha512 prefix collision needs ~2^64 tx
+// an all zero key marks an empty slot
+const u32 replay_key_size = 16;
+struct Replay_key {
+  u8 b[replay_key_size];
+};
+struct Replay_table {
+  u32 tx_epoch = 0;
+  u32 count = 0;
+  // power of 2, at most half full
+  vector<Replay_key> slot_list;
+};
+struct Replay_set {
+  Replay_table table_list[tx_epoch_window + 1];
 };
 
+// speculative state of a candidate block on top of gms, only what its tx changed
+// drop it to discard, overlay_commit to write it into gms
+// balances are settled at demurrage_height, a block applied in between makes it stale
+struct State_overlay {
+  u32 demurrage_height;
+  unordered_map<u32, u32> balance;
+  unordered_map<u32, t_pub_key> a2pk;
+  Replay_set done_tx;
+};
+
+// what one applied block changed, chain_rollback replays it backwards
+// entries are old values in the order they were overwritten, restore goes from the end
+struct Undo_balance {
+  u32 addr;
+  u32 balance;
+  u32 balance_height;
+};
+struct Undo_a2pk {
+  u32 addr;
+  t_pub_key pub_key;
+};
+struct Undo_replay {
+  u32 tx_epoch;
+  Replay_key key;
+};
+struct Undo_block {
+  vector<Undo_balance> balance_list;
+  vector<Undo_a2pk> a2pk_list;
+  vector<Undo_replay> replay_list;
+  // tables of an expired epoch, reset by this block
+  vector<Replay_table> replay_reset_list;
+  // account count before the block, the block issues one
+  u32 account_count;
+};
+// blocks past pack_finality are not rolled back
+const u32 undo_depth = pack_finality;
+
 struct MemState {
   bool ready = false;
   u32 target_bc_height = 0;
   // TODO Block hash -> map
   u32 main_chain_block_offset = 0;
-  vector<Block> main_chain_block_list;
-  // tx prepared by this node
-  vector<Tx> tx_list;
+  // last blocks only, older ones are read back from block_log
+  // only the main loop changes it, under main_chain_lock; rpc threads read with main_chain_tail_get
+  mutex main_chain_lock;
+  deque<Block> main_chain_block_list;
   
   bool is_proposal_valid = false;
   Block proposed_block;
-  unordered_map<string, Tx> done_tx_hash;
+  Replay_set done_tx;
   // address_to_pub_key
   vector<t_pub_key> a2pk;
+  // cache, dropped for an addr when a2pk[addr] changes
+  Verify_ctx_cache a2vc;
   // analog PascalCoin safebox
+  // balance[addr] is settled at demurrage height balance_height[addr], read it with balance_get
   vector<u32> balance;
-  // consensus stuff
-  vector<Acc_weight_pair*> w_weak_list;
-  vector<Acc_weight_pair> aw_sort_list;
+  vector<u32> balance_height;
+  // blocks applied to this state, each one is hot_potato_penalty off every balance
+  u32 demurrage_height = 0;
+  // last undo_depth applied blocks, oldest first
+  deque<Undo_block> undo_list;
 } gms;
 // global_mem_state
+u32 main_chain_tail_size = 1024;
+
+// safebox snapshot, chain_path/snapshot.bin, written by a forked child from its copy of gms
+//   [u32 magic][u32 version][u32 bc_height][t_hash last block]
+//   [u32 account count][t_pub_key a2pk...][u32 balance...]
+//   ([u32 tx_epoch][u32 count][u32 capacity][Replay_key * capacity]) per done_tx table
+//   [u32 crc32c of all the above]
+const u32 snapshot_magic = 0x50414e53;
+const u32 snapshot_version = 2;
+// every N blocks, 0 = off
+u32 snapshot_interval = 1000;
+pid_t snapshot_pid = 0;
+bool snapshot_poll();
+void snapshot_start();
+bool chain_rollback(u32 count);
+bool chain_fork_switch(u32 n, vector<Block> &branch);
+
+// mempool, validated tx waiting for a block
+//   hash_index  - full tx hash -> tx, a duplicate is rejected in O(1)
+//   sender_hash - per sender queue in arrival order and what it spends in total,
+//                 a tx gets in only if its sender can pay for the whole queue
+//   over count_limit/byte_limit the newest tx of the longest queue goes, so a spammer evicts itself
+//   block_propose packs up to block_tx_limit tx, heaviest sender head first
+struct Mempool_sender {
+  deque<string> queue;
+  u64 spend = 0;
+};
+struct Mempool_tx {
+  Tx tx;
+  // the key its signature was checked with, packing checks it again if the sender is rebound since
+  t_pub_key pub_key;
+};
+// rough memory per tx: Mempool_tx, its key in hash_index and in the sender queue
+const u32 mempool_tx_size = sizeof(Mempool_tx) + 2*t_hash_size;
+struct Mempool {
+  mutex lock;
+  unordered_map<string, Mempool_tx> hash_index;
+  unordered_map<u32, Mempool_sender> sender_hash;
+  // (queue size, sender), last = longest queue
+  set<pair<u32, u32>> sender_size;
+  u32 count_limit = 100000;
+  u64 byte_limit  = 64 << 20;
+  u64 byte_count  = 0;
+  // stats
+  u64 push_count, duplicate_count, spend_reject_count, evict_count, drop_count;
+  u32 pack_count_last;
+  u64 pack_us_last;
+} mempool;
+u32 block_tx_limit = 10000;
+// 0 ok, 1 duplicate, 2 sender can't pay for its queue, 3 evicted right away (full)
+int mempool_push(Tx &tx);
+void mempool_block_remove(Block &block);
+void mempool_tx_drop(Tx &tx);
 
 u32 my_primary_address;
 t_pub_key my_pub_key;
 t_prv_key my_prv_key;
 bool tx_mining_mode = false;
 
+// stake weight = balance after demurrage, ordered by key = balance + penalty*balance_height
+// every nonzero balance loses the same per block, so the order only moves when a balance is set
+// weight = key - penalty*demurrage_height, 0 if below
+typedef pair<u64, u32> Weight_key;// key, account
+typedef __gnu_pbds::tree<Weight_key, __gnu_pbds::null_type, greater<Weight_key>,
+  __gnu_pbds::rb_tree_tag, __gnu_pbds::tree_order_statistics_node_update> Weight_tree;
+struct Weight_index {
+  mutex lock;
+  Weight_tree tree;
+  // key per account, as it is in tree
+  vector<u64> key_list;
+} weight_index;
+
+u64 weight_key(u32 addr) {
+  return gms.balance[addr] + (u64)hot_potato_penalty*gms.balance_height[addr];
+}
+u64 weight_from_key(u64 key) {
+  u64 penalty = (u64)hot_potato_penalty*gms.demurrage_height;
+  return key > penalty ? key - penalty : 0;
+}
+// after balance[addr] or balance_height[addr] changed, or addr is new
+void weight_index_update(u32 addr) {
+  auto &w = weight_index;
+  lock_guard<mutex> guard(w.lock);
+  if (addr < w.key_list.size()) {
+    w.tree.erase(Weight_key(w.key_list[addr], addr));
+  } else {
+    w.key_list.resize(addr + 1);
+  }
+  w.key_list[addr] = weight_key(addr);
+  w.tree.insert(Weight_key(w.key_list[addr], addr));
+}
+// accounts from count on are gone
+void weight_index_truncate(u32 count) {
+  auto &w = weight_index;
+  lock_guard<mutex> guard(w.lock);
+  for(u32 addr=count;addr<w.key_list.size();addr++) {
+    w.tree.erase(Weight_key(w.key_list[addr], addr));
+  }
+  w.key_list.resize(min<size_t>(count, w.key_list.size()));
+}
+void weight_index_rebuild() {
+  auto &w = weight_index;
+  lock_guard<mutex> guard(w.lock);
+  w.tree.clear();
+  w.key_list.resize(gms.balance.size());
+  for(u32 addr=0;addr<w.key_list.size();addr++) {
+    w.key_list[addr] = weight_key(addr);
+    w.tree.insert(Weight_key(w.key_list[addr], addr));
+  }
+}
+
 void gms_account_new(t_pub_key &pub_key) {
   gms.a2pk.push_back(pub_key);
   gms.balance.push_back(0);
-  gms.w_weak_list.push_back(NULL);
+  gms.balance_height.push_back(gms.demurrage_height);
+  weight_index_update(gms.balance.size() - 1);
+}
+
+// hot potato demurrage, lazy
+// -penalty per block down to 0 is a saturating sub, n blocks at once = -n*penalty down to 0
+u32 balance_get(u32 addr) {
+  u64 penalty = (u64)hot_potato_penalty*(gms.demurrage_height - gms.balance_height[addr]);
+  u32 balance = gms.balance[addr];
+  return balance > penalty ? balance - penalty : 0;
+}
+// all writes go here, settled at demurrage_height
+void balance_set(u32 addr, u32 balance) {
+  gms.balance[addr] = balance;
+  gms.balance_height[addr] = gms.demurrage_height;
+  weight_index_update(addr);
 }
 
 u32 bc_height() {
   return gms.main_chain_block_offset + gms.main_chain_block_list.size();
 }
+u32 tx_epoch_now() {
+  return bc_height() / tx_epoch_blocks;
+}
 
 bool key_gen(t_pub_key &pub_key, t_prv_key &prv_key) {
   u8 seed[32];
@@ -1,9 +1,17 @@
 #include <stddef.h>
 
+/* decompressed public key with its odd multiples, see verify.c */
+typedef struct ed25519_verify_context ed25519_verify_context;
+
 int ed25519_create_seed(u8 *seed);
+int ed25519_create_seeds(u8 *seeds, size_t num);
 
 void ed25519_create_keypair(u8 *public_key, u8 *private_key, const u8 *seed);
+int ed25519_create_keypairs(u8 *public_keys, u8 *private_keys, const u8 *seeds, size_t num);
 void ed25519_sign(u8 *signature, const u8 *message, size_t message_len, const u8 *public_key, const u8 *private_key);
 int ed25519_verify(const u8 *signature, const u8 *message, size_t message_len, const u8 *public_key);
+int ed25519_verify_with_context(const u8 *signature, const u8 *message, size_t message_len, const ed25519_verify_context *context);
+int ed25519_verify_context_init(ed25519_verify_context *context, const u8 *public_key);
+int ed25519_verify_batch(const u8 **signatures, const u8 **messages, const size_t *message_lens, const u8 **public_keys, size_t num, int *valid);
 void ed25519_add_scalar(u8 *public_key, u8 *private_key, const u8 *scalar);
 void ed25519_key_exchange(u8 *shared_secret, const u8 *public_key, const u8 *private_key);
@@ -28,6 +28,7 @@ static u64 load_4(const u8 *in) {
 
 
 
+#ifndef FE_RADIX51
 /*
     h = 0
 */
@@ -358,6 +359,7 @@ void fe_frombytes(fe h, const u8 *s) {
     h[8] = (i32) h8;
     h[9] = (i32) h9;
 }
+#endif
 
 
 
@@ -448,7 +450,38 @@ void fe_invert(fe out, const fe z) {
 }
 
 
+/*
+    out[i] = 1/z[i] for n nonzero elements with one fe_invert
+    (Montgomery's trick), out must not alias z
+*/
+
+void fe_batch_invert(fe *out, const fe *z, size_t n) {
+    fe inv;
+    size_t i;
+
+    if (n == 0) {
+        return;
+    }
+
+    fe_copy(out[0], z[0]);
+
+    for (i = 1; i < n; ++i) {
+        fe_mul(out[i], out[i - 1], z[i]);
+    }
+
+    fe_invert(inv, out[n - 1]);
+
+    for (i = n - 1; i > 0; --i) {
+        fe_mul(out[i], inv, out[i - 1]);
+        fe_mul(inv, inv, z[i]);
+    }
+
+    fe_copy(out[0], inv);
+}
+
+
 
+#ifndef FE_RADIX51
 /*
     return 1 if f is in {1,3,5,...,q-2}
     return 0 if f is in {0,2,4,...,q-1}
@@ -878,6 +911,7 @@ void fe_neg(fe h, const fe f) {
     h[8] = h8;
     h[9] = h9;
 }
+#endif
 
 
 void fe_pow22523(fe out, const fe z) {
@@ -966,6 +1000,7 @@ void fe_pow22523(fe out, const fe z) {
 }
 
 
+#ifndef FE_RADIX51
 /*
 h = f * f
 Can overlap h with f.
@@ -1491,3 +1526,4 @@ void fe_tobytes(u8 *s, const fe h) {
     s[30] = (u8) (h9 >> 10);
     s[31] = (u8) (h9 >> 18);
 }
+#endif
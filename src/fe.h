@@ -10,7 +10,27 @@
 */
 
 
+#ifndef FE_RADIX51
 typedef i32 fe[10];
+#define FE(...) { __VA_ARGS__ }
+#endif
+#ifdef FE_RADIX51
+/*
+    FE_RADIX51 (fe51.c): t[0]+2^51 t[1]+2^102 t[2]+2^153 t[3]+2^204 t[4],
+    unsigned limbs, 64x64->128 multiplies.
+    FE() takes constants written in the 10 limb form above,
+    t[2k]+2^26 t[2k+1] is limb k, +2p keeps it positive.
+*/
+typedef u64 fe[5];
+#define FE51_LIMB(lo, hi, p2) ((u64) ((i64) (lo) + (i64) (hi) * (1 << 26) + (i64) (p2)))
+#define FE(t0, t1, t2, t3, t4, t5, t6, t7, t8, t9) {   \
+    FE51_LIMB(t0, t1, 0xfffffffffffda),                \
+    FE51_LIMB(t2, t3, 0xffffffffffffe),                \
+    FE51_LIMB(t4, t5, 0xffffffffffffe),                \
+    FE51_LIMB(t6, t7, 0xffffffffffffe),                \
+    FE51_LIMB(t8, t9, 0xffffffffffffe)                 \
+}
+#endif
 
 
 void fe_0(fe h);
@@ -28,6 +48,7 @@ void fe_cswap(fe f, fe g, u32 b);
 void fe_neg(fe h, const fe f);
 void fe_add(fe h, const fe f, const fe g);
 void fe_invert(fe out, const fe z);
+void fe_batch_invert(fe *out, const fe *z, size_t n);
 void fe_sq(fe h, const fe f);
 void fe_sq2(fe h, const fe f);
 void fe_mul(fe h, const fe f, const fe g);
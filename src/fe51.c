@@ -0,0 +1,234 @@
+#include "fixedint.h"
+#include "fe.h"
+
+#ifdef FE_RADIX51
+/*
+    fe.c API on 5 limbs of 51 bits.
+    add/sub/neg leave limbs below 2^52, everything else below 2^51+2^13,
+    mul/sq accept limbs up to 2^54.
+*/
+
+__extension__ typedef unsigned __int128 u128;
+
+static const u64 mask51 = (((u64) 1) << 51) - 1;
+
+static u64 load_8(const u8 *in) {
+    u64 result = 0;
+    int i;
+
+    for (i = 7; i >= 0; --i) {
+        result = (result << 8) | in[i];
+    }
+
+    return result;
+}
+
+static void fe_carry(fe h) {
+    u64 c;
+    c = h[0] >> 51; h[0] &= mask51; h[1] += c;
+    c = h[1] >> 51; h[1] &= mask51; h[2] += c;
+    c = h[2] >> 51; h[2] &= mask51; h[3] += c;
+    c = h[3] >> 51; h[3] &= mask51; h[4] += c;
+    c = h[4] >> 51; h[4] &= mask51; h[0] += c * 19;
+}
+
+static void fe_carry_wide(fe h, u128 r0, u128 r1, u128 r2, u128 r3, u128 r4) {
+    u64 c;
+    r1 += (u64) (r0 >> 51); h[0] = (u64) r0 & mask51;
+    r2 += (u64) (r1 >> 51); h[1] = (u64) r1 & mask51;
+    r3 += (u64) (r2 >> 51); h[2] = (u64) r2 & mask51;
+    r4 += (u64) (r3 >> 51); h[3] = (u64) r3 & mask51;
+    c = (u64) (r4 >> 51);   h[4] = (u64) r4 & mask51;
+    h[0] += c * 19;
+    h[1] += h[0] >> 51;
+    h[0] &= mask51;
+}
+
+
+void fe_0(fe h) {
+    h[0] = 0;
+    h[1] = 0;
+    h[2] = 0;
+    h[3] = 0;
+    h[4] = 0;
+}
+
+void fe_1(fe h) {
+    h[0] = 1;
+    h[1] = 0;
+    h[2] = 0;
+    h[3] = 0;
+    h[4] = 0;
+}
+
+void fe_copy(fe h, const fe f) {
+    h[0] = f[0];
+    h[1] = f[1];
+    h[2] = f[2];
+    h[3] = f[3];
+    h[4] = f[4];
+}
+
+void fe_add(fe h, const fe f, const fe g) {
+    h[0] = f[0] + g[0];
+    h[1] = f[1] + g[1];
+    h[2] = f[2] + g[2];
+    h[3] = f[3] + g[3];
+    h[4] = f[4] + g[4];
+    fe_carry(h);
+}
+
+/* +4p so that g up to 2^53 can't underflow */
+void fe_sub(fe h, const fe f, const fe g) {
+    h[0] = f[0] + 0x1fffffffffffb4 - g[0];
+    h[1] = f[1] + 0x1ffffffffffffc - g[1];
+    h[2] = f[2] + 0x1ffffffffffffc - g[2];
+    h[3] = f[3] + 0x1ffffffffffffc - g[3];
+    h[4] = f[4] + 0x1ffffffffffffc - g[4];
+    fe_carry(h);
+}
+
+void fe_neg(fe h, const fe f) {
+    fe zero;
+    fe_0(zero);
+    fe_sub(h, zero, f);
+}
+
+void fe_cmov(fe f, const fe g, u32 b) {
+    u64 mask = 0 - (u64) b;
+    f[0] ^= (f[0] ^ g[0]) & mask;
+    f[1] ^= (f[1] ^ g[1]) & mask;
+    f[2] ^= (f[2] ^ g[2]) & mask;
+    f[3] ^= (f[3] ^ g[3]) & mask;
+    f[4] ^= (f[4] ^ g[4]) & mask;
+}
+
+void fe_cswap(fe f, fe g, u32 b) {
+    u64 mask = 0 - (u64) b;
+    u64 x;
+    int i;
+
+    for (i = 0; i < 5; ++i) {
+        x = (f[i] ^ g[i]) & mask;
+        f[i] ^= x;
+        g[i] ^= x;
+    }
+}
+
+void fe_frombytes(fe h, const u8 *s) {
+    h[0] = load_8(s) & mask51;
+    h[1] = (load_8(s + 6) >> 3) & mask51;
+    h[2] = (load_8(s + 12) >> 6) & mask51;
+    h[3] = (load_8(s + 19) >> 1) & mask51;
+    h[4] = (load_8(s + 24) >> 12) & mask51;
+}
+
+/*
+    carry twice, then subtract p if h >= p:
+    q = floor((h + 19) / 2^255) is 1 exactly then.
+*/
+
+void fe_tobytes(u8 *s, const fe f) {
+    fe h;
+    u64 q;
+    u64 t[4];
+    int i;
+    fe_copy(h, f);
+    fe_carry(h);
+    fe_carry(h);
+    q = (h[0] + 19) >> 51;
+    q = (h[1] + q) >> 51;
+    q = (h[2] + q) >> 51;
+    q = (h[3] + q) >> 51;
+    q = (h[4] + q) >> 51;
+    h[0] += 19 * q;
+    h[1] += h[0] >> 51; h[0] &= mask51;
+    h[2] += h[1] >> 51; h[1] &= mask51;
+    h[3] += h[2] >> 51; h[2] &= mask51;
+    h[4] += h[3] >> 51; h[3] &= mask51;
+    h[4] &= mask51;
+    t[0] = h[0] | (h[1] << 51);
+    t[1] = (h[1] >> 13) | (h[2] << 38);
+    t[2] = (h[2] >> 26) | (h[3] << 25);
+    t[3] = (h[3] >> 39) | (h[4] << 12);
+
+    for (i = 0; i < 32; ++i) {
+        s[i] = (u8) (t[i >> 3] >> (8 * (i & 7)));
+    }
+}
+
+int fe_isnegative(const fe f) {
+    u8 s[32];
+    fe_tobytes(s, f);
+    return s[0] & 1;
+}
+
+int fe_isnonzero(const fe f) {
+    u8 s[32];
+    u8 r = 0;
+    int i;
+    fe_tobytes(s, f);
+
+    for (i = 0; i < 32; ++i) {
+        r |= s[i];
+    }
+
+    return r != 0;
+}
+
+/*
+h = f * g
+Can overlap h with f or g.
+*/
+
+void fe_mul(fe h, const fe f, const fe g) {
+    u64 f0 = f[0], f1 = f[1], f2 = f[2], f3 = f[3], f4 = f[4];
+    u64 g0 = g[0], g1 = g[1], g2 = g[2], g3 = g[3], g4 = g[4];
+    u64 g1_19 = 19 * g1, g2_19 = 19 * g2, g3_19 = 19 * g3, g4_19 = 19 * g4;
+    u128 r0, r1, r2, r3, r4;
+    r0 = (u128) f0 * g0 + (u128) f1 * g4_19 + (u128) f2 * g3_19 + (u128) f3 * g2_19 + (u128) f4 * g1_19;
+    r1 = (u128) f0 * g1 + (u128) f1 * g0    + (u128) f2 * g4_19 + (u128) f3 * g3_19 + (u128) f4 * g2_19;
+    r2 = (u128) f0 * g2 + (u128) f1 * g1    + (u128) f2 * g0    + (u128) f3 * g4_19 + (u128) f4 * g3_19;
+    r3 = (u128) f0 * g3 + (u128) f1 * g2    + (u128) f2 * g1    + (u128) f3 * g0    + (u128) f4 * g4_19;
+    r4 = (u128) f0 * g4 + (u128) f1 * g3    + (u128) f2 * g2    + (u128) f3 * g1    + (u128) f4 * g0;
+    fe_carry_wide(h, r0, r1, r2, r3, r4);
+}
+
+/*
+h = f * f, times 2 if shift is 1
+*/
+
+static void fe_sq_shift(fe h, const fe f, int shift) {
+    u64 f0 = f[0], f1 = f[1], f2 = f[2], f3 = f[3], f4 = f[4];
+    u64 f0_2 = 2 * f0, f1_2 = 2 * f1, f2_2 = 2 * f2, f3_2 = 2 * f3;
+    u64 f3_19 = 19 * f3, f4_19 = 19 * f4;
+    u128 r0, r1, r2, r3, r4;
+    r0 = (u128) f0 * f0   + (u128) f1_2 * f4_19 + (u128) f2_2 * f3_19;
+    r1 = (u128) f0_2 * f1 + (u128) f2_2 * f4_19 + (u128) f3 * f3_19;
+    r2 = (u128) f0_2 * f2 + (u128) f1 * f1      + (u128) f3_2 * f4_19;
+    r3 = (u128) f0_2 * f3 + (u128) f1_2 * f2    + (u128) f4 * f4_19;
+    r4 = (u128) f0_2 * f4 + (u128) f1_2 * f3    + (u128) f2 * f2;
+    fe_carry_wide(h, r0 << shift, r1 << shift, r2 << shift, r3 << shift, r4 << shift);
+}
+
+void fe_sq(fe h, const fe f) {
+    fe_sq_shift(h, f, 0);
+}
+
+/*
+h = 2 * f * f
+*/
+
+void fe_sq2(fe h, const fe f) {
+    fe_sq_shift(h, f, 1);
+}
+
+void fe_mul121666(fe h, fe f) {
+    fe_carry_wide(h,
+        (u128) f[0] * 121666,
+        (u128) f[1] * 121666,
+        (u128) f[2] * 121666,
+        (u128) f[3] * 121666,
+        (u128) f[4] * 121666);
+}
+#endif
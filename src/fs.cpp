@@ -1,4 +1,7 @@
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
 // https://stackoverflow.com/questions/12774207/fastest-way-to-check-if-a-file-exist-using-standard-c-c11-c/19841704
 bool file_exists(string& name) {
   struct stat buffer;
@@ -15,6 +18,15 @@ bool file_save(string& path, u8* buf, u32 len) {
   if (ferror(fh)) return false;
   return true;
 }
+// readers see the old file or the whole new one, never a part
+bool file_save_atomic(string& path, const u8* buf, size_t len) {
+  string tmp_path = path + ".tmp";
+  int fd = open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) return false;
+  bool res = write(fd, buf, len) == len && !fsync(fd);
+  close(fd);
+  return res && !rename(tmp_path.c_str(), path.c_str());
+}
 bool file_load(string& path, u8* buf, u32 len) {
   FILE* fh = fopen(path.c_str(), "rb");
   if (!fh) return false;
@@ -23,4 +35,43 @@ bool file_load(string& path, u8* buf, u32 len) {
   fclose(fh);
   if (ferror(fh)) return false;
   return true;
-}
\ No newline at end of file
+}
+
+// crc32c (Castagnoli), frame checksums of the block log
+struct Crc32c_table {
+  u32 t[256];
+  Crc32c_table() {
+    for(u32 i=0;i<256;i++) {
+      u32 c = i;
+      for(int k=0;k<8;k++) c = c & 1 ? (c >> 1) ^ 0x82f63b78 : c >> 1;
+      t[i] = c;
+    }
+  }
+} crc32c_table;
+
+u32 crc32c_scalar(u32 crc, const u8 *buf, size_t len) {
+  crc = ~crc;
+  for(size_t i=0;i<len;i++) crc = crc32c_table.t[(crc ^ buf[i]) & 0xff] ^ (crc >> 8);
+  return ~crc;
+}
+__attribute__((target("sse4.2")))
+u32 crc32c_sse42(u32 crc, const u8 *buf, size_t len) {
+  u64 c = ~crc;
+  size_t i = 0;
+  for(;i+8<=len;i+=8) {
+    u64 v;
+    memcpy(&v, buf+i, 8);
+    c = __builtin_ia32_crc32di(c, v);
+  }
+  for(;i<len;i++) c = __builtin_ia32_crc32qi(c, buf[i]);
+  return ~(u32)c;
+}
+
+u32 (*crc32c_kernel)(u32 crc, const u8 *buf, size_t len) = NULL;
+u32 crc32c(const u8 *buf, size_t len) {
+  if (!crc32c_kernel) {
+    __builtin_cpu_init();
+    crc32c_kernel = __builtin_cpu_supports("sse4.2") ? crc32c_sse42 : crc32c_scalar;
+  }
+  return crc32c_kernel(0, buf, len);
+}
@@ -1,3 +1,6 @@
+#include <stdlib.h>
+#include <string.h>
+
 #include "ge.h"
 #include "precomp_data.h"
 
@@ -22,10 +25,16 @@ void ge_add(ge_p1p1 *r, const ge_p3 *p, const ge_cached *q) {
 }
 
 
-static void slide(signed char *r, const u8 *a) {
+/*
+Signed sliding window of width w: odd digits in [-(2^(w-1)-1), 2^(w-1)-1].
+short because digits outgrow signed char for w > 8.
+*/
+
+static void slide_w(short *r, const u8 *a, int w) {
     int i;
     int b;
     int k;
+    int m = (1 << (w - 1)) - 1;
 
     for (i = 0; i < 256; ++i) {
         r[i] = 1 & (a[i >> 3] >> (i & 7));
@@ -33,12 +42,12 @@ static void slide(signed char *r, const u8 *a) {
 
     for (i = 0; i < 256; ++i)
         if (r[i]) {
-            for (b = 1; b <= 6 && i + b < 256; ++b) {
+            for (b = 1; b <= w + 1 && i + b < 256; ++b) {
                 if (r[i + b]) {
-                    if (r[i] + (r[i + b] << b) <= 15) {
+                    if (r[i] + (r[i + b] << b) <= m) {
                         r[i] += r[i + b] << b;
                         r[i + b] = 0;
-                    } else if (r[i] - (r[i + b] << b) >= -15) {
+                    } else if (r[i] - (r[i + b] << b) >= -m) {
                         r[i] -= r[i + b] << b;
 
                         for (k = i + b; k < 256; ++k) {
@@ -57,6 +66,134 @@ static void slide(signed char *r, const u8 *a) {
         }
 }
 
+static void slide(short *r, const u8 *a) {
+    slide_w(r, a, 5);
+}
+
+
+/*
+Wider odd multiples B,3B,...,(2^(w-1)-1)B for the b * B half of the vartime
+multiplications. B is fixed, so a table of 2^(w-2) entries is built once and
+every verify does ~256/(w+1) base additions instead of ~256/6 with Bi (w = 5).
+*/
+
+static ge_precomp *Bw = NULL;
+static int Bw_width = 0;
+
+static void base_table(const ge_precomp **table, int *width) {
+    if (Bw_width) {
+        *table = Bw;
+        *width = Bw_width;
+    } else {
+        *table = Bi;
+        *width = 5;
+    }
+}
+
+/*
+Builds the widest table (w <= GE_BASE_WIDE_MAX) that fits in budget bytes,
+budget too small for w = 6 keeps Bi. Returns the width in use.
+Not thread safe, call it before anything is verified.
+*/
+
+int ge_base_wide_init(size_t budget) {
+    ge_p3 B;
+    ge_p3 B2;
+    ge_p3 u;
+    ge_p1p1 t;
+    ge_cached *Ci;
+    fe *z;
+    fe *zinv;
+    size_t count = 0;
+    size_t i;
+    int w;
+
+    free(Bw);
+    Bw = NULL;
+    Bw_width = 0;
+
+    for (w = GE_BASE_WIDE_MAX; w > 5; --w) {
+        count = (size_t) 1 << (w - 2);
+
+        if (count * sizeof(ge_precomp) <= budget) {
+            break;
+        }
+    }
+
+    if (w == 5) {
+        return 5;
+    }
+
+    Bw = (ge_precomp *) malloc(count * sizeof(ge_precomp));
+    Ci = (ge_cached *) malloc(count * sizeof(ge_cached));
+    z = (fe *) malloc(2 * count * sizeof(fe));
+
+    if (Bw == NULL || Ci == NULL || z == NULL) {
+        free(Bw);
+        free(Ci);
+        free(z);
+        Bw = NULL;
+        return 5;
+    }
+
+    /* B = 0 + Bi[0], doesn't need the base[32][8] table to be ready */
+    ge_p3_0(&u);
+    ge_madd(&t, &u, &Bi[0]);
+    ge_p1p1_to_p3(&B, &t);
+    ge_p3_to_cached(&Ci[0], &B);
+    ge_p3_dbl(&t, &B);
+    ge_p1p1_to_p3(&B2, &t);
+
+    for (i = 1; i < count; ++i) {
+        ge_add(&t, &B2, &Ci[i - 1]);
+        ge_p1p1_to_p3(&u, &t);
+        ge_p3_to_cached(&Ci[i], &u);
+    }
+
+    zinv = z + count;
+
+    for (i = 0; i < count; ++i) {
+        fe_copy(z[i], Ci[i].Z);
+    }
+
+    fe_batch_invert(zinv, z, count);
+
+    for (i = 0; i < count; ++i) {
+        fe_mul(Bw[i].yplusx, Ci[i].YplusX, zinv[i]);
+        fe_mul(Bw[i].yminusx, Ci[i].YminusX, zinv[i]);
+        fe_mul(Bw[i].xy2d, Ci[i].T2d, zinv[i]);
+    }
+
+    free(Ci);
+    free(z);
+    Bw_width = w;
+    return w;
+}
+
+int ge_base_wide_width(void) {
+    return Bw_width ? Bw_width : 5;
+}
+
+/*
+Ai = A,3A,5A,7A,9A,11A,13A,15A
+*/
+
+void ge_p3_odd_multiples(ge_cached *Ai, const ge_p3 *A) {
+    ge_p1p1 t;
+    ge_p3 u;
+    ge_p3 A2;
+    int i;
+    ge_p3_to_cached(&Ai[0], A);
+    ge_p3_dbl(&t, A);
+    ge_p1p1_to_p3(&A2, &t);
+
+    for (i = 1; i < 8; ++i) {
+        ge_add(&t, &A2, &Ai[i - 1]);
+        ge_p1p1_to_p3(&u, &t);
+        ge_p3_to_cached(&Ai[i], &u);
+    }
+}
+
 /*
 r = a * A + b * B
 where a = a[0]+256*a[1]+...+256^31 a[31].
@@ -65,39 +202,36 @@ B is the Ed25519 base point (x,4/5) with x positive.
 */
 
 void ge_double_scalarmult_vartime(ge_p2 *r, const u8 *a, const ge_p3 *A, const u8 *b) {
-    signed char aslide[256];
-    signed char bslide[256];
     ge_cached Ai[8]; /* A,3A,5A,7A,9A,11A,13A,15A */
+    ge_p3_odd_multiples(Ai, A);
+    ge_double_scalarmult_cached_vartime(r, a, Ai, b);
+}
+
+/*
+Same with Ai = ge_p3_odd_multiples(A) computed by the caller,
+so it can be kept for many scalars with the same A.
+*/
+
+void ge_double_scalarmult_cached_vartime(ge_p2 *r, const u8 *a, const ge_cached *Ai, const u8 *b) {
+    const ge_precomp *Bt;
+    int w;
+    base_table(&Bt, &w);
+    ge_double_scalarmult_table_vartime(r, a, Ai, b, Bt, w);
+}
+
+/*
+Same with an explicit odd-multiples table Bt of B for width w,
+Bi with w = 5 is the narrow kernel.
+*/
+
+void ge_double_scalarmult_table_vartime(ge_p2 *r, const u8 *a, const ge_cached *Ai, const u8 *b, const ge_precomp *Bt, int w) {
+    short aslide[256];
+    short bslide[256];
     ge_p1p1 t;
     ge_p3 u;
-    ge_p3 A2;
     int i;
     slide(aslide, a);
-    slide(bslide, b);
-    ge_p3_to_cached(&Ai[0], A);
-    ge_p3_dbl(&t, A);
-    ge_p1p1_to_p3(&A2, &t);
-    ge_add(&t, &A2, &Ai[0]);
-    ge_p1p1_to_p3(&u, &t);
-    ge_p3_to_cached(&Ai[1], &u);
-    ge_add(&t, &A2, &Ai[1]);
-    ge_p1p1_to_p3(&u, &t);
-    ge_p3_to_cached(&Ai[2], &u);
-    ge_add(&t, &A2, &Ai[2]);
-    ge_p1p1_to_p3(&u, &t);
-    ge_p3_to_cached(&Ai[3], &u);
-    ge_add(&t, &A2, &Ai[3]);
-    ge_p1p1_to_p3(&u, &t);
-    ge_p3_to_cached(&Ai[4], &u);
-    ge_add(&t, &A2, &Ai[4]);
-    ge_p1p1_to_p3(&u, &t);
-    ge_p3_to_cached(&Ai[5], &u);
-    ge_add(&t, &A2, &Ai[5]);
-    ge_p1p1_to_p3(&u, &t);
-    ge_p3_to_cached(&Ai[6], &u);
-    ge_add(&t, &A2, &Ai[6]);
-    ge_p1p1_to_p3(&u, &t);
-    ge_p3_to_cached(&Ai[7], &u);
+    slide_w(bslide, b, w);
     ge_p2_0(r);
 
     for (i = 255; i >= 0; --i) {
@@ -119,24 +253,107 @@ void ge_double_scalarmult_vartime(ge_p2 *r, const u8 *a, const ge_p3 *A, const u
 
         if (bslide[i] > 0) {
             ge_p1p1_to_p3(&u, &t);
-            ge_madd(&t, &u, &Bi[bslide[i] / 2]);
+            ge_madd(&t, &u, &Bt[bslide[i] / 2]);
+        } else if (bslide[i] < 0) {
+            ge_p1p1_to_p3(&u, &t);
+            ge_msub(&t, &u, &Bt[(-bslide[i]) / 2]);
+        }
+
+        ge_p1p1_to_p2(r, &t);
+    }
+}
+
+
+/*
+r = a[0] * A[0] + ... + a[n-1] * A[n-1] + b * B
+where each a[i] (32 bytes, at a + 32*i) and b are little-endian scalars.
+Straus: one shared doubling chain, one odd-multiples table per point.
+Returns -1 if scratch memory can't be allocated.
+*/
+
+int ge_multi_scalarmult_vartime(ge_p2 *r, const u8 *a, const ge_p3 *A, size_t n, const u8 *b) {
+    short *aslide;
+    short bslide[256];
+    ge_cached *Ai;
+    ge_p1p1 t;
+    ge_p3 u;
+    short v;
+    size_t j;
+    int i;
+    int top = -1;
+    const ge_precomp *Bt;
+    int w;
+
+    aslide = (short *) malloc(n * 256 * sizeof(short));
+    Ai = (ge_cached *) malloc(n * 8 * sizeof(ge_cached));
+
+    if (aslide == NULL || Ai == NULL) {
+        free(aslide);
+        free(Ai);
+        return -1;
+    }
+
+    base_table(&Bt, &w);
+    slide_w(bslide, b, w);
+
+    for (i = 255; i > top; --i) {
+        if (bslide[i]) {
+            top = i;
+        }
+    }
+
+    for (j = 0; j < n; ++j) {
+        slide(aslide + 256 * j, a + 32 * j);
+        ge_p3_odd_multiples(Ai + 8 * j, &A[j]);
+
+        for (i = 255; i > top; --i) {
+            if (aslide[256 * j + i]) {
+                top = i;
+            }
+        }
+    }
+
+    ge_p2_0(r);
+
+    for (i = top; i >= 0; --i) {
+        ge_p2_dbl(&t, r);
+
+        for (j = 0; j < n; ++j) {
+            v = aslide[256 * j + i];
+
+            if (v > 0) {
+                ge_p1p1_to_p3(&u, &t);
+                ge_add(&t, &u, &Ai[8 * j + v / 2]);
+            } else if (v < 0) {
+                ge_p1p1_to_p3(&u, &t);
+                ge_sub(&t, &u, &Ai[8 * j + (-v) / 2]);
+            }
+        }
+
+        if (bslide[i] > 0) {
+            ge_p1p1_to_p3(&u, &t);
+            ge_madd(&t, &u, &Bt[bslide[i] / 2]);
         } else if (bslide[i] < 0) {
             ge_p1p1_to_p3(&u, &t);
-            ge_msub(&t, &u, &Bi[(-bslide[i]) / 2]);
+            ge_msub(&t, &u, &Bt[(-bslide[i]) / 2]);
         }
 
         ge_p1p1_to_p2(r, &t);
     }
+
+    free(aslide);
+    free(Ai);
+    return 0;
 }
 
 
-static const fe d = {
+static const fe d = FE(
     -10913610, 13857413, -15372611, 6949391, 114729, -8787816, -6275908, -3247719, -18696448, -12055116
-};
+);
 
-static const fe sqrtm1 = {
+static const fe sqrtm1 = FE(
     -32595792, -7943725, 9377950, 3500415, 12389472, -272473, -25146209, -2005654, 326686, 11406482
-};
+);
 
 int ge_frombytes_negate_vartime(ge_p3 *h, const u8 *s) {
     fe u;
@@ -295,9 +512,9 @@ void ge_p3_dbl(ge_p1p1 *r, const ge_p3 *p) {
 r = p
 */
 
-static const fe d2 = {
+static const fe d2 = FE(
     -21827239, -5839606, -30745221, 13898782, 229458, 15978800, -12551817, -6495438, 29715968, 9444199
-};
+);
 
 void ge_p3_to_cached(ge_cached *r, const ge_p3 *p) {
     fe_add(r->YplusX, p->Y, p->X);
@@ -329,6 +546,43 @@ void ge_p3_tobytes(u8 *s, const ge_p3 *h) {
     s[31] ^= fe_isnegative(x) << 7;
 }
 
+/*
+ge_p3_tobytes for n points (32 bytes each at s + 32*i), one shared inversion.
+Returns -1 if scratch memory can't be allocated.
+*/
+
+int ge_p3_batch_tobytes(u8 *s, const ge_p3 *h, size_t n) {
+    fe *z;
+    fe *recip;
+    fe x;
+    fe y;
+    size_t i;
+
+    z = (fe *) malloc(2 * n * sizeof(fe));
+
+    if (z == NULL) {
+        return -1;
+    }
+
+    recip = z + n;
+
+    for (i = 0; i < n; ++i) {
+        fe_copy(z[i], h[i].Z);
+    }
+
+    fe_batch_invert(recip, z, n);
+
+    for (i = 0; i < n; ++i) {
+        fe_mul(x, h[i].X, recip[i]);
+        fe_mul(y, h[i].Y, recip[i]);
+        fe_tobytes(s + 32 * i, y);
+        s[32 * i + 31] ^= fe_isnegative(x) << 7;
+    }
+
+    free(z);
+    return 0;
+}
+
 
 static u8 equal(signed char b, signed char c) {
     u8 ub = b;
@@ -353,27 +607,144 @@ static void cmov(ge_precomp *t, const ge_precomp *u, u8 b) {
 }
 
 
-static void select(ge_precomp *t, int pos, signed char b) {
-    ge_precomp minust;
-    u8 bnegative = negative(b);
-    u8 babs = b - (((-bnegative) & b) << 1);
+/*
+t = row[babs - 1], or the identity (1,1,0) for babs = 0.
+Every entry of the row is read and blended, no branch or index depends on babs.
+*/
+
+static void select_row_scalar(ge_precomp *t, const ge_precomp *row, u8 babs) {
     fe_1(t->yplusx);
     fe_1(t->yminusx);
     fe_0(t->xy2d);
-    cmov(t, &base[pos][0], equal(babs, 1));
-    cmov(t, &base[pos][1], equal(babs, 2));
-    cmov(t, &base[pos][2], equal(babs, 3));
-    cmov(t, &base[pos][3], equal(babs, 4));
-    cmov(t, &base[pos][4], equal(babs, 5));
-    cmov(t, &base[pos][5], equal(babs, 6));
-    cmov(t, &base[pos][6], equal(babs, 7));
-    cmov(t, &base[pos][7], equal(babs, 8));
+    cmov(t, &row[0], equal(babs, 1));
+    cmov(t, &row[1], equal(babs, 2));
+    cmov(t, &row[2], equal(babs, 3));
+    cmov(t, &row[3], equal(babs, 4));
+    cmov(t, &row[4], equal(babs, 5));
+    cmov(t, &row[5], equal(babs, 6));
+    cmov(t, &row[6], equal(babs, 7));
+    cmov(t, &row[7], equal(babs, 8));
+}
+
+/*
+Same on raw bytes with 256-bit blends, so it doesn't care about the fe limb
+layout. A ge_precomp (120 bytes for both fe backends) is covered by four
+32-byte chunks, the last one overlapping the third.
+*/
+
+typedef u32 ge_v8u32 __attribute__((vector_size(32)));
+typedef char ge_precomp_is_4_chunks[sizeof(ge_precomp) > 96 && sizeof(ge_precomp) <= 128 ? 1 : -1];
+
+__attribute__((target("avx2")))
+static void select_row_avx2(ge_precomp *t, const ge_precomp *row, u8 babs) {
+    const size_t last = sizeof(ge_precomp) - 32;
+    ge_v8u32 a0, a1, a2, a3;
+    ge_v8u32 v0, v1, v2, v3;
+    ge_v8u32 mask;
+    ge_v8u32 zero = {0};
+    const u8 *p;
+    int j;
+
+    fe_1(t->yplusx);
+    fe_1(t->yminusx);
+    fe_0(t->xy2d);
+    p = (const u8 *) t;
+    memcpy(&a0, p, 32);
+    memcpy(&a1, p + 32, 32);
+    memcpy(&a2, p + 64, 32);
+    memcpy(&a3, p + last, 32);
+
+    for (j = 0; j < 8; ++j) {
+        mask = zero - (u32) equal(babs, j + 1);
+        p = (const u8 *) &row[j];
+        memcpy(&v0, p, 32);
+        memcpy(&v1, p + 32, 32);
+        memcpy(&v2, p + 64, 32);
+        memcpy(&v3, p + last, 32);
+        a0 ^= (a0 ^ v0) & mask;
+        a1 ^= (a1 ^ v1) & mask;
+        a2 ^= (a2 ^ v2) & mask;
+        a3 ^= (a3 ^ v3) & mask;
+    }
+
+    memcpy((u8 *) t, &a0, 32);
+    memcpy((u8 *) t + 32, &a1, 32);
+    memcpy((u8 *) t + 64, &a2, 32);
+    memcpy((u8 *) t + last, &a3, 32);
+}
+
+typedef void (*select_row_fn)(ge_precomp *t, const ge_precomp *row, u8 babs);
+
+static select_row_fn select_row_kernel = NULL;
+
+static void select_with(ge_precomp *t, int pos, signed char b, select_row_fn kernel) {
+    ge_precomp minust;
+    u8 bnegative = negative(b);
+    u8 babs = b - (((-bnegative) & b) << 1);
+    kernel(t, base[pos], babs);
     fe_copy(minust.yplusx, t->yminusx);
     fe_copy(minust.yminusx, t->yplusx);
     fe_neg(minust.xy2d, t->xy2d);
     cmov(t, &minust, bnegative);
 }
 
+/* AVX2 and scalar lookups that differ, over every row of base and every digit -8..8 */
+static int select_mismatch_count(void) {
+    ge_precomp t0;
+    ge_precomp t1;
+    int pos;
+    int b;
+    int res = 0;
+
+    for (pos = 0; pos < 32; ++pos) {
+        for (b = -8; b <= 8; ++b) {
+            select_with(&t0, pos, b, select_row_scalar);
+            select_with(&t1, pos, b, select_row_avx2);
+            res += memcmp(&t0, &t1, sizeof(ge_precomp)) != 0;
+        }
+    }
+
+    return res;
+}
+
+/*
+Picks the row lookup kernel once. The AVX2 one is only kept if it gives
+the same bytes as the scalar one for every row and digit of base,
+so base has to be ready (LOOKT_write_lookup_table_to_flash).
+Returns 1 for AVX2, 0 for scalar.
+*/
+
+int ge_select_init(void) {
+    if (select_row_kernel != NULL) {
+        return select_row_kernel == select_row_avx2;
+    }
+
+    __builtin_cpu_init();
+
+    if (__builtin_cpu_supports("avx2") && select_mismatch_count() == 0) {
+        select_row_kernel = select_row_avx2;
+        return 1;
+    }
+
+    select_row_kernel = select_row_scalar;
+    return 0;
+}
+
+/* the same comparison on demand, -1 if the cpu has no AVX2 */
+int ge_select_check(void) {
+    __builtin_cpu_init();
+
+    if (!__builtin_cpu_supports("avx2")) {
+        return -1;
+    }
+
+    return select_mismatch_count();
+}
+
+static void select(ge_precomp *t, int pos, signed char b) {
+    select_with(t, pos, b, select_row_kernel);
+}
+
 /*
 h = a * B
 where a = a[0]+256*a[1]+...+256^31 a[31]
@@ -391,6 +762,8 @@ void ge_scalarmult_base(ge_p3 *h, const u8 *a) {
     ge_precomp t;
     int i;
 
+    ge_select_init();
+
     for (i = 0; i < 32; ++i) {
         e[2 * i + 0] = (a[i] >> 0) & 15;
         e[2 * i + 1] = (a[i] >> 4) & 15;
@@ -49,15 +49,26 @@ typedef struct {
 } ge_cached;
 
 void ge_p3_tobytes(u8 *s, const ge_p3 *h);
+int ge_p3_batch_tobytes(u8 *s, const ge_p3 *h, size_t n);
 void ge_tobytes(u8 *s, const ge_p2 *h);
 int ge_frombytes_negate_vartime(ge_p3 *h, const u8 *s);
 
 void ge_add(ge_p1p1 *r, const ge_p3 *p, const ge_cached *q);
 void ge_sub(ge_p1p1 *r, const ge_p3 *p, const ge_cached *q);
 void ge_double_scalarmult_vartime(ge_p2 *r, const u8 *a, const ge_p3 *A, const u8 *b);
+void ge_double_scalarmult_cached_vartime(ge_p2 *r, const u8 *a, const ge_cached *Ai, const u8 *b);
+void ge_double_scalarmult_table_vartime(ge_p2 *r, const u8 *a, const ge_cached *Ai, const u8 *b, const ge_precomp *Bt, int w);
+int ge_multi_scalarmult_vartime(ge_p2 *r, const u8 *a, const ge_p3 *A, size_t n, const u8 *b);
 void ge_madd(ge_p1p1 *r, const ge_p3 *p, const ge_precomp *q);
 void ge_msub(ge_p1p1 *r, const ge_p3 *p, const ge_precomp *q);
 void ge_scalarmult_base(ge_p3 *h, const u8 *a);
+int ge_select_init(void);
+int ge_select_check(void);
+
+/* 2^(w-2) * sizeof(ge_precomp) bytes, 120 KB for w = 12 */
+#define GE_BASE_WIDE_MAX 12
+int ge_base_wide_init(size_t budget);
+int ge_base_wide_width(void);
 
 void ge_p1p1_to_p2(ge_p2 *r, const ge_p1p1 *p);
 void ge_p1p1_to_p3(ge_p3 *r, const ge_p1p1 *p);
@@ -66,5 +77,6 @@ void ge_p2_dbl(ge_p1p1 *r, const ge_p2 *p);
 void ge_p3_0(ge_p3 *h);
 void ge_p3_dbl(ge_p1p1 *r, const ge_p3 *p);
 void ge_p3_to_cached(ge_cached *r, const ge_p3 *p);
+void ge_p3_odd_multiples(ge_cached *Ai, const ge_p3 *A);
 void ge_p3_to_p2(ge_p2 *r, const ge_p3 *p);
 
@@ -1,6 +1,7 @@
 #include "ed25519.h"
 #include "sha512.h"
 #include "ge.h"
+#include <stdlib.h>
 
 
 void ed25519_create_keypair(u8 *public_key, u8 *private_key, const u8 *seed) {
@@ -14,3 +15,34 @@ void ed25519_create_keypair(u8 *public_key, u8 *private_key, const u8 *seed) {
     ge_scalarmult_base(&A, private_key);
     ge_p3_tobytes(public_key, &A);
 }
+
+/*
+num keypairs (32/64 bytes each) from num seeds, ge_p3_tobytes inversions
+shared across the batch. Returns 1 if scratch memory can't be allocated.
+*/
+int ed25519_create_keypairs(u8 *public_keys, u8 *private_keys, const u8 *seeds, size_t num) {
+    ge_p3 *A;
+    u8 *private_key;
+    size_t i;
+    int res;
+
+    A = (ge_p3 *) malloc(num * sizeof(ge_p3));
+
+    if (A == NULL) {
+        return 1;
+    }
+
+    for (i = 0; i < num; ++i) {
+        private_key = private_keys + 64 * i;
+        sha512(seeds + 32 * i, 32, private_key);
+        private_key[0] &= 248;
+        private_key[31] &= 63;
+        private_key[31] |= 64;
+
+        ge_scalarmult_base(&A[i], private_key);
+    }
+
+    res = ge_p3_batch_tobytes(public_keys, A, num) != 0;
+    free(A);
+    return res;
+}
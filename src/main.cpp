@@ -15,8 +15,34 @@
 #include<algorithm>
 #include<vector>
 #include<unordered_map>
+#include<list>
+#include<map>
+#include<set>
+#include<memory>
+#include<deque>
+#include<queue>
+#include<tuple>
+#include<mutex>
+#include<condition_variable>
+#include<atomic>
+#include<functional>
 #include<cstring>
 #include<getopt.h>
+#include<sys/wait.h>
+#include<sys/socket.h>
+#include<sys/time.h>
+#include<sys/sendfile.h>
+#include<netinet/in.h>
+#include<zlib.h>
+// build.coffee #defines U and V before everything, pb_ds names template parameters so
+#pragma push_macro("U")
+#pragma push_macro("V")
+#undef U
+#undef V
+#include<ext/pb_ds/assoc_container.hpp>
+#include<ext/pb_ds/tree_policy.hpp>
+#pragma pop_macro("U")
+#pragma pop_macro("V")
 #define FOR_COL(it, arr) for(auto it = arr.begin(), end = arr.end(); it != end; ++it)
 
 using namespace std;
@@ -26,6 +52,7 @@ using namespace Json;
 // cryptography
 #include "ed25519.h"
 #include "fe.c"
+#include "fe51.c"
 #include "ge.c"
 #include "sc.c"
 #include "keypair.c"
@@ -66,10 +93,24 @@ int main(int argc, char **argv) {
     {"pub_key_path",      1,      0,  0  },
     {"prv_key_path",      1,      0,  0  },
     {"drop_keys",         0,      0,  0  },
+    {"verify_table_kb",   1,      0,  0  },
+    {"block_cache_mb",    1,      0,  0  },
+    {"chain_path",        1,      0,  0  },
+    {"block_tail",        1,      0,  0  },
+    {"snapshot_interval", 1,      0,  0  },
+    {"rpc_pack_port",     1,      0,  0  },
+    {"durability",        1,      0,  0  },
+    {"mempool_mb",        1,      0,  0  },
+    {"mempool_tx",        1,      0,  0  },
+    {"block_tx_max",      1,      0,  0  },
+    {"replay_check",      0,      0,  0  },
     {0, 0, 0, 0}
   };
   
   bool drop_keys = false;
+  bool replay_check_only = false;
+  // wide B table for signature verification, 0 = built-in 8 entry table
+  u32 verify_table_kb = 8;
   while (1) {
     int c = getopt_long(argc, argv, "", long_options, &option_index);
     if (c == -1) break;
@@ -93,8 +134,42 @@ int main(int argc, char **argv) {
       case 5:
         drop_keys = true;
         break;
+      case 6:
+        verify_table_kb = atoi(optarg);
+        break;
+      case 7:
+        block_wire_cache.size_limit = (u64)atoi(optarg) << 20;
+        break;
+      case 8:
+        chain_path = optarg;
+        break;
+      case 9:
+        main_chain_tail_size = max(1, atoi(optarg));
+        break;
+      case 10:
+        snapshot_interval = atoi(optarg);
+        break;
+      case 11:
+        RPC_PACK_PORT = atoi(optarg);
+        break;
+      case 12:
+        durability = min(2, max(0, atoi(optarg)));
+        break;
+      case 13:
+        mempool.byte_limit = (u64)atoi(optarg) << 20;
+        break;
+      case 14:
+        mempool.count_limit = max(1, atoi(optarg));
+        break;
+      case 15:
+        block_tx_limit = max(1, atoi(optarg));
+        break;
+      case 16:
+        replay_check_only = true;
+        break;
     }
   }
+  printf("verify table width %d\n", ge_base_wide_init(verify_table_kb*1024));
   
   if (drop_keys) {
     printf("drop keys\n");
@@ -189,8 +264,29 @@ int main(int argc, char **argv) {
     printf("prv_key %s\n", prv_exists?"present":"missing");
     return 1;
   }
+  if (!block_log_open(chain_path)) {
+    printf("failed to open block log %s\n", chain_path.c_str());
+    return 1;
+  }
+  if (durability) {
+    thread(persist_writer).detach();
+  }
+  printf("restored bc_height %d\n", chain_restore());
+  if (replay_check_only) {
+    // no servers yet, the replay may rebuild gms
+    bool ok = replay_check();
+    printf("replay check %s\n", ok ? "ok" : "failed");
+    persist_stop();
+    return ok ? 0 : 1;
+  }
+  pack_scan();
+  thread(pack_server).detach();
   if (i_am_seed_node) {
-    gms_init();
+    if (bc_height()) {
+      gms.ready = true;
+    } else {
+      gms_init();
+    }
   } else {
     NetNode node;
     node.ip_port = seed_ip_port;
@@ -205,6 +301,7 @@ int main(int argc, char **argv) {
   s2.StartListening();
   printf("pub server port %d\n", RPC_PUB_PORT);
   printf("prv server port %d\n", RPC_PRV_PORT);
+  printf("pack server port %d\n", RPC_PACK_PORT);
   printf("seed_ip_port___ %s\n", seed_ip_port.c_str());
   printf("i_am_seed_node_ %d\n", i_am_seed_node);
   printf("welcome to UTON HACK!\n");
@@ -240,5 +337,6 @@ int main(int argc, char **argv) {
   }
   s1.StopListening();
   s2.StopListening();
+  persist_stop();
   return 0;
 }
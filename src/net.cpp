@@ -2,6 +2,127 @@
 // u32 pseudo_broadcast_limit = 7;
 u32 pseudo_broadcast_limit = 1; // DEBUG
 
+void socket_timeout_set(int fd, u32 sec) {
+  struct timeval tv = {0};
+  tv.tv_sec = sec;
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+  setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+}
+// pack files, outside of jsonrpc so the file goes to the socket as is
+void pack_serve_con(int fd) {
+  char req[256];
+  u32 len = 0;
+  while (len < sizeof(req) - 1) {
+    ssize_t n = read(fd, req + len, sizeof(req) - 1 - len);
+    if (n <= 0) break;
+    len += n;
+    req[len] = 0;
+    if (strstr(req, "\r\n\r\n")) break;
+  }
+  req[len] = 0;
+  u32 pack_id;
+  int file_fd = -1;
+  if (sscanf(req, "GET /pack/%u ", &pack_id) == 1) {
+    lock_guard<mutex> guard(pack_state.lock);
+    if (pack_id < pack_state.count) file_fd = open(pack_path(pack_id).c_str(), O_RDONLY);
+  }
+  struct stat st;
+  if (file_fd < 0 || fstat(file_fd, &st)) {
+    const char *res = "HTTP/1.0 404 Not Found\r\nContent-Length: 0\r\n\r\n";
+    write(fd, res, strlen(res));
+  } else {
+    string head = "HTTP/1.0 200 OK\r\nContent-Type: application/octet-stream\r\nContent-Length: " + to_string(st.st_size) + "\r\n\r\n";
+    off_t offset = 0;
+    if (write(fd, head.data(), head.size()) == head.size()) {
+      while (offset < st.st_size && sendfile(fd, file_fd, &offset, st.st_size - offset) > 0);
+    }
+  }
+  if (file_fd >= 0) close(file_fd);
+  close(fd);
+}
+void pack_server() {
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (fd < 0) return;
+  int one = 1;
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  struct sockaddr_in addr = {0};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  addr.sin_port = htons(RPC_PACK_PORT);
+  if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) || listen(fd, 16)) {
+    printf("pack server failed on port %d\n", RPC_PACK_PORT);
+    close(fd);
+    return;
+  }
+  static atomic<u32> con_count(0);
+  while (true) {
+    int con = accept(fd, NULL, NULL);
+    if (con < 0) continue;
+    if (con_count >= pack_con_limit) {
+      close(con);
+      continue;
+    }
+    socket_timeout_set(con, pack_io_timeout_sec);
+    con_count++;
+    thread([con]() {
+      pack_serve_con(con);
+      con_count--;
+    }).detach();
+  }
+}
+// ip_port is "http://a.b.c.d:port"
+bool pack_fetch(const string &ip_port, u32 port, u32 pack_id, vector<u8> &buf) {
+  size_t from = ip_port.find("//"), to = ip_port.rfind(':');
+  if (from == string::npos || to == string::npos || to < from) return false;
+  string host = ip_port.substr(from + 2, to - from - 2);
+  struct sockaddr_in addr = {0};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  if (inet_pton(AF_INET, host.c_str(), &addr.sin_addr) != 1) return false;
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (fd < 0) return false;
+  socket_timeout_set(fd, pack_io_timeout_sec);
+  string req = "GET /pack/" + to_string(pack_id) + " HTTP/1.0\r\n\r\n";
+  if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) || write(fd, req.data(), req.size()) != req.size()) {
+    close(fd);
+    return false;
+  }
+  // head first, the body size is checked before it is read
+  string head;
+  size_t body = string::npos;
+  char chunk[1 << 16];
+  ssize_t n;
+  while (body == string::npos && head.size() < 4096 && (n = read(fd, chunk, sizeof(chunk))) > 0) {
+    head.append(chunk, n);
+    body = head.find("\r\n\r\n");
+  }
+  size_t field = head.find("Content-Length:");
+  bool res = body != string::npos && !head.compare(0, 12, "HTTP/1.0 200") && field < body;
+  u64 size = res ? strtoull(head.c_str() + field + 15, NULL, 10) : 0;
+  res = res && size && size <= pack_size_max() && head.size() - body - 4 <= size;
+  if (res) {
+    buf.assign(head.begin() + body + 4, head.end());
+    size_t len = buf.size();
+    buf.resize(size);
+    while (len < size && (n = read(fd, buf.data() + len, size - len)) > 0) len += n;
+    res = len == size;
+  }
+  close(fd);
+  return res;
+}
+
+bool net_block_apply(Block &block) {
+  State_overlay overlay;
+  if (!block_validate(block, &overlay)) return false;
+  if (bc_height() == 0) {
+    // genesis костыль
+    gms_account_new(block.header.issuer_pub_key);
+    balance_set(0, 1e6);
+  }
+  block_apply(block, &overlay);
+  return true;
+}
+
 void net_ask_con(NetNode &node) {
   try {
     HttpClient c1(node.ip_port);
@@ -36,23 +157,59 @@ void net_ask_con(NetNode &node) {
     if (!gms.ready && remote_bc_height == bh) {
       gms.ready = true;
     } else {
+      // форк: у них длиннее, а наш последний блок у них другой - откатываемся до общего предка
+      if (gms.ready && remote_bc_height > bh && bh > 1) {
+        u32 n = 0;
+        while (true) {
+          Value param;
+          param["id"] = bh - 1 - n;
+          Block remote_block, local_block;
+          if (!hex_to_block(c.CallMethod("get_block_bin", param).asString(), remote_block)) return;
+          if (!block_get(bh - 1 - n, local_block)) return;
+          if (!(remote_block.header.hash != local_block.header.hash)) break;
+          // глубже журналов нет
+          if (++n > gms.undo_list.size() || n >= bh) return;
+        }
+        if (n) {
+          // их ветка целиком, откат только если она проходит проверку и тяжелее нашей
+          u32 fork_id = bh - n;
+          u32 count = min(remote_bc_height - fork_id, undo_depth);
+          vector<Block> branch(count);
+          for(u32 i=0;i<count;i++) {
+            Value param;
+            param["id"] = fork_id + i;
+            if (!hex_to_block(c.CallMethod("get_block_bin", param).asString(), branch[i])) return;
+          }
+          if (!chain_fork_switch(n, branch)) return;
+          bh = bc_height();
+        }
+      }
+      // целыми пачками, пока есть
+      while (bh % pack_block_count == 0 && remote_bc_height >= bh + pack_block_count + pack_finality) {
+        Value param;
+        param["id"] = bh / pack_block_count;
+        Value info = c.CallMethod("get_pack_info", param);
+        if (!info.isObject()) break;
+        vector<u8> buf;
+        vector<Block> block_list;
+        if (!pack_fetch(node.ip_port, info["port"].asUInt(), bh / pack_block_count, buf)) break;
+        if (!pack_unpack(buf.data(), buf.size(), bh / pack_block_count, block_list)) break;
+        gms.target_bc_height = remote_bc_height;
+        FOR_COL(it, block_list) {
+          if (!net_block_apply(*it)) return;
+          bh++;
+        }
+      }
       while(remote_bc_height > bh && limit--) {
         gms.target_bc_height = remote_bc_height;
         Value param;
         param["id"] = bh;
         // printf("get_block_number %d\n", bh);
         // cout << c.CallMethod("get_block_number", param) << endl;
-        Value json_block = c.CallMethod("get_block_number", param);
+        Value bin_block = c.CallMethod("get_block_bin", param);
         Block tmp;
-        if (!json_to_block(json_block, tmp)) return;
-        if (!block_validate(tmp)) return;
-        if (bh == 0) {
-          // genesis костыль
-          gms_account_new(tmp.header.issuer_pub_key);
-          gms.balance[0] = 1e6;
-        }
-        
-        block_apply(tmp);
+        if (!hex_to_block(bin_block.asString(), tmp)) return;
+        if (!net_block_apply(tmp)) return;
         bh++;
       }
       return;
@@ -60,9 +217,9 @@ void net_ask_con(NetNode &node) {
     
     {
       // cout << c.CallMethod("get_proposed_block", nullValue) << endl;
-      Value json_block = c.CallMethod("get_proposed_block", nullValue);
+      Value bin_block = c.CallMethod("get_proposed_block_bin", nullValue);
       Block tmp;
-      if (!json_to_block(json_block, tmp)) {
+      if (!hex_to_block(bin_block.asString(), tmp)) {
         // а чё с тобой дальше говорить...
         node.is_proposal_valid = false;
         return;
@@ -1,5 +1,10 @@
 u32 RPC_PRV_PORT = 10002;
 u32 RPC_PUB_PORT = 10001;
+// plain http, GET /pack/N, whole pack files go out with sendfile
+u32 RPC_PACK_PORT = 10003;
+// pack sockets give up after this, both ways; at most pack_con_limit are served at once
+const u32 pack_io_timeout_sec = 10;
+const u32 pack_con_limit = 16;
 string seed_ip_port = "http://192.168.2.3:10001";
 
 struct NetNode {
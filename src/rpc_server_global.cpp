@@ -15,6 +15,37 @@ class GlobalServer : public AbstractServer<GlobalServer> {
       "get_block_number", PARAMS_BY_NAME, JSON_OBJECT,
         NULL),
       &GlobalServer::get_block_numberI);
+    bindAndAddMethod(Procedure(
+      "get_block_bin", PARAMS_BY_NAME, JSON_STRING,
+        "id", JSON_INTEGER,
+        NULL),
+      &GlobalServer::get_block_binI);
+    bindAndAddMethod(Procedure(
+      "get_block_by_hash", PARAMS_BY_NAME, JSON_OBJECT,
+        "hash", JSON_STRING,
+        NULL),
+      &GlobalServer::get_block_by_hashI);
+    bindAndAddMethod(Procedure(
+      "get_pack_info", PARAMS_BY_NAME, JSON_OBJECT,
+        "id", JSON_INTEGER,
+        NULL),
+      &GlobalServer::get_pack_infoI);
+    bindAndAddMethod(Procedure(
+      "get_weight_rank", PARAMS_BY_NAME, JSON_OBJECT,
+        "address", JSON_STRING,
+        NULL),
+      &GlobalServer::get_weight_rankI);
+    bindAndAddMethod(Procedure(
+      "get_top_weights", PARAMS_BY_NAME, JSON_ARRAY,
+        "count", JSON_INTEGER,
+        NULL),
+      &GlobalServer::get_top_weightsI);
+    bindAndAddMethod(Procedure(
+      "get_tx_proof", PARAMS_BY_NAME, JSON_OBJECT,
+        "id"  , JSON_INTEGER,
+        "hash", JSON_STRING,
+        NULL),
+      &GlobalServer::get_tx_proofI);
     bindAndAddMethod(Procedure(
       "tx_push", PARAMS_BY_NAME, JSON_OBJECT,
             "type"          , JSON_INTEGER,
@@ -38,6 +69,10 @@ class GlobalServer : public AbstractServer<GlobalServer> {
       "get_proposed_block", PARAMS_BY_NAME, JSON_OBJECT,
           NULL),
       &GlobalServer::get_proposed_blockI);
+    bindAndAddMethod(Procedure(
+      "get_proposed_block_bin", PARAMS_BY_NAME, JSON_STRING,
+          NULL),
+      &GlobalServer::get_proposed_block_binI);
     bindAndAddMethod(Procedure(
       "proposed_block_push", PARAMS_BY_NAME, JSON_STRING,
         "header", JSON_OBJECT,
@@ -80,6 +115,26 @@ class GlobalServer : public AbstractServer<GlobalServer> {
     rpc_get_block_number(request, response);
   }
   
+  void get_block_binI(const Value &request, Value &response) {
+    rpc_get_block_bin(request, response);
+  }
+  void get_block_by_hashI(const Value &request, Value &response) {
+    rpc_get_block_by_hash(request, response);
+  }
+  void get_pack_infoI(const Value &request, Value &response) {
+    rpc_get_pack_info(request, response);
+  }
+  void get_weight_rankI(const Value &request, Value &response) {
+    rpc_get_weight_rank(request, response);
+  }
+  void get_top_weightsI(const Value &request, Value &response) {
+    rpc_get_top_weights(request, response);
+  }
+  
+  void get_tx_proofI(const Value &request, Value &response) {
+    rpc_get_tx_proof(request, response);
+  }
+  
   void tx_pushI(const Value &request, Value &response) {
     rpc_tx_push(request, response);
   }
@@ -119,8 +174,21 @@ class GlobalServer : public AbstractServer<GlobalServer> {
     response = "ok";
   }
   void get_proposed_blockI(const Value &request, Value &response) {
+    auto wire = block_wire_proposal_get();
+    if (wire) {
+      response = wire->json;
+      return;
+    }
     block_to_json(gms.proposed_block, response);
   }
+  void get_proposed_block_binI(const Value &request, Value &response) {
+    auto wire = block_wire_proposal_get();
+    if (wire) {
+      response = wire->bin;
+      return;
+    }
+    response = block_to_hex(gms.proposed_block);
+  }
   void proposed_block_pushI(const Value &request, Value &response) {
     Block block;
     if (!json_to_block(request, block)) {
@@ -149,7 +217,7 @@ class GlobalServer : public AbstractServer<GlobalServer> {
       return;
       // throw JsonRpcException(-1, "Address not exists");
     }
-    response = gms.balance[address];
+    response = balance_get(address);
   }
   void transferI(const Value &request, Value &response) {
     u32 amount = request["amount"].asInt();
@@ -183,7 +251,7 @@ class GlobalServer : public AbstractServer<GlobalServer> {
       // throw JsonRpcException(-2, "you don't own from_address");
     }
     // overflow protection
-    if (gms.balance[from_address] < max(amount, amount + tx_fee)) {
+    if (balance_get(from_address) < max(amount, amount + tx_fee)) {
       response = "fail";
       return;
       // throw JsonRpcException(-3, "not enough balance");
@@ -194,6 +262,7 @@ class GlobalServer : public AbstractServer<GlobalServer> {
     tx.amount   = amount;
     tx.send_addr= from_address;
     tx.recv_addr= to_address;
+    tx.tx_epoch = tx_epoch_now();
     tx.nonce    = 0;
     tx_sign(tx, my_pub_key, my_prv_key);
     
@@ -206,7 +275,11 @@ class GlobalServer : public AbstractServer<GlobalServer> {
     
     printf("tx transfer %d coin %d -> %d\n", amount, from_address, to_address);
     
-    gms.tx_list.push_back(tx);
+    if (mempool_push(tx)) {
+      response = "fail";
+      return;
+      // throw JsonRpcException(-9, "mempool reject");
+    }
     
     response = "ok";
   }
@@ -244,6 +317,7 @@ class GlobalServer : public AbstractServer<GlobalServer> {
       return;
       // throw JsonRpcException(-1, "bad pub_key");
     }
+    tx.tx_epoch = tx_epoch_now();
     tx.nonce    = 0;
     tx_sign(tx, my_pub_key, my_prv_key);
     
@@ -256,7 +330,11 @@ class GlobalServer : public AbstractServer<GlobalServer> {
     
     printf("address transfer owner=%d address=%d pub_key=%s\n", my_primary_address, address, pub_key.c_str());
     
-    gms.tx_list.push_back(tx);
+    if (mempool_push(tx)) {
+      response = "fail";
+      return;
+      // throw JsonRpcException(-9, "mempool reject");
+    }
     
     response = "ok";
   }
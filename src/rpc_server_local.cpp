@@ -61,6 +61,29 @@ class LocalServer : public AbstractServer<LocalServer> {
       "debug_key_gen", PARAMS_BY_NAME, JSON_STRING,
         NULL),
       &LocalServer::debug_key_genI);
+    bindAndAddMethod(Procedure(
+      "debug_key_gen_bulk", PARAMS_BY_NAME, JSON_ARRAY,
+        "count", JSON_INTEGER,
+        NULL),
+      &LocalServer::debug_key_gen_bulkI);
+    bindAndAddMethod(Procedure(
+      "debug_verify_bench", PARAMS_BY_NAME, JSON_OBJECT,
+        "count", JSON_INTEGER,
+        NULL),
+      &LocalServer::debug_verify_benchI);
+    bindAndAddMethod(Procedure(
+      "debug_chain_rollback", PARAMS_BY_NAME, JSON_OBJECT,
+        "count", JSON_INTEGER,
+        NULL),
+      &LocalServer::debug_chain_rollbackI);
+    bindAndAddMethod(Procedure(
+      "get_persist_stats", PARAMS_BY_NAME, JSON_OBJECT,
+        NULL),
+      &LocalServer::get_persist_statsI);
+    bindAndAddMethod(Procedure(
+      "get_mempool_stats", PARAMS_BY_NAME, JSON_OBJECT,
+        NULL),
+      &LocalServer::get_mempool_statsI);
   }
   
   void bc_heightI(const Value &request, Value &response) {
@@ -85,7 +108,7 @@ class LocalServer : public AbstractServer<LocalServer> {
       return;
       // throw JsonRpcException(-1, "Address not exists");
     }
-    response = gms.balance[address];
+    response = balance_get(address);
   }
   
   void shutdownI(const Value &request, Value &response) {
@@ -104,15 +127,44 @@ class LocalServer : public AbstractServer<LocalServer> {
   }
   
   void get_my_weightI(const Value &request, Value &response) {
-    // TODO binary search
-    FOR_COL(it, gms.aw_sort_list) {
-      if (it->account == my_primary_address) {
-        response = it->weight;
-        return;
-      }
+    auto &w = weight_index;
+    lock_guard<mutex> guard(w.lock);
+    if (my_primary_address >= w.key_list.size()) {
+      response = 0;
+      return;
     }
-    
-    response = 0;
+    response = weight_from_key(w.key_list[my_primary_address]);
+  }
+  
+  void get_persist_statsI(const Value &request, Value &response) {
+    lock_guard<mutex> guard(persist.lock);
+    u64 block_count = persist.seq_durable;
+    response["durability"]      = durability;
+    response["commit_count"]    = persist.commit_count;
+    response["block_count"]     = block_count;
+    response["pending"]         = persist.seq_appended - persist.seq_durable;
+    response["batch_avg"]       = persist.commit_count ? (double)block_count/persist.commit_count : 0.0;
+    response["batch_max"]       = persist.batch_max;
+    response["latency_avg_us"]  = block_count ? persist.latency_sum_us/block_count : 0;
+    response["latency_max_us"]  = persist.latency_max_us;
+    response["latency_last_us"] = persist.latency_last_us;
+  }
+  
+  void get_mempool_statsI(const Value &request, Value &response) {
+    lock_guard<mutex> guard(mempool.lock);
+    response["count"]              = (u64)mempool.hash_index.size();
+    response["bytes"]              = mempool.byte_count;
+    response["sender_count"]       = (u64)mempool.sender_hash.size();
+    response["count_limit"]        = mempool.count_limit;
+    response["byte_limit"]         = mempool.byte_limit;
+    response["push_count"]         = mempool.push_count;
+    response["duplicate_count"]    = mempool.duplicate_count;
+    response["spend_reject_count"] = mempool.spend_reject_count;
+    response["evict_count"]        = mempool.evict_count;
+    response["drop_count"]         = mempool.drop_count;
+    response["pack_count_last"]    = mempool.pack_count_last;
+    response["pack_us_last"]       = mempool.pack_us_last;
+    response["block_tx_limit"]     = block_tx_limit;
   }
   
   void transferI(const Value &request, Value &response) {
@@ -147,7 +199,7 @@ class LocalServer : public AbstractServer<LocalServer> {
       // throw JsonRpcException(-2, "you don't own from_address");
     }
     // overflow protection
-    if (gms.balance[from_address] < max(amount, amount + tx_fee)) {
+    if (balance_get(from_address) < max(amount, amount + tx_fee)) {
       response = "fail";
       return;
       // throw JsonRpcException(-3, "not enough balance");
@@ -158,6 +210,7 @@ class LocalServer : public AbstractServer<LocalServer> {
     tx.amount   = amount;
     tx.send_addr= from_address;
     tx.recv_addr= to_address;
+    tx.tx_epoch = tx_epoch_now();
     tx.nonce    = 0;
     tx_sign(tx, my_pub_key, my_prv_key);
     
@@ -170,7 +223,11 @@ class LocalServer : public AbstractServer<LocalServer> {
     
     printf("tx transfer %d coin %d -> %d\n", amount, from_address, to_address);
     
-    gms.tx_list.push_back(tx);
+    if (mempool_push(tx)) {
+      response = "fail";
+      return;
+      // throw JsonRpcException(-9, "mempool reject");
+    }
     
     response = "ok";
   }
@@ -201,23 +258,18 @@ class LocalServer : public AbstractServer<LocalServer> {
       return;
       // throw JsonRpcException(-1, "bad pub_key size");
     }
-    for(int i=0;i<2*t_pub_key_size;i++) {
-      char ch = hex_pub_key[i];
-      if ('0' <= ch && ch <= '9') continue;
-      if ('a' <= ch && ch <= 'f') continue;
-      if ('A' <= ch && ch <= 'A') continue;
+    Tx tx;
+    if (!str2t_pub_key(hex_pub_key, tx.bind_pub_key)) {
       response = "fail";
       return;
       // throw JsonRpcException(-1, "bad pub_key hex");
     }
-    
-    Tx tx;
     tx.type     = 2;
     tx.amount   = 0;
     tx.send_addr= my_primary_address;
     tx.recv_addr= address;
     
-    str2t_pub_key(hex_pub_key, tx.bind_pub_key);
+    tx.tx_epoch = tx_epoch_now();
     tx.nonce    = 0;
     tx_sign(tx, my_pub_key, my_prv_key);
     
@@ -230,7 +282,11 @@ class LocalServer : public AbstractServer<LocalServer> {
     
     printf("address transfer owner=%d address=%d pub_key=%s\n", my_primary_address, address, hex_pub_key.c_str());
     
-    gms.tx_list.push_back(tx);
+    if (mempool_push(tx)) {
+      response = "fail";
+      return;
+      // throw JsonRpcException(-9, "mempool reject");
+    }
     
     response = "ok";
   }
@@ -255,38 +311,28 @@ class LocalServer : public AbstractServer<LocalServer> {
       return;
       // throw JsonRpcException(-1, "bad pub_key size");
     }
-    for(int i=0;i<2*t_pub_key_size;i++) {
-      char ch = hex_pub_key[i];
-      if ('0' <= ch && ch <= '9') continue;
-      if ('a' <= ch && ch <= 'f') continue;
-      if ('A' <= ch && ch <= 'A') continue;
+
+    string hex_prv_key = request["prv_key"].asString();
+    if (hex_prv_key.size() != 2*t_prv_key_size) {
       response = "fail";
       return;
-      // throw JsonRpcException(-1, "bad pub_key hex");
+      // throw JsonRpcException(-1, "bad prv_key size");
     }
     
-    string hex_prv_key = request["prv_key"].asString();
-    if (hex_prv_key.size() != 2*t_prv_key_size) {
+    t_pub_key pub_key;
+    t_prv_key prv_key;
+    
+    if (!str2t_pub_key(hex_pub_key, pub_key)) {
       response = "fail";
       return;
-      // throw JsonRpcException(-1, "bad prv_key size");
+      // throw JsonRpcException(-1, "bad pub_key hex");
     }
-    for(int i=0;i<2*t_prv_key_size;i++) {
-      char ch = hex_prv_key[i];
-      if ('0' <= ch && ch <= '9') continue;
-      if ('a' <= ch && ch <= 'f') continue;
-      if ('A' <= ch && ch <= 'A') continue;
+    if (!str2t_prv_key(hex_prv_key, prv_key)) {
       response = "fail";
       return;
       // throw JsonRpcException(-1, "bad prv_key hex");
     }
     
-    t_pub_key pub_key;
-    t_prv_key prv_key;
-    
-    str2t_pub_key(hex_pub_key, pub_key);
-    str2t_prv_key(hex_prv_key, prv_key);
-    
     if (gms.a2pk[address] != pub_key) {
       printf("debug_set_keyI %d\n", address);
       t_pub_key_print("pub_key           = ", pub_key);
@@ -320,4 +366,90 @@ class LocalServer : public AbstractServer<LocalServer> {
     response["pub_key"] = t_pub_key2str(pub_key);
     response["prv_key"] = t_prv_key2str(prv_key);
   }
+  
+  void debug_key_gen_bulkI(const Value &request, Value &response) {
+    u32 count = request["count"].asInt();
+    if (count == 0 || count > 100000) {
+      response = "fail";
+      return;
+      // throw JsonRpcException(-1, "count must be 1..100000");
+    }
+    vector<t_pub_key> pub_key_list;
+    vector<t_prv_key> prv_key_list;
+    if (!key_gen_bulk(count, pub_key_list, prv_key_list)) {
+      response = "fail";
+      return;
+      // throw JsonRpcException(-2, "error while generating keypair");
+    }
+    
+    response = Value(arrayValue);
+    for(u32 i=0;i<count;i++) {
+      Value key;
+      key["pub_key"] = t_pub_key2str(pub_key_list[i]);
+      key["prv_key"] = t_prv_key2str(prv_key_list[i]);
+      response.append(key);
+    }
+  }
+  
+  // verify kernel, built-in Bi table vs --verify_table_kb one, same scalars
+  void debug_verify_benchI(const Value &request, Value &response) {
+    u32 count = request["count"].asInt();
+    if (count == 0 || count > 100000) {
+      response = "fail";
+      return;
+      // throw JsonRpcException(-1, "count must be 1..100000");
+    }
+    ed25519_verify_context ctx;
+    if (!ed25519_verify_context_init(&ctx, my_pub_key.b)) {
+      response = "fail";
+      return;
+      // throw JsonRpcException(-2, "bad pub_key");
+    }
+    
+    const u32 scalar_count = 64;
+    u8 a[scalar_count][64], b[scalar_count][64];
+    for(u32 i=0;i<scalar_count;i++) {
+      ed25519_create_seed(a[i]);
+      ed25519_create_seed(a[i]+32);
+      ed25519_create_seed(b[i]);
+      ed25519_create_seed(b[i]+32);
+      sc_reduce(a[i]);
+      sc_reduce(b[i]);
+    }
+    
+    ge_p2 r;
+    u8 res_narrow[32], res_wide[32];
+    auto t0 = chrono::steady_clock::now();
+    for(u32 i=0;i<count;i++) {
+      ge_double_scalarmult_table_vartime(&r, a[i%scalar_count], ctx.Ai, b[i%scalar_count], Bi, 5);
+    }
+    ge_tobytes(res_narrow, &r);
+    auto t1 = chrono::steady_clock::now();
+    for(u32 i=0;i<count;i++) {
+      ge_double_scalarmult_cached_vartime(&r, a[i%scalar_count], ctx.Ai, b[i%scalar_count]);
+    }
+    ge_tobytes(res_wide, &r);
+    auto t2 = chrono::steady_clock::now();
+    
+    response["width"]     = ge_base_wide_width();
+    response["narrow_us"] = chrono::duration<double, micro>(t1-t0).count()/count;
+    response["wide_us"]   = chrono::duration<double, micro>(t2-t1).count()/count;
+    response["match"]     = !memcmp(res_narrow, res_wide, 32);
+    // base row lookup: AVX2 in use, and AVX2 vs scalar mismatches (-1 no AVX2)
+    response["select_avx2"]     = ge_select_init();
+    response["select_mismatch"] = ge_select_check();
+  }
+  
+  void debug_chain_rollbackI(const Value &request, Value &response) {
+    u32 count = request["count"].asInt();
+    auto t0 = chrono::steady_clock::now();
+    if (!chain_rollback(count)) {
+      response = "fail";
+      return;
+      // throw JsonRpcException(-1, "count must be 0..undo depth");
+    }
+    auto t1 = chrono::steady_clock::now();
+    response["bc_height"] = bc_height();
+    response["undo_us"]   = chrono::duration<double, micro>(t1-t0).count();
+  }
 };
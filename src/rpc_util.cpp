@@ -10,20 +10,179 @@ void rpc_get_node_list(const Value &request, Value &response) {
   }
 }
 void rpc_get_block_number(const Value &request, Value &response) {
-  // не совсем конкретно, т.к. есть offset
-  // если вылетаем за пределы offset'а снизу, то надо читать с базы...
+  // ниже offset'а блоки читаются из block_log
   i64 id = request["id"].asInt();
   if (id < 0) {
     response = "fail";
     return;
     // throw JsonRpcException(-1, "id < 0");
   }
-  if (id >= gms.main_chain_block_list.size()) {
+  if (id >= bc_height()) {
     response = "fail";
     return;
     // throw JsonRpcException(-1, "id not exists");
   }
-  block_to_json(gms.main_chain_block_list[id], response);
+  auto wire = block_wire_get(id);
+  if (wire) {
+    response = wire->json;
+    return;
+  }
+  Block block;
+  if (!block_get(id, block)) {
+    response = "fail";
+    return;
+    // throw JsonRpcException(-1, "block log read failed");
+  }
+  block_to_json(block, response);
+}
+void rpc_get_block_by_hash(const Value &request, Value &response) {
+  t_hash hash;
+  u32 id;
+  if (!str2t_hash(request["hash"].asString(), hash) || !block_log_find(hash, id)) {
+    response = "fail";
+    return;
+    // throw JsonRpcException(-1, "hash not exists");
+  }
+  Value param;
+  param["id"] = id;
+  rpc_get_block_number(param, response);
+}
+
+// same block packed (block_pack), hex, ~2x smaller than json and no tree to parse
+void rpc_get_block_bin(const Value &request, Value &response) {
+  i64 id = request["id"].asInt();
+  if (id < 0 || id >= bc_height()) {
+    response = "fail";
+    return;
+    // throw JsonRpcException(-1, "id not exists");
+  }
+  auto wire = block_wire_get(id);
+  if (wire) {
+    response = wire->bin;
+    return;
+  }
+  Block block;
+  if (main_chain_tail_get(id, block)) {
+    response = block_to_hex(block);
+    return;
+  }
+  // log frames are block_pack already
+  vector<u8> buf;
+  if (!block_log_read(id, buf)) {
+    response = "fail";
+    return;
+    // throw JsonRpcException(-1, "block log read failed");
+  }
+  response = buf2hex(buf.data(), buf.size());
+}
+
+// the pack itself comes from the pack port, GET /pack/<id>
+void rpc_get_pack_info(const Value &request, Value &response) {
+  i64 id = request["id"].asInt();
+  u32 count;
+  {
+    lock_guard<mutex> guard(pack_state.lock);
+    count = pack_state.count;
+  }
+  struct stat st;
+  if (id < 0 || id >= count || stat(pack_path(id).c_str(), &st)) {
+    response = "fail";
+    return;
+    // throw JsonRpcException(-1, "pack not exists");
+  }
+  response["id"]          = (u32)id;
+  response["first_id"]    = (u32)id*pack_block_count;
+  response["block_count"] = pack_block_count;
+  response["pack_count"]  = count;
+  response["size"]        = (u64)st.st_size;
+  response["port"]        = RPC_PACK_PORT;
+}
+
+void rpc_get_weight_rank(const Value &request, Value &response) {
+  u32 address;
+  if (!address_json_parse(request["address"], address)) {
+    response = "fail";
+    return;
+    // throw JsonRpcException(-1, "Invalid address");
+  }
+  auto &w = weight_index;
+  lock_guard<mutex> guard(w.lock);
+  if (address >= w.key_list.size()) {
+    response = "fail";
+    return;
+    // throw JsonRpcException(-1, "Address not exists");
+  }
+  Weight_key key(w.key_list[address], address);
+  response["address"]       = address;
+  response["weight"]        = weight_from_key(key.first);
+  // 1 = heaviest
+  response["rank"]          = (u32)w.tree.order_of_key(key) + 1;
+  response["account_count"] = (u32)w.tree.size();
+}
+
+const u32 top_weights_limit = 1000;
+void rpc_get_top_weights(const Value &request, Value &response) {
+  i64 count = request["count"].asInt();
+  if (count <= 0 || count > top_weights_limit) {
+    response = "fail";
+    return;
+    // throw JsonRpcException(-1, "count must be 1..1000");
+  }
+  auto &w = weight_index;
+  lock_guard<mutex> guard(w.lock);
+  response = Value(arrayValue);
+  for(auto it = w.tree.begin(); it != w.tree.end() && count--; it++) {
+    Value item;
+    item["address"] = it->second;
+    item["weight"]  = weight_from_key(it->first);
+    response.append(item);
+  }
+}
+
+void rpc_get_tx_proof(const Value &request, Value &response) {
+  i64 id = request["id"].asInt();
+  Block block;
+  if (id < 0 || !block_get(id, block)) {
+    response = "fail";
+    return;
+    // throw JsonRpcException(-1, "id not exists");
+  }
+  t_hash hash;
+  if (!str2t_hash(request["hash"].asString(), hash)) {
+    response = "fail";
+    return;
+    // throw JsonRpcException(-1, "bad hash");
+  }
+  if (block.header.version < 2) {
+    response = "fail";
+    return;
+    // throw JsonRpcException(-1, "block has no merkle tree");
+  }
+  u32 idx = 0, len = block.tx_list.size();
+  while(idx < len && block.tx_list[idx].hash != hash) idx++;
+  if (idx == len) {
+    response = "fail";
+    return;
+    // throw JsonRpcException(-1, "tx not in block");
+  }
+  Merkle_tree tree;
+  merkle_tree_build(block.tx_list, tree);
+  vector<t_hash> path;
+  merkle_tree_proof(tree, idx, path);
+  
+  Tx &tx = block.tx_list[idx];
+  Value json_tx;
+  tx_to_json(tx, json_tx);
+  Value json_path(arrayValue);
+  FOR_COL(it, path) {
+    json_path.append(t_hash2str(*it));
+  }
+  response["tx"]          = json_tx;
+  response["tx_index"]    = idx;
+  response["tx_count"]    = len;
+  response["leaf"]        = t_hash2str(tree.level_list[0][idx]);
+  response["path"]        = json_path;
+  response["merkle_tree"] = t_hash2str(block.header.merkle_tree);
 }
 
 void rpc_tx_push(const Value &request, Value &response) {
@@ -45,8 +204,7 @@ void rpc_tx_push(const Value &request, Value &response) {
     return;
     // throw JsonRpcException(-1, "bad bind_pub_key");
   }
-  // will be later
-  // tx.tx_epoch = request["tx_epoch"].asInt();
+  tx.tx_epoch = request["tx_epoch"].asInt();
   tx.nonce    = request["nonce"].asInt();
   
   if (!str2t_hash(request["hash"].asString(), tx.hash)) {
@@ -67,5 +225,9 @@ void rpc_tx_push(const Value &request, Value &response) {
     // throw JsonRpcException(-1, "validation fail");
   }
   
-  gms.tx_list.push_back(tx);
+  if (mempool_push(tx)) {
+    response = "fail";
+    return;
+    // throw JsonRpcException(-9, "mempool reject");
+  }
 }
\ No newline at end of file
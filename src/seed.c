@@ -1,6 +1,8 @@
 #include "ed25519.h"
 
 #include <stdio.h>
+#include <errno.h>
+#include <sys/random.h>
 
 int ed25519_create_seed(u8 *seed) {
     FILE *f = fopen("/dev/urandom", "rb");
@@ -15,3 +17,26 @@ int ed25519_create_seed(u8 *seed) {
     return 0;
 }
 
+
+/* num seeds (32 bytes each) straight from getrandom(), no file per seed */
+int ed25519_create_seeds(u8 *seeds, size_t num) {
+    size_t len = 32 * num;
+    size_t done = 0;
+    ssize_t res;
+
+    while (done < len) {
+        res = getrandom(seeds + done, len - done, 0);
+
+        if (res < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            return 1;
+        }
+
+        done += res;
+    }
+
+    return 0;
+}
@@ -271,3 +271,148 @@ int sha512(const u8 *message, size_t message_len, u8 *out)
     if ((ret = sha512_final(&ctx, out))) return ret;
     return 0;
 }
+
+
+/* multi-buffer: independent short messages hashed side by side in vector lanes */
+
+typedef struct {
+    const u8 *in;
+    size_t inlen;
+    size_t full;      /* whole blocks read straight from in */
+    size_t blocks;    /* full + 1 or 2 padding blocks */
+    u8 tail[256];
+} sha512_lane;
+
+static void sha512_lane_init(sha512_lane *l, const u8 *in, size_t inlen) {
+    size_t rem = inlen & 127;
+    l->in = in;
+    l->inlen = inlen;
+    l->full = inlen >> 7;
+    l->blocks = l->full + (rem < 112 ? 1 : 2);
+    memset(l->tail, 0, sizeof(l->tail));
+    memcpy(l->tail, in + 128 * l->full, rem);
+    l->tail[rem] = (u8)0x80;
+    STORE64H((u64)inlen * 8, l->tail + 128 * (l->blocks - l->full) - 8);
+}
+
+/* finished (or unused) lanes keep hashing their tail, result is dropped */
+static const u8 *sha512_lane_block(const sha512_lane *l, size_t k) {
+    if (k < l->full) return l->in + 128 * k;
+    if (k < l->blocks) return l->tail + 128 * (k - l->full);
+    return l->tail;
+}
+
+#define MB_RND(a,b,c,d,e,f,g,h,i) \
+    t0 = h + Sigma1(e) + Ch(e, f, g) + K[i] + W[i]; \
+    t1 = Sigma0(a) + Maj(a, b, c);\
+    d += t0; \
+    h  = t0 + t1;
+
+#define SHA512_MB_KERNEL(name, target_, lanes)                                        \
+typedef u64 name##_v __attribute__((vector_size(8 * (lanes))));                       \
+__attribute__((target(target_)))                                                     \
+static void name(const sha512_lane *l, size_t num, u8 *const *out) {                 \
+    name##_v st[8], S[8], W[80], t0, t1, zero = {0};                                  \
+    u64 w[16][lanes];                                                                 \
+    sha512_context iv;                                                                \
+    const u8 *p;                                                                      \
+    size_t k, j, max = 0;                                                             \
+    int i;                                                                            \
+    sha512_init(&iv);                                                                 \
+    for (i = 0; i < 8; i++) {                                                         \
+        st[i] = zero + iv.state[i];                                                   \
+    }                                                                                 \
+    for (j = 0; j < num; j++) {                                                       \
+        if (l[j].blocks > max) max = l[j].blocks;                                     \
+    }                                                                                 \
+    for (k = 0; k < max; k++) {                                                       \
+        for (j = 0; j < lanes; j++) {                                                 \
+            p = sha512_lane_block(&l[j < num ? j : 0], k);                            \
+            for (i = 0; i < 16; i++) {                                                \
+                LOAD64H(w[i][j], p + 8 * i);                                          \
+            }                                                                         \
+        }                                                                             \
+        for (i = 0; i < 16; i++) {                                                    \
+            memcpy(&W[i], w[i], sizeof(W[i]));                                        \
+        }                                                                             \
+        for (i = 16; i < 80; i++) {                                                   \
+            W[i] = Gamma1(W[i - 2]) + W[i - 7] + Gamma0(W[i - 15]) + W[i - 16];       \
+        }                                                                             \
+        for (i = 0; i < 8; i++) {                                                     \
+            S[i] = st[i];                                                             \
+        }                                                                             \
+        for (i = 0; i < 80; i += 8) {                                                 \
+            MB_RND(S[0],S[1],S[2],S[3],S[4],S[5],S[6],S[7],i+0);                      \
+            MB_RND(S[7],S[0],S[1],S[2],S[3],S[4],S[5],S[6],i+1);                      \
+            MB_RND(S[6],S[7],S[0],S[1],S[2],S[3],S[4],S[5],i+2);                      \
+            MB_RND(S[5],S[6],S[7],S[0],S[1],S[2],S[3],S[4],i+3);                      \
+            MB_RND(S[4],S[5],S[6],S[7],S[0],S[1],S[2],S[3],i+4);                      \
+            MB_RND(S[3],S[4],S[5],S[6],S[7],S[0],S[1],S[2],i+5);                      \
+            MB_RND(S[2],S[3],S[4],S[5],S[6],S[7],S[0],S[1],i+6);                      \
+            MB_RND(S[1],S[2],S[3],S[4],S[5],S[6],S[7],S[0],i+7);                      \
+        }                                                                             \
+        for (i = 0; i < 8; i++) {                                                     \
+            st[i] += S[i];                                                            \
+        }                                                                             \
+        for (j = 0; j < num; j++) {                                                   \
+            if (l[j].blocks != k + 1) continue;                                       \
+            for (i = 0; i < 8; i++) {                                                 \
+                STORE64H(st[i][j], out[j] + 8 * i);                                   \
+            }                                                                         \
+        }                                                                             \
+    }                                                                                 \
+}
+
+SHA512_MB_KERNEL(sha512_mb_sse4,   "sse4.2",  2)
+SHA512_MB_KERNEL(sha512_mb_avx2,   "avx2",    4)
+SHA512_MB_KERNEL(sha512_mb_avx512, "avx512f", 8)
+
+static void sha512_mb_scalar(const sha512_lane *l, size_t num, u8 *const *out) {
+    size_t j;
+    for (j = 0; j < num; j++) {
+        sha512(l[j].in, l[j].inlen, out[j]);
+    }
+}
+
+static void (*sha512_mb_kernel)(const sha512_lane *l, size_t num, u8 *const *out) = NULL;
+static size_t sha512_mb_lanes = 1;
+
+/* best kernel for this CPU, picked once */
+size_t sha512_multi_init(void) {
+    if (sha512_mb_kernel != NULL) return sha512_mb_lanes;
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) {
+        sha512_mb_lanes = 8;
+        sha512_mb_kernel = sha512_mb_avx512;
+    } else if (__builtin_cpu_supports("avx2")) {
+        sha512_mb_lanes = 4;
+        sha512_mb_kernel = sha512_mb_avx2;
+    } else if (__builtin_cpu_supports("sse4.2")) {
+        sha512_mb_lanes = 2;
+        sha512_mb_kernel = sha512_mb_sse4;
+    } else {
+        sha512_mb_lanes = 1;
+        sha512_mb_kernel = sha512_mb_scalar;
+    }
+    return sha512_mb_lanes;
+}
+
+/**
+   Hash num independent messages, lane-parallel
+   @param messages      The messages
+   @param message_lens  Their lengths (octets)
+   @param num           Number of messages
+   @param out           [out] Destinations (64 bytes each)
+*/
+void sha512_multi(const u8 *const *messages, const size_t *message_lens, size_t num, u8 *const *out) {
+    sha512_lane l[8];
+    size_t i, j, len;
+    sha512_multi_init();
+    for (i = 0; i < num; i += len) {
+        len = min(num - i, sha512_mb_lanes);
+        for (j = 0; j < len; j++) {
+            sha512_lane_init(&l[j], messages[i + j], message_lens[i + j]);
+        }
+        sha512_mb_kernel(l, len, out + i);
+    }
+}
@@ -14,3 +14,6 @@ int sha512_init(sha512_context * md);
 int sha512_final(sha512_context * md, u8 *out);
 int sha512_update(sha512_context * md, const u8 *in, size_t inlen);
 int sha512(const u8 *message, size_t message_len, u8 *out);
+
+size_t sha512_multi_init(void);
+void sha512_multi(const u8 *const *messages, const size_t *message_lens, size_t num, u8 *const *out);
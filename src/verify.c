@@ -1,3 +1,6 @@
+#include <stdio.h>
+#include <string.h>
+
 #include "ed25519.h"
 #include "sha512.h"
 #include "ge.h"
@@ -44,34 +47,207 @@ static int consttime_equal(const u8 *x, const u8 *y) {
     return !r;
 }
 
-int ed25519_verify(const u8 *signature, const u8 *message, size_t message_len, const u8 *public_key) {
+/*
+Everything ed25519_verify needs from the public key alone: the point -A
+(a square root to decompress) and its odd multiples. A sender that signs
+many messages pays for both once.
+*/
+
+struct ed25519_verify_context {
+    u8 public_key[32];
+    ge_p3 A;
+    ge_cached Ai[8];
+};
+
+int ed25519_verify_context_init(ed25519_verify_context *context, const u8 *public_key) {
+    if (ge_frombytes_negate_vartime(&context->A, public_key) != 0) {
+        return 0;
+    }
+
+    memcpy(context->public_key, public_key, 32);
+    ge_p3_odd_multiples(context->Ai, &context->A);
+    return 1;
+}
+
+/* -R from the first half of a signature, R has to be in canonical form */
+static int signature_r_negate(ge_p3 *r, const u8 *signature) {
+    u8 check[32];
+    fe x;
+
+    if (ge_frombytes_negate_vartime(r, signature) != 0) {
+        return 0;
+    }
+
+    fe_tobytes(check, r->Y);
+    fe_neg(x, r->X);
+    check[31] ^= fe_isnegative(x) << 7;
+    return consttime_equal(check, signature);
+}
+
+/* [8]p == 0, p is overwritten */
+static int ge_p2_is_small_order(ge_p2 *p) {
+    ge_p1p1 t;
+    fe x;
+
+    ge_p2_dbl(&t, p);
+    ge_p1p1_to_p2(p, &t);
+    ge_p2_dbl(&t, p);
+    ge_p1p1_to_p2(p, &t);
+    ge_p2_dbl(&t, p);
+    ge_p1p1_to_p2(p, &t);
+
+    /* identity is (0:Z:Z) */
+    fe_sub(x, p->Y, p->Z);
+    return !fe_isnonzero(p->X) && !fe_isnonzero(x);
+}
+
+/*
+Cofactored check [8](sB - hA - R) == 0, the same rule as ed25519_verify_batch,
+so a signature is valid or not whatever path checks it. Honest signatures pass
+both rules, they differ only for R or A with a small order component.
+*/
+
+int ed25519_verify_with_context(const u8 *signature, const u8 *message, size_t message_len, const ed25519_verify_context *context) {
     u8 h[64];
-    u8 checker[32];
     sha512_context hash;
-    ge_p3 A;
+    ge_p3 neg_r;
+    ge_p3 p;
+    ge_cached c;
+    ge_p1p1 t;
     ge_p2 R;
 
     if (signature[63] & 224) {
         return 0;
     }
 
-    if (ge_frombytes_negate_vartime(&A, public_key) != 0) {
+    if (!signature_r_negate(&neg_r, signature)) {
         return 0;
     }
 
     sha512_init(&hash);
     sha512_update(&hash, signature, 32);
-    sha512_update(&hash, public_key, 32);
+    sha512_update(&hash, context->public_key, 32);
     sha512_update(&hash, message, message_len);
     sha512_final(&hash, h);
     
     sc_reduce(h);
-    ge_double_scalarmult_vartime(&R, h, &A, signature + 32);
-    ge_tobytes(checker, &R);
+    ge_double_scalarmult_cached_vartime(&R, h, context->Ai, signature + 32);
+
+    /* p2 -> p3: (XZ:YZ:Z^2:XY) */
+    fe_mul(p.X, R.X, R.Z);
+    fe_mul(p.Y, R.Y, R.Z);
+    fe_sq(p.Z, R.Z);
+    fe_mul(p.T, R.X, R.Y);
+    ge_p3_to_cached(&c, &neg_r);
+    ge_add(&t, &p, &c);
+    ge_p1p1_to_p2(&R, &t);
 
-    if (!consttime_equal(checker, signature)) {
+    return ge_p2_is_small_order(&R);
+}
+
+int ed25519_verify(const u8 *signature, const u8 *message, size_t message_len, const u8 *public_key) {
+    ed25519_verify_context context;
+
+    if (signature[63] & 224) {
         return 0;
     }
 
-    return 1;
+    if (!ed25519_verify_context_init(&context, public_key)) {
+        return 0;
+    }
+
+    return ed25519_verify_with_context(signature, message, message_len, &context);
+}
+
+/*
+Batch verification of num signatures with one randomized multi-scalar multiplication:
+  [8]( sum (z_i*h_i)(-A_i) + (sum z_i*s_i) B + sum z_i(-R_i) ) == 0
+z_i are random 128-bit scalars. The check is cofactored, so it can't depend on z_i,
+and so is ed25519_verify: a chunk passes only if every signature in it would.
+If a chunk fails, its signatures are checked one by one with ed25519_verify.
+valid[i] gets the result for every signature; returns 1 if all are valid.
+*/
+
+#define ED25519_BATCH_MAX 64
+
+static int batch_chunk_verify(const u8 **signatures, const u8 **messages, const size_t *message_lens, const u8 **public_keys, size_t num) {
+    static const u8 zero[32] = {0};
+    u8 z[ED25519_BATCH_MAX][32];
+    u8 scalars[2 * ED25519_BATCH_MAX][32];
+    ge_p3 points[2 * ED25519_BATCH_MAX];
+    u8 b[32] = {0};
+    u8 h[64];
+    sha512_context hash;
+    ge_p2 r;
+    size_t i;
+
+    if (ed25519_create_seeds(z[0], num) != 0) {
+        return 0;
+    }
+
+    for (i = 0; i < num; ++i) {
+        memset(z[i] + 16, 0, 16);
+        z[i][0] |= 1;
+    }
+
+    for (i = 0; i < num; ++i) {
+        if (signatures[i][63] & 224) {
+            return 0;
+        }
+
+        if (ge_frombytes_negate_vartime(&points[2 * i], public_keys[i]) != 0) {
+            return 0;
+        }
+
+        if (!signature_r_negate(&points[2 * i + 1], signatures[i])) {
+            return 0;
+        }
+
+        sha512_init(&hash);
+        sha512_update(&hash, signatures[i], 32);
+        sha512_update(&hash, public_keys[i], 32);
+        sha512_update(&hash, messages[i], message_lens[i]);
+        sha512_final(&hash, h);
+        sc_reduce(h);
+
+        sc_muladd(scalars[2 * i], z[i], h, zero);
+        memcpy(scalars[2 * i + 1], z[i], 32);
+        sc_muladd(b, z[i], signatures[i] + 32, b);
+    }
+
+    if (ge_multi_scalarmult_vartime(&r, (const u8 *) scalars, points, 2 * num, b) != 0) {
+        return 0;
+    }
+
+    return ge_p2_is_small_order(&r);
+}
+
+int ed25519_verify_batch(const u8 **signatures, const u8 **messages, const size_t *message_lens, const u8 **public_keys, size_t num, int *valid) {
+    size_t i;
+    size_t j;
+    size_t len;
+    int res = 1;
+
+    for (i = 0; i < num; i += len) {
+        len = num - i;
+
+        if (len > ED25519_BATCH_MAX) {
+            len = ED25519_BATCH_MAX;
+        }
+
+        if (batch_chunk_verify(signatures + i, messages + i, message_lens + i, public_keys + i, len)) {
+            for (j = i; j < i + len; ++j) {
+                valid[j] = 1;
+            }
+
+            continue;
+        }
+
+        for (j = i; j < i + len; ++j) {
+            valid[j] = ed25519_verify(signatures[j], messages[j], message_lens[j], public_keys[j]);
+            res &= valid[j];
+        }
+    }
+
+    return res;
 }